@@ -0,0 +1,81 @@
+#pragma once
+#ifndef ISMRMRD_COMPRESSION_H
+#define ISMRMRD_COMPRESSION_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ismrmrd/export.h"
+#include "ismrmrd/ismrmrd.h"
+
+/**
+ * @file compression.h
+ *
+ * @brief Compression of message payloads (sample and pixel data)
+ *
+ * The codecs are lossless, apart from the quantized codec of acquisitions
+ * (quantization.h). Deflate is provided by zlib, which is an optional
+ * dependency: a library built without it does not support any codec, which
+ * compression_supported() reports, so that a client only sends compressed
+ * messages to a server that can read them.
+ */
+
+namespace ISMRMRD {
+
+enum ISMRMRD_CompressionCodecs {
+    ISMRMRD_COMPRESSION_NONE = 0,
+    // zlib deflate of the payload bytes
+    ISMRMRD_COMPRESSION_DEFLATE = 1,
+    // deflate after grouping the bytes of the payload by their position in each
+    // element (as the HDF5 shuffle filter does), which compresses floating point
+    // data considerably better
+    ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE = 2,
+    // acquisitions only: the samples are quantized with a bounded error before
+    // shuffle+deflate (QuantizingCodec)
+    ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE = 3
+};
+
+// Largest payload of a compressed message, before or after compression. zlib
+// takes the sizes of a payload deflated in one call as 32 bit integers.
+const uint64_t ISMRMRD_MAX_COMPRESSED_PAYLOAD = 0xffffffffu;
+
+// Whether this build of the library can compress and decompress with codec
+EXPORTISMRMRD bool compression_supported(uint16_t codec);
+
+// Largest compressed payload of size bytes with any codec, deflate expands data
+// that does not compress by a few bytes per block. A receiver rejects larger
+// payloads before allocating them.
+EXPORTISMRMRD uint64_t compressed_size_bound(uint64_t size);
+
+// Compresses and decompresses payloads. Keeps the compressor state and scratch
+// buffers between calls, so that compressing a stream of messages does not
+// allocate for every message. Not thread safe.
+class EXPORTISMRMRD PayloadCodec {
+public:
+    PayloadCodec();
+    ~PayloadCodec();
+
+    // Compresses size bytes made of elements of element_size bytes (the shuffle
+    // width, the size of a real or imaginary part for complex data) into out.
+    // level is the zlib level from 1 (fastest) to 9 (smallest), -1 for the default.
+    void compress(uint16_t codec, int level, size_t element_size, const void *data, size_t size,
+                  std::vector<char> &out);
+
+    // Decompresses into exactly size bytes at data, throws if the compressed
+    // payload does not hold that many bytes.
+    void decompress(uint16_t codec, size_t element_size, const void *compressed, size_t compressed_size,
+                    void *data, size_t size);
+
+private:
+    PayloadCodec(const PayloadCodec &);
+    PayloadCodec &operator=(const PayloadCodec &);
+
+    void *_deflate;
+    int _deflate_level;
+    void *_inflate;
+    std::vector<char> _shuffled;
+};
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_COMPRESSION_H
@@ -46,6 +46,17 @@ EXPORTISMRMRD int ismrmrd_init_dataset(ISMRMRD_Dataset *dset, const char *filena
  */
 EXPORTISMRMRD int ismrmrd_open_dataset(ISMRMRD_Dataset *dset, const bool create_if_needed);
 
+/**
+ * Opens an existing ISMRMRD dataset for reading only.
+ *
+ * Unlike ismrmrd_open_dataset, no read-write open is attempted and the group is
+ * not created, which makes opening many archived files considerably cheaper.
+ * File locking can be disabled for files on read-only or network file systems
+ * (requires HDF5 1.10.7 or later).
+ *
+ */
+EXPORTISMRMRD int ismrmrd_open_dataset_readonly(ISMRMRD_Dataset *dset, const bool use_file_locking);
+
 /**
  * Closes all references to the underlying HDF5 file.
  *
@@ -75,11 +86,79 @@ EXPORTISMRMRD char * ismrmrd_read_header(const ISMRMRD_Dataset *dset);
  */
 EXPORTISMRMRD int ismrmrd_append_acquisition(const ISMRMRD_Dataset *dset, const ISMRMRD_Acquisition *acq);
 
+/**
+ *  Appends count acquisitions to the dataset with a single HDF5 write.
+ */
+EXPORTISMRMRD int ismrmrd_append_acquisitions(const ISMRMRD_Dataset *dset, const ISMRMRD_Acquisition *acqs,
+                                              uint32_t count);
+
 /**
  *  Reads the acquisition with the specified index from the dataset.
  */
 EXPORTISMRMRD int ismrmrd_read_acquisition(const ISMRMRD_Dataset *dset, uint32_t index, ISMRMRD_Acquisition *acq);
 
+/**
+ *  Reads count consecutive acquisitions starting at index with a single HDF5 read.
+ *
+ *  acqs must point to count initialized acquisitions.
+ */
+EXPORTISMRMRD int ismrmrd_read_acquisitions(const ISMRMRD_Dataset *dset, uint32_t index, uint32_t count,
+                                            ISMRMRD_Acquisition *acqs);
+
+/**
+ *  Reads only the headers of count consecutive acquisitions starting at index.
+ */
+EXPORTISMRMRD int ismrmrd_read_acquisition_headers(const ISMRMRD_Dataset *dset, uint32_t index, uint32_t count,
+                                                   ISMRMRD_AcquisitionHeader *heads);
+
+/**
+ *  Reads a single header member of count consecutive acquisitions starting at index into a
+ *  contiguous array, e.g. "scan_counter", "position" or "idx.slice".
+ *
+ *  Only the member is converted (a compound subset of the acquisition type), array members
+ *  such as "position" yield one group of elements per acquisition. size is the size of
+ *  values in bytes and must equal count times the size of the member.
+ */
+EXPORTISMRMRD int ismrmrd_read_acquisition_header_member(const ISMRMRD_Dataset *dset, const char *member,
+                                                         uint32_t index, uint32_t count, void *values,
+                                                         size_t size);
+
+/**
+ *  Stores the acquisitions of src in dst physically sorted by the encoding counters in keys
+ *  (ISMRMRD_EncodingCounterKeys, most significant first). The sort is stable.
+ *
+ *  If dst and src are the same dataset, the acquisitions are sorted in place. The space of the
+ *  unsorted acquisitions is only returned to the file system by repacking (e.g. h5repack), so
+ *  sorting into a new file is preferable for large datasets. Otherwise dst must not contain
+ *  acquisitions yet.
+ *
+ *  The permutation is stored in groupname/acquisition_order, see ismrmrd_read_acquisition_order.
+ */
+EXPORTISMRMRD int ismrmrd_sort_acquisitions(const ISMRMRD_Dataset *dst, const ISMRMRD_Dataset *src,
+                                            const int *keys, uint16_t nkeys);
+
+/**
+ *  Fills order with the original position of each stored acquisition, i.e. order[i] is
+ *  the index the acquisition now at position i had when it was acquired.
+ *
+ *  order must have room for ismrmrd_get_number_of_acquisitions elements. Unsorted datasets
+ *  and acquisitions appended after sorting map to themselves.
+ */
+EXPORTISMRMRD int ismrmrd_read_acquisition_order(const ISMRMRD_Dataset *dset, uint32_t *order);
+
+/**
+ *  Returns the keys the acquisitions were sorted by, nkeys is 0 for unsorted datasets.
+ */
+EXPORTISMRMRD int ismrmrd_get_acquisition_sort_keys(const ISMRMRD_Dataset *dset,
+                                                    int keys[ISMRMRD_IDX_NUMBER_OF_KEYS], uint16_t *nkeys);
+
+/**
+ *  Finds the contiguous range of sorted acquisitions whose leading nvalues sort keys equal values,
+ *  e.g. all acquisitions of one slice when the dataset is sorted by slice first.
+ */
+EXPORTISMRMRD int ismrmrd_find_acquisition_range(const ISMRMRD_Dataset *dset, const uint16_t *values,
+                                                 uint16_t nvalues, uint32_t *first, uint32_t *count);
+
 /**
  *  Return the number of acquisitions in the dataset.
  */
@@ -92,11 +171,24 @@ EXPORTISMRMRD uint32_t ismrmrd_get_number_of_acquisitions(const ISMRMRD_Dataset
  */
 EXPORTISMRMRD int ismrmrd_append_waveform(const ISMRMRD_Dataset *dset, const ISMRMRD_Waveform *wav);
 
+/**
+ *  Appends count waveforms to the dataset with a single HDF5 write.
+ */
+EXPORTISMRMRD int ismrmrd_append_waveforms(const ISMRMRD_Dataset *dset, const ISMRMRD_Waveform *wavs, uint32_t count);
+
 /**
  *  Reads the  wveformith the specified index from the dataset.
  */
 EXPORTISMRMRD int ismrmrd_read_waveform(const ISMRMRD_Dataset *dset, uint32_t index, ISMRMRD_Waveform* wav);
 
+/**
+ *  Reads count consecutive waveforms starting at index with a single HDF5 read.
+ *
+ *  wavs must point to count initialized waveforms.
+ */
+EXPORTISMRMRD int ismrmrd_read_waveforms(const ISMRMRD_Dataset *dset, uint32_t index, uint32_t count,
+                                         ISMRMRD_Waveform *wavs);
+
 /**
  *  Return the number of waveforms in the dataset.
  */
@@ -117,6 +209,13 @@ EXPORTISMRMRD uint32_t ismrmrd_get_number_of_waveforms(const ISMRMRD_Dataset *ds
 EXPORTISMRMRD int ismrmrd_append_image(const ISMRMRD_Dataset *dset, const char *varname,
                                        const ISMRMRD_Image *im);
 
+/**
+ *  Appends count images of the same size and type to the variable named varname
+ *  with one HDF5 write each for their headers, attributes and data.
+ */
+EXPORTISMRMRD int ismrmrd_append_images(const ISMRMRD_Dataset *dset, const char *varname,
+                                        const ISMRMRD_Image *ims, uint32_t count);
+
 /**
  *   Reads an image stored with appendImage.
  *   The index indicates which image to read from the variable named varname.
@@ -154,15 +253,95 @@ EXPORTISMRMRD int ismrmrd_read_array(const ISMRMRD_Dataset *dataset, const char
  */
 EXPORTISMRMRD uint32_t ismrmrd_get_number_of_arrays(const ISMRMRD_Dataset *dset, const char *varname);
 
+/**
+ *  Copies the variable srcvar of src to dstvar in dst without decoding the elements.
+ *
+ *  A new variable is created with H5Ocopy. If dstvar already exists, the elements of
+ *  srcvar are appended to it: fixed size elements (images, arrays) are moved as raw
+ *  chunks, variable length elements (acquisitions, waveforms, attributes) in large
+ *  blocks. The element types and dimensions must match.
+ */
+EXPORTISMRMRD int ismrmrd_copy_variable(const ISMRMRD_Dataset *dst, const ISMRMRD_Dataset *src,
+                                        const char *srcvar, const char *dstvar);
+
+/**
+ *  Copies every variable of src into dst with ismrmrd_copy_variable.
+ *
+ *  The XML header of dst is kept if it has one. The acquisition order of a
+ *  sorted src is only copied into a dst without acquisitions, otherwise the
+ *  merged acquisitions keep their position after those of dst.
+ */
+EXPORTISMRMRD int ismrmrd_merge_dataset(const ISMRMRD_Dataset *dst, const ISMRMRD_Dataset *src);
+
     
 #ifdef __cplusplus
 } /* extern "C" */
 
+//  Open modes for read-only access, see ismrmrd_open_dataset_readonly
+enum DatasetOpenMode {
+    DATASET_READ_ONLY,
+    DATASET_READ_ONLY_NO_FILE_LOCKING
+};
+
+/**
+ *  All acquisition headers of a dataset stored column-wise (structure of arrays).
+ *
+ *  Each member of AcquisitionHeader becomes one contiguous vector with one entry per
+ *  acquisition; array members hold their elements consecutively per acquisition, e.g.
+ *  position[3*n+1] is the y position of acquisition n. Filled by
+ *  Dataset::readAcquisitionHeaderTable, single columns can be read with
+ *  Dataset::readAcquisitionHeaderColumn.
+ */
+struct EXPORTISMRMRD AcquisitionHeaderTable {
+    AcquisitionHeaderTable();
+
+    // Number of acquisitions (rows)
+    uint32_t size() const;
+    // Column of an encoding counter, key must not be ISMRMRD_IDX_NUMBER_OF_KEYS
+    const std::vector<uint16_t> &counter(ISMRMRD_EncodingCounterKeys key) const;
+    // Sorted distinct values of an encoding counter
+    std::vector<uint16_t> uniqueCounterValues(ISMRMRD_EncodingCounterKeys key) const;
+    // Smallest and largest value of an encoding counter, false if the table is empty
+    bool counterRange(ISMRMRD_EncodingCounterKeys key, uint16_t &min, uint16_t &max) const;
+    // Indices of the acquisitions where the encoding counter equals value
+    std::vector<uint32_t> selectCounterValue(ISMRMRD_EncodingCounterKeys key, uint16_t value) const;
+    // Indices of the acquisitions with the flag set
+    std::vector<uint32_t> selectFlag(uint64_t flag) const;
+
+    uint32_t number_of_acquisitions;
+    std::vector<uint16_t> version;
+    std::vector<uint64_t> flags;
+    std::vector<uint32_t> measurement_uid;
+    std::vector<uint32_t> scan_counter;
+    std::vector<uint32_t> acquisition_time_stamp;
+    std::vector<uint32_t> physiology_time_stamp;    // ISMRMRD_PHYS_STAMPS per acquisition
+    std::vector<uint16_t> number_of_samples;
+    std::vector<uint16_t> available_channels;
+    std::vector<uint16_t> active_channels;
+    std::vector<uint64_t> channel_mask;             // ISMRMRD_CHANNEL_MASKS per acquisition
+    std::vector<uint16_t> discard_pre;
+    std::vector<uint16_t> discard_post;
+    std::vector<uint16_t> center_sample;
+    std::vector<uint16_t> encoding_space_ref;
+    std::vector<uint16_t> trajectory_dimensions;
+    std::vector<float> sample_time_us;
+    std::vector<float> position;                    // 3 per acquisition
+    std::vector<float> read_dir;                    // 3 per acquisition
+    std::vector<float> phase_dir;                   // 3 per acquisition
+    std::vector<float> slice_dir;                   // 3 per acquisition
+    std::vector<float> patient_table_position;      // 3 per acquisition
+    // Encoding counters (idx), indexed by ISMRMRD_EncodingCounterKeys
+    std::vector<std::vector<uint16_t> > idx;
+    std::vector<int32_t> user_int;                  // ISMRMRD_USER_INTS per acquisition
+    std::vector<float> user_float;                  // ISMRMRD_USER_FLOATS per acquisition
+};
+
 //  ISMRMRD Dataset C++ Interface
 class EXPORTISMRMRD Dataset {
 public:
     // Constructor and destructor
     Dataset(const char* filename, const char* groupname, bool create_file_if_needed = true);
+    Dataset(const char* filename, const char* groupname, DatasetOpenMode mode);
     ~Dataset();
     
     // Methods
@@ -171,23 +350,52 @@ public:
     void readHeader(std::string& xmlstring);
     // Acquisitions
     void appendAcquisition(const Acquisition &acq);
+    // Appends an acquisition from buffers owned by the caller, without copying them
+    void appendAcquisition(const AcquisitionView &acq);
+    void appendAcquisition(const ISMRMRD_Acquisition *acq);
+    // Appends count acquisitions with a single HDF5 write
+    void appendAcquisitions(const Acquisition *acqs, size_t count);
     void readAcquisition(uint32_t index, Acquisition &acq);
+    void readAcquisitions(uint32_t index, uint32_t count, std::vector<Acquisition> &acqs);
+    void readAcquisitionHeaders(uint32_t index, uint32_t count, std::vector<AcquisitionHeader> &heads);
+    void readAcquisitionHeaderTable(AcquisitionHeaderTable &table);
+    // Single header member of all acquisitions, e.g. "idx.slice" (width 1) or "position" (width 3).
+    // T must be the type of the member.
+    template <typename T> void readAcquisitionHeaderColumn(const std::string &member, std::vector<T> &column,
+                                                           size_t width = 1);
     uint32_t getNumberOfAcquisitions();
+    // Encoding sorted layout
+    void sortAcquisitions(const std::vector<ISMRMRD_EncodingCounterKeys> &keys);
+    void sortAcquisitions(const Dataset &src, const std::vector<ISMRMRD_EncodingCounterKeys> &keys);
+    void getAcquisitionOrder(std::vector<uint32_t> &order);
+    std::vector<ISMRMRD_EncodingCounterKeys> getAcquisitionSortKeys();
+    void findAcquisitionRange(const std::vector<uint16_t> &values, uint32_t &first, uint32_t &count);
     // Images
     template <typename T> void appendImage(const std::string &var, const Image<T> &im);
+    template <typename T> void appendImage(const std::string &var, const ImageView<T> &im);
+    // Appends count images of the same size and type with one HDF5 write each
+    // for their headers, attributes and data
+    template <typename T> void appendImages(const std::string &var, const Image<T> *ims, size_t count);
     void appendImage(const std::string &var, const ISMRMRD_Image *im);
     template <typename T> void readImage(const std::string &var, uint32_t index, Image<T> &im);
     uint32_t getNumberOfImages(const std::string &var);
     // NDArrays
     template <typename T> void appendNDArray(const std::string &var, const NDArray<T> &arr);
+    template <typename T> void appendNDArray(const std::string &var, const NDArrayView<T> &arr);
     void appendNDArray(const std::string &var, const ISMRMRD_NDArray *arr);
     template <typename T> void readNDArray(const std::string &var, uint32_t index, NDArray<T> &arr);
     uint32_t getNumberOfNDArrays(const std::string &var);
 
     //Waveforms
     void appendWaveform(const Waveform &wav);
+    void appendWaveforms(const Waveform *wavs, size_t count);
     void readWaveform(uint32_t index, Waveform & wav);
+    void readWaveforms(uint32_t index, uint32_t count, std::vector<Waveform> &wavs);
     uint32_t getNumberOfWaveforms();
+
+    // Copying between datasets
+    void copyVariable(const Dataset &src, const std::string &srcVar, const std::string &dstVar);
+    void merge(const Dataset &src);
 protected:
     ISMRMRD_Dataset dset_;
 };
@@ -0,0 +1,162 @@
+/* ISMRMRD Data Set split across several files */
+
+/**
+ * @file dataset_rollover.h
+ */
+
+#pragma once
+#ifndef ISMRMRD_DATASET_ROLLOVER_H
+#define ISMRMRD_DATASET_ROLLOVER_H
+
+#include "ismrmrd/dataset.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ISMRMRD {
+
+/**
+ *  Writes a dataset as a sequence of HDF5 files ("parts").
+ *
+ *  A new part is started once the current one holds max_acquisitions_per_part
+ *  acquisitions or max_bytes_per_part bytes of payload (headers, trajectories,
+ *  samples, image and array data). A limit of zero disables that criterion.
+ *  Every part is a complete ISMRMRD dataset carrying a copy of the XML header,
+ *  so a crash late in a session only affects the part being written.
+ *
+ *  For an output file "session.h5" the parts are named "session_part0000.h5",
+ *  "session_part0001.h5", ... and the text manifest "session.manifest" lists
+ *  them in order. The manifest is rewritten every time a part is started or
+ *  closed.
+ *
+ *  The bulk appends (appendAcquisitions, appendImages, appendWaveforms) split
+ *  their input where per-item appends would have started a new part and write
+ *  each piece with a single HDF5 write.
+ */
+class EXPORTISMRMRD RolloverDataset {
+public:
+    RolloverDataset(const char* filename, const char* groupname,
+                    uint64_t max_bytes_per_part, uint32_t max_acquisitions_per_part);
+    ~RolloverDataset();
+
+    // XML Header, written to every part
+    void writeHeader(const std::string &xmlstring);
+    // Acquisitions
+    void appendAcquisition(const Acquisition &acq);
+    void appendAcquisition(const AcquisitionView &acq);
+    void appendAcquisitions(const Acquisition *acqs, size_t count);
+    // Images
+    template <typename T> void appendImage(const std::string &var, const Image<T> &im);
+    template <typename T> void appendImage(const std::string &var, const ImageView<T> &im);
+    template <typename T> void appendImages(const std::string &var, const Image<T> *ims, size_t count);
+    // NDArrays
+    template <typename T> void appendNDArray(const std::string &var, const NDArray<T> &arr);
+    template <typename T> void appendNDArray(const std::string &var, const NDArrayView<T> &arr);
+    // Waveforms
+    void appendWaveform(const Waveform &wav);
+    void appendWaveforms(const Waveform *wavs, size_t count);
+
+    // Closes the current part and finalizes the manifest
+    void close();
+
+    std::string getManifestFilename() const;
+    size_t getNumberOfParts() const;
+    std::string getPartFilename(size_t part) const;
+
+private:
+    struct Part {
+        std::string filename;
+        bool closed;
+        uint64_t acquisitions;
+        uint64_t waveforms;
+        uint64_t bytes;
+    };
+
+    RolloverDataset(const RolloverDataset &);
+    RolloverDataset &operator=(const RolloverDataset &);
+
+    bool full(const Part &p, bool is_acquisition) const;
+    Dataset &current(bool is_acquisition);
+    void open_part();
+    void close_part();
+    void write_manifest();
+
+    std::string directory_;
+    std::string stem_;
+    std::string extension_;
+    std::string groupname_;
+    std::string header_;
+    bool has_header_;
+    uint64_t max_bytes_;
+    uint32_t max_acquisitions_;
+    std::vector<Part> parts_;
+    Dataset *dataset_;
+};
+
+/**
+ *  Reads a dataset written by RolloverDataset as one sequence.
+ *
+ *  Acquisitions are read in blocks of prefetch_count with a single HDF5 read
+ *  per block. A block that reaches the end of a part continues in the next
+ *  part, so the next file is already open and its first acquisitions are in
+ *  memory when the reader crosses the boundary.
+ *
+ *  Parts still marked as open in the manifest (e.g. after a crash) are used
+ *  if they can be read and skipped otherwise.
+ */
+class EXPORTISMRMRD RolloverDatasetReader {
+public:
+    RolloverDatasetReader(const char* manifest, uint32_t prefetch_count = 64);
+    ~RolloverDatasetReader();
+
+    // XML Header, read from the first part
+    void readHeader(std::string& xmlstring);
+    // Acquisitions
+    void readAcquisition(uint64_t index, Acquisition &acq);
+    uint64_t getNumberOfAcquisitions() const;
+    // Images
+    template <typename T> void readImage(const std::string &var, uint64_t index, Image<T> &im);
+    uint64_t getNumberOfImages(const std::string &var);
+    // NDArrays
+    template <typename T> void readNDArray(const std::string &var, uint64_t index, NDArray<T> &arr);
+    uint64_t getNumberOfNDArrays(const std::string &var);
+    // Waveforms
+    void readWaveform(uint64_t index, Waveform &wav);
+    uint64_t getNumberOfWaveforms() const;
+
+    size_t getNumberOfParts() const;
+    std::string getPartFilename(size_t part) const;
+
+private:
+    struct Part {
+        std::string filename;
+        uint64_t first_acquisition;
+        uint64_t acquisitions;
+        uint64_t first_waveform;
+        uint64_t waveforms;
+    };
+
+    RolloverDatasetReader(const RolloverDatasetReader &);
+    RolloverDatasetReader &operator=(const RolloverDatasetReader &);
+
+    Dataset &part(size_t n);
+    size_t find_part(uint64_t index, bool waveforms) const;
+    const std::vector<uint64_t> &variable_offsets(const std::string &var, bool images);
+    size_t locate(const std::vector<uint64_t> &offsets, uint64_t index) const;
+    void prefetch(uint64_t index);
+
+    std::string groupname_;
+    std::vector<Part> parts_;
+    std::vector<Dataset *> datasets_;
+    uint64_t number_of_acquisitions_;
+    uint64_t number_of_waveforms_;
+    std::map<std::string, std::vector<uint64_t> > image_offsets_;
+    std::map<std::string, std::vector<uint64_t> > array_offsets_;
+    uint32_t prefetch_count_;
+    uint64_t cache_start_;
+    std::vector<Acquisition> cache_;
+};
+
+} // namespace ISMRMRD
+
+#endif /* ISMRMRD_DATASET_ROLLOVER_H */
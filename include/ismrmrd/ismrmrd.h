@@ -253,6 +253,26 @@ static_assert(offsetof(ISMRMRD_EncodingCounters, segment) == 16, "segment is not
 static_assert(offsetof(ISMRMRD_EncodingCounters, user) == 18, "user is not at the expected offset");
 #endif
 
+/**
+ * Keys for the members of ISMRMRD_EncodingCounters, e.g. for sorting or routing acquisitions.
+ */
+enum ISMRMRD_EncodingCounterKeys {
+    ISMRMRD_IDX_KSPACE_ENCODE_STEP_1 = 0,
+    ISMRMRD_IDX_KSPACE_ENCODE_STEP_2 = 1,
+    ISMRMRD_IDX_AVERAGE              = 2,
+    ISMRMRD_IDX_SLICE                = 3,
+    ISMRMRD_IDX_CONTRAST             = 4,
+    ISMRMRD_IDX_PHASE                = 5,
+    ISMRMRD_IDX_REPETITION           = 6,
+    ISMRMRD_IDX_SET                  = 7,
+    ISMRMRD_IDX_SEGMENT              = 8,
+    ISMRMRD_IDX_USER_0               = 9, /**< user[n] is ISMRMRD_IDX_USER_0 + n */
+    ISMRMRD_IDX_NUMBER_OF_KEYS       = ISMRMRD_IDX_USER_0 + ISMRMRD_USER_INTS
+};
+
+/** Returns the encoding counter selected by an ISMRMRD_EncodingCounterKeys value, 0 for an invalid key */
+EXPORTISMRMRD uint16_t ismrmrd_get_encoding_counter(const ISMRMRD_EncodingCounters *idx, int key);
+
 /**
  * Header for each MR acquisition.
  */
@@ -930,6 +950,48 @@ protected:
     ISMRMRD_Image im;
 };
 
+/// Non-owning view of an acquisition in memory owned elsewhere (a mapped file,
+/// a shared memory slot, a DMA buffer), valid as long as that memory. Views can
+/// be serialized and appended to datasets like the owning types.
+struct EXPORTISMRMRD AcquisitionView {
+    AcquisitionView();
+    /// Views the header, trajectory and data of acq
+    AcquisitionView(const Acquisition &acq);
+    /// Views data (and traj) laid out as the header describes
+    AcquisitionView(const AcquisitionHeader &head, const complex_float_t *data, const float *traj = NULL);
+
+    size_t getNumberOfDataElements() const;
+    size_t getNumberOfTrajElements() const;
+    /** Returns the size of the data in bytes **/
+    size_t getDataSize() const;
+    /** Returns the size of the trajectory in bytes **/
+    size_t getTrajSize() const;
+
+    const AcquisitionHeader *head;
+    const float *traj;
+    const complex_float_t *data;
+};
+
+/// Non-owning view of an image in memory owned elsewhere, valid as long as that memory
+template <typename T> struct EXPORTISMRMRD ImageView {
+    ImageView();
+    /// Views the header, attributes and data of img
+    ImageView(const Image<T> &img);
+    /// Views data laid out as the header describes, with head.attribute_string_len
+    /// bytes of attributes
+    ImageView(const ImageHeader &head, const T *data, const char *attribute_string = NULL);
+
+    size_t getNumberOfDataElements() const;
+    /** Returns the size of the image data in bytes **/
+    size_t getDataSize() const;
+
+    const ImageHeader *head;
+    /** Not null terminated **/
+    const char *attribute_string;
+    size_t attribute_string_length;
+    const T *data;
+};
+
 /// N-Dimensional array type
 template <typename T> class EXPORTISMRMRD NDArray {
     friend class Dataset;
@@ -965,6 +1027,24 @@ protected:
     ISMRMRD_NDArray arr;
 };
 
+/// Non-owning view of an N-dimensional array in memory owned elsewhere
+template <typename T> struct EXPORTISMRMRD NDArrayView {
+    NDArrayView();
+    /// Views the dimensions and data of arr
+    NDArrayView(const NDArray<T> &arr);
+    /// Views data with dimensions dimvec, first dimension fastest
+    NDArrayView(const std::vector<size_t> &dimvec, const T *data);
+
+    size_t getNumberOfElements() const;
+    size_t getDataSize() const;
+
+    uint16_t version;
+    uint16_t data_type;
+    uint16_t ndim;
+    size_t dims[ISMRMRD_NDARRAY_MAXDIM];
+    const T *data;
+};
+
 
 /** @} */
 
@@ -0,0 +1,146 @@
+#pragma once
+#ifndef ISMRMRD_OBJECT_POOL_H
+#define ISMRMRD_OBJECT_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @file object_pool.h
+ *
+ * @brief Recycling of objects with large buffers (acquisitions, images)
+ *
+ * An ObjectPool hands out Pooled<T> handles. When the last handle to an object
+ * goes away the object, with the storage it owns, goes back to the pool and is
+ * handed out again by the next acquire(). Once a pool holds as many objects as
+ * are in use at the same time, acquiring and releasing does not allocate.
+ *
+ * Pools and handles are not thread safe.
+ */
+
+namespace ISMRMRD {
+
+template <typename T> class ObjectPool;
+
+template <typename T> struct PoolSlot {
+    PoolSlot() : pool(NULL), refs(0) {}
+    T object;
+    ObjectPool<T> *pool;
+    size_t refs;
+};
+
+// Shared handle to an object of an ObjectPool
+template <typename T> class Pooled {
+public:
+    Pooled() : _slot(NULL) {}
+
+    Pooled(const Pooled &other) : _slot(other._slot) {
+        if (_slot) {
+            _slot->refs++;
+        }
+    }
+
+    ~Pooled() {
+        reset();
+    }
+
+    Pooled &operator=(const Pooled &other) {
+        if (other._slot) {
+            other._slot->refs++;
+        }
+        reset();
+        _slot = other._slot;
+        return *this;
+    }
+
+    // Drops this handle, the object returns to its pool with the last handle
+    void reset() {
+        if (_slot && --_slot->refs == 0) {
+            ObjectPool<T>::release(_slot);
+        }
+        _slot = NULL;
+    }
+
+    T *get() const {
+        return _slot ? &_slot->object : NULL;
+    }
+
+    T &operator*() const {
+        return _slot->object;
+    }
+
+    T *operator->() const {
+        return &_slot->object;
+    }
+
+private:
+    friend class ObjectPool<T>;
+
+    explicit Pooled(PoolSlot<T> *slot) : _slot(slot) {
+        _slot->refs++;
+    }
+
+    PoolSlot<T> *_slot;
+};
+
+template <typename T> class ObjectPool {
+public:
+    ObjectPool() {}
+
+    // Objects still in use when the pool is destroyed are deleted with their last handle
+    ~ObjectPool() {
+        for (size_t i = 0; i < _slots.size(); i++) {
+            if (_slots[i]->refs == 0) {
+                delete _slots[i];
+            } else {
+                _slots[i]->pool = NULL;
+            }
+        }
+    }
+
+    // Returns an unused object, which holds whatever its previous user left in it
+    Pooled<T> acquire() {
+        PoolSlot<T> *slot;
+        if (_free.empty()) {
+            slot = new PoolSlot<T>();
+            slot->pool = this;
+            _slots.push_back(slot);
+            _free.reserve(_slots.size());
+        } else {
+            slot = _free.back();
+            _free.pop_back();
+        }
+        return Pooled<T>(slot);
+    }
+
+    // Number of objects owned by the pool
+    size_t size() const {
+        return _slots.size();
+    }
+
+    // Number of objects ready to be acquired
+    size_t available() const {
+        return _free.size();
+    }
+
+private:
+    friend class Pooled<T>;
+
+    ObjectPool(const ObjectPool &);
+    ObjectPool &operator=(const ObjectPool &);
+
+    static void release(PoolSlot<T> *slot) {
+        if (slot->pool) {
+            slot->pool->_free.push_back(slot);
+        } else {
+            delete slot;
+        }
+    }
+
+    std::vector<PoolSlot<T> *> _slots;
+    std::vector<PoolSlot<T> *> _free;
+};
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_OBJECT_POOL_H
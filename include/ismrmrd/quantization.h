@@ -0,0 +1,88 @@
+#pragma once
+#ifndef ISMRMRD_QUANTIZATION_H
+#define ISMRMRD_QUANTIZATION_H
+
+#include <vector>
+
+#include "ismrmrd/compression.h"
+#include "ismrmrd/export.h"
+#include "ismrmrd/ismrmrd.h"
+
+/**
+ * @file quantization.h
+ *
+ * @brief Lossy compression of k-space with a bounded error
+ *
+ * Each channel of a readout is rounded to a multiple of a quantization step.
+ * The step is the largest power of two not above twice the tolerance, so every
+ * real and imaginary part of the decoded data is within the tolerance of the
+ * original, and the rounding and reconstruction are exact in floating point.
+ * The tolerance is either absolute, or a fraction of the noise level of each
+ * channel, estimated per readout from the median absolute value of its samples
+ * (most samples of a readout away from the k-space center are noise).
+ *
+ * Channels that cannot be quantized (non-finite values, or values too large
+ * for the step) are kept exactly. The trajectory is never quantized.
+ */
+
+namespace ISMRMRD {
+
+enum ISMRMRD_ToleranceModes {
+    // The tolerance is in the units of the data
+    ISMRMRD_TOLERANCE_ABSOLUTE = 0,
+    // The tolerance is a fraction of the noise standard deviation of each channel
+    ISMRMRD_TOLERANCE_NOISE = 1
+};
+
+struct EXPORTISMRMRD QuantizationSettings {
+    QuantizationSettings();
+    QuantizationSettings(int mode, float tolerance);
+
+    int mode;
+    float tolerance;
+};
+
+// Quantization step for a tolerance, 0 (keep exactly) for tolerances that are not positive
+EXPORTISMRMRD float quantization_step(float tolerance);
+
+// Noise standard deviation of count complex samples, from the median absolute value
+// of their real and imaginary parts. scratch is working space.
+EXPORTISMRMRD float estimate_noise_level(const complex_float_t *data, size_t count, std::vector<float> &scratch);
+
+// The quantization step of every channel of acq
+EXPORTISMRMRD void quantization_steps(const AcquisitionView &acq, const QuantizationSettings &settings,
+                                      std::vector<float> &steps, std::vector<float> &scratch);
+
+// Kernels (SSE2 where available). quantize writes round(in / step) for count
+// values and returns false, with out undefined, if a value is not finite or its
+// quotient does not fit in 31 bits. step must be a power of two.
+EXPORTISMRMRD bool quantize(const float *in, size_t count, float step, int32_t *out);
+EXPORTISMRMRD void dequantize(const int32_t *in, size_t count, float step, float *out);
+
+// Rounds the data of acq in place, giving the data a decoder of the quantized
+// codec would see
+EXPORTISMRMRD void quantize_acquisition(Acquisition &acq, const QuantizationSettings &settings);
+
+// Payload codec of ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE. The payload holds the
+// trajectory, the step of each channel (0 for channels kept exactly) and the
+// quantized samples, all compressed with shuffle+deflate. Not thread safe.
+class EXPORTISMRMRD QuantizingCodec {
+public:
+    void compress(const AcquisitionView &acq, const QuantizationSettings &settings, int level, std::vector<char> &out);
+
+    // Decompresses into acq, whose header must already be set
+    void decompress(const void *compressed, size_t size, Acquisition &acq);
+
+    // Size of the payload of an acquisition with header head before deflate
+    static size_t payload_size(const AcquisitionHeader &head);
+
+private:
+    PayloadCodec _codec;
+    std::vector<int32_t> _words;
+    std::vector<float> _steps;
+    std::vector<float> _scratch;
+};
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_QUANTIZATION_H
@@ -4,8 +4,12 @@
 #include <exception>
 #include <iostream>
 
+#include "ismrmrd/compression.h"
+#include "ismrmrd/quantization.h"
 #include "ismrmrd/export.h"
 #include "ismrmrd/ismrmrd.h"
+#include "ismrmrd/object_pool.h"
+#include "ismrmrd/stream_statistics.h"
 #include "ismrmrd/waveform.h"
 #include "ismrmrd/xml.h"
 
@@ -34,15 +38,49 @@ enum ISMRMRD_MESSAGE_ID {
     ISMRMRD_MESSAGE_ACQUISITION = 1008,
     ISMRMRD_MESSAGE_IMAGE = 1022,
     ISMRMRD_MESSAGE_WAVEFORM = 1026,
-    ISMRMRD_MESSAGE_NDARRAY = 1030
+    ISMRMRD_MESSAGE_NDARRAY = 1030,
+    ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION = 1040,
+    ISMRMRD_MESSAGE_COMPRESSED_IMAGE = 1041,
+    ISMRMRD_MESSAGE_ACQUISITION_BATCH = 1042
 };
 
+// Most acquisitions in one ISMRMRD_MESSAGE_ACQUISITION_BATCH. A receiver
+// rejects a larger count before allocating the headers of the batch.
+const uint32_t ISMRMRD_MAX_BATCH_ACQUISITIONS = 65536;
+
 // A wrapper interface, which we can implement, e.g., for std::istream
 class ReadableStreamView {
 public:
     virtual void read(char *buffer, size_t count) = 0;
 
     virtual bool eof() = 0;
+
+    // Discards count bytes. The default reads them into a scratch buffer,
+    // seekable sources should override it to seek instead.
+    virtual void skip(size_t count) {
+        char scratch[16384];
+        while (count > 0 && !eof()) {
+            size_t n = count < sizeof(scratch) ? count : sizeof(scratch);
+            read(scratch, n);
+            count -= n;
+        }
+    }
+
+    // Returns the next count bytes where they are in the memory of the source
+    // and moves past them, or NULL if the source cannot, in which case nothing
+    // is consumed. The bytes stay valid at least until the next call on the
+    // view. Memory backed sources (see MmapReadStream) override it, so that the
+    // deserializers can hand out views of the data instead of copies.
+    virtual const char *read_in_place(size_t count) {
+        (void)count;
+        return NULL;
+    }
+};
+
+// A contiguous piece of a message, see WritableStreamView::writev
+struct StreamBuffer {
+    const char *data;
+    size_t size;
 };
 
 // A wrapper interface, which we can implement, e.g., for std::ostream
@@ -50,7 +88,54 @@ class WritableStreamView {
 public:
     virtual void write(const char *buffer, size_t count) = 0;
 
+    // Writes the buffers in order. The serializers pass all parts of a message
+    // (message id, header, payload) in one call, so that implementations on
+    // pipes or sockets can send them with a single system call. The default
+    // writes the buffers one by one.
+    virtual void writev(const StreamBuffer *buffers, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            write(buffers[i].data, buffers[i].size);
+        }
+    }
+
     virtual bool bad() = 0;
+
+    // Pushes buffered data to the underlying stream
+    virtual void flush() {}
+};
+
+// Views of ProtocolSerializer and ProtocolDeserializer on the stream, which time
+// the calls into the wrapped view and count their bytes while timed is set
+class EXPORTISMRMRD TimedReadableStreamView : public ReadableStreamView {
+public:
+    TimedReadableStreamView(ReadableStreamView &rs);
+    virtual void read(char *buffer, size_t count);
+    virtual bool eof();
+    virtual void skip(size_t count);
+    virtual const char *read_in_place(size_t count);
+
+    bool timed;
+    uint64_t bytes;
+    double seconds;
+
+private:
+    ReadableStreamView &_rs;
+};
+
+class EXPORTISMRMRD TimedWritableStreamView : public WritableStreamView {
+public:
+    TimedWritableStreamView(WritableStreamView &ws);
+    virtual void write(const char *buffer, size_t count);
+    virtual void writev(const StreamBuffer *buffers, size_t count);
+    virtual bool bad();
+    virtual void flush();
+
+    bool timed;
+    uint64_t bytes;
+    double seconds;
+
+private:
+    WritableStreamView &_ws;
 };
 
 // We define a few wrapper structs here to make the serialization code a bit
@@ -70,10 +155,17 @@ struct TextMessage {
 // serialize Acquisition to ostream
 EXPORTISMRMRD void serialize(const Acquisition &acq, WritableStreamView &ws);
 
+// serialize an acquisition from buffers owned by the caller
+EXPORTISMRMRD void serialize(const AcquisitionView &acq, WritableStreamView &ws);
+
 // serialize Image<T> to ostream
 template <typename T>
 EXPORTISMRMRD void serialize(const Image<T> &img, WritableStreamView &ws);
 
+// serialize an image from buffers owned by the caller
+template <typename T>
+EXPORTISMRMRD void serialize(const ImageView<T> &img, WritableStreamView &ws);
+
 // serialize Waveform to ostream
 EXPORTISMRMRD void serialize(const Waveform &wfm, WritableStreamView &ws);
 
@@ -87,6 +179,10 @@ EXPORTISMRMRD void serialize(const std::string &str, WritableStreamView &ws);
 template <typename T> 
 EXPORTISMRMRD void serialize(const NDArray<T> &arr, WritableStreamView &ws);
 
+// serialize a NDArray from a buffer owned by the caller
+template <typename T>
+EXPORTISMRMRD void serialize(const NDArrayView<T> &arr, WritableStreamView &ws);
+
 // deserialize Acquisition from istream
 EXPORTISMRMRD void deserialize(Acquisition &acq, ReadableStreamView &rs);
 
@@ -117,38 +213,175 @@ public:
     void serialize(const TextMessage &tm);
     void serialize(const IsmrmrdHeader &hdr);
     void serialize(const Acquisition &acq);
+    // The view overloads send the same messages as the owning types, without
+    // copying the caller's buffers into them first
+    void serialize(const AcquisitionView &acq);
+    // Sends the acquisitions as one ISMRMRD_MESSAGE_ACQUISITION_BATCH message,
+    // with their headers first. Batches are not compressed and hold at most
+    // ISMRMRD_MAX_BATCH_ACQUISITIONS acquisitions.
+    void serialize(const std::vector<Acquisition> &acqs);
     template <typename T> void serialize(const Image<T> &img);
+    template <typename T> void serialize(const ImageView<T> &img);
     void serialize(const Waveform &wfm);
     template <typename T> void serialize(const NDArray<T> &arr);
+    template <typename T> void serialize(const NDArrayView<T> &arr);
     void close();
 
+    // Sends acquisitions and images as compressed messages from now on, codec
+    // is one of ISMRMRD_CompressionCodecs and level the zlib level (1-9, -1 for
+    // the default). The receiver must support the codec, see compression_supported.
+    // ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE quantizes acquisitions with the
+    // settings of set_quantization, images are sent with shuffle+deflate.
+    void set_compression(uint16_t codec, int level = -1);
+
+    // Tolerance of ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, by default half the noise level
+    void set_quantization(const QuantizationSettings &settings);
+
+    // Counts the messages sent from now on in statistics, which must outlive
+    // the serializer. NULL stops counting.
+    void set_statistics(StreamStatistics *statistics);
+
 protected:
     void write_msg_id(uint16_t id);
+    // Time and bytes of a message for the statistics
+    void begin_message();
+    void end_message(uint16_t id);
+    TimedWritableStreamView _timed;
     WritableStreamView &_ws;
+    StreamStatistics *_statistics;
+    double _message_start;
+    uint16_t _compression;
+    int _compression_level;
+    QuantizationSettings _quantization;
+    PayloadCodec _codec;
+    QuantizingCodec _quantizing_codec;
+    std::vector<char> _payload;
+    std::vector<char> _compressed;
+    std::vector<AcquisitionHeader> _batch_headers;
+    std::vector<StreamBuffer> _batch_parts;
 };
 
+// Objects recycled by a ProtocolDeserializer, one pool per message type
+class MessagePool {
+public:
+    ObjectPool<Acquisition> &acquisitions() { return _acquisitions; }
+    ObjectPool<Waveform> &waveforms() { return _waveforms; }
+    template <typename T> ObjectPool<Image<T> > &images();
+
+private:
+    ObjectPool<Acquisition> _acquisitions;
+    ObjectPool<Waveform> _waveforms;
+    ObjectPool<Image<uint16_t> > _ushort_images;
+    ObjectPool<Image<int16_t> > _short_images;
+    ObjectPool<Image<uint32_t> > _uint_images;
+    ObjectPool<Image<int32_t> > _int_images;
+    ObjectPool<Image<float> > _float_images;
+    ObjectPool<Image<double> > _double_images;
+    ObjectPool<Image<complex_float_t> > _cxfloat_images;
+    ObjectPool<Image<complex_double_t> > _cxdouble_images;
+};
+
+template <> inline ObjectPool<Image<uint16_t> > &MessagePool::images<uint16_t>() { return _ushort_images; }
+template <> inline ObjectPool<Image<int16_t> > &MessagePool::images<int16_t>() { return _short_images; }
+template <> inline ObjectPool<Image<uint32_t> > &MessagePool::images<uint32_t>() { return _uint_images; }
+template <> inline ObjectPool<Image<int32_t> > &MessagePool::images<int32_t>() { return _int_images; }
+template <> inline ObjectPool<Image<float> > &MessagePool::images<float>() { return _float_images; }
+template <> inline ObjectPool<Image<double> > &MessagePool::images<double>() { return _double_images; }
+template <> inline ObjectPool<Image<complex_float_t> > &MessagePool::images<complex_float_t>() { return _cxfloat_images; }
+template <> inline ObjectPool<Image<complex_double_t> > &MessagePool::images<complex_double_t>() { return _cxdouble_images; }
+
 class EXPORTISMRMRD ProtocolDeserializer {
 public:
     ProtocolDeserializer(ReadableStreamView &rs);
+    // Deserializer that can recycle acquisitions, images and waveforms from pool
+    ProtocolDeserializer(ReadableStreamView &rs, MessagePool &pool);
     void deserialize(ConfigFile &cf);
     void deserialize(ConfigText &ct);
     void deserialize(TextMessage &tm);
     void deserialize(IsmrmrdHeader &hdr);
     void deserialize(Acquisition &acq);
+    // Deserializes an ISMRMRD_MESSAGE_ACQUISITION_BATCH, reusing the storage of
+    // the acquisitions already in acqs
+    void deserialize(std::vector<Acquisition> &acqs);
     template <typename T> void deserialize(Image<T> &img);
     void deserialize(Waveform &wfm);
     template <typename T> void deserialize(NDArray<T> &arr);
 
-    // Peek at the next data type in the stream
+    // Deserialize into an object of the pool, reusing its storage. The object
+    // previously held by the handle is released first, so a loop that keeps only
+    // the current message reuses the same buffers for every message.
+    void deserialize(Pooled<Acquisition> &acq);
+    template <typename T> void deserialize(Pooled<Image<T> > &img);
+    void deserialize(Pooled<Waveform> &wfm);
+
+    // Deserialize into views instead of owning objects. The data is viewed where
+    // the stream holds it (see ReadableStreamView::read_in_place), if it is
+    // aligned for its type, and otherwise in buffers of the deserializer, also
+    // for compressed messages. Views are valid until the next call on the
+    // deserializer.
+    void deserialize(AcquisitionView &acq);
+    template <typename T> void deserialize(ImageView<T> &img);
+
+    // Discards the next message without deserializing it and returns its id.
+    // The payload size is taken from the message header and the payload is
+    // skipped with ReadableStreamView::skip.
+    uint16_t skip();
+
+    // Peek at the next data type in the stream. Compressed acquisitions and
+    // images are reported as ISMRMRD_MESSAGE_ACQUISITION and ISMRMRD_MESSAGE_IMAGE,
+    // deserialize decompresses them.
     uint16_t peek();
+    // Whether the peeked message is compressed
+    bool peek_compressed();
     int peek_image_data_type();
+    const ImageHeader &peek_image_header();
     int peek_ndarray_data_type();
+    // Headers of the peeked ISMRMRD_MESSAGE_ACQUISITION_BATCH, read before any of
+    // its data, so that a receiver can decide to skip the batch
+    const std::vector<AcquisitionHeader> &peek_batch_headers();
+    // Header of the peeked acquisition, compressed or not
+    const AcquisitionHeader &peek_acquisition_header();
+
+    // Counts the messages received from now on in statistics, which must
+    // outlive the deserializer. NULL stops counting.
+    void set_statistics(StreamStatistics *statistics);
 
 protected:
+    MessagePool &pool();
+    // Reads the codec and payload of a compressed message into _compressed, returns
+    // the codec. Throws if the payload is larger than what size bytes, the largest
+    // payload the message header allows, compress to.
+    uint16_t read_compressed_payload(size_t size);
+    // Reads the codec and payload of a compressed message and decompresses it into data
+    void read_compressed_payload(size_t element_size, void *data, size_t size);
+    // The next size bytes of the stream, in place if they are aligned to
+    // alignment and otherwise read into _view_data
+    const char *read_view_data(size_t size, size_t alignment);
+    // Time and bytes of a message for the statistics: start_call begins each
+    // deserialize or skip, finish_message ends the peeked message
+    void start_call();
+    void finish_message();
+
+    TimedReadableStreamView _timed;
     ReadableStreamView &_rs;
+    StreamStatistics *_statistics;
+    double _call_start;
+    double _peek_seconds;
     uint16_t _peeked;
     ImageHeader _peeked_image_header;
+    AcquisitionHeader _peeked_acquisition_header;
     uint16_t _peeked_ndarray_data_type;
+    std::vector<AcquisitionHeader> _peeked_batch_headers;
+    MessagePool *_pool;
+    std::vector<char> _attribute_buffer;
+    bool _peeked_compressed;
+    PayloadCodec _codec;
+    QuantizingCodec _quantizing_codec;
+    std::vector<char> _payload;
+    std::vector<char> _compressed;
+    // Storage of views that cannot point into the stream
+    std::vector<double> _view_data;
+    Acquisition _view_acquisition;
 };
 
 } // namespace ISMRMRD
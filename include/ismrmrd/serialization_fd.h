@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <sys/uio.h>
+#include <ismrmrd/serialization.h>
+
+/**
+ * @file serialization_fd.h
+ *
+ * @brief Buffered stream views on POSIX file descriptors
+ *
+ * FdReadStream and FdWriteStream read and write a file descriptor (file, pipe,
+ * socket, stdin/stdout) with read(2)/write(2) through a large internal buffer,
+ * so that the many small fields of a message (message id, headers) do not each
+ * cost a call into the iostream machinery. Reads and writes at least as large
+ * as the buffer bypass it. Only available on POSIX platforms.
+ */
+
+namespace ISMRMRD {
+
+#define ISMRMRD_FD_STREAM_BUFFER_SIZE (1024 * 1024)
+
+class EXPORTISMRMRD FdReadStream : public ReadableStreamView {
+public:
+    // The file descriptor is not closed by the stream
+    FdReadStream(int fd, size_t buffer_size = ISMRMRD_FD_STREAM_BUFFER_SIZE);
+
+    // Reads count bytes, retrying short reads. Sets eof() if the input ends first
+    virtual void read(char *buffer, size_t count);
+
+    virtual bool eof();
+
+    // Seeks over the bytes if the file descriptor is seekable (regular files),
+    // reads them otherwise. Sets eof if the input ends first.
+    virtual void skip(size_t count);
+
+protected:
+    // Fills the buffer with at most one read call, returns false at end of input
+    bool fill();
+    // Reads directly into buffer until count bytes or end of input, returns the bytes read
+    size_t read_fd(char *buffer, size_t count);
+
+    int _fd;
+    std::vector<char> _buffer;
+    size_t _begin;
+    size_t _end;
+    bool _eof;
+    bool _seekable;
+};
+
+class EXPORTISMRMRD FdWriteStream : public WritableStreamView {
+public:
+    // The file descriptor is not closed by the stream, the destructor flushes
+    FdWriteStream(int fd, size_t buffer_size = ISMRMRD_FD_STREAM_BUFFER_SIZE);
+    ~FdWriteStream();
+
+    virtual void write(const char *buffer, size_t count);
+
+    // Messages that fit are appended to the buffer, larger ones are sent together
+    // with the buffered bytes in a single writev(2)
+    virtual void writev(const StreamBuffer *buffers, size_t count);
+
+    virtual bool bad();
+
+    // Writes the buffered bytes to the file descriptor
+    virtual void flush();
+
+protected:
+    // Writes count bytes, retrying short writes. Sets bad() on error
+    void write_fd(const char *buffer, size_t count);
+    // Writes all of iov, retrying partial writes. Sets bad() on error
+    void write_iov(struct iovec *iov, size_t count);
+
+    int _fd;
+    std::vector<char> _buffer;
+    size_t _size;
+    bool _bad;
+    std::vector<struct iovec> _iov;
+
+private:
+    FdWriteStream(const FdWriteStream &);
+    FdWriteStream &operator=(const FdWriteStream &);
+};
+
+} // namespace ISMRMRD
@@ -17,6 +17,29 @@ public:
         return _is.eof();
     }
 
+    // Seeks if the stream supports it (files, string streams), reads otherwise
+    // (pipes). Sets eof if the stream ends first.
+    virtual void skip(size_t count) {
+        std::streampos position = _is.tellg();
+        if (position != std::streampos(-1)) {
+            // A seek past the end of a file succeeds, so the target is checked
+            // against the end of the stream
+            _is.seekg(0, std::ios::end);
+            std::streampos end = _is.tellg();
+            if (end != std::streampos(-1) && end - position >= static_cast<std::streamoff>(count)) {
+                _is.seekg(position + static_cast<std::streamoff>(count));
+            } else {
+                _is.setstate(std::ios::eofbit);
+            }
+        } else {
+            _is.clear(_is.rdstate() & ~std::ios::failbit);
+            _is.ignore(static_cast<std::streamsize>(count));
+            if (static_cast<size_t>(_is.gcount()) < count) {
+                _is.setstate(std::ios::eofbit);
+            }
+        }
+    }
+
 protected:
     std::istream &_is;
 };
@@ -33,6 +56,10 @@ public:
         return _os.bad();
     }
 
+    void flush() {
+        _os.flush();
+    }
+
 private:
     std::ostream &_os;
 };
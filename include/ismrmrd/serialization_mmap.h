@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <ismrmrd/serialization.h>
+
+/**
+ * @file serialization_mmap.h
+ *
+ * @brief Memory mapped stream view on recorded stream files
+ *
+ * MmapReadStream maps a whole stream file read-only and reads it without
+ * system calls. It provides its bytes in place (read_in_place), so that
+ * ProtocolDeserializer can deserialize acquisitions and images into views
+ * (AcquisitionView, ImageView) pointing into the mapping instead of copying
+ * them. The views of one message are valid until the next call on the
+ * deserializer, data in the mapping stays valid for the life of the stream.
+ * Only available on POSIX platforms.
+ */
+
+namespace ISMRMRD {
+
+class EXPORTISMRMRD MmapReadStream : public ReadableStreamView {
+public:
+    // Maps the file, throws if it cannot be opened or mapped
+    explicit MmapReadStream(const std::string &path);
+    ~MmapReadStream();
+
+    // Sets eof() if the file ends before count bytes
+    virtual void read(char *buffer, size_t count);
+    virtual bool eof();
+    virtual void skip(size_t count);
+    virtual const char *read_in_place(size_t count);
+
+    // The mapped file
+    const char *data() const;
+    size_t size() const;
+
+    // Offset of the next read in the file
+    size_t position() const;
+    // Moves the next read to an offset in the file and clears eof()
+    void seek(size_t position);
+
+private:
+    MmapReadStream(const MmapReadStream &);
+    MmapReadStream &operator=(const MmapReadStream &);
+
+    const char *_data;
+    size_t _size;
+    size_t _position;
+    bool _eof;
+};
+
+} // namespace ISMRMRD
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <ismrmrd/serialization.h>
+
+/**
+ * @file serialization_shm.h
+ *
+ * @brief Shared memory transport between processes on the same host
+ *
+ * A ShmRing is a ring of fixed size slots in a POSIX shared memory object,
+ * with a single writing and a single reading process. Each message goes into
+ * its own slot (messages larger than a slot continue in the following slots),
+ * written in place by ShmRingWriter and read in place by ShmRingReader, so the
+ * data is copied once instead of twice through the kernel as with a pipe.
+ *
+ * ShmRingReader hands out views of the slots, which stay valid until they are
+ * released, and is also a ReadableStreamView for use with ProtocolDeserializer.
+ * Messages start in their slot so that the data of an acquisition is 4 byte
+ * aligned and can be used without copying, see view_acquisition.
+ *
+ * A waiting writer or reader sleeps on a futex on Linux, and polls elsewhere.
+ * A waiting reader wakes up every 100 ms to check that the writer process is
+ * still alive, and throws if it exited without closing the stream.
+ * Only available on POSIX platforms.
+ */
+
+namespace ISMRMRD {
+
+struct ShmRingHeader;
+
+class EXPORTISMRMRD ShmRing {
+public:
+    // Creates the shared memory object name ("/name"), which must not exist, with
+    // slot_count (a power of two) slots. The object is removed when the creating
+    // ShmRing is destroyed.
+    ShmRing(const std::string &name, size_t slot_size, size_t slot_count);
+    // Opens a ring created by another process
+    explicit ShmRing(const std::string &name);
+    ~ShmRing();
+
+    // Largest number of message bytes in a slot
+    size_t slot_size() const;
+    size_t slot_count() const;
+
+private:
+    ShmRing(const ShmRing &);
+    ShmRing &operator=(const ShmRing &);
+
+    friend class ShmRingWriter;
+    friend class ShmRingReader;
+
+    char *slot(uint32_t sequence) const;
+
+    std::string _name;
+    bool _owner;
+    void *_mapping;
+    size_t _mapping_size;
+    ShmRingHeader *_header;
+    size_t _slot_stride;
+};
+
+class EXPORTISMRMRD ShmRingWriter : public WritableStreamView {
+public:
+    // There must be only one writer per ring. The destructor closes the stream.
+    explicit ShmRingWriter(ShmRing &ring);
+    ~ShmRingWriter();
+
+    // Waits for a free slot and returns where to write a message of at most
+    // slot_size() bytes in place. The message is sent by commit.
+    char *reserve();
+    void commit(size_t size);
+
+    // Each call sends one message, split over several slots if needed
+    virtual void write(const char *buffer, size_t count);
+    virtual void writev(const StreamBuffer *buffers, size_t count);
+
+    virtual bool bad();
+
+    // Ends the stream: the reader sees the end of input after the messages
+    // already sent. Called by the destructor.
+    void close();
+
+private:
+    ShmRingWriter(const ShmRingWriter &);
+    ShmRingWriter &operator=(const ShmRingWriter &);
+
+    void publish(size_t size, uint32_t flags);
+
+    ShmRing &_ring;
+    char *_reserved;
+    bool _closed;
+};
+
+// Bytes of one slot, valid until ShmRingReader::release
+struct ShmSlotView {
+    const char *data;
+    size_t size;
+    // The message continues in the next slot
+    bool continued;
+};
+
+// The parts of an acquisition message in a slot, see view_acquisition
+typedef AcquisitionView ShmAcquisitionView;
+
+class EXPORTISMRMRD ShmRingReader : public ReadableStreamView {
+public:
+    // There must be only one reader per ring
+    explicit ShmRingReader(ShmRing &ring);
+    ~ShmRingReader();
+
+    // Waits for the next slot. Returns false at the end of the stream. The
+    // previous slot must have been released. Throws if the writer exited
+    // without closing the stream, or if the slot is corrupt.
+    bool acquire(ShmSlotView &slot);
+    // Gives the acquired slot back to the writer
+    void release();
+
+    // Stream view over the slots, for ProtocolDeserializer. Not to be mixed
+    // with acquire/release in the middle of a message.
+    virtual void read(char *buffer, size_t count);
+    virtual bool eof();
+    virtual void skip(size_t count);
+
+private:
+    ShmRingReader(const ShmRingReader &);
+    ShmRingReader &operator=(const ShmRingReader &);
+
+    // Makes the next slot current for the stream view, returns false at the end
+    bool next_stream_slot();
+
+    ShmRing &_ring;
+    bool _acquired;
+    bool _end;
+    ShmSlotView _slot;
+    size_t _offset;
+    bool _eof;
+};
+
+// Views the acquisition message (ISMRMRD_MESSAGE_ACQUISITION, with its id) held
+// whole in slot. Returns false if the slot holds another message, or only part of one.
+EXPORTISMRMRD bool view_acquisition(const ShmSlotView &slot, AcquisitionView &acq);
+
+} // namespace ISMRMRD
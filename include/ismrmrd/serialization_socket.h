@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <ismrmrd/serialization_fd.h>
+
+/**
+ * @file serialization_socket.h
+ *
+ * @brief Stream views on TCP and Unix domain sockets
+ *
+ * SocketReadStream and SocketWriteStream are FdReadStream/FdWriteStream on a
+ * connected socket, with the socket options a streaming client or server needs:
+ * kernel buffer sizes, send and receive timeouts, TCP_NODELAY, and sending each
+ * message as soon as it is complete instead of when the stream buffer is full.
+ * The functions below create connected and listening sockets. The streams do not
+ * close their socket, close it with close(2) when done. Writing to a socket the
+ * peer has closed raises SIGPIPE unless the process ignores it. Only available
+ * on POSIX platforms.
+ */
+
+namespace ISMRMRD {
+
+struct EXPORTISMRMRD SocketOptions {
+    SocketOptions();
+
+    // Kernel buffer sizes (SO_SNDBUF/SO_RCVBUF), 0 keeps the system default
+    int send_buffer_size;
+    int receive_buffer_size;
+    // Timeout of a single send or receive in milliseconds, 0 waits forever
+    int timeout_ms;
+    // Disables Nagle's algorithm on TCP sockets, so the end of a message is not
+    // held back waiting for the acknowledgement of the previous segment
+    bool no_delay;
+    // Corks TCP sockets (TCP_CORK, Linux only) so that only full segments are
+    // sent until the stream is flushed, see flush_messages
+    bool cork;
+    // Sends each message when it is serialized. Otherwise messages are sent when
+    // the stream buffer is full or flushed, which is faster for bulk transfers
+    bool flush_messages;
+    // Size of the stream buffer
+    size_t stream_buffer_size;
+};
+
+class EXPORTISMRMRD SocketReadStream : public FdReadStream {
+public:
+    // Applies the receive options to the socket. A read that times out throws
+    SocketReadStream(int fd, const SocketOptions &options = SocketOptions());
+};
+
+class EXPORTISMRMRD SocketWriteStream : public FdWriteStream {
+public:
+    // Applies the send options to the socket. A send that times out sets bad()
+    SocketWriteStream(int fd, const SocketOptions &options = SocketOptions());
+    ~SocketWriteStream();
+
+    virtual void writev(const StreamBuffer *buffers, size_t count);
+
+    // Writes the buffered bytes and pushes out a partial segment held by the cork
+    virtual void flush();
+
+protected:
+    void set_cork(bool enabled);
+
+    bool _flush_messages;
+    bool _corked;
+};
+
+// Connects to a TCP server, host is a name or numeric address. Returns the socket
+EXPORTISMRMRD int connect_tcp(const std::string &host, unsigned short port);
+
+// Connects to a Unix domain socket. Returns the socket
+EXPORTISMRMRD int connect_unix(const std::string &path);
+
+// Listens on a TCP address, port 0 picks a free port (see socket_port). Returns the socket
+EXPORTISMRMRD int listen_tcp(const std::string &host, unsigned short port, int backlog = 8);
+
+// Listens on a Unix domain socket, replacing an existing socket file at path. Returns the socket
+EXPORTISMRMRD int listen_unix(const std::string &path, int backlog = 8);
+
+// Waits for a connection on a listening socket. Returns the connected socket
+EXPORTISMRMRD int accept_connection(int listen_fd);
+
+// Local port of a TCP socket
+EXPORTISMRMRD unsigned short socket_port(int fd);
+
+} // namespace ISMRMRD
@@ -0,0 +1,185 @@
+#pragma once
+#ifndef ISMRMRD_STREAM_INDEX_H
+#define ISMRMRD_STREAM_INDEX_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ismrmrd/serialization.h"
+#include "ismrmrd/serialization_iostream.h"
+
+#if __cplusplus >= 201103L
+#include <exception>
+#include <thread>
+#endif
+
+/**
+ * @file stream_index.h
+ *
+ * @brief Random access to recorded protocol streams
+ *
+ * A StreamIndex is built by scanning a recorded stream file once, reading only
+ * the message headers, and lists the offset, size and type of every message
+ * and the header fields of every acquisition. It is saved next to the stream
+ * in a sidecar file (stream path + ".idx"), so that later readers do not scan
+ * the stream again.
+ *
+ * An IndexedStreamReader uses the index to read any message, or any
+ * acquisition by number or by encoding counters, without reading the messages
+ * before it. Readers are independent, so several threads can decode disjoint
+ * parts of the same file with a reader each, see decode_acquisitions.
+ */
+
+namespace ISMRMRD {
+
+// One message of a recorded stream
+struct StreamIndexMessage {
+    uint64_t offset;             // of the message id in the stream
+    uint64_t size;               // of the message, including the message id
+    uint64_t first_acquisition;  // number of its first acquisition in StreamIndex::acquisitions
+    uint32_t acquisitions;       // number of acquisitions in the message
+    uint16_t id;                 // ISMRMRD_MESSAGE_ID as in the stream, compressed messages keep their id
+    uint16_t data_type;          // of an image or NDArray
+    uint16_t image_index;        // of an image
+    uint16_t image_series_index; // of an image
+    uint32_t reserved;
+};
+
+// One acquisition of a recorded stream
+struct StreamIndexAcquisition {
+    uint64_t message;                  // number of the message holding the acquisition
+    uint64_t header_offset;            // of the acquisition header in the stream
+    uint64_t data_offset;              // of the trajectory and data, 0 if compressed
+    uint64_t flags;
+    uint32_t scan_counter;
+    ISMRMRD_EncodingCounters idx;
+    uint16_t reserved;
+};
+
+class EXPORTISMRMRD StreamIndex {
+public:
+    StreamIndex();
+
+    // Scans the stream file up to its close message. A message cut short at
+    // the end of the file (an interrupted recording) is left out.
+    void build(const std::string &stream_path);
+
+    // The sidecar file is written in the byte order of the machine
+    void save(const std::string &index_path) const;
+    // Throws if the file is not an index
+    void load(const std::string &index_path);
+
+    // The index of stream_path from its sidecar file, which is created (if it
+    // can be written) when it is missing or was made for a file of a different
+    // size, modification time or content at either end
+    void open(const std::string &stream_path);
+
+    static std::string sidecar_path(const std::string &stream_path);
+
+    const std::vector<StreamIndexMessage> &messages() const;
+    const std::vector<StreamIndexAcquisition> &acquisitions() const;
+
+    // Size of the indexed stream file
+    uint64_t stream_size() const;
+    // Whether the stream ends with a close message, which is not listed
+    bool closed() const;
+
+    // Numbers of the acquisitions whose encoding counter key
+    // (ISMRMRD_EncodingCounterKeys) has the value, in stream order
+    std::vector<size_t> find_acquisitions(int key, uint16_t value) const;
+    // Number of the acquisition with the scan counter, or acquisitions().size()
+    size_t find_scan_counter(uint32_t scan_counter) const;
+    // Numbers of the messages with the id (as in ISMRMRD_MESSAGE_ID, compressed
+    // messages are found with the uncompressed id)
+    std::vector<size_t> find_messages(uint16_t id) const;
+
+private:
+    std::vector<StreamIndexMessage> _messages;
+    std::vector<StreamIndexAcquisition> _acquisitions;
+    uint64_t _stream_size;
+    int64_t _stream_mtime;
+    uint64_t _stream_fingerprint;
+    bool _closed;
+};
+
+class EXPORTISMRMRD IndexedStreamReader {
+public:
+    // Opens the stream file with its index, see StreamIndex::open
+    explicit IndexedStreamReader(const std::string &stream_path);
+    // Opens the stream file with an index, which must outlive the reader
+    IndexedStreamReader(const std::string &stream_path, const StreamIndex &index);
+    ~IndexedStreamReader();
+
+    const StreamIndex &index() const;
+
+    // Positions the reader at message n, which the returned deserializer reads
+    // next with peek and deserialize, followed by the messages after it. The
+    // deserializer is valid until the next call of message or read_acquisition.
+    ProtocolDeserializer &message(size_t n);
+
+    // Reads acquisition n (see StreamIndex::acquisitions), also from inside
+    // a batch, without reading the rest of its message
+    void read_acquisition(size_t n, Acquisition &acq);
+
+private:
+    IndexedStreamReader(const IndexedStreamReader &);
+    IndexedStreamReader &operator=(const IndexedStreamReader &);
+
+    void seek(uint64_t offset);
+
+    StreamIndex _own_index;
+    const StreamIndex &_index;
+    std::ifstream _file;
+    IStreamView _view;
+    ProtocolDeserializer *_deserializer;
+};
+
+#if __cplusplus >= 201103L
+// Decodes the acquisitions [begin, end) of an indexed stream file with threads
+// threads, each reading a contiguous part with its own IndexedStreamReader,
+// and calls f(n, acq) for acquisition n. f is called from several threads at
+// once, in stream order within each part. The first error is thrown after
+// all threads have finished.
+template <typename F>
+void decode_acquisitions(const std::string &stream_path, const StreamIndex &index, size_t begin, size_t end,
+                         size_t threads, F f) {
+    if (end > index.acquisitions().size() || begin > end) {
+        throw std::runtime_error("Acquisition range out of the index");
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    size_t count = end - begin;
+    for (size_t t = 0; t < threads; t++) {
+        size_t first = begin + count * t / threads;
+        size_t last = begin + count * (t + 1) / threads;
+        workers.push_back(std::thread([&, t, first, last] {
+            try {
+                IndexedStreamReader reader(stream_path, index);
+                Acquisition acq;
+                for (size_t n = first; n < last; n++) {
+                    reader.read_acquisition(n, acq);
+                    f(n, acq);
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    for (size_t t = 0; t < errors.size(); t++) {
+        if (errors[t]) {
+            std::rethrow_exception(errors[t]);
+        }
+    }
+}
+#endif
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_STREAM_INDEX_H
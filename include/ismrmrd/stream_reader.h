@@ -0,0 +1,464 @@
+#pragma once
+#ifndef ISMRMRD_STREAM_READER_H
+#define ISMRMRD_STREAM_READER_H
+
+#if __cplusplus < 201103L
+#error "ismrmrd/stream_reader.h requires C++11"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "ismrmrd/serialization.h"
+
+/**
+ * @file stream_reader.h
+ *
+ * @brief Deserialization of a protocol stream on a background thread
+ *
+ * A StreamReader runs a ProtocolDeserializer on its own thread and hands the
+ * decoded messages to the consuming thread through a bounded single-producer,
+ * single-consumer ring, so that reading and decoding the next messages overlaps
+ * with processing the current one. The messages are decoded in place into the
+ * ring's slots, which are reused, so a running reader does not allocate once
+ * the slots have grown to the message sizes of the stream.
+ *
+ * BackgroundProducer is the thread and ring behind StreamReader, for readers
+ * that produce something else than single messages, e.g. blocks of a dataset.
+ *
+ * Requires C++11. Header only, the library itself does not depend on C++11.
+ */
+
+namespace ISMRMRD {
+
+// Bounded lock-free ring for one producer and one consumer thread. Elements
+// are filled and consumed in place: the producer fills back() and publishes it
+// with push(), the consumer reads front() and hands it back with pop().
+template <typename T> class SpscRing {
+public:
+    // The capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) : _head(0), _tail(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        _slots.resize(size);
+        _mask = size - 1;
+    }
+
+    size_t capacity() const {
+        return _slots.size();
+    }
+
+    // Producer side: the next free slot, or NULL if the ring is full
+    T *back() {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size()) {
+            return NULL;
+        }
+        return &_slots[tail & _mask];
+    }
+
+    // Producer side: publishes the slot returned by back()
+    void push() {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side: the oldest published slot, or NULL if the ring is empty
+    T *front() {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return NULL;
+        }
+        return &_slots[head & _mask];
+    }
+
+    // Consumer side: returns the slot returned by front() to the producer
+    void pop() {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+private:
+    std::vector<T> _slots;
+    size_t _mask;
+    // On separate cache lines, each is written by one thread only
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+};
+
+// Fills the slots of an SpscRing on a background thread, ahead of the consuming
+// thread. Slots are reused, so the producer refills storage from earlier items.
+template <typename T> class BackgroundProducer {
+public:
+    // produce fills a slot and returns false once there is nothing left, that
+    // slot is not handed to the consumer
+    typedef std::function<bool(T &)> Producer;
+
+    // The capacity is rounded up to a power of two
+    explicit BackgroundProducer(size_t capacity) : _ring(capacity), _current(NULL), _stop(false), _done(false) {}
+
+    // Waits for the producer thread, which finishes the item it is producing.
+    // A producer blocked on input only returns when input arrives or ends.
+    ~BackgroundProducer() {
+        _stop.store(true);
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    // Starts the thread, once the owner has finished setting up what produce uses
+    void start(const Producer &produce) {
+        _produce = produce;
+        _thread = std::thread(&BackgroundProducer::run, this);
+    }
+
+    // The next item, valid until the following call. Returns NULL once produce
+    // has returned false. An error thrown by produce is rethrown here.
+    T *next() {
+        if (_current) {
+            _ring.pop();
+            _current = NULL;
+        }
+        for (int spins = 0;;) {
+            // _done is read before the ring, so an item published just before
+            // the thread finished is not missed
+            bool done = _done.load(std::memory_order_acquire);
+            _current = _ring.front();
+            if (_current) {
+                return _current;
+            }
+            if (done) {
+                if (_error) {
+                    std::rethrow_exception(_error);
+                }
+                return NULL;
+            }
+            wait(spins);
+        }
+    }
+
+    BackgroundProducer(const BackgroundProducer &) = delete;
+    BackgroundProducer &operator=(const BackgroundProducer &) = delete;
+
+private:
+    // Spins briefly, then backs off so an idle producer or consumer does not
+    // occupy a core
+    static void wait(int &spins) {
+        if (spins < 64) {
+            spins++;
+        } else if (spins < 128) {
+            spins++;
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    void run() {
+        try {
+            for (int spins = 0; !_stop.load(std::memory_order_relaxed);) {
+                T *item = _ring.back();
+                if (!item) {
+                    wait(spins);
+                    continue;
+                }
+                spins = 0;
+                if (!_produce(*item)) {
+                    break;
+                }
+                _ring.push();
+            }
+        } catch (...) {
+            _error = std::current_exception();
+        }
+        _done.store(true, std::memory_order_release);
+    }
+
+    SpscRing<T> _ring;
+    Producer _produce;
+    T *_current;
+    std::exception_ptr _error;
+    std::atomic<bool> _stop;
+    std::atomic<bool> _done;
+    std::thread _thread;
+};
+
+// A decoded message. Only the member matching id (and data_type for images and
+// arrays) holds the message, the others keep storage from earlier messages.
+struct StreamMessage {
+    StreamMessage() : id(0), data_type(0), received(0) {}
+
+    uint16_t id;
+    // ISMRMRD_DataTypes of an image or NDArray message
+    int data_type;
+    // When StreamReader finished decoding the message (StreamStatistics::now())
+    double received;
+
+    ConfigFile config_file;
+    ConfigText config_text;
+    IsmrmrdHeader header;
+    TextMessage text;
+    Acquisition acquisition;
+    std::vector<Acquisition> acquisitions;
+    Waveform waveform;
+
+    template <typename T> Image<T> &image();
+    template <typename T> NDArray<T> &ndarray();
+    template <typename T> const Image<T> &image() const {
+        return const_cast<StreamMessage *>(this)->image<T>();
+    }
+    template <typename T> const NDArray<T> &ndarray() const {
+        return const_cast<StreamMessage *>(this)->ndarray<T>();
+    }
+
+private:
+    Image<uint16_t> _ushort_image;
+    Image<int16_t> _short_image;
+    Image<uint32_t> _uint_image;
+    Image<int32_t> _int_image;
+    Image<float> _float_image;
+    Image<double> _double_image;
+    Image<complex_float_t> _cxfloat_image;
+    Image<complex_double_t> _cxdouble_image;
+
+    NDArray<uint16_t> _ushort_array;
+    NDArray<int16_t> _short_array;
+    NDArray<uint32_t> _uint_array;
+    NDArray<int32_t> _int_array;
+    NDArray<float> _float_array;
+    NDArray<double> _double_array;
+    NDArray<complex_float_t> _cxfloat_array;
+    NDArray<complex_double_t> _cxdouble_array;
+};
+
+template <> inline Image<uint16_t> &StreamMessage::image<uint16_t>() { return _ushort_image; }
+template <> inline Image<int16_t> &StreamMessage::image<int16_t>() { return _short_image; }
+template <> inline Image<uint32_t> &StreamMessage::image<uint32_t>() { return _uint_image; }
+template <> inline Image<int32_t> &StreamMessage::image<int32_t>() { return _int_image; }
+template <> inline Image<float> &StreamMessage::image<float>() { return _float_image; }
+template <> inline Image<double> &StreamMessage::image<double>() { return _double_image; }
+template <> inline Image<complex_float_t> &StreamMessage::image<complex_float_t>() { return _cxfloat_image; }
+template <> inline Image<complex_double_t> &StreamMessage::image<complex_double_t>() { return _cxdouble_image; }
+
+template <> inline NDArray<uint16_t> &StreamMessage::ndarray<uint16_t>() { return _ushort_array; }
+template <> inline NDArray<int16_t> &StreamMessage::ndarray<int16_t>() { return _short_array; }
+template <> inline NDArray<uint32_t> &StreamMessage::ndarray<uint32_t>() { return _uint_array; }
+template <> inline NDArray<int32_t> &StreamMessage::ndarray<int32_t>() { return _int_array; }
+template <> inline NDArray<float> &StreamMessage::ndarray<float>() { return _float_array; }
+template <> inline NDArray<double> &StreamMessage::ndarray<double>() { return _double_array; }
+template <> inline NDArray<complex_float_t> &StreamMessage::ndarray<complex_float_t>() { return _cxfloat_array; }
+template <> inline NDArray<complex_double_t> &StreamMessage::ndarray<complex_double_t>() { return _cxdouble_array; }
+
+namespace detail {
+
+template <typename T> void read_image(ProtocolDeserializer &deserializer, StreamMessage &msg) {
+    deserializer.deserialize(msg.image<T>());
+}
+
+template <typename T> void read_ndarray(ProtocolDeserializer &deserializer, StreamMessage &msg) {
+    deserializer.deserialize(msg.ndarray<T>());
+}
+
+inline void read_image(ProtocolDeserializer &deserializer, StreamMessage &msg, int data_type) {
+    switch (data_type) {
+    case ISMRMRD_USHORT: read_image<uint16_t>(deserializer, msg); break;
+    case ISMRMRD_SHORT: read_image<int16_t>(deserializer, msg); break;
+    case ISMRMRD_UINT: read_image<uint32_t>(deserializer, msg); break;
+    case ISMRMRD_INT: read_image<int32_t>(deserializer, msg); break;
+    case ISMRMRD_FLOAT: read_image<float>(deserializer, msg); break;
+    case ISMRMRD_DOUBLE: read_image<double>(deserializer, msg); break;
+    case ISMRMRD_CXFLOAT: read_image<complex_float_t>(deserializer, msg); break;
+    case ISMRMRD_CXDOUBLE: read_image<complex_double_t>(deserializer, msg); break;
+    default: throw std::runtime_error("Unsupported image data type");
+    }
+}
+
+inline void read_ndarray(ProtocolDeserializer &deserializer, StreamMessage &msg, int data_type) {
+    switch (data_type) {
+    case ISMRMRD_USHORT: read_ndarray<uint16_t>(deserializer, msg); break;
+    case ISMRMRD_SHORT: read_ndarray<int16_t>(deserializer, msg); break;
+    case ISMRMRD_UINT: read_ndarray<uint32_t>(deserializer, msg); break;
+    case ISMRMRD_INT: read_ndarray<int32_t>(deserializer, msg); break;
+    case ISMRMRD_FLOAT: read_ndarray<float>(deserializer, msg); break;
+    case ISMRMRD_DOUBLE: read_ndarray<double>(deserializer, msg); break;
+    case ISMRMRD_CXFLOAT: read_ndarray<complex_float_t>(deserializer, msg); break;
+    case ISMRMRD_CXDOUBLE: read_ndarray<complex_double_t>(deserializer, msg); break;
+    default: throw std::runtime_error("Unsupported NDArray data type");
+    }
+}
+
+template <typename T> void write_image(ProtocolSerializer &serializer, const StreamMessage &msg) {
+    serializer.serialize(msg.image<T>());
+}
+
+template <typename T> void write_ndarray(ProtocolSerializer &serializer, const StreamMessage &msg) {
+    serializer.serialize(msg.ndarray<T>());
+}
+
+inline void write_image(ProtocolSerializer &serializer, const StreamMessage &msg) {
+    switch (msg.data_type) {
+    case ISMRMRD_USHORT: write_image<uint16_t>(serializer, msg); break;
+    case ISMRMRD_SHORT: write_image<int16_t>(serializer, msg); break;
+    case ISMRMRD_UINT: write_image<uint32_t>(serializer, msg); break;
+    case ISMRMRD_INT: write_image<int32_t>(serializer, msg); break;
+    case ISMRMRD_FLOAT: write_image<float>(serializer, msg); break;
+    case ISMRMRD_DOUBLE: write_image<double>(serializer, msg); break;
+    case ISMRMRD_CXFLOAT: write_image<complex_float_t>(serializer, msg); break;
+    case ISMRMRD_CXDOUBLE: write_image<complex_double_t>(serializer, msg); break;
+    default: throw std::runtime_error("Unsupported image data type");
+    }
+}
+
+inline void write_ndarray(ProtocolSerializer &serializer, const StreamMessage &msg) {
+    switch (msg.data_type) {
+    case ISMRMRD_USHORT: write_ndarray<uint16_t>(serializer, msg); break;
+    case ISMRMRD_SHORT: write_ndarray<int16_t>(serializer, msg); break;
+    case ISMRMRD_UINT: write_ndarray<uint32_t>(serializer, msg); break;
+    case ISMRMRD_INT: write_ndarray<int32_t>(serializer, msg); break;
+    case ISMRMRD_FLOAT: write_ndarray<float>(serializer, msg); break;
+    case ISMRMRD_DOUBLE: write_ndarray<double>(serializer, msg); break;
+    case ISMRMRD_CXFLOAT: write_ndarray<complex_float_t>(serializer, msg); break;
+    case ISMRMRD_CXDOUBLE: write_ndarray<complex_double_t>(serializer, msg); break;
+    default: throw std::runtime_error("Unsupported NDArray data type");
+    }
+}
+
+} // namespace detail
+
+// Decodes the next message of the stream into msg, reusing its storage. Returns
+// false at the close message.
+inline bool read_message(ProtocolDeserializer &deserializer, StreamMessage &msg) {
+    uint16_t id = deserializer.peek();
+    msg.id = id;
+    msg.data_type = 0;
+    switch (id) {
+    case ISMRMRD_MESSAGE_CLOSE:
+        return false;
+    case ISMRMRD_MESSAGE_CONFIG_FILE:
+        deserializer.deserialize(msg.config_file);
+        break;
+    case ISMRMRD_MESSAGE_CONFIG_TEXT:
+        deserializer.deserialize(msg.config_text);
+        break;
+    case ISMRMRD_MESSAGE_HEADER:
+        deserializer.deserialize(msg.header);
+        break;
+    case ISMRMRD_MESSAGE_TEXT:
+        deserializer.deserialize(msg.text);
+        break;
+    case ISMRMRD_MESSAGE_ACQUISITION:
+        deserializer.deserialize(msg.acquisition);
+        break;
+    case ISMRMRD_MESSAGE_ACQUISITION_BATCH:
+        deserializer.deserialize(msg.acquisitions);
+        break;
+    case ISMRMRD_MESSAGE_WAVEFORM:
+        deserializer.deserialize(msg.waveform);
+        break;
+    case ISMRMRD_MESSAGE_IMAGE:
+        msg.data_type = deserializer.peek_image_data_type();
+        detail::read_image(deserializer, msg, msg.data_type);
+        break;
+    case ISMRMRD_MESSAGE_NDARRAY:
+        msg.data_type = deserializer.peek_ndarray_data_type();
+        detail::read_ndarray(deserializer, msg, msg.data_type);
+        break;
+    default:
+        throw std::runtime_error("Unsupported message type");
+    }
+    return true;
+}
+
+// Serializes the message held by msg, the counterpart of read_message
+inline void write_message(ProtocolSerializer &serializer, const StreamMessage &msg) {
+    switch (msg.id) {
+    case ISMRMRD_MESSAGE_CLOSE:
+        serializer.close();
+        break;
+    case ISMRMRD_MESSAGE_CONFIG_FILE:
+        serializer.serialize(msg.config_file);
+        break;
+    case ISMRMRD_MESSAGE_CONFIG_TEXT:
+        serializer.serialize(msg.config_text);
+        break;
+    case ISMRMRD_MESSAGE_HEADER:
+        serializer.serialize(msg.header);
+        break;
+    case ISMRMRD_MESSAGE_TEXT:
+        serializer.serialize(msg.text);
+        break;
+    case ISMRMRD_MESSAGE_ACQUISITION:
+        serializer.serialize(msg.acquisition);
+        break;
+    case ISMRMRD_MESSAGE_ACQUISITION_BATCH:
+        serializer.serialize(msg.acquisitions);
+        break;
+    case ISMRMRD_MESSAGE_WAVEFORM:
+        serializer.serialize(msg.waveform);
+        break;
+    case ISMRMRD_MESSAGE_IMAGE:
+        detail::write_image(serializer, msg);
+        break;
+    case ISMRMRD_MESSAGE_NDARRAY:
+        detail::write_ndarray(serializer, msg);
+        break;
+    default:
+        throw std::runtime_error("Unsupported message type");
+    }
+}
+
+class StreamReader {
+public:
+    // Starts reading rs on a background thread. Messages with an id in skipped
+    // are discarded without being decoded (see ProtocolDeserializer::skip).
+    // Statistics, if given, are updated by the reader thread and may only be
+    // read once read has returned false or the reader is destroyed.
+    StreamReader(ReadableStreamView &rs, size_t capacity = 64,
+                 const std::set<uint16_t> &skipped = std::set<uint16_t>(), StreamStatistics *statistics = NULL)
+        : _deserializer(rs), _skipped(skipped), _producer(capacity) {
+        _deserializer.set_statistics(statistics);
+        _producer.start([this](StreamMessage &msg) { return read(msg); });
+    }
+
+    // The next message, valid until the following call. Returns NULL once the
+    // close message has been read. An error of the reader thread (including the
+    // input ending without a close message) is rethrown here.
+    StreamMessage *next() {
+        return _producer.next();
+    }
+
+    StreamReader(const StreamReader &) = delete;
+    StreamReader &operator=(const StreamReader &) = delete;
+
+private:
+    // Decodes the next message into msg, returns false at the close message
+    bool read(StreamMessage &msg) {
+        uint16_t id = _deserializer.peek();
+        while (_skipped.count(id) && id != ISMRMRD_MESSAGE_CLOSE) {
+            _deserializer.skip();
+            id = _deserializer.peek();
+        }
+        if (!read_message(_deserializer, msg)) {
+            return false;
+        }
+        msg.received = StreamStatistics::now();
+        return true;
+    }
+
+    ProtocolDeserializer _deserializer;
+    std::set<uint16_t> _skipped;
+    // Last, so that the thread is joined before the members it uses go away
+    BackgroundProducer<StreamMessage> _producer;
+};
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_STREAM_READER_H
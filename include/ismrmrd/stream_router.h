@@ -0,0 +1,459 @@
+#pragma once
+#ifndef ISMRMRD_STREAM_ROUTER_H
+#define ISMRMRD_STREAM_ROUTER_H
+
+#if __cplusplus < 201103L
+#error "ismrmrd/stream_router.h requires C++11"
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "ismrmrd/stream_reader.h"
+
+/**
+ * @file stream_router.h
+ *
+ * @brief Parallel reconstruction of one stream by several workers
+ *
+ * A StreamRouter reads an incoming stream and fans it out to worker streams:
+ * the header and the other control messages, waveforms and arrays are sent to
+ * every worker, and each acquisition goes to the worker selected by one of its
+ * encoding counters (ISMRMRD_EncodingCounterKeys), e.g. the slice. Noise
+ * measurements are sent to every worker. The images the workers send back are
+ * merged into one outgoing stream ordered by image_series_index and
+ * image_index.
+ *
+ * The worker streams can be pipes to subprocesses (FdReadStream and
+ * FdWriteStream) or, with route_to_threads, MemoryPipes to worker threads.
+ *
+ * Requires C++11. Header only, the library itself does not depend on C++11.
+ */
+
+namespace ISMRMRD {
+
+// Bounded byte pipe between two threads. The writing thread blocks while the
+// pipe is full, the reading thread while it is empty.
+class MemoryPipe : public ReadableStreamView, public WritableStreamView {
+public:
+    explicit MemoryPipe(size_t capacity = 4 * 1024 * 1024)
+        : _buffer(capacity), _begin(0), _size(0), _closed(false), _aborted(false), _eof(false) {}
+
+    // Reads count bytes. Sets eof() if the pipe is closed first
+    virtual void read(char *buffer, size_t count) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (count > 0) {
+            _readable.wait(lock, [this] { return _size > 0 || _closed; });
+            if (_size == 0) {
+                _eof = true;
+                return;
+            }
+            size_t n = std::min(count, std::min(_size, _buffer.size() - _begin));
+            memcpy(buffer, &_buffer[_begin], n);
+            _begin = (_begin + n) % _buffer.size();
+            _size -= n;
+            buffer += n;
+            count -= n;
+            _writable.notify_one();
+        }
+    }
+
+    virtual bool eof() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _eof;
+    }
+
+    // Throws once the reading side has called abort()
+    virtual void write(const char *buffer, size_t count) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (count > 0) {
+            _writable.wait(lock, [this] { return _size < _buffer.size() || _aborted; });
+            if (_aborted) {
+                throw std::runtime_error("The reader of the pipe has stopped");
+            }
+            size_t end = (_begin + _size) % _buffer.size();
+            size_t n = std::min(count, std::min(_buffer.size() - _size, _buffer.size() - end));
+            memcpy(&_buffer[end], buffer, n);
+            _size += n;
+            buffer += n;
+            count -= n;
+            _readable.notify_one();
+        }
+    }
+
+    virtual bool bad() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _aborted;
+    }
+
+    // Writing side: no more data, the reader sees the end of input after the
+    // buffered bytes
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _readable.notify_all();
+    }
+
+    // Reading side: no more data is read, writes fail instead of blocking
+    void abort() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _aborted = true;
+        _writable.notify_all();
+    }
+
+    MemoryPipe(const MemoryPipe &) = delete;
+    MemoryPipe &operator=(const MemoryPipe &) = delete;
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _readable;
+    std::condition_variable _writable;
+    std::vector<char> _buffer;
+    size_t _begin;
+    size_t _size;
+    bool _closed;
+    bool _aborted;
+    bool _eof;
+};
+
+class StreamRouter {
+public:
+    // Routes acquisitions by the encoding counter key (ISMRMRD_EncodingCounterKeys)
+    // to the worker streams inputs, and merges the worker streams outputs. Worker
+    // n reads inputs[n] and writes outputs[n], and must keep reading its input
+    // while it writes images. The streams must outlive the router.
+    StreamRouter(int key, const std::vector<WritableStreamView *> &inputs,
+                 const std::vector<ReadableStreamView *> &outputs)
+        : _key(key), _inputs(inputs), _outputs(outputs) {
+        if (key < 0 || key >= ISMRMRD_IDX_NUMBER_OF_KEYS) {
+            throw std::runtime_error("Invalid encoding counter key");
+        }
+        if (inputs.empty() || inputs.size() != outputs.size()) {
+            throw std::runtime_error("A stream router needs an input and an output stream per worker");
+        }
+    }
+
+    size_t workers() const {
+        return _inputs.size();
+    }
+
+    // Worker of an acquisition: the value of the encoding counter modulo the
+    // number of workers, so each worker gets every workers()-th slice, say
+    size_t worker(const AcquisitionHeader &head) const {
+        return ismrmrd_get_encoding_counter(&head.idx, _key) % _inputs.size();
+    }
+
+    // Routes in until its close message, while writing the merged output of
+    // the workers to out. Returns once every worker has closed its output, and
+    // then closes out.
+    //
+    // The merge is deterministic: each worker must send its images in
+    // increasing (image_series_index, image_index) order, and an image is only
+    // written once every worker has sent a later image or closed its output,
+    // the lower worker first for equal indices. Other messages of a worker are
+    // written in their order among its images. Images that arrive ahead of a
+    // slower worker are held in memory.
+    //
+    // The first error of the routing or of reading a worker output is thrown
+    // after all threads have finished.
+    void run(ReadableStreamView &in, WritableStreamView &out) {
+        _queues.clear();
+        _queues.resize(_outputs.size());
+        _route_error = std::exception_ptr();
+
+        std::thread router(&StreamRouter::route, this, std::ref(in));
+        std::vector<std::thread> drains;
+        for (size_t n = 0; n < _outputs.size(); n++) {
+            drains.push_back(std::thread(&StreamRouter::drain, this, n));
+        }
+
+        std::exception_ptr error;
+        try {
+            merge(out);
+        } catch (...) {
+            error = std::current_exception();
+            discard();
+        }
+        router.join();
+        for (size_t n = 0; n < drains.size(); n++) {
+            drains[n].join();
+        }
+
+        if (!error) {
+            error = _route_error;
+        }
+        for (size_t n = 0; n < _queues.size() && !error; n++) {
+            error = _queues[n].error;
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    StreamRouter(const StreamRouter &) = delete;
+    StreamRouter &operator=(const StreamRouter &) = delete;
+
+private:
+    // Messages decoded from one worker output
+    struct WorkerQueue {
+        WorkerQueue() : done(false) {}
+        std::deque<StreamMessage *> messages;
+        bool done;
+        std::exception_ptr error;
+    };
+
+    void route(ReadableStreamView &in) {
+        std::vector<std::unique_ptr<ProtocolSerializer> > serializers;
+        for (size_t n = 0; n < _inputs.size(); n++) {
+            serializers.push_back(std::unique_ptr<ProtocolSerializer>(new ProtocolSerializer(*_inputs[n])));
+        }
+        try {
+            ProtocolDeserializer deserializer(in);
+            StreamMessage msg;
+            std::vector<std::vector<Acquisition> > batches(_inputs.size());
+            while (read_message(deserializer, msg)) {
+                if (msg.id == ISMRMRD_MESSAGE_ACQUISITION && !is_noise(msg.acquisition)) {
+                    serializers[worker(msg.acquisition.getHead())]->serialize(msg.acquisition);
+                } else if (msg.id == ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+                    route_batch(msg.acquisitions, batches, serializers);
+                } else {
+                    for (size_t n = 0; n < serializers.size(); n++) {
+                        write_message(*serializers[n], msg);
+                    }
+                }
+            }
+        } catch (...) {
+            _route_error = std::current_exception();
+        }
+        // Also after an error, so that the workers finish
+        for (size_t n = 0; n < serializers.size(); n++) {
+            try {
+                serializers[n]->close();
+            } catch (...) {
+            }
+        }
+    }
+
+    static bool is_noise(const Acquisition &acq) {
+        return acq.isFlagSet(ISMRMRD_ACQ_IS_NOISE_MEASUREMENT);
+    }
+
+    // Splits a batch into one batch per worker, in the same order
+    void route_batch(const std::vector<Acquisition> &acqs, std::vector<std::vector<Acquisition> > &batches,
+                     std::vector<std::unique_ptr<ProtocolSerializer> > &serializers) {
+        for (size_t n = 0; n < batches.size(); n++) {
+            batches[n].clear();
+        }
+        for (size_t i = 0; i < acqs.size(); i++) {
+            if (is_noise(acqs[i])) {
+                for (size_t n = 0; n < batches.size(); n++) {
+                    batches[n].push_back(acqs[i]);
+                }
+            } else {
+                batches[worker(acqs[i].getHead())].push_back(acqs[i]);
+            }
+        }
+        for (size_t n = 0; n < batches.size(); n++) {
+            if (!batches[n].empty()) {
+                serializers[n]->serialize(batches[n]);
+            }
+        }
+    }
+
+    StreamMessage *allocate() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_free.empty()) {
+            _messages.push_back(std::unique_ptr<StreamMessage>(new StreamMessage()));
+            return _messages.back().get();
+        }
+        StreamMessage *msg = _free.back();
+        _free.pop_back();
+        return msg;
+    }
+
+    void recycle(StreamMessage *msg) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(msg);
+    }
+
+    // Decodes the output of worker n into its queue, without bound so that a
+    // worker never waits for the merge
+    void drain(size_t n) {
+        std::exception_ptr error;
+        try {
+            ProtocolDeserializer deserializer(*_outputs[n]);
+            for (;;) {
+                StreamMessage *msg = allocate();
+                if (!read_message(deserializer, *msg)) {
+                    recycle(msg);
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(_mutex);
+                _queues[n].messages.push_back(msg);
+                _changed.notify_one();
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queues[n].done = true;
+        _queues[n].error = error;
+        _changed.notify_one();
+    }
+
+    static bool image_before(const StreamMessage &a, const StreamMessage &b) {
+        const ImageHeader &ha = image_head(a);
+        const ImageHeader &hb = image_head(b);
+        if (ha.image_series_index != hb.image_series_index) {
+            return ha.image_series_index < hb.image_series_index;
+        }
+        return ha.image_index < hb.image_index;
+    }
+
+    static const ImageHeader &image_head(const StreamMessage &msg) {
+        switch (msg.data_type) {
+        case ISMRMRD_USHORT: return msg.image<uint16_t>().getHead();
+        case ISMRMRD_SHORT: return msg.image<int16_t>().getHead();
+        case ISMRMRD_UINT: return msg.image<uint32_t>().getHead();
+        case ISMRMRD_INT: return msg.image<int32_t>().getHead();
+        case ISMRMRD_FLOAT: return msg.image<float>().getHead();
+        case ISMRMRD_DOUBLE: return msg.image<double>().getHead();
+        case ISMRMRD_CXFLOAT: return msg.image<complex_float_t>().getHead();
+        case ISMRMRD_CXDOUBLE: return msg.image<complex_double_t>().getHead();
+        default: throw std::runtime_error("Unsupported image data type");
+        }
+    }
+
+    // Waits until every worker has a message queued or is done, and takes the
+    // next message to write. Returns NULL when all workers are done.
+    StreamMessage *next_merged() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this] {
+            for (size_t n = 0; n < _queues.size(); n++) {
+                if (_queues[n].messages.empty() && !_queues[n].done) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        size_t next = _queues.size();
+        for (size_t n = 0; n < _queues.size(); n++) {
+            if (_queues[n].messages.empty()) {
+                continue;
+            }
+            const StreamMessage &msg = *_queues[n].messages.front();
+            if (msg.id != ISMRMRD_MESSAGE_IMAGE) {
+                next = n;
+                break;
+            }
+            if (next == _queues.size() || image_before(msg, *_queues[next].messages.front())) {
+                next = n;
+            }
+        }
+        if (next == _queues.size()) {
+            return NULL;
+        }
+        StreamMessage *msg = _queues[next].messages.front();
+        _queues[next].messages.pop_front();
+        return msg;
+    }
+
+    void merge(WritableStreamView &out) {
+        ProtocolSerializer serializer(out);
+        StreamMessage *msg;
+        while ((msg = next_merged()) != NULL) {
+            try {
+                write_message(serializer, *msg);
+            } catch (...) {
+                recycle(msg);
+                throw;
+            }
+            recycle(msg);
+        }
+        serializer.close();
+    }
+
+    // Drops the worker outputs after the merge has failed
+    void discard() {
+        StreamMessage *msg;
+        while ((msg = next_merged()) != NULL) {
+            recycle(msg);
+        }
+    }
+
+    int _key;
+    std::vector<WritableStreamView *> _inputs;
+    std::vector<ReadableStreamView *> _outputs;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<WorkerQueue> _queues;
+    std::vector<std::unique_ptr<StreamMessage> > _messages;
+    std::vector<StreamMessage *> _free;
+    std::exception_ptr _route_error;
+};
+
+// A worker of route_to_threads: reads the routed stream in and writes its
+// images to out, ending with a close message
+typedef std::function<void(ReadableStreamView &in, WritableStreamView &out)> StreamWorker;
+
+// Reconstructs in with workers threads running worker, see StreamRouter. An
+// error of a worker is thrown after all threads have finished.
+inline void route_to_threads(ReadableStreamView &in, WritableStreamView &out, int key, size_t workers,
+                             const StreamWorker &worker) {
+    std::vector<std::unique_ptr<MemoryPipe> > pipes;
+    std::vector<WritableStreamView *> inputs;
+    std::vector<ReadableStreamView *> outputs;
+    for (size_t n = 0; n < workers; n++) {
+        pipes.push_back(std::unique_ptr<MemoryPipe>(new MemoryPipe()));
+        inputs.push_back(pipes.back().get());
+        pipes.push_back(std::unique_ptr<MemoryPipe>(new MemoryPipe()));
+        outputs.push_back(pipes.back().get());
+    }
+    StreamRouter router(key, inputs, outputs);
+
+    std::vector<std::exception_ptr> errors(workers);
+    std::vector<std::thread> threads;
+    for (size_t n = 0; n < workers; n++) {
+        MemoryPipe *input = pipes[2 * n].get();
+        MemoryPipe *output = pipes[2 * n + 1].get();
+        std::exception_ptr *error = &errors[n];
+        threads.push_back(std::thread([input, output, error, &worker] {
+            try {
+                worker(*input, *output);
+            } catch (...) {
+                *error = std::current_exception();
+            }
+            input->abort();
+            output->close();
+        }));
+    }
+
+    std::exception_ptr error;
+    try {
+        router.run(in, out);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (size_t n = 0; n < threads.size(); n++) {
+        threads[n].join();
+    }
+    // The error of a worker explains the error of the router reading its output
+    for (size_t n = 0; n < errors.size(); n++) {
+        if (errors[n]) {
+            std::rethrow_exception(errors[n]);
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_STREAM_ROUTER_H
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef ISMRMRD_STREAM_STATISTICS_H
+#define ISMRMRD_STREAM_STATISTICS_H
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "ismrmrd/export.h"
+#include "ismrmrd/ismrmrd.h"
+
+/**
+ * @file stream_statistics.h
+ *
+ * @brief Counters of the messages sent or received on a protocol stream
+ *
+ * A StreamStatistics attached to a ProtocolSerializer or ProtocolDeserializer
+ * (set_statistics) records, per message type, the number of messages, their
+ * bytes, the time spent blocked in the reads or writes of the stream view, and
+ * the rest of the time spent serializing or deserializing them (copying,
+ * compression). Without statistics the serializers do not read the clock.
+ *
+ * LatencyStatistics measures how long after its last input (e.g. the last
+ * acquisition of a slice) a reconstruction sends each output.
+ */
+
+namespace ISMRMRD {
+
+// Name of a message id (ISMRMRD_MESSAGE_ID), e.g. "acquisition"
+EXPORTISMRMRD const char *message_name(uint16_t id);
+
+// Counters of one message type
+struct EXPORTISMRMRD MessageStatistics {
+    MessageStatistics();
+    uint64_t count;
+    // Including the message ids
+    uint64_t bytes;
+    // Blocked in the reads or writes of the stream view
+    double io_seconds;
+    // Serializing or deserializing, besides the I/O
+    double codec_seconds;
+};
+
+class EXPORTISMRMRD StreamStatistics {
+public:
+    // Counters of each message id seen, as sent on the stream, so compressed
+    // acquisitions and images are counted apart from uncompressed ones. The
+    // close message is not counted.
+    const std::map<uint16_t, MessageStatistics> &messages() const;
+    // Counters of one message id, zero if none was seen
+    MessageStatistics message(uint16_t id) const;
+    // Sum over all message types
+    MessageStatistics total() const;
+    void reset();
+
+    // Prints a table with a line per message type and the total
+    void print(std::ostream &os) const;
+
+    // Counts a message, used by the serializers
+    void record(uint16_t id, uint64_t bytes, double io_seconds, double seconds);
+
+    // Monotonic time in seconds, from an arbitrary origin
+    static double now();
+
+private:
+    std::map<uint16_t, MessageStatistics> _messages;
+};
+
+// Latencies from the arrival of the inputs of an output to the output being
+// sent. Inputs and outputs are matched by a key chosen by the caller, e.g. the
+// slice, and times are from StreamStatistics::now().
+class EXPORTISMRMRD LatencyStatistics {
+public:
+    // Records the arrival of an input for key; the latest one counts
+    void received(uint64_t key, double time);
+    // Records an output for key sent at time and returns its latency in
+    // seconds. The inputs of the key are forgotten, an output without any
+    // input is not counted and returns a negative latency.
+    double sent(uint64_t key, double time);
+
+    // Latencies of the outputs, in the order they were sent
+    const std::vector<double> &latencies() const;
+    // Latency that a fraction p (0 to 1) of the outputs did not exceed, by
+    // nearest rank, 0 without outputs
+    double percentile(double p) const;
+    void reset();
+
+    // Prints the count, mean, p50, p95, p99 and maximum in milliseconds
+    void print(std::ostream &os) const;
+
+private:
+    std::map<uint64_t, double> _received;
+    std::vector<double> _latencies;
+};
+
+} // namespace ISMRMRD
+
+#endif // ISMRMRD_STREAM_STATISTICS_H
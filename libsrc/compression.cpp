@@ -0,0 +1,187 @@
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef ISMRMRD_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ismrmrd/compression.h"
+
+namespace ISMRMRD {
+
+bool compression_supported(uint16_t codec) {
+    switch (codec) {
+    case ISMRMRD_COMPRESSION_NONE:
+        return true;
+    case ISMRMRD_COMPRESSION_DEFLATE:
+    case ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE:
+    case ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE:
+#ifdef ISMRMRD_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+uint64_t compressed_size_bound(uint64_t size) {
+    // zlib's compressBound, with room for the zlib wrapper
+    return size + (size >> 12) + (size >> 14) + (size >> 25) + 64;
+}
+
+static void check_codec(uint16_t codec) {
+    if (codec == ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE) {
+        throw std::runtime_error("The quantized codec only applies to acquisitions");
+    }
+    if (!compression_supported(codec)) {
+        std::stringstream ss;
+        ss << "Unsupported compression codec " << codec;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+// Groups byte b of every element together, trailing bytes that do not make a
+// whole element are kept at the end
+static void shuffle(const char *in, char *out, size_t size, size_t width) {
+    size_t n = size / width;
+    for (size_t b = 0; b < width; b++) {
+        char *o = out + b * n;
+        for (size_t i = 0; i < n; i++) {
+            o[i] = in[i * width + b];
+        }
+    }
+    memcpy(out + n * width, in + n * width, size - n * width);
+}
+
+static void unshuffle(const char *in, char *out, size_t size, size_t width) {
+    size_t n = size / width;
+    for (size_t b = 0; b < width; b++) {
+        const char *s = in + b * n;
+        for (size_t i = 0; i < n; i++) {
+            out[i * width + b] = s[i];
+        }
+    }
+    memcpy(out + n * width, in + n * width, size - n * width);
+}
+
+PayloadCodec::PayloadCodec() : _deflate(NULL), _deflate_level(0), _inflate(NULL) {}
+
+PayloadCodec::~PayloadCodec() {
+#ifdef ISMRMRD_HAVE_ZLIB
+    if (_deflate) {
+        deflateEnd(static_cast<z_stream *>(_deflate));
+        delete static_cast<z_stream *>(_deflate);
+    }
+    if (_inflate) {
+        inflateEnd(static_cast<z_stream *>(_inflate));
+        delete static_cast<z_stream *>(_inflate);
+    }
+#endif
+}
+
+void PayloadCodec::compress(uint16_t codec, int level, size_t element_size, const void *data, size_t size,
+                            std::vector<char> &out) {
+    check_codec(codec);
+    if (size > ISMRMRD_MAX_COMPRESSED_PAYLOAD) {
+        throw std::runtime_error("Payload too large to compress");
+    }
+    const char *input = static_cast<const char *>(data);
+    if (codec == ISMRMRD_COMPRESSION_NONE) {
+        out.assign(input, input + size);
+        return;
+    }
+#ifdef ISMRMRD_HAVE_ZLIB
+    if (codec == ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE && element_size > 1 && size > 0) {
+        _shuffled.resize(size);
+        shuffle(input, &_shuffled[0], size, element_size);
+        input = &_shuffled[0];
+    }
+
+    z_stream *zs = static_cast<z_stream *>(_deflate);
+    if (zs && _deflate_level != level) {
+        deflateEnd(zs);
+        delete zs;
+        zs = NULL;
+        _deflate = NULL;
+    }
+    if (!zs) {
+        zs = new z_stream();
+        if (deflateInit(zs, level) != Z_OK) {
+            delete zs;
+            throw std::runtime_error("Error initializing deflate compression");
+        }
+        _deflate = zs;
+        _deflate_level = level;
+    } else {
+        deflateReset(zs);
+    }
+
+    out.resize(deflateBound(zs, static_cast<uLong>(size)));
+    zs->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input));
+    zs->avail_in = static_cast<uInt>(size);
+    zs->next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs->avail_out = static_cast<uInt>(out.size());
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+        throw std::runtime_error("Error compressing payload");
+    }
+    out.resize(zs->total_out);
+#else
+    (void)level;
+    (void)element_size;
+#endif
+}
+
+void PayloadCodec::decompress(uint16_t codec, size_t element_size, const void *compressed, size_t compressed_size,
+                              void *data, size_t size) {
+    check_codec(codec);
+    char *output = static_cast<char *>(data);
+    if (codec == ISMRMRD_COMPRESSION_NONE) {
+        if (compressed_size != size) {
+            throw std::runtime_error("Uncompressed payload has the wrong size");
+        }
+        memcpy(output, compressed, size);
+        return;
+    }
+#ifdef ISMRMRD_HAVE_ZLIB
+    if (size > std::numeric_limits<uInt>::max() || compressed_size > std::numeric_limits<uInt>::max()) {
+        throw std::runtime_error("Payload too large to decompress");
+    }
+    bool shuffled = codec == ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE && element_size > 1 && size > 0;
+    char *target = output;
+    if (shuffled) {
+        _shuffled.resize(size);
+        target = &_shuffled[0];
+    }
+
+    z_stream *zs = static_cast<z_stream *>(_inflate);
+    if (!zs) {
+        zs = new z_stream();
+        if (inflateInit(zs) != Z_OK) {
+            delete zs;
+            throw std::runtime_error("Error initializing deflate decompression");
+        }
+        _inflate = zs;
+    } else {
+        inflateReset(zs);
+    }
+
+    zs->next_in = reinterpret_cast<Bytef *>(const_cast<void *>(compressed));
+    zs->avail_in = static_cast<uInt>(compressed_size);
+    zs->next_out = reinterpret_cast<Bytef *>(target);
+    zs->avail_out = static_cast<uInt>(size);
+    if (inflate(zs, Z_FINISH) != Z_STREAM_END || zs->total_out != size) {
+        throw std::runtime_error("Error decompressing payload");
+    }
+    if (shuffled) {
+        unshuffle(target, output, size, element_size);
+    }
+#else
+    (void)element_size;
+#endif
+}
+
+} // namespace ISMRMRD
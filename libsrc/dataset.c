@@ -153,6 +153,7 @@ static int delete_var(const ISMRMRD_Dataset *dset, const char *var) {
 }
 
 #define ISMRMRD_READ_BUFFER_SIZE 1024*1024 //HDF5 default buffer size
+#define ISMRMRD_READONLY_MDC_INITIAL_SIZE 256*1024 //HDF5 default is 2 MB
 
 //Static buffers here means ISMRMRD is not threadsafe. Howevever, neither is HDF5, so we don't loose anything here. 
 static char ismrmrd_conversion_buffer[ISMRMRD_READ_BUFFER_SIZE];
@@ -369,6 +370,67 @@ static hid_t get_hdf5type_acquisition(void) {
     return datatype;
 }
 
+/* Compound subset of the acquisition type: reading with it skips the trajectory and data */
+static hid_t get_hdf5type_acquisition_head(void) {
+    hid_t datatype, vartype;
+    herr_t h5status;
+
+    datatype = H5Tcreate(H5T_COMPOUND, sizeof(ISMRMRD_AcquisitionHeader));
+    vartype = get_hdf5type_acquisitionheader();
+    h5status = H5Tinsert(datatype, "head", 0, vartype);
+    H5Tclose(vartype);
+
+    if (h5status < 0) {
+        ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed get acquisition header data type");
+    }
+
+    return datatype;
+}
+
+/* Compound subset of parent holding only the (nested) member at member_path, e.g. "head.idx.slice" */
+static hid_t get_hdf5type_member(hid_t parent, const char *member_path) {
+    hid_t datatype, membertype, innertype;
+    herr_t h5status;
+    const char *rest;
+    char *name;
+    size_t len;
+    int member;
+
+    rest = strchr(member_path, '.');
+    len = rest ? (size_t)(rest - member_path) : strlen(member_path);
+    name = (char *) malloc(len + 1);
+    if (name == NULL) {
+        ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc member name");
+        return -1;
+    }
+    memcpy(name, member_path, len);
+    name[len] = '\0';
+
+    datatype = -1;
+    member = H5Tget_class(parent) == H5T_COMPOUND ? H5Tget_member_index(parent, name) : -1;
+    if (member < 0) {
+        ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Unknown acquisition header member.");
+        free(name);
+        return -1;
+    }
+
+    membertype = H5Tget_member_type(parent, (unsigned) member);
+    innertype = rest ? get_hdf5type_member(membertype, rest + 1) : H5Tcopy(membertype);
+    H5Tclose(membertype);
+    if (innertype >= 0) {
+        datatype = H5Tcreate(H5T_COMPOUND, H5Tget_size(innertype));
+        h5status = H5Tinsert(datatype, name, 0, innertype);
+        H5Tclose(innertype);
+        if (h5status < 0) {
+            H5Tclose(datatype);
+            datatype = -1;
+            ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed get acquisition header member data type");
+        }
+    }
+    free(name);
+    return datatype;
+}
+
 static hid_t get_hdf5type_imageheader(void) {
     hid_t datatype;
     herr_t h5status;
@@ -624,9 +686,10 @@ static uint32_t get_number_of_elements(const ISMRMRD_Dataset *dset, const char *
     return num;
 }
 
-static int append_element(const ISMRMRD_Dataset * dset, const char * path,
-        void * elem, const hid_t datatype,
-        const uint16_t ndim, const size_t *dims)
+/* Appends count consecutive elements of ndim dimensions each */
+static int append_elements(const ISMRMRD_Dataset * dset, const char * path,
+        void * elems, const hid_t datatype,
+        const uint16_t ndim, const size_t *dims, uint32_t count)
 {
     hid_t dataset, dataspace, props, filespace, memspace;
     herr_t h5status = 0;
@@ -672,19 +735,19 @@ static int append_element(const ISMRMRD_Dataset * dset, const char * path,
                 return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Dimensions are incorrect.");
             }
         }
-        /* extend it by one */
-        hdfdims[0] += 1;
+        /* extend it by count */
+        hdfdims[0] += count;
         h5status = H5Dset_extent(dataset, hdfdims);
         /* Select the last block */
-        ext_dims[0] = 1;
+        ext_dims[0] = count;
         for (n = 0; n < ndim; n++) {
             offset[n + 1] = 0;
             ext_dims[n + 1] = dims[n];
         }
     } else {
-        hdfdims[0] = 1;
+        hdfdims[0] = count;
         maxdims[0] = H5S_UNLIMITED;
-        ext_dims[0] = 1;
+        ext_dims[0] = count;
         chunk_dims[0] = 1;
         for (n = 0; n < ndim; n++) {
             hdfdims[n + 1] = dims[n];
@@ -721,7 +784,7 @@ static int append_element(const ISMRMRD_Dataset * dset, const char * path,
     }
 
     /* Select the last block */
-    offset[0] = hdfdims[0]-1;
+    offset[0] = hdfdims[0]-count;
     filespace = H5Dget_space(dataset);
     h5status  = H5Sselect_hyperslab (filespace, H5S_SELECT_SET, offset, NULL, ext_dims, NULL);
 	
@@ -739,8 +802,7 @@ static int append_element(const ISMRMRD_Dataset * dset, const char * path,
     free(chunk_dims);
 
     /* Write it */
-    /* since this is a 1 element array we can just pass the pointer to the header */
-    h5status = H5Dwrite(dataset, datatype, memspace, filespace, dset->transfer_properties, elem);
+    h5status = H5Dwrite(dataset, datatype, memspace, filespace, dset->transfer_properties, elems);
     if (h5status < 0) {
         H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
         return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to write dataset");
@@ -771,6 +833,14 @@ static int append_element(const ISMRMRD_Dataset * dset, const char * path,
     return ISMRMRD_NOERROR;
 }
 
+static int append_element(const ISMRMRD_Dataset * dset, const char * path,
+        void * elem, const hid_t datatype,
+        const uint16_t ndim, const size_t *dims)
+{
+    /* since this is a 1 element array we can just pass the pointer to the element */
+    return append_elements(dset, path, elem, datatype, ndim, dims, 1);
+}
+
 static int get_array_properties(const ISMRMRD_Dataset *dset, const char *path,
         uint16_t *ndim, size_t dims[ISMRMRD_NDARRAY_MAXDIM],
         uint16_t *data_type)
@@ -924,6 +994,469 @@ cleanup:
     return ret_code;
 }
 
+/* Reads count consecutive elements of a one dimensional variable with a single hyperslab selection */
+static int read_elements(const ISMRMRD_Dataset *dset, const char *path, void *elems,
+                         const hid_t datatype, const uint32_t index, const uint32_t count) {
+    hid_t dataset, filespace, memspace;
+    hsize_t hdfdims[1], offset[1], block[1];
+    herr_t h5status = 0;
+    int ret_code = ISMRMRD_NOERROR;
+
+    if (NULL == dset) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+
+    /* Check path existence */
+    if (!link_exists(dset, path)) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Path to element not found.");
+    }
+
+    dataset = H5Dopen2(dset->fileid, path, H5P_DEFAULT);
+    filespace = H5Dget_space(dataset);
+
+    if (H5Sget_simple_extent_ndims(filespace) != 1) {
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Block reads require a one dimensional variable.");
+        goto cleanup;
+    }
+
+    h5status = H5Sget_simple_extent_dims(filespace, hdfdims, NULL);
+    if (count == 0 || (hsize_t)index + count > hdfdims[0]) {
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Index out of range.");
+        goto cleanup;
+    }
+
+    offset[0] = index;
+    block[0] = count;
+    h5status = H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, block, NULL);
+    memspace = H5Screate_simple(1, block, NULL);
+
+    h5status = H5Dread(dataset, datatype, memspace, filespace, dset->transfer_properties, elems);
+    H5Sclose(memspace);
+    if (h5status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to read from dataset.");
+        goto cleanup;
+    }
+
+cleanup:
+    H5Sclose(filespace);
+    h5status = H5Dclose(dataset);
+    if (h5status < 0 && ret_code == ISMRMRD_NOERROR) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to close dataset.");
+    }
+    return ret_code;
+}
+
+#if H5_VERSION_GE(1, 10, 3)
+#define ISMRMRD_HAVE_RAW_CHUNK_IO 1
+#endif
+
+/* Number of bytes moved per read/write when a variable has to be copied element-wise */
+#define ISMRMRD_COPY_BLOCK_SIZE 64*1024*1024
+
+static bool has_variable_length(hid_t datatype) {
+    if (H5Tdetect_class(datatype, H5T_VLEN) > 0) {
+        return true;
+    }
+    return H5Tget_class(datatype) == H5T_STRING && H5Tis_variable_str(datatype) > 0;
+}
+
+static herr_t reclaim_variable_length(hid_t datatype, hid_t space, void *buf) {
+#if H5_VERSION_GE(1, 12, 0)
+    return H5Treclaim(datatype, space, H5P_DEFAULT, buf);
+#else
+    return H5Dvlen_reclaim(datatype, space, H5P_DEFAULT, buf);
+#endif
+}
+
+/* True if every element of both variables is stored as exactly one chunk with the same filters,
+ * so chunks can be moved between the files without being decoded */
+static bool raw_chunk_copy_possible(hid_t dst, hid_t src, hid_t datatype, int rank, const hsize_t *dims) {
+#ifdef ISMRMRD_HAVE_RAW_CHUNK_IO
+    hid_t src_dcpl, dst_dcpl;
+    hsize_t src_chunk[H5S_MAX_RANK], dst_chunk[H5S_MAX_RANK];
+    unsigned int src_flags, dst_flags;
+    size_t nelmts = 0;
+    int n, nfilters;
+    bool possible = !has_variable_length(datatype);
+
+    src_dcpl = H5Dget_create_plist(src);
+    dst_dcpl = H5Dget_create_plist(dst);
+    if (possible) {
+        possible = H5Pget_layout(src_dcpl) == H5D_CHUNKED && H5Pget_layout(dst_dcpl) == H5D_CHUNKED &&
+                   H5Pget_chunk(src_dcpl, rank, src_chunk) == rank && H5Pget_chunk(dst_dcpl, rank, dst_chunk) == rank;
+    }
+    for (n = 0; possible && n < rank; n++) {
+        possible = src_chunk[n] == dst_chunk[n] && src_chunk[n] == (n == 0 ? 1 : dims[n]);
+    }
+    if (possible) {
+        nfilters = H5Pget_nfilters(src_dcpl);
+        possible = nfilters == H5Pget_nfilters(dst_dcpl);
+        for (n = 0; possible && n < nfilters; n++) {
+            H5Z_filter_t src_filter, dst_filter;
+            nelmts = 0;
+            src_filter = H5Pget_filter2(src_dcpl, n, &src_flags, &nelmts, NULL, 0, NULL, NULL);
+            nelmts = 0;
+            dst_filter = H5Pget_filter2(dst_dcpl, n, &dst_flags, &nelmts, NULL, 0, NULL, NULL);
+            possible = src_filter == dst_filter && src_flags == dst_flags;
+        }
+    }
+    H5Pclose(src_dcpl);
+    H5Pclose(dst_dcpl);
+    return possible;
+#else
+    (void)dst;
+    (void)src;
+    (void)datatype;
+    (void)rank;
+    (void)dims;
+    return false;
+#endif
+}
+
+/* Appends all elements of the HDF5 dataset src to dst, extending dst once */
+static int append_dataset(hid_t dst, hid_t src) {
+    hid_t src_space, dst_space, src_type, dst_type, memtype, memspace;
+    hsize_t src_dims[H5S_MAX_RANK], dst_dims[H5S_MAX_RANK], offset[H5S_MAX_RANK], count[H5S_MAX_RANK];
+    hsize_t dst_offset[H5S_MAX_RANK];
+    hsize_t first, n, block, element_size;
+    herr_t h5status = 0;
+    void *buffer = NULL;
+    int rank, k;
+    int ret_code = ISMRMRD_NOERROR;
+
+    src_space = H5Dget_space(src);
+    dst_space = H5Dget_space(dst);
+    src_type = H5Dget_type(src);
+    dst_type = H5Dget_type(dst);
+    rank = H5Sget_simple_extent_ndims(src_space);
+
+    if (rank < 1 || rank != H5Sget_simple_extent_ndims(dst_space) || H5Tequal(src_type, dst_type) <= 0) {
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Variable types do not match.");
+        goto cleanup;
+    }
+    H5Sget_simple_extent_dims(src_space, src_dims, NULL);
+    H5Sget_simple_extent_dims(dst_space, dst_dims, NULL);
+    for (k = 1; k < rank; k++) {
+        if (src_dims[k] != dst_dims[k]) {
+            ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Dimensions are incorrect.");
+            goto cleanup;
+        }
+    }
+    if (src_dims[0] == 0) {
+        goto cleanup;
+    }
+
+    /* extend once for all the new elements */
+    first = dst_dims[0];
+    dst_dims[0] += src_dims[0];
+    if (H5Dset_extent(dst, dst_dims) < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to extend dataset.");
+        goto cleanup;
+    }
+
+#ifdef ISMRMRD_HAVE_RAW_CHUNK_IO
+    if (raw_chunk_copy_possible(dst, src, src_type, rank, src_dims)) {
+        size_t capacity = 0;
+        hsize_t chunk_size;
+        uint32_t filter_mask;
+        for (k = 1; k < rank; k++) {
+            offset[k] = 0;
+            dst_offset[k] = 0;
+        }
+        for (n = 0; n < src_dims[0]; n++) {
+            offset[0] = n;
+            dst_offset[0] = first + n;
+            if (H5Dget_chunk_storage_size(src, offset, &chunk_size) < 0) {
+                H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+                ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to get chunk size.");
+                goto cleanup;
+            }
+            if (chunk_size == 0) {
+                /* never written, leave the fill value */
+                continue;
+            }
+            if (chunk_size > capacity) {
+                void *resized = realloc(buffer, (size_t)chunk_size);
+                if (resized == NULL) {
+                    ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc chunk buffer.");
+                    goto cleanup;
+                }
+                buffer = resized;
+                capacity = (size_t)chunk_size;
+            }
+            if (H5Dread_chunk(src, H5P_DEFAULT, offset, &filter_mask, buffer) < 0 ||
+                H5Dwrite_chunk(dst, H5P_DEFAULT, filter_mask, dst_offset, (size_t)chunk_size, buffer) < 0) {
+                H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+                ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to copy chunk.");
+                goto cleanup;
+            }
+        }
+        goto cleanup;
+    }
+#endif
+
+    /* Variable length or differently chunked data has to go through memory, in large blocks */
+    memtype = H5Tget_native_type(src_type, H5T_DIR_DEFAULT);
+    element_size = H5Tget_size(memtype);
+    for (k = 1; k < rank; k++) {
+        element_size *= src_dims[k];
+    }
+    block = ISMRMRD_COPY_BLOCK_SIZE / element_size;
+    if (block < 1) {
+        block = 1;
+    }
+    if (block > src_dims[0]) {
+        block = src_dims[0];
+    }
+    buffer = malloc((size_t)(block * element_size));
+    if (buffer == NULL) {
+        H5Tclose(memtype);
+        ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc copy buffer.");
+        goto cleanup;
+    }
+
+    for (k = 1; k < rank; k++) {
+        offset[k] = 0;
+        count[k] = src_dims[k];
+    }
+    H5Sclose(dst_space);
+    dst_space = H5Dget_space(dst);
+    for (n = 0; n < src_dims[0] && ret_code == ISMRMRD_NOERROR; n += block) {
+        count[0] = (n + block > src_dims[0]) ? src_dims[0] - n : block;
+        memspace = H5Screate_simple(rank, count, NULL);
+        offset[0] = n;
+        h5status = H5Sselect_hyperslab(src_space, H5S_SELECT_SET, offset, NULL, count, NULL);
+        h5status = H5Dread(src, memtype, memspace, src_space, H5P_DEFAULT, buffer);
+        if (h5status >= 0) {
+            offset[0] = first + n;
+            h5status = H5Sselect_hyperslab(dst_space, H5S_SELECT_SET, offset, NULL, count, NULL);
+            h5status = H5Dwrite(dst, memtype, memspace, dst_space, H5P_DEFAULT, buffer);
+            if (has_variable_length(memtype)) {
+                reclaim_variable_length(memtype, memspace, buffer);
+            }
+        }
+        if (h5status < 0) {
+            H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+            ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to copy elements.");
+        }
+        H5Sclose(memspace);
+    }
+    H5Tclose(memtype);
+
+cleanup:
+    free(buffer);
+    H5Tclose(src_type);
+    H5Tclose(dst_type);
+    H5Sclose(src_space);
+    H5Sclose(dst_space);
+    return ret_code;
+}
+
+/* Copies the object at src_path in src to dst_path in dst, appending if the destination exists */
+static int copy_object(const ISMRMRD_Dataset *dst, const char *dst_path,
+                       const ISMRMRD_Dataset *src, const char *src_path) {
+    hid_t src_obj, dst_obj, lcpl_id;
+    H5G_info_t info;
+    H5I_type_t type;
+    char *name, *src_member, *dst_member;
+    ssize_t len;
+    hsize_t n;
+    int status = ISMRMRD_NOERROR;
+
+    if (!link_exists(dst, dst_path)) {
+        /* A whole new variable: let HDF5 copy the object and its storage */
+        lcpl_id = H5Pcreate(H5P_LINK_CREATE);
+        H5Pset_create_intermediate_group(lcpl_id, 1);
+        status = H5Ocopy(src->fileid, src_path, dst->fileid, dst_path, H5P_DEFAULT, lcpl_id);
+        H5Pclose(lcpl_id);
+        if (status < 0) {
+            H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+            return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to copy variable.");
+        }
+        return ISMRMRD_NOERROR;
+    }
+
+    src_obj = H5Oopen(src->fileid, src_path, H5P_DEFAULT);
+    dst_obj = H5Oopen(dst->fileid, dst_path, H5P_DEFAULT);
+    type = H5Iget_type(src_obj);
+    if (src_obj < 0 || dst_obj < 0 || type != H5Iget_type(dst_obj)) {
+        status = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Variables are not of the same kind.");
+    } else if (type == H5I_DATASET) {
+        status = append_dataset(dst_obj, src_obj);
+    } else if (type == H5I_GROUP) {
+        /* e.g. an image series: append each of header, attributes and data */
+        H5Gget_info(src_obj, &info);
+        for (n = 0; n < info.nlinks && status == ISMRMRD_NOERROR; n++) {
+            len = H5Lget_name_by_idx(src_obj, ".", H5_INDEX_NAME, H5_ITER_INC, n, NULL, 0, H5P_DEFAULT);
+            name = (char *) malloc(len + 1);
+            H5Lget_name_by_idx(src_obj, ".", H5_INDEX_NAME, H5_ITER_INC, n, name, len + 1, H5P_DEFAULT);
+            src_member = append_to_path(src, src_path, name);
+            dst_member = append_to_path(dst, dst_path, name);
+            status = copy_object(dst, dst_member, src, src_member);
+            free(src_member);
+            free(dst_member);
+            free(name);
+        }
+    } else {
+        status = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Unsupported variable type.");
+    }
+    if (src_obj >= 0) {
+        H5Oclose(src_obj);
+    }
+    if (dst_obj >= 0) {
+        H5Oclose(dst_obj);
+    }
+    return status;
+}
+
+typedef struct AcquisitionSortEntry {
+    uint16_t key[ISMRMRD_IDX_NUMBER_OF_KEYS];
+    uint32_t index;
+} AcquisitionSortEntry;
+
+/* Lexicographic on the keys, then on the original index so the sort is stable */
+static int compare_sort_entries(const void *a, const void *b) {
+    const AcquisitionSortEntry *ea = (const AcquisitionSortEntry *) a;
+    const AcquisitionSortEntry *eb = (const AcquisitionSortEntry *) b;
+    int n;
+    for (n = 0; n < ISMRMRD_IDX_NUMBER_OF_KEYS; n++) {
+        if (ea->key[n] != eb->key[n]) {
+            return ea->key[n] < eb->key[n] ? -1 : 1;
+        }
+    }
+    return ea->index < eb->index ? -1 : (ea->index > eb->index ? 1 : 0);
+}
+
+/* Writes the elements of src_path selected by order to a new variable dst_path, in that order */
+static int write_permuted_acquisitions(const ISMRMRD_Dataset *dst, const char *dst_path,
+                                       const ISMRMRD_Dataset *src, const char *src_path,
+                                       const uint32_t *order, uint32_t n) {
+    hid_t src_dataset, dst_dataset, src_space, dst_space, memspace, filetype, memtype, dcpl;
+    hsize_t dims[1], maxdims[1], offset[1], count[1], *coords;
+    HDF5_Acquisition *buffer;
+    herr_t h5status = 0;
+    uint32_t j, k, block = 256;
+    int ret_code = ISMRMRD_NOERROR;
+
+    src_dataset = H5Dopen2(src->fileid, src_path, H5P_DEFAULT);
+    if (src_dataset < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to open acquisitions.");
+    }
+
+    /* Same type and storage properties as the source */
+    filetype = H5Dget_type(src_dataset);
+    dcpl = H5Dget_create_plist(src_dataset);
+    dims[0] = n;
+    maxdims[0] = H5S_UNLIMITED;
+    dst_space = H5Screate_simple(1, dims, maxdims);
+    dst_dataset = H5Dcreate2(dst->fileid, dst_path, filetype, dst_space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Pclose(dcpl);
+    H5Tclose(filetype);
+    if (dst_dataset < 0) {
+        H5Sclose(dst_space);
+        H5Dclose(src_dataset);
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to create sorted acquisitions.");
+    }
+
+    memtype = get_hdf5type_acquisition();
+    src_space = H5Dget_space(src_dataset);
+    buffer = (HDF5_Acquisition *) malloc(block * sizeof(HDF5_Acquisition));
+    coords = (hsize_t *) malloc(block * sizeof(hsize_t));
+
+    for (j = 0; j < n && ret_code == ISMRMRD_NOERROR; j += block) {
+        count[0] = (n - j < block) ? n - j : block;
+        /* A point selection is read in the order the points are listed */
+        for (k = 0; k < count[0]; k++) {
+            coords[k] = order[j + k];
+        }
+        memspace = H5Screate_simple(1, count, NULL);
+        h5status = H5Sselect_elements(src_space, H5S_SELECT_SET, (size_t)count[0], coords);
+        h5status = H5Dread(src_dataset, memtype, memspace, src_space, dst->transfer_properties, buffer);
+        if (h5status >= 0) {
+            offset[0] = j;
+            h5status = H5Sselect_hyperslab(dst_space, H5S_SELECT_SET, offset, NULL, count, NULL);
+            h5status = H5Dwrite(dst_dataset, memtype, memspace, dst_space, dst->transfer_properties, buffer);
+            reclaim_variable_length(memtype, memspace, buffer);
+        }
+        if (h5status < 0) {
+            H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+            ret_code = ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to write sorted acquisitions.");
+        }
+        H5Sclose(memspace);
+    }
+
+    free(coords);
+    free(buffer);
+    H5Tclose(memtype);
+    H5Sclose(src_space);
+    H5Sclose(dst_space);
+    H5Dclose(dst_dataset);
+    H5Dclose(src_dataset);
+    return ret_code;
+}
+
+/* Stores the acquisition order and the sort keys in groupname/acquisition_order */
+static int write_acquisition_order(const ISMRMRD_Dataset *dset, const uint32_t *order, uint32_t n,
+                                   const int *keys, uint16_t nkeys) {
+    hid_t dataset, dataspace, attrspace, attribute;
+    hsize_t dims[1];
+    uint16_t keyvalues[ISMRMRD_IDX_NUMBER_OF_KEYS];
+    herr_t h5status;
+    char *path;
+    uint16_t k;
+
+    delete_var(dset, "acquisition_order");
+    path = make_path(dset, "acquisition_order");
+    dims[0] = n;
+    dataspace = H5Screate_simple(1, dims, NULL);
+    dataset = H5Dcreate2(dset->fileid, path, H5T_NATIVE_UINT32, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    free(path);
+    if (dataset < 0) {
+        H5Sclose(dataspace);
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to create acquisition order.");
+    }
+    h5status = H5Dwrite(dataset, H5T_NATIVE_UINT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, order);
+
+    for (k = 0; k < nkeys; k++) {
+        keyvalues[k] = (uint16_t)keys[k];
+    }
+    dims[0] = nkeys;
+    attrspace = H5Screate_simple(1, dims, NULL);
+    attribute = H5Acreate2(dataset, "keys", H5T_NATIVE_UINT16, attrspace, H5P_DEFAULT, H5P_DEFAULT);
+    if (h5status >= 0) {
+        h5status = H5Awrite(attribute, H5T_NATIVE_UINT16, keyvalues);
+    }
+    H5Aclose(attribute);
+    H5Sclose(attrspace);
+    H5Sclose(dataspace);
+    H5Dclose(dataset);
+
+    if (h5status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to write acquisition order.");
+    }
+    return ISMRMRD_NOERROR;
+}
+
+/* Compares the leading sort keys of an acquisition header with values */
+static int compare_key_prefix(const ISMRMRD_AcquisitionHeader *head, const int *keys,
+                              const uint16_t *values, uint16_t nvalues) {
+    uint16_t n, value;
+    for (n = 0; n < nvalues; n++) {
+        value = ismrmrd_get_encoding_counter(&head->idx, keys[n]);
+        if (value != values[n]) {
+            return value < values[n] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
 /********************/
 /* Public functions */
 /********************/
@@ -1013,6 +1546,48 @@ int ismrmrd_open_dataset(ISMRMRD_Dataset *dset, const bool create_if_needed) {
     return ISMRMRD_NOERROR;
 }
 
+int ismrmrd_open_dataset_readonly(ISMRMRD_Dataset *dset, const bool use_file_locking) {
+    hid_t fileid, file_access;
+    H5AC_cache_config_t mdc_config;
+
+    if (NULL == dset) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "NULL Dataset parameter");
+    }
+
+    /* Use the default (sec2) driver, no read-write attempt and no group creation */
+    file_access = H5Pcreate(H5P_FILE_ACCESS);
+
+#if (H5_VERS_MAJOR == 1 && H5_VERS_MINOR == 10 && H5_VERS_RELEASE >= 7) || H5_VERSION_GE(1, 12, 1)
+    if (!use_file_locking) {
+        H5Pset_file_locking(file_access, 0, 1);
+    }
+#else
+    /* File locking can only be disabled through HDF5_USE_FILE_LOCKING with this HDF5 version */
+    (void)use_file_locking;
+#endif
+
+    /* Most files are opened to read a handful of small objects, start with a small metadata cache */
+    mdc_config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    if (H5Pget_mdc_config(file_access, &mdc_config) >= 0) {
+        mdc_config.set_initial_size = 1;
+        mdc_config.initial_size = ISMRMRD_READONLY_MDC_INITIAL_SIZE;
+        if (mdc_config.min_size > mdc_config.initial_size) {
+            mdc_config.min_size = mdc_config.initial_size;
+        }
+        H5Pset_mdc_config(file_access, &mdc_config);
+    }
+
+    fileid = H5Fopen(dset->filename, H5F_ACC_RDONLY, file_access);
+    H5Pclose(file_access);
+    if (fileid < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to open file.");
+    }
+    dset->fileid = fileid;
+
+    return ISMRMRD_NOERROR;
+}
+
 int ismrmrd_close_dataset(ISMRMRD_Dataset *dset) {
     herr_t h5status;
 
@@ -1221,6 +1796,58 @@ int ismrmrd_append_acquisition(const ISMRMRD_Dataset *dset, const ISMRMRD_Acquis
     return ISMRMRD_NOERROR;
 }
 
+int ismrmrd_append_acquisitions(const ISMRMRD_Dataset *dset, const ISMRMRD_Acquisition *acqs, uint32_t count) {
+    int status;
+    char *path;
+    hid_t datatype;
+    HDF5_Acquisition *hdf5acqs;
+    uint32_t n;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (acqs==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Acquisition pointer should not be NULL.");
+    }
+    if (count == 0) {
+        return ISMRMRD_NOERROR;
+    }
+
+    hdf5acqs = (HDF5_Acquisition *) malloc(count * sizeof(HDF5_Acquisition));
+    if (hdf5acqs == NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc acquisition block.");
+    }
+
+    /* The HDF5 versions of the acquisitions point to their data */
+    for (n = 0; n < count; n++) {
+        hdf5acqs[n].head = acqs[n].head;
+        hdf5acqs[n].traj.len = (size_t)(acqs[n].head.number_of_samples) * (size_t)(acqs[n].head.trajectory_dimensions);
+        hdf5acqs[n].traj.p = acqs[n].traj;
+        hdf5acqs[n].data.len = 2 * (size_t)(acqs[n].head.number_of_samples) * (size_t)(acqs[n].head.active_channels);
+        hdf5acqs[n].data.p = acqs[n].data;
+    }
+
+    path = make_path(dset, "data");
+    datatype = get_hdf5type_acquisition();
+
+    /* Write them with a single extent and write */
+    status = append_elements(dset, path, hdf5acqs, datatype, 0, NULL, count);
+    free(hdf5acqs);
+    free(path);
+    if (status != ISMRMRD_NOERROR) {
+        H5Tclose(datatype);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to append acquisitions.");
+    }
+
+    status = H5Tclose(datatype);
+    if (status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to close datatype.");
+    }
+
+    return ISMRMRD_NOERROR;
+}
+
 int ismrmrd_read_acquisition(const ISMRMRD_Dataset *dset, uint32_t index, ISMRMRD_Acquisition *acq)
 {
     hid_t datatype;
@@ -1259,20 +1886,378 @@ int ismrmrd_read_acquisition(const ISMRMRD_Dataset *dset, uint32_t index, ISMRMR
     return ISMRMRD_NOERROR;
 }
 
-int ismrmrd_append_image(const ISMRMRD_Dataset *dset, const char *varname, const ISMRMRD_Image *im) {
-    int status;
+int ismrmrd_read_acquisitions(const ISMRMRD_Dataset *dset, uint32_t index, uint32_t count,
+                              ISMRMRD_Acquisition *acqs)
+{
     hid_t datatype;
-    char *path, *headerpath, *attrpath, *datapath;
-    size_t dims[4];
+    herr_t h5status;
+    HDF5_Acquisition *hdf5acqs;
+    char *path;
+    uint32_t n;
+    int status;
 
     if (dset==NULL) {
         return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
     }
-    if (varname==NULL) {
-        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Varname should not be NULL.");
+    if (acqs==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Acquisition pointer should not be NULL.");
     }
-    if (im==NULL) {
-        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Image pointer should not be NULL.");
+
+    hdf5acqs = (HDF5_Acquisition *) malloc(count * sizeof(HDF5_Acquisition));
+    if (hdf5acqs == NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc acquisition block.");
+    }
+
+    /* The path to the acquisition data */
+    path = make_path(dset, "data");
+
+    /* The acquisition datatype */
+    datatype = get_hdf5type_acquisition();
+
+    status = read_elements(dset, path, hdf5acqs, datatype, index, count);
+    free(path);
+    h5status = H5Tclose(datatype);
+    if (status != ISMRMRD_NOERROR) {
+        free(hdf5acqs);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to read acquisitions.");
+    }
+
+    /* Hand the variable length buffers allocated by HDF5 over to the acquisitions */
+    for (n = 0; n < count; n++) {
+        ismrmrd_cleanup_acquisition(&acqs[n]);
+        memcpy(&acqs[n].head, &hdf5acqs[n].head, sizeof(ISMRMRD_AcquisitionHeader));
+        acqs[n].traj = (float *) hdf5acqs[n].traj.p;
+        acqs[n].data = (complex_float_t *) hdf5acqs[n].data.p;
+    }
+    free(hdf5acqs);
+
+    if (h5status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to close datatype.");
+    }
+
+    return ISMRMRD_NOERROR;
+}
+
+int ismrmrd_read_acquisition_headers(const ISMRMRD_Dataset *dset, uint32_t index, uint32_t count,
+                                     ISMRMRD_AcquisitionHeader *heads)
+{
+    hid_t datatype;
+    char *path;
+    int status;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (heads==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Header pointer should not be NULL.");
+    }
+
+    path = make_path(dset, "data");
+    datatype = get_hdf5type_acquisition_head();
+    status = read_elements(dset, path, heads, datatype, index, count);
+    free(path);
+    H5Tclose(datatype);
+    if (status != ISMRMRD_NOERROR) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to read acquisition headers.");
+    }
+    return ISMRMRD_NOERROR;
+}
+
+int ismrmrd_read_acquisition_header_member(const ISMRMRD_Dataset *dset, const char *member,
+                                           uint32_t index, uint32_t count, void *values, size_t size)
+{
+    hid_t acqtype, datatype;
+    char *path, *member_path;
+    int status;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (member==NULL || values==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Member and value pointers should not be NULL.");
+    }
+
+    member_path = (char *) malloc(strlen(member) + 6);
+    if (member_path == NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc member path");
+    }
+    strcpy(member_path, "head.");
+    strcat(member_path, member);
+
+    acqtype = get_hdf5type_acquisition();
+    datatype = get_hdf5type_member(acqtype, member_path);
+    H5Tclose(acqtype);
+    free(member_path);
+    if (datatype < 0) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Failed to get acquisition header member type.");
+    }
+    if ((size_t) count * H5Tget_size(datatype) != size) {
+        H5Tclose(datatype);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Buffer size does not match acquisition header member.");
+    }
+
+    path = make_path(dset, "data");
+    status = read_elements(dset, path, values, datatype, index, count);
+    free(path);
+    H5Tclose(datatype);
+    if (status != ISMRMRD_NOERROR) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to read acquisition header member.");
+    }
+    return ISMRMRD_NOERROR;
+}
+
+int ismrmrd_sort_acquisitions(const ISMRMRD_Dataset *dst, const ISMRMRD_Dataset *src,
+                              const int *keys, uint16_t nkeys)
+{
+    ISMRMRD_AcquisitionHeader *heads = NULL;
+    AcquisitionSortEntry *entries = NULL;
+    uint32_t *order = NULL, *previous = NULL;
+    char *src_path = NULL, *dst_path = NULL;
+    uint32_t n, j;
+    uint16_t k;
+    bool in_place;
+    int status = ISMRMRD_NOERROR;
+
+    if (dst==NULL || src==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (keys==NULL || nkeys == 0 || nkeys > ISMRMRD_IDX_NUMBER_OF_KEYS) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Invalid number of sort keys.");
+    }
+    for (k = 0; k < nkeys; k++) {
+        if (keys[k] < 0 || keys[k] >= ISMRMRD_IDX_NUMBER_OF_KEYS) {
+            return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Invalid encoding counter key.");
+        }
+    }
+
+    in_place = dst == src || (strcmp(dst->filename, src->filename) == 0 && strcmp(dst->groupname, src->groupname) == 0);
+    src_path = make_path(src, "data");
+    dst_path = make_path(dst, in_place ? "data_sorting" : "data");
+    if (!in_place && link_exists(dst, dst_path)) {
+        status = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Destination already contains acquisitions.");
+        goto cleanup;
+    }
+    if (in_place) {
+        /* Left behind by a sort that did not finish */
+        status = delete_var(dst, "data_sorting");
+        if (status != ISMRMRD_NOERROR) {
+            goto cleanup;
+        }
+    }
+
+    n = ismrmrd_get_number_of_acquisitions(src);
+    if (n == 0) {
+        goto cleanup;
+    }
+
+    /* Only the headers are needed to work out the order */
+    heads = (ISMRMRD_AcquisitionHeader *) malloc(n * sizeof(ISMRMRD_AcquisitionHeader));
+    entries = (AcquisitionSortEntry *) calloc(n, sizeof(AcquisitionSortEntry));
+    order = (uint32_t *) malloc(n * sizeof(uint32_t));
+    previous = (uint32_t *) malloc(n * sizeof(uint32_t));
+    if (heads == NULL || entries == NULL || order == NULL || previous == NULL) {
+        status = ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc sort buffers.");
+        goto cleanup;
+    }
+    status = ismrmrd_read_acquisition_headers(src, 0, n, heads);
+    if (status != ISMRMRD_NOERROR) {
+        goto cleanup;
+    }
+    for (j = 0; j < n; j++) {
+        for (k = 0; k < nkeys; k++) {
+            entries[j].key[k] = ismrmrd_get_encoding_counter(&heads[j].idx, keys[k]);
+        }
+        entries[j].index = j;
+    }
+    qsort(entries, n, sizeof(AcquisitionSortEntry), compare_sort_entries);
+    for (j = 0; j < n; j++) {
+        order[j] = entries[j].index;
+    }
+
+    status = write_permuted_acquisitions(dst, dst_path, src, src_path, order, n);
+    if (status != ISMRMRD_NOERROR) {
+        goto cleanup;
+    }
+    if (in_place) {
+        if (H5Ldelete(dst->fileid, src_path, H5P_DEFAULT) < 0 ||
+            H5Lmove(dst->fileid, dst_path, dst->fileid, src_path, H5P_DEFAULT, H5P_DEFAULT) < 0) {
+            H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+            status = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to replace acquisitions.");
+            goto cleanup;
+        }
+    }
+
+    /* Map back to the original acquisition order if the source had already been sorted */
+    status = ismrmrd_read_acquisition_order(src, previous);
+    if (status != ISMRMRD_NOERROR) {
+        goto cleanup;
+    }
+    for (j = 0; j < n; j++) {
+        order[j] = previous[order[j]];
+    }
+    status = write_acquisition_order(dst, order, n, keys, nkeys);
+
+cleanup:
+    free(previous);
+    free(order);
+    free(entries);
+    free(heads);
+    free(dst_path);
+    free(src_path);
+    return status;
+}
+
+int ismrmrd_read_acquisition_order(const ISMRMRD_Dataset *dset, uint32_t *order)
+{
+    hid_t datatype;
+    uint32_t n, stored, j;
+    char *path;
+    int status = ISMRMRD_NOERROR;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (order==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Order pointer should not be NULL.");
+    }
+
+    n = ismrmrd_get_number_of_acquisitions(dset);
+    path = make_path(dset, "acquisition_order");
+    stored = get_number_of_elements(dset, path);
+    if (stored > n) {
+        stored = n;
+    }
+    if (stored > 0) {
+        datatype = H5Tcopy(H5T_NATIVE_UINT32);
+        status = read_elements(dset, path, order, datatype, 0, stored);
+        H5Tclose(datatype);
+    }
+    free(path);
+    /* Acquisitions appended after sorting keep their position */
+    for (j = stored; j < n; j++) {
+        order[j] = j;
+    }
+    return status;
+}
+
+int ismrmrd_get_acquisition_sort_keys(const ISMRMRD_Dataset *dset, int keys[ISMRMRD_IDX_NUMBER_OF_KEYS],
+                                      uint16_t *nkeys)
+{
+    hid_t dataset, attribute, attrspace;
+    hsize_t dims[1];
+    uint16_t keyvalues[ISMRMRD_IDX_NUMBER_OF_KEYS];
+    herr_t h5status = 0;
+    char *path;
+    uint16_t k;
+
+    if (dset==NULL || keys==NULL || nkeys==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Pointer should not be NULL.");
+    }
+
+    *nkeys = 0;
+    path = make_path(dset, "acquisition_order");
+    if (!link_exists(dset, path)) {
+        free(path);
+        return ISMRMRD_NOERROR;
+    }
+    dataset = H5Dopen2(dset->fileid, path, H5P_DEFAULT);
+    free(path);
+    attribute = H5Aopen(dataset, "keys", H5P_DEFAULT);
+    attrspace = H5Aget_space(attribute);
+    dims[0] = 0;
+    H5Sget_simple_extent_dims(attrspace, dims, NULL);
+    if (dims[0] > ISMRMRD_IDX_NUMBER_OF_KEYS) {
+        h5status = -1;
+    } else {
+        h5status = H5Aread(attribute, H5T_NATIVE_UINT16, keyvalues);
+    }
+    H5Sclose(attrspace);
+    H5Aclose(attribute);
+    H5Dclose(dataset);
+    if (h5status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to read acquisition sort keys.");
+    }
+    for (k = 0; k < dims[0]; k++) {
+        keys[k] = keyvalues[k];
+    }
+    *nkeys = (uint16_t)dims[0];
+    return ISMRMRD_NOERROR;
+}
+
+int ismrmrd_find_acquisition_range(const ISMRMRD_Dataset *dset, const uint16_t *values, uint16_t nvalues,
+                                   uint32_t *first, uint32_t *count)
+{
+    int keys[ISMRMRD_IDX_NUMBER_OF_KEYS];
+    ISMRMRD_AcquisitionHeader head;
+    uint16_t nkeys;
+    uint32_t lo, hi, mid, lower, sorted;
+    char *path;
+    int status;
+
+    if (dset==NULL || first==NULL || count==NULL || (values==NULL && nvalues > 0)) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Pointer should not be NULL.");
+    }
+    status = ismrmrd_get_acquisition_sort_keys(dset, keys, &nkeys);
+    if (status != ISMRMRD_NOERROR) {
+        return status;
+    }
+    if (nvalues > nkeys) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "More values than sort keys of the dataset.");
+    }
+
+    /* Only the acquisitions covered by the stored order are sorted */
+    path = make_path(dset, "acquisition_order");
+    sorted = get_number_of_elements(dset, path);
+    free(path);
+
+    /* Two binary searches, reading one header per step */
+    lo = 0;
+    hi = sorted;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((status = ismrmrd_read_acquisition_headers(dset, mid, 1, &head)) != ISMRMRD_NOERROR) {
+            return status;
+        }
+        if (compare_key_prefix(&head, keys, values, nvalues) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    lower = lo;
+    hi = sorted;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((status = ismrmrd_read_acquisition_headers(dset, mid, 1, &head)) != ISMRMRD_NOERROR) {
+            return status;
+        }
+        if (compare_key_prefix(&head, keys, values, nvalues) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *first = lower;
+    *count = lo - lower;
+    return ISMRMRD_NOERROR;
+}
+
+int ismrmrd_append_image(const ISMRMRD_Dataset *dset, const char *varname, const ISMRMRD_Image *im) {
+    int status;
+    hid_t datatype;
+    char *path, *headerpath, *attrpath, *datapath;
+    size_t dims[4];
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (varname==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Varname should not be NULL.");
+    }
+    if (im==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Image pointer should not be NULL.");
     }
 
     /* The group for this set of images */
@@ -1326,6 +2311,102 @@ int ismrmrd_append_image(const ISMRMRD_Dataset *dset, const char *varname, const
     return ISMRMRD_NOERROR;
 }
 
+int ismrmrd_append_images(const ISMRMRD_Dataset *dset, const char *varname, const ISMRMRD_Image *ims,
+                          uint32_t count) {
+    int status;
+    hid_t datatype;
+    char *path, *headerpath, *attrpath, *datapath;
+    size_t dims[4], data_size;
+    ISMRMRD_ImageHeader *heads;
+    char **attributes;
+    char *data;
+    uint32_t n;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (varname==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Varname should not be NULL.");
+    }
+    if (ims==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Image pointer should not be NULL.");
+    }
+    if (count == 0) {
+        return ISMRMRD_NOERROR;
+    }
+
+    /* The images are stacked into one array, so they must all have the same size */
+    for (n = 1; n < count; n++) {
+        if (ims[n].head.data_type != ims[0].head.data_type || ims[n].head.channels != ims[0].head.channels ||
+            ims[n].head.matrix_size[0] != ims[0].head.matrix_size[0] ||
+            ims[n].head.matrix_size[1] != ims[0].head.matrix_size[1] ||
+            ims[n].head.matrix_size[2] != ims[0].head.matrix_size[2]) {
+            return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Images appended together must have the same size and type.");
+        }
+    }
+
+    data_size = ismrmrd_size_of_image_data(&ims[0]);
+    heads = (ISMRMRD_ImageHeader *) malloc(count * sizeof(ISMRMRD_ImageHeader));
+    attributes = (char **) malloc(count * sizeof(char *));
+    data = (char *) malloc(count * data_size);
+    if (heads == NULL || attributes == NULL || (data == NULL && data_size > 0)) {
+        free(heads);
+        free(attributes);
+        free(data);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc image block.");
+    }
+    for (n = 0; n < count; n++) {
+        heads[n] = ims[n].head;
+        attributes[n] = ims[n].attribute_string;
+        if (data_size > 0) {
+            memcpy(data + n * data_size, ims[n].data, data_size);
+        }
+    }
+
+    /* The group for this set of images */
+    path = make_path(dset, varname);
+    create_link(dset, path);
+
+    /* Handle the headers */
+    headerpath = append_to_path(dset, path, "header");
+    datatype = get_hdf5type_imageheader();
+    status = append_elements(dset, headerpath, heads, datatype, 0, NULL, count);
+    H5Tclose(datatype);
+    free(headerpath);
+
+    /* Handle the attribute strings */
+    if (status == ISMRMRD_NOERROR) {
+        attrpath = append_to_path(dset, path, "attributes");
+        datatype = get_hdf5type_image_attribute_string();
+        status = append_elements(dset, attrpath, attributes, datatype, 0, NULL, count);
+        H5Tclose(datatype);
+        free(attrpath);
+    }
+
+    /* Handle the data, with the dimensions permuted in the hdf5 file */
+    if (status == ISMRMRD_NOERROR) {
+        datapath = append_to_path(dset, path, "data");
+        datatype = get_hdf5type_ndarray(ims[0].head.data_type);
+        dims[3] = ims[0].head.matrix_size[0];
+        dims[2] = ims[0].head.matrix_size[1];
+        dims[1] = ims[0].head.matrix_size[2];
+        dims[0] = ims[0].head.channels;
+        status = append_elements(dset, datapath, data, datatype, 4, dims, count);
+        H5Tclose(datatype);
+        free(datapath);
+    }
+
+    free(path);
+    free(heads);
+    free(attributes);
+    free(data);
+    if (status != ISMRMRD_NOERROR) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to append images.");
+    }
+
+    return ISMRMRD_NOERROR;
+}
+
 uint32_t ismrmrd_get_number_of_images(const ISMRMRD_Dataset *dset, const char *varname)
 {
     char *path, *headerpath;
@@ -1469,6 +2550,53 @@ int ismrmrd_append_waveform(const ISMRMRD_Dataset *dset, const ISMRMRD_Waveform
     return ISMRMRD_NOERROR;
 }
 
+int ismrmrd_append_waveforms(const ISMRMRD_Dataset *dset, const ISMRMRD_Waveform *wavs, uint32_t count) {
+    int status;
+    char *path;
+    hid_t datatype;
+    HDF5_Waveform *hdf5wavs;
+    uint32_t n;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (wavs==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Waveform pointer should not be NULL.");
+    }
+    if (count == 0) {
+        return ISMRMRD_NOERROR;
+    }
+
+    hdf5wavs = (HDF5_Waveform *) malloc(count * sizeof(HDF5_Waveform));
+    if (hdf5wavs == NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc waveform block.");
+    }
+    for (n = 0; n < count; n++) {
+        hdf5wavs[n].head = wavs[n].head;
+        hdf5wavs[n].data.len = (size_t)(wavs[n].head.number_of_samples) * (size_t)(wavs[n].head.channels);
+        hdf5wavs[n].data.p = wavs[n].data;
+    }
+
+    path = make_path(dset, "waveforms");
+    datatype = get_hdf5type_waveform();
+
+    status = append_elements(dset, path, hdf5wavs, datatype, 0, NULL, count);
+    free(hdf5wavs);
+    free(path);
+    if (status != ISMRMRD_NOERROR) {
+        H5Tclose(datatype);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to append waveforms.");
+    }
+
+    status = H5Tclose(datatype);
+    if (status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to close datatype.");
+    }
+
+    return ISMRMRD_NOERROR;
+}
+
 int ismrmrd_read_waveform(const ISMRMRD_Dataset *dset, uint32_t index, ISMRMRD_Waveform *wav)
 {
     hid_t datatype;
@@ -1507,6 +2635,57 @@ int ismrmrd_read_waveform(const ISMRMRD_Dataset *dset, uint32_t index, ISMRMRD_W
     return ISMRMRD_NOERROR;
 }
 
+int ismrmrd_read_waveforms(const ISMRMRD_Dataset *dset, uint32_t index, uint32_t count, ISMRMRD_Waveform *wavs)
+{
+    hid_t datatype;
+    herr_t h5status;
+    HDF5_Waveform *hdf5wavs;
+    char *path;
+    uint32_t n;
+    int status;
+
+    if (dset==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (wavs==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Waveform pointer should not be NULL.");
+    }
+
+    hdf5wavs = (HDF5_Waveform *) malloc(count * sizeof(HDF5_Waveform));
+    if (hdf5wavs == NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_MEMORYERROR, "Failed to malloc waveform block.");
+    }
+
+    /* The path to the waveform data */
+    path = make_path(dset, "waveforms");
+
+    /* The waveform datatype */
+    datatype = get_hdf5type_waveform();
+
+    status = read_elements(dset, path, hdf5wavs, datatype, index, count);
+    free(path);
+    h5status = H5Tclose(datatype);
+    if (status != ISMRMRD_NOERROR) {
+        free(hdf5wavs);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to read waveforms.");
+    }
+
+    /* Hand the variable length buffers allocated by HDF5 over to the waveforms */
+    for (n = 0; n < count; n++) {
+        free(wavs[n].data);
+        memcpy(&wavs[n].head, &hdf5wavs[n].head, sizeof(ISMRMRD_WaveformHeader));
+        wavs[n].data = (uint32_t *) hdf5wavs[n].data.p;
+    }
+    free(hdf5wavs);
+
+    if (h5status < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_HDF5ERROR, "Failed to close datatype.");
+    }
+
+    return ISMRMRD_NOERROR;
+}
+
 uint32_t ismrmrd_get_number_of_waveforms(const ISMRMRD_Dataset *dset) {
     char *path;
     uint32_t numacq;
@@ -1636,6 +2815,73 @@ int ismrmrd_read_array(const ISMRMRD_Dataset *dset, const char *varname,
 }
 
 
+int ismrmrd_copy_variable(const ISMRMRD_Dataset *dst, const ISMRMRD_Dataset *src,
+                          const char *srcvar, const char *dstvar) {
+    char *src_path, *dst_path;
+    int status;
+
+    if (dst==NULL || src==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+    if (srcvar==NULL || dstvar==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Varname should not be NULL.");
+    }
+
+    src_path = make_path(src, srcvar);
+    dst_path = make_path(dst, dstvar);
+    if (!link_exists(src, src_path)) {
+        status = ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Source variable not found.");
+    } else {
+        status = copy_object(dst, dst_path, src, src_path);
+    }
+    free(src_path);
+    free(dst_path);
+    return status;
+}
+
+int ismrmrd_merge_dataset(const ISMRMRD_Dataset *dst, const ISMRMRD_Dataset *src) {
+    hid_t gid;
+    H5G_info_t info;
+    char *name, *dst_path;
+    ssize_t len;
+    hsize_t n;
+    bool copy_order;
+    int status = ISMRMRD_NOERROR;
+
+    if (dst==NULL || src==NULL) {
+        return ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Dataset pointer should not be NULL.");
+    }
+
+    /* The order of src holds src indices, which only stay valid if its
+       acquisitions end up at the start of dst */
+    dst_path = make_path(dst, "acquisition_order");
+    copy_order = ismrmrd_get_number_of_acquisitions(dst) == 0 && !link_exists(dst, dst_path);
+    free(dst_path);
+
+    gid = H5Gopen2(src->fileid, src->groupname, H5P_DEFAULT);
+    if (gid < 0) {
+        H5Ewalk2(H5E_DEFAULT, H5E_WALK_UPWARD, walk_hdf5_errors, NULL);
+        return ISMRMRD_PUSH_ERR(ISMRMRD_FILEERROR, "Failed to open source group.");
+    }
+    H5Gget_info(gid, &info);
+    for (n = 0; n < info.nlinks && status == ISMRMRD_NOERROR; n++) {
+        len = H5Lget_name_by_idx(gid, ".", H5_INDEX_NAME, H5_ITER_INC, n, NULL, 0, H5P_DEFAULT);
+        name = (char *) malloc(len + 1);
+        H5Lget_name_by_idx(gid, ".", H5_INDEX_NAME, H5_ITER_INC, n, name, len + 1, H5P_DEFAULT);
+        /* The destination keeps its own XML header */
+        dst_path = make_path(dst, name);
+        if (strcmp(name, "acquisition_order") == 0 ? copy_order
+                                                   : (strcmp(name, "xml") != 0 || !link_exists(dst, dst_path))) {
+            status = ismrmrd_copy_variable(dst, src, name, name);
+        }
+        free(dst_path);
+        free(name);
+    }
+    H5Gclose(gid);
+    return status;
+}
+
+
 #ifdef __cplusplus
 } /* extern "C" */
 } /* ISMRMRD namespace */
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdexcept>
+#include <algorithm>
 
 namespace ISMRMRD {
 //
@@ -26,6 +27,20 @@ Dataset::Dataset(const char* filename, const char* groupname, bool create_file_i
     }
 }
 
+Dataset::Dataset(const char* filename, const char* groupname, DatasetOpenMode mode)
+{
+    int status;
+    status = ismrmrd_init_dataset(&dset_, filename, groupname);
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+    status = ismrmrd_open_dataset_readonly(&dset_, mode != DATASET_READ_ONLY_NO_FILE_LOCKING);
+    if (status != ISMRMRD_NOERROR) {
+        ismrmrd_close_dataset(&dset_);
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
 // Destructor
 Dataset::~Dataset()
 {
@@ -54,7 +69,36 @@ void Dataset::readHeader(std::string& xmlstring){
 // Acquisitions
 void Dataset::appendAcquisition(const Acquisition &acq)
 {
-    int status = ismrmrd_append_acquisition(&dset_, &acq.acq);
+    appendAcquisition(AcquisitionView(acq));
+}
+
+void Dataset::appendAcquisition(const AcquisitionView &acq)
+{
+    // The C API only reads through the pointers of a shallow acquisition
+    ISMRMRD_Acquisition shallow;
+    shallow.head = *acq.head;
+    shallow.traj = const_cast<float *>(acq.traj);
+    shallow.data = const_cast<complex_float_t *>(acq.data);
+    appendAcquisition(&shallow);
+}
+
+void Dataset::appendAcquisition(const ISMRMRD_Acquisition *acq)
+{
+    int status = ismrmrd_append_acquisition(&dset_, acq);
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
+void Dataset::appendAcquisitions(const Acquisition *acqs, size_t count)
+{
+    // Shallow copies, the C API only reads through their pointers
+    std::vector<ISMRMRD_Acquisition> block(count);
+    for (size_t n = 0; n < count; n++) {
+        block[n] = acqs[n].acq;
+    }
+    int status = count > 0 ? ismrmrd_append_acquisitions(&dset_, &block[0], static_cast<uint32_t>(count))
+                           : ISMRMRD_NOERROR;
     if (status != ISMRMRD_NOERROR) {
         throw std::runtime_error(build_exception_string());
     }
@@ -67,6 +111,230 @@ void Dataset::readAcquisition(uint32_t index, Acquisition & acq) {
     }
 }
 
+void Dataset::readAcquisitions(uint32_t index, uint32_t count, std::vector<Acquisition> &acqs) {
+    std::vector<ISMRMRD_Acquisition> block(count);
+    for (uint32_t n = 0; n < count; n++) {
+        ismrmrd_init_acquisition(&block[n]);
+    }
+    int status = count > 0 ? ismrmrd_read_acquisitions(&dset_, index, count, &block[0]) : ISMRMRD_NOERROR;
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+    // Move the buffers into the acquisitions without copying the data
+    acqs.resize(count);
+    for (uint32_t n = 0; n < count; n++) {
+        ismrmrd_cleanup_acquisition(&acqs[n].acq);
+        acqs[n].acq = block[n];
+    }
+}
+
+void Dataset::readAcquisitionHeaders(uint32_t index, uint32_t count, std::vector<AcquisitionHeader> &heads) {
+    heads.resize(count);
+    int status = count > 0 ? ismrmrd_read_acquisition_headers(&dset_, index, count, &heads[0]) : ISMRMRD_NOERROR;
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
+// Appends width elements of a header member to a column
+template <typename T>
+static void append_to_column(std::vector<T> &column, const T *values, size_t width) {
+    column.insert(column.end(), values, values + width);
+}
+
+void Dataset::readAcquisitionHeaderTable(AcquisitionHeaderTable &table) {
+    // Every column costs a pass over the acquisitions in the file, so the headers are read
+    // once in blocks and split into columns in memory
+    const uint32_t block_size = 4096;
+    uint32_t n = getNumberOfAcquisitions();
+
+    table = AcquisitionHeaderTable();
+    table.number_of_acquisitions = n;
+    table.version.reserve(n);
+    table.flags.reserve(n);
+    table.measurement_uid.reserve(n);
+    table.scan_counter.reserve(n);
+    table.acquisition_time_stamp.reserve(n);
+    table.physiology_time_stamp.reserve(n * ISMRMRD_PHYS_STAMPS);
+    table.number_of_samples.reserve(n);
+    table.available_channels.reserve(n);
+    table.active_channels.reserve(n);
+    table.channel_mask.reserve(n * ISMRMRD_CHANNEL_MASKS);
+    table.discard_pre.reserve(n);
+    table.discard_post.reserve(n);
+    table.center_sample.reserve(n);
+    table.encoding_space_ref.reserve(n);
+    table.trajectory_dimensions.reserve(n);
+    table.sample_time_us.reserve(n);
+    table.position.reserve(n * 3);
+    table.read_dir.reserve(n * 3);
+    table.phase_dir.reserve(n * 3);
+    table.slice_dir.reserve(n * 3);
+    table.patient_table_position.reserve(n * 3);
+    table.user_int.reserve(n * ISMRMRD_USER_INTS);
+    table.user_float.reserve(n * ISMRMRD_USER_FLOATS);
+    for (size_t key = 0; key < table.idx.size(); key++) {
+        table.idx[key].resize(n);
+    }
+
+    std::vector<AcquisitionHeader> heads;
+    for (uint32_t index = 0; index < n; index += block_size) {
+        readAcquisitionHeaders(index, std::min(block_size, n - index), heads);
+        for (size_t i = 0; i < heads.size(); i++) {
+            const AcquisitionHeader &h = heads[i];
+            table.version.push_back(h.version);
+            table.flags.push_back(h.flags);
+            table.measurement_uid.push_back(h.measurement_uid);
+            table.scan_counter.push_back(h.scan_counter);
+            table.acquisition_time_stamp.push_back(h.acquisition_time_stamp);
+            append_to_column(table.physiology_time_stamp, h.physiology_time_stamp, ISMRMRD_PHYS_STAMPS);
+            table.number_of_samples.push_back(h.number_of_samples);
+            table.available_channels.push_back(h.available_channels);
+            table.active_channels.push_back(h.active_channels);
+            append_to_column(table.channel_mask, h.channel_mask, ISMRMRD_CHANNEL_MASKS);
+            table.discard_pre.push_back(h.discard_pre);
+            table.discard_post.push_back(h.discard_post);
+            table.center_sample.push_back(h.center_sample);
+            table.encoding_space_ref.push_back(h.encoding_space_ref);
+            table.trajectory_dimensions.push_back(h.trajectory_dimensions);
+            table.sample_time_us.push_back(h.sample_time_us);
+            append_to_column(table.position, h.position, 3);
+            append_to_column(table.read_dir, h.read_dir, 3);
+            append_to_column(table.phase_dir, h.phase_dir, 3);
+            append_to_column(table.slice_dir, h.slice_dir, 3);
+            append_to_column(table.patient_table_position, h.patient_table_position, 3);
+            append_to_column(table.user_int, h.user_int, ISMRMRD_USER_INTS);
+            append_to_column(table.user_float, h.user_float, ISMRMRD_USER_FLOATS);
+            for (int key = 0; key < ISMRMRD_IDX_NUMBER_OF_KEYS; key++) {
+                table.idx[key][index + i] = ismrmrd_get_encoding_counter(&h.idx, key);
+            }
+        }
+    }
+}
+
+template <typename T>
+void Dataset::readAcquisitionHeaderColumn(const std::string &member, std::vector<T> &column, size_t width) {
+    uint32_t n = getNumberOfAcquisitions();
+    column.resize(n * width);
+    int status = n == 0 ? ISMRMRD_NOERROR :
+        ismrmrd_read_acquisition_header_member(&dset_, member.c_str(), 0, n, &column[0], column.size() * sizeof(T));
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
+// Specializations for the member types of AcquisitionHeader
+template EXPORTISMRMRD void Dataset::readAcquisitionHeaderColumn(const std::string &member, std::vector<uint16_t> &column, size_t width);
+template EXPORTISMRMRD void Dataset::readAcquisitionHeaderColumn(const std::string &member, std::vector<uint32_t> &column, size_t width);
+template EXPORTISMRMRD void Dataset::readAcquisitionHeaderColumn(const std::string &member, std::vector<int32_t> &column, size_t width);
+template EXPORTISMRMRD void Dataset::readAcquisitionHeaderColumn(const std::string &member, std::vector<uint64_t> &column, size_t width);
+template EXPORTISMRMRD void Dataset::readAcquisitionHeaderColumn(const std::string &member, std::vector<float> &column, size_t width);
+
+AcquisitionHeaderTable::AcquisitionHeaderTable() : number_of_acquisitions(0), idx(ISMRMRD_IDX_NUMBER_OF_KEYS) {}
+
+uint32_t AcquisitionHeaderTable::size() const {
+    return number_of_acquisitions;
+}
+
+const std::vector<uint16_t> &AcquisitionHeaderTable::counter(ISMRMRD_EncodingCounterKeys key) const {
+    if (static_cast<int>(key) < 0 || key >= ISMRMRD_IDX_NUMBER_OF_KEYS) {
+        throw std::runtime_error("Invalid encoding counter key");
+    }
+    return idx[key];
+}
+
+std::vector<uint16_t> AcquisitionHeaderTable::uniqueCounterValues(ISMRMRD_EncodingCounterKeys key) const {
+    // Counters are small, so mark the values present instead of sorting the column
+    const std::vector<uint16_t> &column = counter(key);
+    std::vector<bool> present(65536, false);
+    for (size_t i = 0; i < column.size(); i++) {
+        present[column[i]] = true;
+    }
+    std::vector<uint16_t> values;
+    for (size_t v = 0; v < present.size(); v++) {
+        if (present[v]) {
+            values.push_back(static_cast<uint16_t>(v));
+        }
+    }
+    return values;
+}
+
+bool AcquisitionHeaderTable::counterRange(ISMRMRD_EncodingCounterKeys key, uint16_t &min, uint16_t &max) const {
+    const std::vector<uint16_t> &column = counter(key);
+    if (column.empty()) {
+        return false;
+    }
+    min = *std::min_element(column.begin(), column.end());
+    max = *std::max_element(column.begin(), column.end());
+    return true;
+}
+
+std::vector<uint32_t> AcquisitionHeaderTable::selectCounterValue(ISMRMRD_EncodingCounterKeys key, uint16_t value) const {
+    const std::vector<uint16_t> &column = counter(key);
+    std::vector<uint32_t> rows;
+    for (size_t i = 0; i < column.size(); i++) {
+        if (column[i] == value) {
+            rows.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return rows;
+}
+
+std::vector<uint32_t> AcquisitionHeaderTable::selectFlag(uint64_t flag) const {
+    std::vector<uint32_t> rows;
+    if (flag == 0 || flag > 64) {
+        return rows;
+    }
+    const uint64_t bitmask = ((uint64_t)1) << (flag - 1);
+    for (size_t i = 0; i < flags.size(); i++) {
+        if (flags[i] & bitmask) {
+            rows.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return rows;
+}
+
+void Dataset::sortAcquisitions(const std::vector<ISMRMRD_EncodingCounterKeys> &keys) {
+    sortAcquisitions(*this, keys);
+}
+
+void Dataset::sortAcquisitions(const Dataset &src, const std::vector<ISMRMRD_EncodingCounterKeys> &keys) {
+    std::vector<int> k(keys.begin(), keys.end());
+    int status = ismrmrd_sort_acquisitions(&dset_, &src.dset_, k.empty() ? NULL : &k[0], static_cast<uint16_t>(k.size()));
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
+void Dataset::getAcquisitionOrder(std::vector<uint32_t> &order) {
+    order.resize(getNumberOfAcquisitions());
+    int status = order.empty() ? ISMRMRD_NOERROR : ismrmrd_read_acquisition_order(&dset_, &order[0]);
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
+std::vector<ISMRMRD_EncodingCounterKeys> Dataset::getAcquisitionSortKeys() {
+    int keys[ISMRMRD_IDX_NUMBER_OF_KEYS];
+    uint16_t nkeys = 0;
+    int status = ismrmrd_get_acquisition_sort_keys(&dset_, keys, &nkeys);
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+    std::vector<ISMRMRD_EncodingCounterKeys> result;
+    for (uint16_t n = 0; n < nkeys; n++) {
+        result.push_back(static_cast<ISMRMRD_EncodingCounterKeys>(keys[n]));
+    }
+    return result;
+}
+
+void Dataset::findAcquisitionRange(const std::vector<uint16_t> &values, uint32_t &first, uint32_t &count) {
+    int status = ismrmrd_find_acquisition_range(&dset_, values.empty() ? NULL : &values[0],
+                                                static_cast<uint16_t>(values.size()), &first, &count);
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
 
 uint32_t Dataset::getNumberOfAcquisitions()
 {
@@ -83,6 +351,40 @@ template <typename T>void Dataset::appendImage(const std::string &var, const Ima
     }
 }
 
+template <typename T> void Dataset::appendImage(const std::string &var, const ImageView<T> &im)
+{
+    // The data is written with the size of the type in the header
+    if (im.head->data_type != get_data_type<T>()) {
+        throw std::runtime_error("Image data type does not match template type");
+    }
+    if (im.attribute_string_length != im.head->attribute_string_len) {
+        throw std::runtime_error("Image attribute string length does not match its header");
+    }
+    // HDF5 stores the attributes as a null terminated string
+    std::string attributes;
+    if (im.attribute_string_length) {
+        attributes.assign(im.attribute_string, im.attribute_string_length);
+    }
+    ISMRMRD_Image shallow;
+    shallow.head = *im.head;
+    shallow.attribute_string = const_cast<char *>(attributes.c_str());
+    shallow.data = const_cast<T *>(im.data);
+    appendImage(var, &shallow);
+}
+
+template <typename T> void Dataset::appendImages(const std::string &var, const Image<T> *ims, size_t count)
+{
+    std::vector<ISMRMRD_Image> block(count);
+    for (size_t n = 0; n < count; n++) {
+        block[n] = ims[n].im;
+    }
+    int status = count > 0 ? ismrmrd_append_images(&dset_, var.c_str(), &block[0], static_cast<uint32_t>(count))
+                           : ISMRMRD_NOERROR;
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
 void Dataset::appendImage(const std::string &var, const ISMRMRD_Image *im)
 {
     int status = ismrmrd_append_image(&dset_, var.c_str(), im);
@@ -99,6 +401,15 @@ void Dataset::appendWaveform(const Waveform &wav) {
     }
 }
 
+void Dataset::appendWaveforms(const Waveform *wavs, size_t count) {
+    std::vector<ISMRMRD_Waveform> block(wavs, wavs + count);
+    int status = count > 0 ? ismrmrd_append_waveforms(&dset_, &block[0], static_cast<uint32_t>(count))
+                           : ISMRMRD_NOERROR;
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
 void Dataset::readWaveform(uint32_t index, Waveform &wav) {
     int status = ismrmrd_read_waveform(&dset_,index,&wav);
     if (status != ISMRMRD_NOERROR){
@@ -106,9 +417,41 @@ void Dataset::readWaveform(uint32_t index, Waveform &wav) {
     }
 }
 
+void Dataset::readWaveforms(uint32_t index, uint32_t count, std::vector<Waveform> &wavs) {
+    std::vector<ISMRMRD_Waveform> block(count);
+    for (uint32_t n = 0; n < count; n++) {
+        ismrmrd_init_waveform(&block[n]);
+    }
+    int status = count > 0 ? ismrmrd_read_waveforms(&dset_, index, count, &block[0]) : ISMRMRD_NOERROR;
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+    // Move the buffers into the waveforms without copying the data
+    wavs.resize(count);
+    for (uint32_t n = 0; n < count; n++) {
+        free(wavs[n].data);
+        static_cast<ISMRMRD_Waveform &>(wavs[n]) = block[n];
+    }
+}
+
 uint32_t Dataset::getNumberOfWaveforms() {
     return ismrmrd_get_number_of_waveforms(&dset_);
 }
+
+// Copying between datasets
+void Dataset::copyVariable(const Dataset &src, const std::string &srcVar, const std::string &dstVar) {
+    int status = ismrmrd_copy_variable(&dset_, &src.dset_, srcVar.c_str(), dstVar.c_str());
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
+
+void Dataset::merge(const Dataset &src) {
+    int status = ismrmrd_merge_dataset(&dset_, &src.dset_);
+    if (status != ISMRMRD_NOERROR) {
+        throw std::runtime_error(build_exception_string());
+    }
+}
 // Specific instantiations
 template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const Image<uint16_t> &im);
 template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const Image<int16_t> &im);
@@ -119,6 +462,24 @@ template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const I
 template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const Image<complex_float_t> &im);
 template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const Image<complex_double_t> &im);
 
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<uint16_t> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<int16_t> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<uint32_t> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<int32_t> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<float> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<double> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<complex_float_t> &im);
+template EXPORTISMRMRD void Dataset::appendImage(const std::string &var, const ImageView<complex_double_t> &im);
+
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<uint16_t> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<int16_t> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<uint32_t> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<int32_t> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<float> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<double> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<complex_float_t> *ims, size_t count);
+template EXPORTISMRMRD void Dataset::appendImages(const std::string &var, const Image<complex_double_t> *ims, size_t count);
+
 
 template <typename T> void Dataset::readImage(const std::string &var, uint32_t index, Image<T> &im) {
     int status = ismrmrd_read_image(&dset_, var.c_str(), index, &im.im);
@@ -153,6 +514,17 @@ template <typename T> void Dataset::appendNDArray(const std::string &var, const
     }
 }
 
+template <typename T> void Dataset::appendNDArray(const std::string &var, const NDArrayView<T> &arr)
+{
+    ISMRMRD_NDArray shallow;
+    shallow.version = arr.version;
+    shallow.data_type = arr.data_type;
+    shallow.ndim = arr.ndim;
+    memcpy(shallow.dims, arr.dims, sizeof(shallow.dims));
+    shallow.data = const_cast<T *>(arr.data);
+    appendNDArray(var, &shallow);
+}
+
 // Specific instantiations
 template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArray<uint16_t> &arr);
 template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArray<int16_t> &arr);
@@ -163,6 +535,15 @@ template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const
 template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArray<complex_float_t> &arr);
 template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArray<complex_double_t> &arr);
 
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<uint16_t> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<int16_t> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<uint32_t> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<int32_t> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<float> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<double> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<complex_float_t> &arr);
+template EXPORTISMRMRD void Dataset::appendNDArray(const std::string &var, const NDArrayView<complex_double_t> &arr);
+
 void Dataset::appendNDArray(const std::string &var, const ISMRMRD_NDArray *arr)
 {
     int status = ismrmrd_append_array(&dset_, var.c_str(), arr);
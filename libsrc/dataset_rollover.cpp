@@ -0,0 +1,541 @@
+#include "ismrmrd/dataset_rollover.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ISMRMRD {
+
+namespace {
+
+const char MANIFEST_MAGIC[] = "ISMRMRD_ROLLOVER_MANIFEST";
+const int MANIFEST_VERSION = 1;
+
+size_t directory_length(const std::string &filename) {
+    size_t pos = filename.find_last_of("/\\");
+    return pos == std::string::npos ? 0 : pos + 1;
+}
+
+std::string part_name(const std::string &stem, size_t part, const std::string &extension) {
+    std::stringstream ss;
+    ss.imbue(std::locale::classic());
+    ss << stem << "_part";
+    ss.width(4);
+    ss.fill('0');
+    ss << part;
+    ss << extension;
+    return ss.str();
+}
+
+} // namespace
+
+//
+// RolloverDataset class implementation
+//
+RolloverDataset::RolloverDataset(const char* filename, const char* groupname,
+                                 uint64_t max_bytes_per_part, uint32_t max_acquisitions_per_part)
+    : groupname_(groupname), has_header_(false), max_bytes_(max_bytes_per_part),
+      max_acquisitions_(max_acquisitions_per_part), dataset_(NULL)
+{
+    std::string name(filename);
+    size_t dirlen = directory_length(name);
+    directory_ = name.substr(0, dirlen);
+    stem_ = name.substr(dirlen);
+    size_t dot = stem_.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        extension_ = stem_.substr(dot);
+        stem_ = stem_.substr(0, dot);
+    } else {
+        extension_ = ".h5";
+    }
+    open_part();
+}
+
+RolloverDataset::~RolloverDataset()
+{
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void RolloverDataset::writeHeader(const std::string &xmlstring)
+{
+    header_ = xmlstring;
+    has_header_ = true;
+    current(false).writeHeader(xmlstring);
+}
+
+void RolloverDataset::appendAcquisition(const Acquisition &acq)
+{
+    appendAcquisition(AcquisitionView(acq));
+}
+
+void RolloverDataset::appendAcquisition(const AcquisitionView &acq)
+{
+    current(true).appendAcquisition(acq);
+    Part &p = parts_.back();
+    p.acquisitions++;
+    p.bytes += sizeof(AcquisitionHeader) + acq.getTrajSize() + acq.getDataSize();
+}
+
+void RolloverDataset::appendAcquisitions(const Acquisition *acqs, size_t count)
+{
+    size_t n = 0;
+    while (n < count) {
+        Dataset &d = current(true);
+        // Take acquisitions until the part would have been rolled over
+        Part next = parts_.back();
+        size_t first = n;
+        do {
+            next.acquisitions++;
+            next.bytes += sizeof(AcquisitionHeader) + acqs[n].getTrajSize() + acqs[n].getDataSize();
+            n++;
+        } while (n < count && !full(next, true));
+        d.appendAcquisitions(acqs + first, n - first);
+        parts_.back() = next;
+    }
+}
+
+template <typename T> void RolloverDataset::appendImage(const std::string &var, const Image<T> &im)
+{
+    current(false).appendImage(var, im);
+    parts_.back().bytes += sizeof(ImageHeader) + im.getAttributeStringLength() + im.getDataSize();
+}
+
+template <typename T> void RolloverDataset::appendImage(const std::string &var, const ImageView<T> &im)
+{
+    current(false).appendImage(var, im);
+    parts_.back().bytes += sizeof(ImageHeader) + im.attribute_string_length + im.getDataSize();
+}
+
+template <typename T> void RolloverDataset::appendImages(const std::string &var, const Image<T> *ims, size_t count)
+{
+    size_t n = 0;
+    while (n < count) {
+        Dataset &d = current(false);
+        Part next = parts_.back();
+        size_t first = n;
+        do {
+            next.bytes += sizeof(ImageHeader) + ims[n].getAttributeStringLength() + ims[n].getDataSize();
+            n++;
+        } while (n < count && !full(next, false));
+        d.appendImages(var, ims + first, n - first);
+        parts_.back() = next;
+    }
+}
+
+template <typename T> void RolloverDataset::appendNDArray(const std::string &var, const NDArray<T> &arr)
+{
+    current(false).appendNDArray(var, arr);
+    parts_.back().bytes += arr.getDataSize();
+}
+
+template <typename T> void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<T> &arr)
+{
+    current(false).appendNDArray(var, arr);
+    parts_.back().bytes += arr.getDataSize();
+}
+
+void RolloverDataset::appendWaveform(const Waveform &wav)
+{
+    current(false).appendWaveform(wav);
+    Part &p = parts_.back();
+    p.waveforms++;
+    p.bytes += sizeof(WaveformHeader) + ismrmrd_size_of_waveform_data(&wav);
+}
+
+void RolloverDataset::appendWaveforms(const Waveform *wavs, size_t count)
+{
+    size_t n = 0;
+    while (n < count) {
+        Dataset &d = current(false);
+        Part next = parts_.back();
+        size_t first = n;
+        do {
+            next.waveforms++;
+            next.bytes += sizeof(WaveformHeader) + ismrmrd_size_of_waveform_data(&wavs[n]);
+            n++;
+        } while (n < count && !full(next, false));
+        d.appendWaveforms(wavs + first, n - first);
+        parts_.back() = next;
+    }
+}
+
+void RolloverDataset::close()
+{
+    if (dataset_ != NULL) {
+        close_part();
+    }
+}
+
+std::string RolloverDataset::getManifestFilename() const
+{
+    return directory_ + stem_ + ".manifest";
+}
+
+size_t RolloverDataset::getNumberOfParts() const
+{
+    return parts_.size();
+}
+
+std::string RolloverDataset::getPartFilename(size_t part) const
+{
+    return directory_ + parts_.at(part).filename;
+}
+
+bool RolloverDataset::full(const Part &p, bool is_acquisition) const
+{
+    return (max_bytes_ > 0 && p.bytes >= max_bytes_) ||
+           (is_acquisition && max_acquisitions_ > 0 && p.acquisitions >= max_acquisitions_);
+}
+
+Dataset &RolloverDataset::current(bool is_acquisition)
+{
+    if (dataset_ == NULL) {
+        throw std::runtime_error("RolloverDataset has been closed");
+    }
+    if (full(parts_.back(), is_acquisition)) {
+        close_part();
+        open_part();
+    }
+    return *dataset_;
+}
+
+void RolloverDataset::open_part()
+{
+    Part p;
+    p.filename = part_name(stem_, parts_.size(), extension_);
+    p.closed = false;
+    p.acquisitions = 0;
+    p.waveforms = 0;
+    p.bytes = 0;
+
+    // Parts are always started from scratch, never appended to
+    std::string path = directory_ + p.filename;
+    std::remove(path.c_str());
+    dataset_ = new Dataset(path.c_str(), groupname_.c_str(), true);
+    parts_.push_back(p);
+    if (has_header_) {
+        dataset_->writeHeader(header_);
+    }
+    write_manifest();
+}
+
+void RolloverDataset::close_part()
+{
+    delete dataset_;
+    dataset_ = NULL;
+    parts_.back().closed = true;
+    write_manifest();
+}
+
+void RolloverDataset::write_manifest()
+{
+    // Write to a temporary file and rename it so readers never see a partial manifest
+    std::string manifest = getManifestFilename();
+    std::string tmp = manifest + ".tmp";
+    {
+        std::ofstream os(tmp.c_str());
+        os.imbue(std::locale::classic());
+        os << MANIFEST_MAGIC << " " << MANIFEST_VERSION << "\n";
+        os << "group " << groupname_ << "\n";
+        for (size_t n = 0; n < parts_.size(); n++) {
+            const Part &p = parts_[n];
+            os << "part " << (p.closed ? "closed" : "open") << " " << p.acquisitions << " "
+               << p.waveforms << " " << p.bytes << " " << p.filename << "\n";
+        }
+        os.flush();
+        if (!os) {
+            throw std::runtime_error("Failed to write rollover manifest " + tmp);
+        }
+    }
+#ifdef _WIN32
+    std::remove(manifest.c_str());
+#endif
+    if (std::rename(tmp.c_str(), manifest.c_str()) != 0) {
+        throw std::runtime_error("Failed to rename rollover manifest to " + manifest);
+    }
+}
+
+//
+// RolloverDatasetReader class implementation
+//
+RolloverDatasetReader::RolloverDatasetReader(const char* manifest, uint32_t prefetch_count)
+    : number_of_acquisitions_(0), number_of_waveforms_(0),
+      prefetch_count_(prefetch_count > 0 ? prefetch_count : 1), cache_start_(0)
+{
+    std::ifstream is(manifest);
+    if (!is) {
+        throw std::runtime_error("Failed to open rollover manifest " + std::string(manifest));
+    }
+    is.imbue(std::locale::classic());
+
+    std::string magic;
+    int version = 0;
+    is >> magic >> version;
+    if (magic != MANIFEST_MAGIC || version != MANIFEST_VERSION) {
+        throw std::runtime_error("Not a rollover manifest: " + std::string(manifest));
+    }
+
+    std::string directory = std::string(manifest).substr(0, directory_length(manifest));
+    std::string keyword;
+    while (is >> keyword) {
+        if (keyword == "group") {
+            is >> std::ws;
+            std::getline(is, groupname_);
+        } else if (keyword == "part") {
+            std::string state;
+            uint64_t bytes;
+            Part p;
+            is >> state >> p.acquisitions >> p.waveforms >> bytes >> std::ws;
+            std::getline(is, p.filename);
+            if (!is) {
+                throw std::runtime_error("Malformed rollover manifest " + std::string(manifest));
+            }
+            p.filename = directory + p.filename;
+            p.first_acquisition = number_of_acquisitions_;
+            p.first_waveform = number_of_waveforms_;
+
+            if (state != "closed") {
+                // The writer did not finish this part; use whatever made it to disk
+                try {
+                    Dataset d(p.filename.c_str(), groupname_.c_str(), DATASET_READ_ONLY);
+                    p.acquisitions = d.getNumberOfAcquisitions();
+                    p.waveforms = d.getNumberOfWaveforms();
+                } catch (std::runtime_error &) {
+                    continue;
+                }
+            }
+
+            number_of_acquisitions_ += p.acquisitions;
+            number_of_waveforms_ += p.waveforms;
+            parts_.push_back(p);
+        } else {
+            throw std::runtime_error("Unknown entry in rollover manifest: " + keyword);
+        }
+    }
+    datasets_.resize(parts_.size(), NULL);
+}
+
+RolloverDatasetReader::~RolloverDatasetReader()
+{
+    for (size_t n = 0; n < datasets_.size(); n++) {
+        delete datasets_[n];
+    }
+}
+
+void RolloverDatasetReader::readHeader(std::string& xmlstring)
+{
+    if (parts_.empty()) {
+        throw std::runtime_error("Rollover dataset has no parts");
+    }
+    part(0).readHeader(xmlstring);
+}
+
+void RolloverDatasetReader::readAcquisition(uint64_t index, Acquisition &acq)
+{
+    if (index >= number_of_acquisitions_) {
+        throw std::runtime_error("Acquisition index out of range");
+    }
+    if (index < cache_start_ || index >= cache_start_ + cache_.size()) {
+        prefetch(index);
+    }
+    acq = cache_[index - cache_start_];
+}
+
+uint64_t RolloverDatasetReader::getNumberOfAcquisitions() const
+{
+    return number_of_acquisitions_;
+}
+
+template <typename T> void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<T> &im)
+{
+    const std::vector<uint64_t> &offsets = variable_offsets(var, true);
+    size_t n = locate(offsets, index);
+    part(n).readImage(var, static_cast<uint32_t>(index - offsets[n]), im);
+}
+
+uint64_t RolloverDatasetReader::getNumberOfImages(const std::string &var)
+{
+    return variable_offsets(var, true).back();
+}
+
+template <typename T> void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<T> &arr)
+{
+    const std::vector<uint64_t> &offsets = variable_offsets(var, false);
+    size_t n = locate(offsets, index);
+    part(n).readNDArray(var, static_cast<uint32_t>(index - offsets[n]), arr);
+}
+
+uint64_t RolloverDatasetReader::getNumberOfNDArrays(const std::string &var)
+{
+    return variable_offsets(var, false).back();
+}
+
+void RolloverDatasetReader::readWaveform(uint64_t index, Waveform &wav)
+{
+    if (index >= number_of_waveforms_) {
+        throw std::runtime_error("Waveform index out of range");
+    }
+    size_t n = find_part(index, true);
+    part(n).readWaveform(static_cast<uint32_t>(index - parts_[n].first_waveform), wav);
+}
+
+uint64_t RolloverDatasetReader::getNumberOfWaveforms() const
+{
+    return number_of_waveforms_;
+}
+
+size_t RolloverDatasetReader::getNumberOfParts() const
+{
+    return parts_.size();
+}
+
+std::string RolloverDatasetReader::getPartFilename(size_t part) const
+{
+    return parts_.at(part).filename;
+}
+
+Dataset &RolloverDatasetReader::part(size_t n)
+{
+    if (datasets_[n] == NULL) {
+        // Only keep the requested part and its neighbours open
+        for (size_t k = 0; k < datasets_.size(); k++) {
+            if (datasets_[k] != NULL && k + 1 != n && k != n + 1) {
+                delete datasets_[k];
+                datasets_[k] = NULL;
+            }
+        }
+        datasets_[n] = new Dataset(parts_[n].filename.c_str(), groupname_.c_str(), DATASET_READ_ONLY);
+    }
+    return *datasets_[n];
+}
+
+size_t RolloverDatasetReader::find_part(uint64_t index, bool waveforms) const
+{
+    size_t lo = 0, hi = parts_.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        uint64_t first = waveforms ? parts_[mid].first_waveform : parts_[mid].first_acquisition;
+        if (first <= index) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const std::vector<uint64_t> &RolloverDatasetReader::variable_offsets(const std::string &var, bool images)
+{
+    std::map<std::string, std::vector<uint64_t> > &cache = images ? image_offsets_ : array_offsets_;
+    std::map<std::string, std::vector<uint64_t> >::iterator it = cache.find(var);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    // offsets[n] is the first global index stored in part n, offsets.back() the total
+    std::vector<uint64_t> offsets(1, 0);
+    for (size_t n = 0; n < parts_.size(); n++) {
+        Dataset &d = part(n);
+        offsets.push_back(offsets.back() + (images ? d.getNumberOfImages(var) : d.getNumberOfNDArrays(var)));
+    }
+    return cache[var] = offsets;
+}
+
+size_t RolloverDatasetReader::locate(const std::vector<uint64_t> &offsets, uint64_t index) const
+{
+    if (index >= offsets.back()) {
+        throw std::runtime_error("Index out of range");
+    }
+    return std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+}
+
+void RolloverDatasetReader::prefetch(uint64_t index)
+{
+    uint64_t count = std::min<uint64_t>(prefetch_count_, number_of_acquisitions_ - index);
+    cache_.clear();
+    cache_.reserve(count);
+    cache_start_ = index;
+
+    std::vector<Acquisition> block;
+    size_t n = find_part(index, false);
+    while (cache_.size() < count) {
+        const Part &p = parts_[n];
+        uint64_t local = index + cache_.size() - p.first_acquisition;
+        uint64_t available = std::min<uint64_t>(p.acquisitions - local, count - cache_.size());
+        if (available > 0) {
+            part(n).readAcquisitions(static_cast<uint32_t>(local), static_cast<uint32_t>(available), block);
+            cache_.insert(cache_.end(), block.begin(), block.end());
+        }
+        n++;
+    }
+}
+
+// Specific instantiations
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<uint16_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<int16_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<uint32_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<int32_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<float> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<double> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<complex_float_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const Image<complex_double_t> &im);
+
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<uint16_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<int16_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<uint32_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<int32_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<float> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<double> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<complex_float_t> &im);
+template EXPORTISMRMRD void RolloverDataset::appendImage(const std::string &var, const ImageView<complex_double_t> &im);
+
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<uint16_t> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<int16_t> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<uint32_t> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<int32_t> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<float> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<double> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<complex_float_t> *ims, size_t count);
+template EXPORTISMRMRD void RolloverDataset::appendImages(const std::string &var, const Image<complex_double_t> *ims, size_t count);
+
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<uint16_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<int16_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<uint32_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<int32_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<float> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<double> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<complex_float_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArray<complex_double_t> &arr);
+
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<uint16_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<int16_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<uint32_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<int32_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<float> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<double> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<complex_float_t> &arr);
+template EXPORTISMRMRD void RolloverDataset::appendNDArray(const std::string &var, const NDArrayView<complex_double_t> &arr);
+
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<uint16_t> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<int16_t> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<uint32_t> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<int32_t> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<float> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<double> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<complex_float_t> &im);
+template EXPORTISMRMRD void RolloverDatasetReader::readImage(const std::string &var, uint64_t index, Image<complex_double_t> &im);
+
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<uint16_t> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<int16_t> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<uint32_t> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<int32_t> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<float> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<double> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<complex_float_t> &arr);
+template EXPORTISMRMRD void RolloverDatasetReader::readNDArray(const std::string &var, uint64_t index, NDArray<complex_double_t> &arr);
+
+} // namespace ISMRMRD
@@ -574,6 +574,39 @@ int ismrmrd_set_all_channels_off(uint64_t channel_mask[ISMRMRD_CHANNEL_MASKS]) {
     }
     return ISMRMRD_NOERROR;
 }
+
+uint16_t ismrmrd_get_encoding_counter(const ISMRMRD_EncodingCounters *idx, int key) {
+    if (idx==NULL) {
+        ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Pointer should not be NULL.");
+        return 0;
+    }
+    switch (key) {
+    case ISMRMRD_IDX_KSPACE_ENCODE_STEP_1:
+        return idx->kspace_encode_step_1;
+    case ISMRMRD_IDX_KSPACE_ENCODE_STEP_2:
+        return idx->kspace_encode_step_2;
+    case ISMRMRD_IDX_AVERAGE:
+        return idx->average;
+    case ISMRMRD_IDX_SLICE:
+        return idx->slice;
+    case ISMRMRD_IDX_CONTRAST:
+        return idx->contrast;
+    case ISMRMRD_IDX_PHASE:
+        return idx->phase;
+    case ISMRMRD_IDX_REPETITION:
+        return idx->repetition;
+    case ISMRMRD_IDX_SET:
+        return idx->set;
+    case ISMRMRD_IDX_SEGMENT:
+        return idx->segment;
+    default:
+        if (key >= ISMRMRD_IDX_USER_0 && key < ISMRMRD_IDX_NUMBER_OF_KEYS) {
+            return idx->user[key - ISMRMRD_IDX_USER_0];
+        }
+        ISMRMRD_PUSH_ERR(ISMRMRD_RUNTIMEERROR, "Invalid encoding counter key.");
+        return 0;
+    }
+}
     
 int ismrmrd_sign_of_directions(float const read_dir[3], float const phase_dir[3], float const slice_dir[3]) {
     float r11 = read_dir[0], r12 = phase_dir[0], r13 = slice_dir[0];
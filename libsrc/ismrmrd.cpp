@@ -2,10 +2,12 @@
 #include <stdlib.h>
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
 
 #include "ismrmrd/cpp98.h"
 #include <iostream>
 #include "ismrmrd/ismrmrd.h"
+#include "ismrmrd/version.h"
 
 namespace ISMRMRD {
 
@@ -1145,6 +1147,85 @@ template <typename T> T & Image<T>::operator () (uint16_t ix, uint16_t iy, uint1
      return static_cast<T*>(im.data)[index];
 }
 
+//
+// View Implementations
+//
+AcquisitionView::AcquisitionView() : head(NULL), traj(NULL), data(NULL) {}
+
+AcquisitionView::AcquisitionView(const Acquisition &acq)
+    : head(&acq.getHead()), traj(acq.getTrajPtr()), data(acq.getDataPtr()) {}
+
+AcquisitionView::AcquisitionView(const AcquisitionHeader &head, const complex_float_t *data, const float *traj)
+    : head(&head), traj(traj), data(data) {}
+
+size_t AcquisitionView::getNumberOfDataElements() const {
+    return size_t(head->number_of_samples) * head->active_channels;
+}
+
+size_t AcquisitionView::getNumberOfTrajElements() const {
+    return size_t(head->number_of_samples) * head->trajectory_dimensions;
+}
+
+size_t AcquisitionView::getDataSize() const {
+    return getNumberOfDataElements() * sizeof(complex_float_t);
+}
+
+size_t AcquisitionView::getTrajSize() const {
+    return getNumberOfTrajElements() * sizeof(float);
+}
+
+template <typename T> ImageView<T>::ImageView()
+    : head(NULL), attribute_string(NULL), attribute_string_length(0), data(NULL) {}
+
+template <typename T> ImageView<T>::ImageView(const Image<T> &img)
+    : head(&img.getHead()), attribute_string(img.getAttributeString()),
+      attribute_string_length(img.getAttributeStringLength()), data(img.getDataPtr()) {}
+
+template <typename T> ImageView<T>::ImageView(const ImageHeader &head, const T *data, const char *attribute_string)
+    : head(&head), attribute_string(attribute_string), attribute_string_length(head.attribute_string_len),
+      data(data) {}
+
+template <typename T> size_t ImageView<T>::getNumberOfDataElements() const {
+    return size_t(head->matrix_size[0]) * head->matrix_size[1] * head->matrix_size[2] * head->channels;
+}
+
+template <typename T> size_t ImageView<T>::getDataSize() const {
+    return getNumberOfDataElements() * sizeof(T);
+}
+
+template <typename T> NDArrayView<T>::NDArrayView()
+    : version(ISMRMRD_VERSION_MAJOR), data_type(static_cast<uint16_t>(get_data_type<T>())), ndim(0), data(NULL) {
+    std::fill(dims, dims + ISMRMRD_NDARRAY_MAXDIM, 0);
+}
+
+template <typename T> NDArrayView<T>::NDArrayView(const NDArray<T> &arr)
+    : version(arr.getVersion()), data_type(static_cast<uint16_t>(arr.getDataType())), ndim(arr.getNDim()),
+      data(arr.getDataPtr()) {
+    std::copy(arr.getDims(), arr.getDims() + ISMRMRD_NDARRAY_MAXDIM, dims);
+}
+
+template <typename T> NDArrayView<T>::NDArrayView(const std::vector<size_t> &dimvec, const T *data)
+    : version(ISMRMRD_VERSION_MAJOR), data_type(static_cast<uint16_t>(get_data_type<T>())),
+      ndim(static_cast<uint16_t>(dimvec.size())), data(data) {
+    if (dimvec.size() > ISMRMRD_NDARRAY_MAXDIM) {
+        throw std::runtime_error("Input vector dimvec is too long");
+    }
+    std::fill(dims, dims + ISMRMRD_NDARRAY_MAXDIM, 0);
+    std::copy(dimvec.begin(), dimvec.end(), dims);
+}
+
+template <typename T> size_t NDArrayView<T>::getNumberOfElements() const {
+    size_t elements = 1;
+    for (uint16_t d = 0; d < ndim; d++) {
+        elements *= dims[d];
+    }
+    return elements;
+}
+
+template <typename T> size_t NDArrayView<T>::getDataSize() const {
+    return getNumberOfElements() * sizeof(T);
+}
+
 //
 // Array class Implementation
 //
@@ -1281,37 +1362,37 @@ template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<uint16_t>()
     return ISMRMRD_USHORT;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<int16_t>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<int16_t>()
 {
     return ISMRMRD_SHORT;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<uint32_t>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<uint32_t>()
 {
     return ISMRMRD_UINT;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<int32_t>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<int32_t>()
 {
     return ISMRMRD_INT;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<float>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<float>()
 {
     return ISMRMRD_FLOAT;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<double>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<double>()
 {
     return ISMRMRD_DOUBLE;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<complex_float_t>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<complex_float_t>()
 {
     return ISMRMRD_CXFLOAT;
 }
 
-template <> EXPORTISMRMRD inline ISMRMRD_DataTypes get_data_type<complex_double_t>()
+template <> EXPORTISMRMRD ISMRMRD_DataTypes get_data_type<complex_double_t>()
 {
     return ISMRMRD_CXDOUBLE;
 }
@@ -1325,6 +1406,14 @@ template class EXPORTISMRMRD Image<float>;
 template class EXPORTISMRMRD Image<double>;
 template class EXPORTISMRMRD Image<complex_float_t>;
 template class EXPORTISMRMRD Image<complex_double_t>;
+template struct EXPORTISMRMRD ImageView<uint16_t>;
+template struct EXPORTISMRMRD ImageView<int16_t>;
+template struct EXPORTISMRMRD ImageView<uint32_t>;
+template struct EXPORTISMRMRD ImageView<int32_t>;
+template struct EXPORTISMRMRD ImageView<float>;
+template struct EXPORTISMRMRD ImageView<double>;
+template struct EXPORTISMRMRD ImageView<complex_float_t>;
+template struct EXPORTISMRMRD ImageView<complex_double_t>;
 
 // NDArrays
 template class EXPORTISMRMRD NDArray<uint16_t>;
@@ -1335,6 +1424,14 @@ template class EXPORTISMRMRD NDArray<float>;
 template class EXPORTISMRMRD NDArray<double>;
 template class EXPORTISMRMRD NDArray<complex_float_t>;
 template class EXPORTISMRMRD NDArray<complex_double_t>;
+template struct EXPORTISMRMRD NDArrayView<uint16_t>;
+template struct EXPORTISMRMRD NDArrayView<int16_t>;
+template struct EXPORTISMRMRD NDArrayView<uint32_t>;
+template struct EXPORTISMRMRD NDArrayView<int32_t>;
+template struct EXPORTISMRMRD NDArrayView<float>;
+template struct EXPORTISMRMRD NDArrayView<double>;
+template struct EXPORTISMRMRD NDArrayView<complex_float_t>;
+template struct EXPORTISMRMRD NDArrayView<complex_double_t>;
 
 
 // Helper function for generating exception message from ISMRMRD error stack
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <math.h>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ISMRMRD_QUANTIZATION_SSE2
+#endif
+
+#include "ismrmrd/quantization.h"
+
+namespace ISMRMRD {
+
+// Quotients must stay well inside int32 for the zigzag coding
+static const float max_quotient = 1073741824.0f; // 2^30
+
+QuantizationSettings::QuantizationSettings() : mode(ISMRMRD_TOLERANCE_NOISE), tolerance(0.5f) {}
+
+QuantizationSettings::QuantizationSettings(int mode, float tolerance) : mode(mode), tolerance(tolerance) {}
+
+float quantization_step(float tolerance) {
+    double bound = 2.0 * tolerance;
+    if (!(bound > 0) || bound > 1e38) {
+        return 0;
+    }
+    int exponent;
+    frexp(bound, &exponent);
+    // bound = m * 2^exponent with m in [0.5, 1), the step is 2^(exponent - 1)
+    if (exponent - 1 < -126) {
+        // Subnormal steps have no exact inverse
+        return 0;
+    }
+    return static_cast<float>(ldexp(1.0, exponent - 1));
+}
+
+float estimate_noise_level(const complex_float_t *data, size_t count, std::vector<float> &scratch) {
+    if (count == 0) {
+        return 0;
+    }
+    scratch.resize(2 * count);
+    for (size_t i = 0; i < count; i++) {
+        scratch[2 * i] = std::fabs(data[i].real());
+        scratch[2 * i + 1] = std::fabs(data[i].imag());
+    }
+    std::vector<float>::iterator middle = scratch.begin() + scratch.size() / 2;
+    std::nth_element(scratch.begin(), middle, scratch.end());
+    // The median absolute value of normally distributed noise is 0.6745 sigma
+    return *middle / 0.6745f;
+}
+
+void quantization_steps(const AcquisitionView &acq, const QuantizationSettings &settings, std::vector<float> &steps,
+                        std::vector<float> &scratch) {
+    uint16_t channels = acq.head->active_channels;
+    uint16_t samples = acq.head->number_of_samples;
+    steps.resize(channels);
+    for (uint16_t c = 0; c < channels; c++) {
+        float tolerance = settings.tolerance;
+        if (settings.mode == ISMRMRD_TOLERANCE_NOISE) {
+            tolerance *= estimate_noise_level(acq.data + static_cast<size_t>(c) * samples, samples, scratch);
+        } else if (settings.mode != ISMRMRD_TOLERANCE_ABSOLUTE) {
+            throw std::runtime_error("Unknown quantization tolerance mode");
+        }
+        steps[c] = quantization_step(tolerance);
+    }
+}
+
+bool quantize(const float *in, size_t count, float step, int32_t *out) {
+    // The inverse of a power of two is exact, so in * inverse is the exact quotient
+    const float inverse = 1.0f / step;
+    size_t i = 0;
+#ifdef ISMRMRD_QUANTIZATION_SSE2
+    const __m128 vinverse = _mm_set1_ps(inverse);
+    const __m128 vmax = _mm_set1_ps(max_quotient);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 y = _mm_mul_ps(_mm_loadu_ps(in + i), vinverse);
+        // False for NaN as well as for quotients that are too large
+        __m128 ok = _mm_cmplt_ps(_mm_andnot_ps(sign, y), vmax);
+        if (_mm_movemask_ps(ok) != 0xF) {
+            return false;
+        }
+        // Rounds to nearest with the default rounding mode
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_cvtps_epi32(y));
+    }
+#endif
+    for (; i < count; i++) {
+        float y = in[i] * inverse;
+        if (!(std::fabs(y) < max_quotient)) {
+            return false;
+        }
+        out[i] = static_cast<int32_t>(lrintf(y));
+    }
+    return true;
+}
+
+void dequantize(const int32_t *in, size_t count, float step, float *out) {
+    size_t i = 0;
+#ifdef ISMRMRD_QUANTIZATION_SSE2
+    const __m128 vstep = _mm_set1_ps(step);
+    for (; i + 4 <= count; i += 4) {
+        __m128 q = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        _mm_storeu_ps(out + i, _mm_mul_ps(q, vstep));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = static_cast<float>(in[i]) * step;
+    }
+}
+
+void quantize_acquisition(Acquisition &acq, const QuantizationSettings &settings) {
+    std::vector<float> steps;
+    std::vector<float> scratch;
+    quantization_steps(acq, settings, steps, scratch);
+    size_t values = 2 * static_cast<size_t>(acq.number_of_samples());
+    std::vector<int32_t> quotients(values);
+    for (uint16_t c = 0; c < acq.active_channels(); c++) {
+        float *data = reinterpret_cast<float *>(acq.getDataPtr()) + c * values;
+        if (steps[c] > 0 && values > 0 && quantize(data, values, steps[c], &quotients[0])) {
+            dequantize(&quotients[0], values, steps[c], data);
+        }
+    }
+}
+
+// Maps small quotients of either sign to small unsigned values, which leaves
+// the high bytes zero for the shuffle and deflate
+static inline int32_t zigzag(int32_t q) {
+    return static_cast<int32_t>((static_cast<uint32_t>(q) << 1) ^ static_cast<uint32_t>(q >> 31));
+}
+
+static inline int32_t unzigzag(int32_t z) {
+    uint32_t u = static_cast<uint32_t>(z);
+    return static_cast<int32_t>((u >> 1) ^ (0u - (u & 1)));
+}
+
+size_t QuantizingCodec::payload_size(const AcquisitionHeader &head) {
+    size_t traj_count = static_cast<size_t>(head.trajectory_dimensions) * head.number_of_samples;
+    size_t channels = head.active_channels;
+    return (traj_count + channels + channels * 2 * static_cast<size_t>(head.number_of_samples)) * sizeof(int32_t);
+}
+
+void QuantizingCodec::compress(const AcquisitionView &acq, const QuantizationSettings &settings, int level,
+                               std::vector<char> &out) {
+    size_t traj_count = static_cast<size_t>(acq.head->trajectory_dimensions) * acq.head->number_of_samples;
+    size_t channels = acq.head->active_channels;
+    size_t values = 2 * static_cast<size_t>(acq.head->number_of_samples);
+    quantization_steps(acq, settings, _steps, _scratch);
+
+    _words.resize(traj_count + channels + channels * values);
+    if (_words.empty()) {
+        _codec.compress(ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, level, sizeof(int32_t), NULL, 0, out);
+        return;
+    }
+    if (traj_count) {
+        memcpy(&_words[0], acq.traj, traj_count * sizeof(float));
+    }
+    int32_t *steps = &_words[traj_count];
+    int32_t *quotients = steps + channels;
+    const float *data = reinterpret_cast<const float *>(acq.data);
+    for (size_t c = 0; c < channels; c++) {
+        float step = _steps[c];
+        int32_t *q = quotients + c * values;
+        if (step > 0 && quantize(data + c * values, values, step, q)) {
+            for (size_t i = 0; i < values; i++) {
+                q[i] = zigzag(q[i]);
+            }
+        } else {
+            // Kept exactly
+            step = 0;
+            memcpy(q, data + c * values, values * sizeof(float));
+        }
+        memcpy(&steps[c], &step, sizeof(float));
+    }
+    _codec.compress(ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, level, sizeof(int32_t), &_words[0],
+                    _words.size() * sizeof(int32_t), out);
+}
+
+void QuantizingCodec::decompress(const void *compressed, size_t size, Acquisition &acq) {
+    size_t traj_count = static_cast<size_t>(acq.trajectory_dimensions()) * acq.number_of_samples();
+    size_t channels = acq.active_channels();
+    size_t values = 2 * static_cast<size_t>(acq.number_of_samples());
+
+    _words.resize(traj_count + channels + channels * values);
+    if (_words.empty()) {
+        return;
+    }
+    _codec.decompress(ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, sizeof(int32_t), compressed, size, &_words[0],
+                      _words.size() * sizeof(int32_t));
+    if (traj_count) {
+        memcpy(acq.getTrajPtr(), &_words[0], traj_count * sizeof(float));
+    }
+    int32_t *steps = &_words[traj_count];
+    int32_t *quotients = steps + channels;
+    float *data = reinterpret_cast<float *>(acq.getDataPtr());
+    for (size_t c = 0; c < channels; c++) {
+        float step;
+        memcpy(&step, &steps[c], sizeof(float));
+        int32_t *q = quotients + c * values;
+        if (step > 0) {
+            for (size_t i = 0; i < values; i++) {
+                q[i] = unzigzag(q[i]);
+            }
+            dequantize(q, values, step, data + c * values);
+        } else {
+            memcpy(data + c * values, q, values * sizeof(float));
+        }
+    }
+}
+
+} // namespace ISMRMRD
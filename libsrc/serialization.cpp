@@ -1,3 +1,4 @@
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -6,76 +7,239 @@
 
 namespace ISMRMRD {
 
-void serialize(const Acquisition &acq, WritableStreamView &ws) {
-    AcquisitionHeader ahead = acq.getHead();
-    ws.write(reinterpret_cast<const char *>(&ahead), sizeof(AcquisitionHeader));
-    ws.write(reinterpret_cast<const char *>(acq.getTrajPtr()), ahead.trajectory_dimensions * ahead.number_of_samples * sizeof(float));
-    ws.write(reinterpret_cast<const char *>(acq.getDataPtr()), ahead.number_of_samples * ahead.active_channels * 2 * sizeof(float));
+namespace {
+
+// Collects the parts of one message (optionally led by its message id) so that
+// the message reaches the stream in a single vectored write
+class MessageParts {
+public:
+    explicit MessageParts(const uint16_t *id) : _count(0) {
+        if (id) {
+            add(id, sizeof(uint16_t));
+        }
+    }
+
+    void add(const void *data, size_t size) {
+        if (size > 0) {
+            _parts[_count].data = static_cast<const char *>(data);
+            _parts[_count].size = size;
+            _count++;
+        }
+    }
+
+    void write(WritableStreamView &ws) const {
+        ws.writev(_parts, _count);
+    }
+
+private:
+    StreamBuffer _parts[8];
+    size_t _count;
+};
+
+void serialize_acquisition(const AcquisitionView &acq, WritableStreamView &ws, const uint16_t *id) {
+    const AcquisitionHeader &ahead = *acq.head;
+    MessageParts parts(id);
+    parts.add(&ahead, sizeof(AcquisitionHeader));
+    parts.add(acq.traj, ahead.trajectory_dimensions * ahead.number_of_samples * sizeof(float));
+    parts.add(acq.data, ahead.number_of_samples * ahead.active_channels * 2 * sizeof(float));
+    parts.write(ws);
     if (ws.bad()) {
         throw std::runtime_error("Error writing acquisition to stream");
     }
 }
 
+// The header of a view may be set up apart from its attributes
 template <typename T>
-void serialize(const Image<T> &img, WritableStreamView &ws) {
-    ImageHeader ihead = img.getHead();
-    if (ismrmrd_sizeof_data_type(ihead.data_type) != sizeof(T)) {
+void check_image(const ImageView<T> &img) {
+    if (img.head->data_type != get_data_type<T>()) {
         throw std::runtime_error("Image data type does not match template type");
     }
-    ws.write(reinterpret_cast<const char *>(&ihead), sizeof(ImageHeader));
-    uint64_t attr_length = img.getAttributeStringLength();
-    ws.write(reinterpret_cast<char *>(&attr_length), sizeof(uint64_t));
+    if (img.attribute_string_length != img.head->attribute_string_len) {
+        throw std::runtime_error("Image attribute string length does not match its header");
+    }
+}
+
+template <typename T>
+void serialize_image(const ImageView<T> &img, WritableStreamView &ws, const uint16_t *id) {
+    check_image(img);
+    const ImageHeader &ihead = *img.head;
+    uint64_t attr_length = img.attribute_string_length;
+    MessageParts parts(id);
+    parts.add(&ihead, sizeof(ImageHeader));
+    parts.add(&attr_length, sizeof(uint64_t));
     if (attr_length) {
-        ws.write(img.getAttributeString(), ihead.attribute_string_len);
+        parts.add(img.attribute_string, ihead.attribute_string_len);
     }
-    ws.write(reinterpret_cast<const char *>(img.getDataPtr()), img.getDataSize());
+    parts.add(img.data, img.getDataSize());
+    parts.write(ws);
     if (ws.bad()) {
         throw std::runtime_error("Error writing image to stream");
     }
 }
 
-void serialize(const Waveform &wfm, WritableStreamView &ws) {
-    ws.write(reinterpret_cast<const char *>(&wfm.head), sizeof(ISMRMRD_WaveformHeader));
-    ws.write(reinterpret_cast<const char *>(wfm.begin_data()), wfm.head.number_of_samples * wfm.head.channels * sizeof(uint32_t));
+void serialize_waveform(const Waveform &wfm, WritableStreamView &ws, const uint16_t *id) {
+    MessageParts parts(id);
+    parts.add(&wfm.head, sizeof(ISMRMRD_WaveformHeader));
+    parts.add(wfm.begin_data(), wfm.head.number_of_samples * wfm.head.channels * sizeof(uint32_t));
+    parts.write(ws);
     if (ws.bad()) {
         throw std::runtime_error("Error writing waveform to stream");
     }
 }
 
-void serialize(const ConfigFile &cfg, WritableStreamView &ws) {
-    ws.write(cfg.config, sizeof(cfg.config));
+void serialize_config_file(const ConfigFile &cfg, WritableStreamView &ws, const uint16_t *id) {
+    MessageParts parts(id);
+    parts.add(cfg.config, sizeof(cfg.config));
+    parts.write(ws);
     if (ws.bad()) {
         throw std::runtime_error("Error writing fixed length char array to stream");
     }
 }
 
-void serialize(const std::string &str, WritableStreamView &ws) {
+void serialize_string(const std::string &str, WritableStreamView &ws, const uint16_t *id) {
     uint32_t len = static_cast<uint32_t>(str.length());
-    ws.write(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    ws.write(str.c_str(), len);
+    MessageParts parts(id);
+    parts.add(&len, sizeof(uint32_t));
+    parts.add(str.c_str(), len);
+    parts.write(ws);
     if (ws.bad()) {
         throw std::runtime_error("Error writing string to stream");
     }
 }
 
 template <typename T>
-void serialize(const NDArray<T> &arr, WritableStreamView &ws) {
-    uint16_t ver = arr.getVersion();
-    uint16_t dtype = static_cast<uint16_t>(arr.getDataType());
-    uint16_t ndim = arr.getNDim();
-    const size_t* dims = arr.getDims();
-
-    ws.write(reinterpret_cast<char *>(&dtype), sizeof(uint16_t));
-    ws.write(reinterpret_cast<char *>(&ver), sizeof(uint16_t));
-    ws.write(reinterpret_cast<char *>(&ndim), sizeof(uint16_t));
-    ws.write(reinterpret_cast<const char *>(dims), sizeof(size_t)*ndim);
+void serialize_ndarray(const NDArrayView<T> &arr, WritableStreamView &ws, const uint16_t *id) {
+    uint16_t ver = arr.version;
+    uint16_t dtype = arr.data_type;
+    uint16_t ndim = arr.ndim;
+    const size_t* dims = arr.dims;
 
-    ws.write(reinterpret_cast<const char *>(arr.getDataPtr()), arr.getDataSize());
+    MessageParts parts(id);
+    parts.add(&dtype, sizeof(uint16_t));
+    parts.add(&ver, sizeof(uint16_t));
+    parts.add(&ndim, sizeof(uint16_t));
+    parts.add(dims, sizeof(size_t)*ndim);
+    parts.add(arr.data, arr.getDataSize());
+    parts.write(ws);
     if (ws.bad()) {
         throw std::runtime_error("Error writing NDArray to stream");
     }
 }
 
+void write_compressed_acquisition(const AcquisitionHeader &ahead, WritableStreamView &ws, uint16_t codec,
+                                  const std::vector<char> &compressed) {
+    const uint16_t id = ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION;
+    uint64_t compressed_size = compressed.size();
+    MessageParts parts(&id);
+    parts.add(&ahead, sizeof(AcquisitionHeader));
+    parts.add(&codec, sizeof(uint16_t));
+    parts.add(&compressed_size, sizeof(uint64_t));
+    parts.add(compressed.empty() ? NULL : &compressed[0], compressed.size());
+    parts.write(ws);
+    if (ws.bad()) {
+        throw std::runtime_error("Error writing acquisition to stream");
+    }
+}
+
+// Trajectory and sample data are compressed together, as one payload of floats
+void serialize_compressed_acquisition(const AcquisitionView &acq, WritableStreamView &ws, uint16_t codec, int level,
+                                      PayloadCodec &compressor, std::vector<char> &payload,
+                                      std::vector<char> &compressed) {
+    const AcquisitionHeader &ahead = *acq.head;
+    size_t traj_size = static_cast<size_t>(ahead.trajectory_dimensions) * ahead.number_of_samples * sizeof(float);
+    size_t data_size = static_cast<size_t>(ahead.number_of_samples) * ahead.active_channels * 2 * sizeof(float);
+    const void *input = acq.data;
+    if (traj_size > 0) {
+        payload.resize(traj_size + data_size);
+        memcpy(&payload[0], acq.traj, traj_size);
+        memcpy(&payload[traj_size], acq.data, data_size);
+        input = &payload[0];
+    }
+    compressor.compress(codec, level, sizeof(float), input, traj_size + data_size, compressed);
+    write_compressed_acquisition(ahead, ws, codec, compressed);
+}
+
+void serialize_quantized_acquisition(const AcquisitionView &acq, WritableStreamView &ws,
+                                     const QuantizationSettings &settings, int level, QuantizingCodec &compressor,
+                                     std::vector<char> &compressed) {
+    compressor.compress(acq, settings, level, compressed);
+    write_compressed_acquisition(*acq.head, ws, ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, compressed);
+}
+
+
+// Size of a real or imaginary part for complex data types, the element size of the shuffle
+size_t component_size(uint16_t data_type) {
+    size_t size = ismrmrd_sizeof_data_type(data_type);
+    return (data_type == ISMRMRD_CXFLOAT || data_type == ISMRMRD_CXDOUBLE) ? size / 2 : size;
+}
+
+template <typename T>
+void serialize_compressed_image(const ImageView<T> &img, WritableStreamView &ws, uint16_t codec, int level,
+                                PayloadCodec &compressor, std::vector<char> &compressed) {
+    check_image(img);
+    const ImageHeader &ihead = *img.head;
+    compressor.compress(codec, level, component_size(ihead.data_type), img.data, img.getDataSize(), compressed);
+
+    const uint16_t id = ISMRMRD_MESSAGE_COMPRESSED_IMAGE;
+    uint64_t attr_length = img.attribute_string_length;
+    uint64_t compressed_size = compressed.size();
+    MessageParts parts(&id);
+    parts.add(&ihead, sizeof(ImageHeader));
+    parts.add(&attr_length, sizeof(uint64_t));
+    if (attr_length) {
+        parts.add(img.attribute_string, ihead.attribute_string_len);
+    }
+    parts.add(&codec, sizeof(uint16_t));
+    parts.add(&compressed_size, sizeof(uint64_t));
+    parts.add(compressed.empty() ? NULL : &compressed[0], compressed.size());
+    parts.write(ws);
+    if (ws.bad()) {
+        throw std::runtime_error("Error writing image to stream");
+    }
+}
+
+} // namespace
+
+void serialize(const Acquisition &acq, WritableStreamView &ws) {
+    serialize_acquisition(AcquisitionView(acq), ws, NULL);
+}
+
+void serialize(const AcquisitionView &acq, WritableStreamView &ws) {
+    serialize_acquisition(acq, ws, NULL);
+}
+
+template <typename T>
+void serialize(const Image<T> &img, WritableStreamView &ws) {
+    serialize_image(ImageView<T>(img), ws, NULL);
+}
+
+template <typename T>
+void serialize(const ImageView<T> &img, WritableStreamView &ws) {
+    serialize_image(img, ws, NULL);
+}
+
+void serialize(const Waveform &wfm, WritableStreamView &ws) {
+    serialize_waveform(wfm, ws, NULL);
+}
+
+void serialize(const ConfigFile &cfg, WritableStreamView &ws) {
+    serialize_config_file(cfg, ws, NULL);
+}
+
+void serialize(const std::string &str, WritableStreamView &ws) {
+    serialize_string(str, ws, NULL);
+}
+
+template <typename T>
+void serialize(const NDArray<T> &arr, WritableStreamView &ws) {
+    serialize_ndarray(NDArrayView<T>(arr), ws, NULL);
+}
+
+template <typename T>
+void serialize(const NDArrayView<T> &arr, WritableStreamView &ws) {
+    serialize_ndarray(arr, ws, NULL);
+}
+
 void deserialize(Acquisition &acq, ReadableStreamView &rs) {
     AcquisitionHeader ahead;
     rs.read(reinterpret_cast<char *>(&ahead), sizeof(AcquisitionHeader));
@@ -87,17 +251,26 @@ void deserialize(Acquisition &acq, ReadableStreamView &rs) {
     }
 }
 
-// Helper function that deserializes attributes and pixels
+// Helper function that deserializes the attributes, attr is scratch space for the attributes
 template <typename T>
-void deserialize_attr_and_pixels(Image<T> &img, ReadableStreamView &rs) {
+void deserialize_attributes(Image<T> &img, ReadableStreamView &rs, std::vector<char> &attr) {
     uint64_t attr_length;
     rs.read(reinterpret_cast<char *>(&attr_length), sizeof(uint64_t));
     if (attr_length) {
-        std::vector<char> attr(attr_length + 1);
+        attr.resize(attr_length + 1);
         rs.read(&attr[0], attr_length);
         attr[attr_length] = '\0';
         img.setAttributeString(&attr[0]);
+    } else if (img.getAttributeStringLength()) {
+        // Recycled images may still hold the attributes of a previous message
+        img.setAttributeString("");
     }
+}
+
+// Helper function that deserializes attributes and pixels, attr is scratch space for the attributes
+template <typename T>
+void deserialize_attr_and_pixels(Image<T> &img, ReadableStreamView &rs, std::vector<char> &attr) {
+    deserialize_attributes(img, rs, attr);
     rs.read(reinterpret_cast<char *>(img.getDataPtr()), img.getDataSize());
     if (rs.eof()) {
         throw std::runtime_error("Error reading image");
@@ -115,7 +288,8 @@ void deserialize(Image<T> &img, ReadableStreamView &rs) {
         throw std::runtime_error("Image data type does not match template type");
     }
     img.setHead(ihead);
-    deserialize_attr_and_pixels(img, rs);
+    std::vector<char> attr;
+    deserialize_attr_and_pixels(img, rs, attr);
 }
 
 void deserialize(Waveform &wfm, ReadableStreamView &rs) {
@@ -179,84 +353,429 @@ void deserialize(NDArray<T> &arr, ReadableStreamView &rs) {
     deserialize_ndarray_data(arr, rs);
 }
 
-ProtocolSerializer::ProtocolSerializer(WritableStreamView &ws) : _ws(ws) {}
+// Payload bytes of an image with the given header
+static size_t image_data_size(const ImageHeader &head) {
+    size_t elements = static_cast<size_t>(head.matrix_size[0]) * head.matrix_size[1] * head.matrix_size[2] * head.channels;
+    return elements * ismrmrd_sizeof_data_type(head.data_type);
+}
+
+// Payload bytes (trajectory and data) of an acquisition with the given header
+static size_t acquisition_data_size(const AcquisitionHeader &head) {
+    return (static_cast<size_t>(head.trajectory_dimensions) * head.number_of_samples +
+            static_cast<size_t>(head.number_of_samples) * head.active_channels * 2) * sizeof(float);
+}
+
+static void add_part(std::vector<StreamBuffer> &parts, const void *data, size_t size) {
+    if (size > 0) {
+        StreamBuffer part = {static_cast<const char *>(data), size};
+        parts.push_back(part);
+    }
+}
+
+ProtocolSerializer::ProtocolSerializer(WritableStreamView &ws)
+    : _timed(ws), _ws(_timed), _statistics(NULL), _message_start(0), _compression(ISMRMRD_COMPRESSION_NONE),
+      _compression_level(-1) {}
+
+void ProtocolSerializer::set_compression(uint16_t codec, int level) {
+    if (!compression_supported(codec)) {
+        std::stringstream ss;
+        ss << "Compression codec " << codec << " is not supported by this build";
+        throw std::runtime_error(ss.str());
+    }
+    _compression = codec;
+    _compression_level = level;
+}
+
+void ProtocolSerializer::set_quantization(const QuantizationSettings &settings) {
+    if (settings.mode != ISMRMRD_TOLERANCE_ABSOLUTE && settings.mode != ISMRMRD_TOLERANCE_NOISE) {
+        throw std::runtime_error("Unknown quantization tolerance mode");
+    }
+    _quantization = settings;
+}
+
+void ProtocolSerializer::set_statistics(StreamStatistics *statistics) {
+    _statistics = statistics;
+    _timed.timed = statistics != NULL;
+}
+
+void ProtocolSerializer::begin_message() {
+    if (_statistics) {
+        _timed.bytes = 0;
+        _timed.seconds = 0;
+        _message_start = StreamStatistics::now();
+    }
+}
+
+void ProtocolSerializer::end_message(uint16_t id) {
+    if (_statistics) {
+        _statistics->record(id, _timed.bytes, _timed.seconds, StreamStatistics::now() - _message_start);
+    }
+}
 
 void ProtocolSerializer::write_msg_id(uint16_t id) {
     _ws.write(reinterpret_cast<const char *>(&id), sizeof(uint16_t));
 }
 
 void ProtocolSerializer::serialize(const ConfigFile &cf) {
-    write_msg_id(ISMRMRD_MESSAGE_CONFIG_FILE);
-    ISMRMRD::serialize(cf, _ws);
+    const uint16_t id = ISMRMRD_MESSAGE_CONFIG_FILE;
+    begin_message();
+    serialize_config_file(cf, _ws, &id);
+    end_message(id);
 }
 
 void ProtocolSerializer::serialize(const ConfigText &ct) {
-    write_msg_id(ISMRMRD_MESSAGE_CONFIG_TEXT);
-    ISMRMRD::serialize(ct.config_text, _ws);
+    const uint16_t id = ISMRMRD_MESSAGE_CONFIG_TEXT;
+    begin_message();
+    serialize_string(ct.config_text, _ws, &id);
+    end_message(id);
 }
 
 void ProtocolSerializer::serialize(const TextMessage &tm) {
-    write_msg_id(ISMRMRD_MESSAGE_TEXT);
-    ISMRMRD::serialize(tm.message, _ws);
+    const uint16_t id = ISMRMRD_MESSAGE_TEXT;
+    begin_message();
+    serialize_string(tm.message, _ws, &id);
+    end_message(id);
 }
 
 void ProtocolSerializer::serialize(const IsmrmrdHeader &hdr) {
+    begin_message();
     std::stringstream str(std::ios::out | std::ios::binary);
     ISMRMRD::serialize(hdr, str);
     std::string as_str = str.str();
     uint32_t size = static_cast<uint32_t>(as_str.size());
-    write_msg_id(ISMRMRD_MESSAGE_HEADER);
-    _ws.write(reinterpret_cast<const char *>(&size), sizeof(uint32_t));
-    _ws.write(as_str.c_str(), as_str.size());
+    const uint16_t id = ISMRMRD_MESSAGE_HEADER;
+    MessageParts parts(&id);
+    parts.add(&size, sizeof(uint32_t));
+    parts.add(as_str.c_str(), as_str.size());
+    parts.write(_ws);
     if (_ws.bad()) {
         throw std::runtime_error("Error writing header to stream");
     }
+    end_message(id);
 }
 
 void ProtocolSerializer::serialize(const Acquisition &acq) {
-    write_msg_id(ISMRMRD_MESSAGE_ACQUISITION);
-    ISMRMRD::serialize(acq, _ws);
+    serialize(AcquisitionView(acq));
+}
+
+void ProtocolSerializer::serialize(const AcquisitionView &acq) {
+    begin_message();
+    if (_compression == ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE) {
+        serialize_quantized_acquisition(acq, _ws, _quantization, _compression_level, _quantizing_codec, _compressed);
+        end_message(ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION);
+    } else if (_compression != ISMRMRD_COMPRESSION_NONE) {
+        serialize_compressed_acquisition(acq, _ws, _compression, _compression_level, _codec, _payload, _compressed);
+        end_message(ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION);
+    } else {
+        const uint16_t id = ISMRMRD_MESSAGE_ACQUISITION;
+        serialize_acquisition(acq, _ws, &id);
+        end_message(id);
+    }
 }
 
 template <typename T>
 void ProtocolSerializer::serialize(const Image<T> &img) {
-    write_msg_id(ISMRMRD_MESSAGE_IMAGE);
-    ISMRMRD::serialize(img, _ws);
+    serialize(ImageView<T>(img));
+}
+
+template <typename T>
+void ProtocolSerializer::serialize(const ImageView<T> &img) {
+    begin_message();
+    if (_compression != ISMRMRD_COMPRESSION_NONE) {
+        // Quantization only applies to k-space, images are compressed losslessly
+        uint16_t codec = _compression == ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE ? uint16_t(ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE)
+                                                                               : _compression;
+        serialize_compressed_image(img, _ws, codec, _compression_level, _codec, _compressed);
+        end_message(ISMRMRD_MESSAGE_COMPRESSED_IMAGE);
+    } else {
+        const uint16_t id = ISMRMRD_MESSAGE_IMAGE;
+        serialize_image(img, _ws, &id);
+        end_message(id);
+    }
+}
+
+void ProtocolSerializer::serialize(const std::vector<Acquisition> &acqs) {
+    if (acqs.size() > ISMRMRD_MAX_BATCH_ACQUISITIONS) {
+        throw std::runtime_error("Too many acquisitions in batch");
+    }
+    begin_message();
+    const uint16_t id = ISMRMRD_MESSAGE_ACQUISITION_BATCH;
+    uint32_t count = static_cast<uint32_t>(acqs.size());
+    _batch_headers.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        _batch_headers[i] = acqs[i].getHead();
+    }
+    // One vectored write: id, count, all headers, then the payloads in order
+    _batch_parts.clear();
+    add_part(_batch_parts, &id, sizeof(uint16_t));
+    add_part(_batch_parts, &count, sizeof(uint32_t));
+    if (count) {
+        add_part(_batch_parts, &_batch_headers[0], count * sizeof(AcquisitionHeader));
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        add_part(_batch_parts, acqs[i].getTrajPtr(), acqs[i].getTrajSize());
+        add_part(_batch_parts, acqs[i].getDataPtr(), acqs[i].getDataSize());
+    }
+    _ws.writev(&_batch_parts[0], _batch_parts.size());
+    if (_ws.bad()) {
+        throw std::runtime_error("Error writing acquisition batch to stream");
+    }
+    end_message(id);
 }
 
 void ProtocolSerializer::serialize(const Waveform &wfm) {
-    write_msg_id(ISMRMRD_MESSAGE_WAVEFORM);
-    ISMRMRD::serialize(wfm, _ws);
+    const uint16_t id = ISMRMRD_MESSAGE_WAVEFORM;
+    begin_message();
+    serialize_waveform(wfm, _ws, &id);
+    end_message(id);
 }
 
 template <typename T>
 void ProtocolSerializer::serialize(const NDArray<T> &arr) {
-    write_msg_id(ISMRMRD_MESSAGE_NDARRAY);
-    ISMRMRD::serialize(arr, _ws);
+    serialize(NDArrayView<T>(arr));
+}
+
+template <typename T>
+void ProtocolSerializer::serialize(const NDArrayView<T> &arr) {
+    const uint16_t id = ISMRMRD_MESSAGE_NDARRAY;
+    begin_message();
+    serialize_ndarray(arr, _ws, &id);
+    end_message(id);
 }
 
 void ProtocolSerializer::close() {
     write_msg_id(ISMRMRD_MESSAGE_CLOSE);
+    _ws.flush();
+}
+
+ProtocolDeserializer::ProtocolDeserializer(ReadableStreamView &rs) : _timed(rs), _rs(_timed), _statistics(NULL), _call_start(0), _peek_seconds(0), _peeked(ISMRMRD_MESSAGE_UNPEEKED), _peeked_ndarray_data_type(ISMRMRD_MESSAGE_UNPEEKED), _pool(NULL), _peeked_compressed(false) {}
+
+ProtocolDeserializer::ProtocolDeserializer(ReadableStreamView &rs, MessagePool &pool) : _timed(rs), _rs(_timed), _statistics(NULL), _call_start(0), _peek_seconds(0), _peeked(ISMRMRD_MESSAGE_UNPEEKED), _peeked_ndarray_data_type(ISMRMRD_MESSAGE_UNPEEKED), _pool(&pool), _peeked_compressed(false) {}
+
+MessagePool &ProtocolDeserializer::pool() {
+    if (_pool == NULL) {
+        throw std::runtime_error("Deserializing into pooled objects requires a MessagePool");
+    }
+    return *_pool;
+}
+
+void ProtocolDeserializer::set_statistics(StreamStatistics *statistics) {
+    _statistics = statistics;
+    _timed.timed = statistics != NULL;
+}
+
+void ProtocolDeserializer::start_call() {
+    if (_statistics) {
+        // A message peeked before the call started with the peek
+        _call_start = StreamStatistics::now() - (_peeked == ISMRMRD_MESSAGE_UNPEEKED ? 0 : _peek_seconds);
+    }
 }
 
-ProtocolDeserializer::ProtocolDeserializer(ReadableStreamView &rs) : _rs(rs), _peeked(ISMRMRD_MESSAGE_UNPEEKED), _peeked_ndarray_data_type(ISMRMRD_MESSAGE_UNPEEKED) {}
+void ProtocolDeserializer::finish_message() {
+    if (_statistics) {
+        uint16_t id = _peeked;
+        if (_peeked_compressed) {
+            id = _peeked == ISMRMRD_MESSAGE_ACQUISITION ? ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION
+                                                        : ISMRMRD_MESSAGE_COMPRESSED_IMAGE;
+        }
+        _statistics->record(id, _timed.bytes, _timed.seconds, StreamStatistics::now() - _call_start);
+    }
+    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+}
 
 uint16_t ProtocolDeserializer::peek() {
     if (_peeked == ISMRMRD_MESSAGE_UNPEEKED) {
+        double start = 0;
+        if (_statistics) {
+            _timed.bytes = 0;
+            _timed.seconds = 0;
+            start = StreamStatistics::now();
+        }
         _rs.read(reinterpret_cast<char *>(&_peeked), sizeof(uint16_t));
+        _peeked_compressed = false;
+        if (_peeked == ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION) {
+            _peeked = ISMRMRD_MESSAGE_ACQUISITION;
+            _peeked_compressed = true;
+        } else if (_peeked == ISMRMRD_MESSAGE_COMPRESSED_IMAGE) {
+            _peeked = ISMRMRD_MESSAGE_IMAGE;
+            _peeked_compressed = true;
+        }
+        if (_peeked == ISMRMRD_MESSAGE_ACQUISITION) {
+            _rs.read(reinterpret_cast<char *>(&_peeked_acquisition_header), sizeof(AcquisitionHeader));
+        }
         if (_peeked == ISMRMRD_MESSAGE_IMAGE) {
             _rs.read(reinterpret_cast<char *>(&_peeked_image_header), sizeof(ImageHeader));
         }
         if (_peeked == ISMRMRD_MESSAGE_NDARRAY) {
             _rs.read(reinterpret_cast<char *>(&_peeked_ndarray_data_type), sizeof(uint16_t));
         }
+        if (_peeked == ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+            uint32_t count = 0;
+            _rs.read(reinterpret_cast<char *>(&count), sizeof(uint32_t));
+            if (count > ISMRMRD_MAX_BATCH_ACQUISITIONS) {
+                std::stringstream ss;
+                ss << "Acquisition batch of " << count << " acquisitions exceeds the maximum of "
+                   << ISMRMRD_MAX_BATCH_ACQUISITIONS;
+                throw std::runtime_error(ss.str());
+            }
+            _peeked_batch_headers.resize(_rs.eof() ? 0 : count);
+            if (!_peeked_batch_headers.empty()) {
+                _rs.read(reinterpret_cast<char *>(&_peeked_batch_headers[0]), count * sizeof(AcquisitionHeader));
+            }
+        }
         if (_rs.eof()) {
             throw std::runtime_error("Error reading message ID");
         }
+        if (_statistics) {
+            _peek_seconds = StreamStatistics::now() - start;
+        }
     }
     return _peeked;
 }
 
+bool ProtocolDeserializer::peek_compressed() {
+    peek();
+    return _peeked_compressed;
+}
+
+uint16_t ProtocolDeserializer::read_compressed_payload(size_t size) {
+    uint16_t codec;
+    uint64_t compressed_size;
+    _rs.read(reinterpret_cast<char *>(&codec), sizeof(uint16_t));
+    _rs.read(reinterpret_cast<char *>(&compressed_size), sizeof(uint64_t));
+    if (_rs.eof()) {
+        throw std::runtime_error("Error reading compressed payload");
+    }
+    if (size > ISMRMRD_MAX_COMPRESSED_PAYLOAD) {
+        std::stringstream ss;
+        ss << "Compressed message of " << size << " bytes exceeds the maximum of " << ISMRMRD_MAX_COMPRESSED_PAYLOAD;
+        throw std::runtime_error(ss.str());
+    }
+    if (compressed_size > compressed_size_bound(size)) {
+        std::stringstream ss;
+        ss << "Compressed payload of " << compressed_size << " bytes is too large for a message of " << size
+           << " bytes";
+        throw std::runtime_error(ss.str());
+    }
+    _compressed.resize(compressed_size);
+    if (compressed_size) {
+        _rs.read(&_compressed[0], compressed_size);
+    }
+    if (_rs.eof()) {
+        throw std::runtime_error("Error reading compressed payload");
+    }
+    return codec;
+}
+
+void ProtocolDeserializer::read_compressed_payload(size_t element_size, void *data, size_t size) {
+    uint16_t codec = read_compressed_payload(size);
+    _codec.decompress(codec, element_size, _compressed.empty() ? NULL : &_compressed[0], _compressed.size(), data,
+                      size);
+}
+
+// Alignment of T, for which C++98 has no operator
+template <typename T>
+static size_t alignment() {
+    struct Probe {
+        char c;
+        T t;
+    };
+    return sizeof(Probe) - sizeof(T);
+}
+
+const char *ProtocolDeserializer::read_view_data(size_t size, size_t alignment) {
+    if (size == 0) {
+        return NULL;
+    }
+    const char *data = _rs.read_in_place(size);
+    if (data && reinterpret_cast<size_t>(data) % alignment == 0) {
+        return data;
+    }
+    _view_data.resize((size + sizeof(double) - 1) / sizeof(double));
+    char *buffer = reinterpret_cast<char *>(&_view_data[0]);
+    if (data) {
+        memcpy(buffer, data, size);
+    } else {
+        _rs.read(buffer, size);
+    }
+    return buffer;
+}
+
+uint16_t ProtocolDeserializer::skip() {
+    start_call();
+    uint16_t id = peek();
+    size_t size = 0;
+    switch (id) {
+    case ISMRMRD_MESSAGE_CLOSE:
+        throw ProtocolStreamClosed();
+    case ISMRMRD_MESSAGE_CONFIG_FILE:
+        size = sizeof(ConfigFile);
+        break;
+    case ISMRMRD_MESSAGE_CONFIG_TEXT:
+    case ISMRMRD_MESSAGE_HEADER:
+    case ISMRMRD_MESSAGE_TEXT: {
+        uint32_t length;
+        _rs.read(reinterpret_cast<char *>(&length), sizeof(uint32_t));
+        size = length;
+        break;
+    }
+    case ISMRMRD_MESSAGE_ACQUISITION:
+        size = acquisition_data_size(_peeked_acquisition_header);
+        break;
+    case ISMRMRD_MESSAGE_ACQUISITION_BATCH:
+        for (size_t i = 0; i < _peeked_batch_headers.size(); i++) {
+            size += acquisition_data_size(_peeked_batch_headers[i]);
+        }
+        break;
+    case ISMRMRD_MESSAGE_IMAGE: {
+        uint64_t attr_length;
+        _rs.read(reinterpret_cast<char *>(&attr_length), sizeof(uint64_t));
+        size = static_cast<size_t>(attr_length) + image_data_size(_peeked_image_header);
+        if (_peeked_compressed) {
+            _rs.skip(static_cast<size_t>(attr_length));
+        }
+        break;
+    }
+    case ISMRMRD_MESSAGE_WAVEFORM: {
+        ISMRMRD_WaveformHeader whead;
+        _rs.read(reinterpret_cast<char *>(&whead), sizeof(ISMRMRD_WaveformHeader));
+        size = static_cast<size_t>(whead.number_of_samples) * whead.channels * sizeof(uint32_t);
+        break;
+    }
+    case ISMRMRD_MESSAGE_NDARRAY: {
+        uint16_t ver, ndim;
+        _rs.read(reinterpret_cast<char *>(&ver), sizeof(uint16_t));
+        _rs.read(reinterpret_cast<char *>(&ndim), sizeof(uint16_t));
+        size = ismrmrd_sizeof_data_type(_peeked_ndarray_data_type);
+        for (uint16_t d = 0; d < ndim; d++) {
+            size_t dim;
+            _rs.read(reinterpret_cast<char *>(&dim), sizeof(size_t));
+            size *= dim;
+        }
+        break;
+    }
+    default: {
+        std::stringstream ss;
+        ss << "Cannot skip unknown message type " << id;
+        throw std::runtime_error(ss.str());
+    }
+    }
+    if (_peeked_compressed) {
+        // The header (and image attributes) are followed by the codec and the compressed size
+        uint16_t codec;
+        uint64_t compressed_size;
+        _rs.read(reinterpret_cast<char *>(&codec), sizeof(uint16_t));
+        _rs.read(reinterpret_cast<char *>(&compressed_size), sizeof(uint64_t));
+        size = static_cast<size_t>(compressed_size);
+    }
+    _rs.skip(size);
+    if (_rs.eof()) {
+        throw std::runtime_error("Error skipping message");
+    }
+    finish_message();
+    return id;
+}
+
 int ProtocolDeserializer::peek_image_data_type() {
     if (_peeked == ISMRMRD_MESSAGE_IMAGE) {
         return _peeked_image_header.data_type;
@@ -265,6 +784,13 @@ int ProtocolDeserializer::peek_image_data_type() {
     }
 }
 
+const ImageHeader &ProtocolDeserializer::peek_image_header() {
+    if (peek() != ISMRMRD_MESSAGE_IMAGE) {
+        throw std::runtime_error("Cannot peek the image header if not peeking an image");
+    }
+    return _peeked_image_header;
+}
+
 int ProtocolDeserializer::peek_ndarray_data_type() {
     if (_peeked == ISMRMRD_MESSAGE_NDARRAY) {
         return _peeked_ndarray_data_type;
@@ -273,31 +799,49 @@ int ProtocolDeserializer::peek_ndarray_data_type() {
     }
 }
 
+const AcquisitionHeader &ProtocolDeserializer::peek_acquisition_header() {
+    if (peek() != ISMRMRD_MESSAGE_ACQUISITION) {
+        throw std::runtime_error("Cannot peek the acquisition header if not peeking an acquisition");
+    }
+    return _peeked_acquisition_header;
+}
+
+const std::vector<AcquisitionHeader> &ProtocolDeserializer::peek_batch_headers() {
+    if (peek() != ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+        throw std::runtime_error("Cannot peek batch headers if not peeking an acquisition batch");
+    }
+    return _peeked_batch_headers;
+}
+
 void ProtocolDeserializer::deserialize(ConfigFile &cf) {
+    start_call();
     if (peek() != ISMRMRD_MESSAGE_CONFIG_FILE) {
         throw std::runtime_error("Expected config file message");
     }
     ISMRMRD::deserialize(cf, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    finish_message();
 }
 
 void ProtocolDeserializer::deserialize(ConfigText &ct) {
+    start_call();
     if (peek() != ISMRMRD_MESSAGE_CONFIG_TEXT) {
         throw std::runtime_error("Expected config text message");
     }
     ISMRMRD::deserialize(ct.config_text, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    finish_message();
 }
 
 void ProtocolDeserializer::deserialize(TextMessage &tm) {
+    start_call();
     if (peek() != ISMRMRD_MESSAGE_TEXT) {
         throw std::runtime_error("Expected text message");
     }
     ISMRMRD::deserialize(tm.message, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    finish_message();
 }
 
 void ProtocolDeserializer::deserialize(IsmrmrdHeader &hdr) {
+    start_call();
     if (peek() == ISMRMRD_MESSAGE_CLOSE) {
         throw ProtocolStreamClosed();
     }
@@ -309,22 +853,94 @@ void ProtocolDeserializer::deserialize(IsmrmrdHeader &hdr) {
     std::string str(size, '\0');
     _rs.read(&str[0], size);
     ISMRMRD::deserialize(str.c_str(), hdr);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    finish_message();
 }
 
 void ProtocolDeserializer::deserialize(Acquisition &acq) {
+    start_call();
     if (peek() == ISMRMRD_MESSAGE_CLOSE) {
         throw ProtocolStreamClosed();
     }
     if (peek() != ISMRMRD_MESSAGE_ACQUISITION) {
         throw std::runtime_error("Expected ISMRMRD_MESSAGE_ACQUISITION");
     }
-    ISMRMRD::deserialize(acq, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    const AcquisitionHeader &ahead = _peeked_acquisition_header;
+    acq.setHead(ahead);
+    if (_peeked_compressed) {
+        size_t traj_size = static_cast<size_t>(ahead.trajectory_dimensions) * ahead.number_of_samples * sizeof(float);
+        size_t data_size = static_cast<size_t>(ahead.number_of_samples) * ahead.active_channels * 2 * sizeof(float);
+        // The quantized payload is the largest, it adds the step of each channel
+        uint16_t codec = read_compressed_payload(QuantizingCodec::payload_size(ahead));
+        const char *compressed = _compressed.empty() ? NULL : &_compressed[0];
+        if (codec == ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE) {
+            _quantizing_codec.decompress(compressed, _compressed.size(), acq);
+        } else if (traj_size == 0) {
+            _codec.decompress(codec, sizeof(float), compressed, _compressed.size(), acq.getDataPtr(), data_size);
+        } else {
+            _payload.resize(traj_size + data_size);
+            _codec.decompress(codec, sizeof(float), compressed, _compressed.size(), &_payload[0], _payload.size());
+            memcpy(acq.getTrajPtr(), &_payload[0], traj_size);
+            memcpy(acq.getDataPtr(), &_payload[traj_size], data_size);
+        }
+    } else {
+        _rs.read(reinterpret_cast<char *>(acq.getTrajPtr()), acq.getTrajSize());
+        _rs.read(reinterpret_cast<char *>(acq.getDataPtr()), acq.getDataSize());
+        if (_rs.eof()) {
+            throw std::runtime_error("Error reading acquisition");
+        }
+    }
+    finish_message();
+}
+
+void ProtocolDeserializer::deserialize(AcquisitionView &acq) {
+    if (peek() == ISMRMRD_MESSAGE_ACQUISITION && _peeked_compressed) {
+        deserialize(_view_acquisition);
+        acq = AcquisitionView(_view_acquisition);
+        return;
+    }
+    start_call();
+    if (peek() == ISMRMRD_MESSAGE_CLOSE) {
+        throw ProtocolStreamClosed();
+    }
+    if (peek() != ISMRMRD_MESSAGE_ACQUISITION) {
+        throw std::runtime_error("Expected ISMRMRD_MESSAGE_ACQUISITION");
+    }
+    const AcquisitionHeader &ahead = _peeked_acquisition_header;
+    size_t traj_size = static_cast<size_t>(ahead.trajectory_dimensions) * ahead.number_of_samples * sizeof(float);
+    size_t data_size = static_cast<size_t>(ahead.number_of_samples) * ahead.active_channels * 2 * sizeof(float);
+    const char *payload = read_view_data(traj_size + data_size, alignment<float>());
+    if (_rs.eof()) {
+        throw std::runtime_error("Error reading acquisition");
+    }
+    acq.head = &ahead;
+    acq.traj = traj_size ? reinterpret_cast<const float *>(payload) : NULL;
+    acq.data = data_size ? reinterpret_cast<const complex_float_t *>(payload + traj_size) : NULL;
+    finish_message();
+}
+
+void ProtocolDeserializer::deserialize(std::vector<Acquisition> &acqs) {
+    start_call();
+    if (peek() == ISMRMRD_MESSAGE_CLOSE) {
+        throw ProtocolStreamClosed();
+    }
+    if (peek() != ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+        throw std::runtime_error("Expected ISMRMRD_MESSAGE_ACQUISITION_BATCH");
+    }
+    acqs.resize(_peeked_batch_headers.size());
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].setHead(_peeked_batch_headers[i]);
+        _rs.read(reinterpret_cast<char *>(acqs[i].getTrajPtr()), acqs[i].getTrajSize());
+        _rs.read(reinterpret_cast<char *>(acqs[i].getDataPtr()), acqs[i].getDataSize());
+    }
+    if (_rs.eof()) {
+        throw std::runtime_error("Error reading acquisition batch");
+    }
+    finish_message();
 }
 
 template <typename T>
 void ProtocolDeserializer::deserialize(Image<T> &img) {
+    start_call();
     if (peek() == ISMRMRD_MESSAGE_CLOSE) {
         throw ProtocolStreamClosed();
     }
@@ -332,11 +948,61 @@ void ProtocolDeserializer::deserialize(Image<T> &img) {
         throw std::runtime_error("Expected ISMRMRD_MESSAGE_IMAGE");
     }
     img.setHead(_peeked_image_header);
-    deserialize_attr_and_pixels(img, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    if (_peeked_compressed) {
+        deserialize_attributes(img, _rs, _attribute_buffer);
+        read_compressed_payload(component_size(_peeked_image_header.data_type), img.getDataPtr(), img.getDataSize());
+    } else {
+        deserialize_attr_and_pixels(img, _rs, _attribute_buffer);
+    }
+    finish_message();
+}
+
+template <typename T>
+void ProtocolDeserializer::deserialize(ImageView<T> &img) {
+    start_call();
+    if (peek() == ISMRMRD_MESSAGE_CLOSE) {
+        throw ProtocolStreamClosed();
+    }
+    if (peek() != ISMRMRD_MESSAGE_IMAGE) {
+        throw std::runtime_error("Expected ISMRMRD_MESSAGE_IMAGE");
+    }
+    // Unlike Image<T>::setHead, a view would take a different type of the same size
+    if (_peeked_image_header.data_type != get_data_type<T>()) {
+        throw std::runtime_error("Image data type does not match template type");
+    }
+    uint64_t attr_length;
+    _rs.read(reinterpret_cast<char *>(&attr_length), sizeof(uint64_t));
+    const char *attr = NULL;
+    if (attr_length) {
+        attr = _rs.read_in_place(static_cast<size_t>(attr_length));
+        if (!attr) {
+            _attribute_buffer.resize(attr_length);
+            _rs.read(&_attribute_buffer[0], attr_length);
+            attr = &_attribute_buffer[0];
+        }
+    }
+    size_t size = image_data_size(_peeked_image_header);
+    const char *data;
+    if (_peeked_compressed) {
+        _view_data.resize((size + sizeof(double) - 1) / sizeof(double));
+        char *buffer = size ? reinterpret_cast<char *>(&_view_data[0]) : NULL;
+        read_compressed_payload(component_size(_peeked_image_header.data_type), buffer, size);
+        data = buffer;
+    } else {
+        data = read_view_data(size, alignment<T>());
+    }
+    if (_rs.eof()) {
+        throw std::runtime_error("Error reading image");
+    }
+    img.head = &_peeked_image_header;
+    img.attribute_string = attr;
+    img.attribute_string_length = static_cast<size_t>(attr_length);
+    img.data = reinterpret_cast<const T *>(data);
+    finish_message();
 }
 
 void ProtocolDeserializer::deserialize(Waveform &wfm) {
+    start_call();
     if (peek() == ISMRMRD_MESSAGE_CLOSE) {
         throw ProtocolStreamClosed();
     }
@@ -344,11 +1010,12 @@ void ProtocolDeserializer::deserialize(Waveform &wfm) {
         throw std::runtime_error("Expected ISMRMRD_MESSAGE_WAVEFORM");
     }
     ISMRMRD::deserialize(wfm, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    finish_message();
 }
 
 template <typename T>
 void ProtocolDeserializer::deserialize(NDArray<T> &arr) {
+    start_call();
     if (peek() == ISMRMRD_MESSAGE_CLOSE) {
         throw ProtocolStreamClosed();
     }
@@ -356,7 +1023,29 @@ void ProtocolDeserializer::deserialize(NDArray<T> &arr) {
         throw std::runtime_error("Expected ISMRMRD_MESSAGE_NDARRAY");
     }
     deserialize_ndarray_data(arr, _rs);
-    _peeked = ISMRMRD_MESSAGE_UNPEEKED;
+    finish_message();
+}
+
+void ProtocolDeserializer::deserialize(Pooled<Acquisition> &acq) {
+    acq.reset();
+    Pooled<Acquisition> pooled = pool().acquisitions().acquire();
+    deserialize(*pooled);
+    acq = pooled;
+}
+
+template <typename T>
+void ProtocolDeserializer::deserialize(Pooled<Image<T> > &img) {
+    img.reset();
+    Pooled<Image<T> > pooled = pool().template images<T>().acquire();
+    deserialize(*pooled);
+    img = pooled;
+}
+
+void ProtocolDeserializer::deserialize(Pooled<Waveform> &wfm) {
+    wfm.reset();
+    Pooled<Waveform> pooled = pool().waveforms().acquire();
+    deserialize(*pooled);
+    wfm = pooled;
 }
 
 // template instantiations
@@ -368,6 +1057,15 @@ template EXPORTISMRMRD void serialize(const Image<float> &img, WritableStreamVie
 template EXPORTISMRMRD void serialize(const Image<double> &img, WritableStreamView &ws);
 template EXPORTISMRMRD void serialize(const Image<std::complex<float> > &img, WritableStreamView &ws);
 template EXPORTISMRMRD void serialize(const Image<std::complex<double> > &img, WritableStreamView &ws);
+
+template EXPORTISMRMRD void serialize(const ImageView<uint16_t> &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<uint32_t> &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<int16_t> &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<int32_t> &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<float> &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<double> &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<std::complex<float> > &img, WritableStreamView &ws);
+template EXPORTISMRMRD void serialize(const ImageView<std::complex<double> > &img, WritableStreamView &ws);
 template EXPORTISMRMRD void deserialize(Image<uint16_t> &img, ReadableStreamView &rs);
 template EXPORTISMRMRD void deserialize(Image<uint32_t> &img, ReadableStreamView &rs);
 template EXPORTISMRMRD void deserialize(Image<int16_t> &img, ReadableStreamView &rs);
@@ -384,6 +1082,15 @@ template EXPORTISMRMRD void ProtocolSerializer::serialize(const Image<float> &im
 template EXPORTISMRMRD void ProtocolSerializer::serialize(const Image<double> &img);
 template EXPORTISMRMRD void ProtocolSerializer::serialize(const Image<std::complex<float> > &img);
 template EXPORTISMRMRD void ProtocolSerializer::serialize(const Image<std::complex<double> > &img);
+
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<uint16_t> &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<uint32_t> &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<int16_t> &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<int32_t> &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<float> &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<double> &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<std::complex<float> > &img);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const ImageView<std::complex<double> > &img);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<uint16_t> &img);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<uint32_t> &img);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<int16_t> &img);
@@ -392,6 +1099,22 @@ template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<float> &img)
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<double> &img);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<std::complex<float> > &img);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Image<std::complex<double> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<uint16_t> &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<uint32_t> &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<int16_t> &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<int32_t> &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<float> &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<double> &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<std::complex<float> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(ImageView<std::complex<double> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<uint16_t> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<uint32_t> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<int16_t> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<int32_t> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<float> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<double> > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<std::complex<float> > > &img);
+template EXPORTISMRMRD void ProtocolDeserializer::deserialize(Pooled<Image<std::complex<double> > > &img);
 
 
 template void EXPORTISMRMRD serialize(const NDArray<uint16_t> &arr, WritableStreamView &ws);
@@ -403,6 +1126,15 @@ template void EXPORTISMRMRD serialize(const NDArray<double> &arr, WritableStream
 template void EXPORTISMRMRD serialize(const NDArray< std::complex<float> > &arr, WritableStreamView &ws);
 template void EXPORTISMRMRD serialize(const NDArray< std::complex<double> > &arr, WritableStreamView &ws);
 
+template void EXPORTISMRMRD serialize(const NDArrayView<uint16_t> &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView<uint32_t> &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView<int16_t> &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView<int32_t> &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView<float> &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView<double> &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView< std::complex<float> > &arr, WritableStreamView &ws);
+template void EXPORTISMRMRD serialize(const NDArrayView< std::complex<double> > &arr, WritableStreamView &ws);
+
 template void EXPORTISMRMRD deserialize(NDArray<uint16_t> &arr, ReadableStreamView &rs);
 template void EXPORTISMRMRD deserialize(NDArray<uint32_t> &arr, ReadableStreamView &rs);
 template void EXPORTISMRMRD deserialize(NDArray<int16_t> &arr, ReadableStreamView &rs);
@@ -421,6 +1153,15 @@ template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArray<double>
 template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArray< std::complex<float> > &arr);
 template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArray< std::complex<double> > &arr);
 
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView<uint16_t> &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView<uint32_t> &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView<int16_t> &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView<int32_t> &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView<float> &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView<double> &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView< std::complex<float> > &arr);
+template EXPORTISMRMRD void ProtocolSerializer::serialize(const NDArrayView< std::complex<double> > &arr);
+
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(NDArray<uint16_t> &arr);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(NDArray<uint32_t> &arr);
 template EXPORTISMRMRD void ProtocolDeserializer::deserialize(NDArray<int16_t> &arr);
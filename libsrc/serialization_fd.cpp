@@ -0,0 +1,233 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+
+#include "ismrmrd/serialization_fd.h"
+
+namespace ISMRMRD {
+
+static void throw_read_error() {
+    // Sockets with a receive timeout (SO_RCVTIMEO) fail with EAGAIN
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        throw std::runtime_error("Timed out reading from file descriptor");
+    }
+    throw std::runtime_error(std::string("Error reading from file descriptor: ") + strerror(errno));
+}
+
+FdReadStream::FdReadStream(int fd, size_t buffer_size)
+    : _fd(fd), _buffer(buffer_size > 0 ? buffer_size : 1), _begin(0), _end(0), _eof(false) {
+    _seekable = lseek(_fd, 0, SEEK_CUR) != (off_t)-1;
+}
+
+size_t FdReadStream::read_fd(char *buffer, size_t count) {
+    size_t total = 0;
+    while (total < count) {
+        ssize_t n = ::read(_fd, buffer + total, count - total);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_read_error();
+        }
+        if (n == 0) {
+            _eof = true;
+            break;
+        }
+        total += static_cast<size_t>(n);
+    }
+    return total;
+}
+
+bool FdReadStream::fill() {
+    _begin = 0;
+    _end = 0;
+    while (true) {
+        ssize_t n = ::read(_fd, &_buffer[0], _buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_read_error();
+        }
+        if (n == 0) {
+            _eof = true;
+            return false;
+        }
+        _end = static_cast<size_t>(n);
+        return true;
+    }
+}
+
+void FdReadStream::read(char *buffer, size_t count) {
+    while (count > 0) {
+        size_t available = _end - _begin;
+        if (available > 0) {
+            size_t n = available < count ? available : count;
+            memcpy(buffer, &_buffer[_begin], n);
+            _begin += n;
+            buffer += n;
+            count -= n;
+        } else if (count >= _buffer.size()) {
+            // Large payloads (sample data) go straight into the destination
+            if (read_fd(buffer, count) < count) {
+                return;
+            }
+            count = 0;
+        } else if (!fill()) {
+            return;
+        }
+    }
+}
+
+bool FdReadStream::eof() {
+    return _eof;
+}
+
+void FdReadStream::skip(size_t count) {
+    size_t available = _end - _begin;
+    if (count <= available) {
+        _begin += count;
+        return;
+    }
+    count -= available;
+    _begin = _end;
+    if (_seekable) {
+        // Seeking past the end of a file succeeds, so a truncated file is
+        // detected by its size
+        off_t position = lseek(_fd, 0, SEEK_CUR);
+        struct stat st;
+        if (position != (off_t)-1 && fstat(_fd, &st) == 0 && S_ISREG(st.st_mode) &&
+            static_cast<uint64_t>(st.st_size - position) < count) {
+            lseek(_fd, 0, SEEK_END);
+            _eof = true;
+            return;
+        }
+        if (lseek(_fd, static_cast<off_t>(count), SEEK_CUR) == (off_t)-1) {
+            throw std::runtime_error(std::string("Error seeking in file descriptor: ") + strerror(errno));
+        }
+        return;
+    }
+    while (count > 0) {
+        if (!fill()) {
+            return;
+        }
+        size_t n = _end < count ? _end : count;
+        _begin = n;
+        count -= n;
+    }
+}
+
+FdWriteStream::FdWriteStream(int fd, size_t buffer_size)
+    : _fd(fd), _buffer(buffer_size > 0 ? buffer_size : 1), _size(0), _bad(false) {}
+
+FdWriteStream::~FdWriteStream() {
+    flush();
+}
+
+void FdWriteStream::write_fd(const char *buffer, size_t count) {
+    while (count > 0 && !_bad) {
+        ssize_t n = ::write(_fd, buffer, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            _bad = true;
+            break;
+        }
+        buffer += n;
+        count -= static_cast<size_t>(n);
+    }
+}
+
+void FdWriteStream::write(const char *buffer, size_t count) {
+    if (_size + count <= _buffer.size()) {
+        memcpy(&_buffer[_size], buffer, count);
+        _size += count;
+        return;
+    }
+    flush();
+    if (count >= _buffer.size()) {
+        // Large payloads are written without copying them into the buffer
+        write_fd(buffer, count);
+    } else {
+        memcpy(&_buffer[0], buffer, count);
+        _size = count;
+    }
+}
+
+void FdWriteStream::write_iov(struct iovec *iov, size_t count) {
+#ifdef IOV_MAX
+    const size_t max_count = IOV_MAX;
+#else
+    const size_t max_count = 16;
+#endif
+    while (count > 0 && !_bad) {
+        ssize_t n = ::writev(_fd, iov, static_cast<int>(count < max_count ? count : max_count));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            _bad = true;
+            break;
+        }
+        // Skip what was written, a partial write may end inside a buffer
+        size_t written = static_cast<size_t>(n);
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+void FdWriteStream::writev(const StreamBuffer *buffers, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += buffers[i].size;
+    }
+    if (_size + total <= _buffer.size()) {
+        for (size_t i = 0; i < count; i++) {
+            memcpy(&_buffer[_size], buffers[i].data, buffers[i].size);
+            _size += buffers[i].size;
+        }
+        return;
+    }
+
+    _iov.clear();
+    if (_size > 0) {
+        struct iovec v;
+        v.iov_base = &_buffer[0];
+        v.iov_len = _size;
+        _iov.push_back(v);
+    }
+    for (size_t i = 0; i < count; i++) {
+        struct iovec v;
+        v.iov_base = const_cast<char *>(buffers[i].data);
+        v.iov_len = buffers[i].size;
+        _iov.push_back(v);
+    }
+    _size = 0;
+    if (!_iov.empty()) {
+        write_iov(&_iov[0], _iov.size());
+    }
+}
+
+bool FdWriteStream::bad() {
+    return _bad;
+}
+
+void FdWriteStream::flush() {
+    if (_size > 0) {
+        write_fd(&_buffer[0], _size);
+        _size = 0;
+    }
+}
+
+} // namespace ISMRMRD
@@ -0,0 +1,96 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+
+#include "ismrmrd/serialization_mmap.h"
+
+namespace ISMRMRD {
+
+MmapReadStream::MmapReadStream(const std::string &path) : _data(NULL), _size(0), _position(0), _eof(false) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening " + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Error reading the size of " + path + ": " + strerror(error));
+    }
+    _size = static_cast<size_t>(st.st_size);
+    // An empty file cannot be mapped, it reads as the end of input
+    if (_size > 0) {
+        void *mapping = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("Error mapping " + path + ": " + strerror(error));
+        }
+        // Replay reads the file front to back
+        madvise(mapping, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const char *>(mapping);
+    }
+    close(fd);
+}
+
+MmapReadStream::~MmapReadStream() {
+    if (_data) {
+        munmap(const_cast<char *>(_data), _size);
+    }
+}
+
+void MmapReadStream::read(char *buffer, size_t count) {
+    if (count > _size - _position) {
+        count = _size - _position;
+        _eof = true;
+    }
+    memcpy(buffer, _data + _position, count);
+    _position += count;
+}
+
+bool MmapReadStream::eof() {
+    return _eof;
+}
+
+void MmapReadStream::skip(size_t count) {
+    if (count > _size - _position) {
+        count = _size - _position;
+        _eof = true;
+    }
+    _position += count;
+}
+
+const char *MmapReadStream::read_in_place(size_t count) {
+    if (count > _size - _position) {
+        return NULL;
+    }
+    const char *data = _data + _position;
+    _position += count;
+    return data;
+}
+
+const char *MmapReadStream::data() const {
+    return _data;
+}
+
+size_t MmapReadStream::size() const {
+    return _size;
+}
+
+size_t MmapReadStream::position() const {
+    return _position;
+}
+
+void MmapReadStream::seek(size_t position) {
+    if (position > _size) {
+        throw std::runtime_error("Seek past the end of the mapped file");
+    }
+    _position = position;
+    _eof = false;
+}
+
+} // namespace ISMRMRD
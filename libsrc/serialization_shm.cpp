@@ -0,0 +1,430 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include <algorithm>
+#include <stdexcept>
+
+#include "ismrmrd/serialization_shm.h"
+
+namespace ISMRMRD {
+
+static const uint32_t shm_ring_magic = 0x4d524452; // "RDRM"
+static const uint32_t shm_ring_version = 2;
+
+// How long a waiting reader sleeps before it checks that the writer is alive
+static const long shm_wait_timeout_ms = 100;
+
+// A slot starts with the message size and flags. The message follows at an
+// offset that leaves the header of an acquisition (after its 2 byte message id)
+// 8 byte aligned and its trajectory and data 4 byte aligned.
+static const size_t slot_data_offset = 14;
+
+enum ShmSlotFlags {
+    SHM_SLOT_CONTINUED = 1,
+    SHM_SLOT_END = 2
+};
+
+// At the start of the shared memory, followed by the slots. The counters of
+// the writer and of the reader are on separate cache lines.
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slot_size;
+    uint64_t slot_count;
+    uint64_t slot_stride;
+    // Process of the writer (0 before it attaches), and whether it closed the stream
+    uint32_t writer_pid;
+    uint32_t writer_closed;
+    char pad0[24];
+    // Slots written, and whether the reader sleeps waiting for more
+    uint32_t head;
+    uint32_t reader_waiting;
+    char pad1[56];
+    // Slots released by the reader, and whether the writer sleeps waiting for one
+    uint32_t tail;
+    uint32_t writer_waiting;
+    char pad2[56];
+};
+
+static void throw_shm_error(const std::string &what) {
+    throw std::runtime_error(what + ": " + strerror(errno));
+}
+
+static uint32_t load(const uint32_t *word) {
+    return __atomic_load_n(word, __ATOMIC_SEQ_CST);
+}
+
+static void store(uint32_t *word, uint32_t value) {
+    __atomic_store_n(word, value, __ATOMIC_SEQ_CST);
+}
+
+// Returns whether *word differs from value, waiting for it up to about
+// shm_wait_timeout_ms. Spins briefly, then sleeps, flagging the sleep in
+// *waiting so that the other side knows to wake it.
+static bool wait_while_equal(uint32_t *word, uint32_t value, uint32_t *waiting) {
+    for (int spins = 0; spins < 1000; spins++) {
+        if (load(word) != value) {
+            return true;
+        }
+    }
+    store(waiting, 1);
+#ifdef __linux__
+    // Returns at once if *word already changed, early on EINTR
+    struct timespec ts = {0, shm_wait_timeout_ms * 1000000L};
+    syscall(SYS_futex, word, FUTEX_WAIT, value, &ts, NULL, 0);
+#else
+    for (long slept = 0; load(word) == value && slept < shm_wait_timeout_ms * 1000; slept += 50) {
+        struct timespec ts = {0, 50000};
+        nanosleep(&ts, NULL);
+    }
+#endif
+    store(waiting, 0);
+    return load(word) != value;
+}
+
+// Whether the writer closed the stream or its process no longer exists
+static bool writer_gone(const ShmRingHeader *header) {
+    if (load(&header->writer_closed)) {
+        return true;
+    }
+    pid_t pid = static_cast<pid_t>(load(&header->writer_pid));
+    return pid != 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+static void wake(uint32_t *word, const uint32_t *waiting) {
+    if (load(waiting)) {
+#ifdef __linux__
+        syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+        (void)word;
+#endif
+    }
+}
+
+ShmRing::ShmRing(const std::string &name, size_t slot_size, size_t slot_count)
+    : _name(name), _owner(true), _mapping(NULL), _mapping_size(0), _header(NULL), _slot_stride(0) {
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || slot_count > 0x80000000u) {
+        throw std::runtime_error("The number of shared memory slots must be a power of two");
+    }
+    if (slot_size == 0 || slot_size > 0xffffffffu - slot_data_offset) {
+        throw std::runtime_error("Invalid shared memory slot size");
+    }
+    _slot_stride = (slot_data_offset + slot_size + 63) / 64 * 64;
+    _mapping_size = sizeof(ShmRingHeader) + _slot_stride * slot_count;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw_shm_error("Error creating shared memory " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(_mapping_size)) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw_shm_error("Error sizing shared memory " + name);
+    }
+    _mapping = mmap(NULL, _mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (_mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw_shm_error("Error mapping shared memory " + name);
+    }
+
+    // The new object is zero filled, the magic number is set last so that a
+    // process opening the ring only sees it initialized
+    _header = static_cast<ShmRingHeader *>(_mapping);
+    _header->version = shm_ring_version;
+    _header->slot_size = slot_size;
+    _header->slot_count = slot_count;
+    _header->slot_stride = _slot_stride;
+    store(&_header->magic, shm_ring_magic);
+}
+
+ShmRing::ShmRing(const std::string &name)
+    : _name(name), _owner(false), _mapping(NULL), _mapping_size(0), _header(NULL), _slot_stride(0) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw_shm_error("Error opening shared memory " + name);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw_shm_error("Error opening shared memory " + name);
+    }
+    _mapping_size = static_cast<size_t>(st.st_size);
+    if (_mapping_size < sizeof(ShmRingHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Shared memory " + name + " is not an initialized ring");
+    }
+    _mapping = mmap(NULL, _mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (_mapping == MAP_FAILED) {
+        throw_shm_error("Error mapping shared memory " + name);
+    }
+    _header = static_cast<ShmRingHeader *>(_mapping);
+    if (load(&_header->magic) != shm_ring_magic || _header->version != shm_ring_version ||
+        _header->slot_count == 0 || (_header->slot_count & (_header->slot_count - 1)) != 0 ||
+        _header->slot_stride < slot_data_offset + _header->slot_size ||
+        _mapping_size < sizeof(ShmRingHeader) + _header->slot_stride * _header->slot_count) {
+        munmap(_mapping, _mapping_size);
+        throw std::runtime_error("Shared memory " + name + " is not an initialized ring");
+    }
+    _slot_stride = static_cast<size_t>(_header->slot_stride);
+}
+
+ShmRing::~ShmRing() {
+    munmap(_mapping, _mapping_size);
+    if (_owner) {
+        shm_unlink(_name.c_str());
+    }
+}
+
+size_t ShmRing::slot_size() const {
+    return static_cast<size_t>(_header->slot_size);
+}
+
+size_t ShmRing::slot_count() const {
+    return static_cast<size_t>(_header->slot_count);
+}
+
+char *ShmRing::slot(uint32_t sequence) const {
+    // The counters wrap around, which keeps the index right as the count is a power of two
+    size_t index = sequence & static_cast<uint32_t>(_header->slot_count - 1);
+    return static_cast<char *>(_mapping) + sizeof(ShmRingHeader) + index * _slot_stride;
+}
+
+ShmRingWriter::ShmRingWriter(ShmRing &ring) : _ring(ring), _reserved(NULL), _closed(false) {
+    store(&_ring._header->writer_pid, static_cast<uint32_t>(getpid()));
+}
+
+ShmRingWriter::~ShmRingWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+char *ShmRingWriter::reserve() {
+    if (_closed) {
+        throw std::runtime_error("Writing to a closed shared memory ring");
+    }
+    if (!_reserved) {
+        ShmRingHeader *header = _ring._header;
+        uint32_t head = header->head;
+        uint32_t tail;
+        while (head - (tail = load(&header->tail)) >= header->slot_count) {
+            wait_while_equal(&header->tail, tail, &header->writer_waiting);
+        }
+        _reserved = _ring.slot(head) + slot_data_offset;
+    }
+    return _reserved;
+}
+
+void ShmRingWriter::publish(size_t size, uint32_t flags) {
+    ShmRingHeader *header = _ring._header;
+    uint32_t head = header->head;
+    char *slot = _ring.slot(head);
+    uint32_t size32 = static_cast<uint32_t>(size);
+    memcpy(slot, &size32, sizeof(uint32_t));
+    memcpy(slot + sizeof(uint32_t), &flags, sizeof(uint32_t));
+    _reserved = NULL;
+    store(&header->head, head + 1);
+    wake(&header->head, &header->reader_waiting);
+}
+
+void ShmRingWriter::commit(size_t size) {
+    if (!_reserved) {
+        throw std::runtime_error("No shared memory slot reserved");
+    }
+    if (size > _ring.slot_size()) {
+        throw std::runtime_error("Message larger than the shared memory slot");
+    }
+    publish(size, 0);
+}
+
+void ShmRingWriter::write(const char *buffer, size_t count) {
+    StreamBuffer part = {buffer, count};
+    writev(&part, 1);
+}
+
+void ShmRingWriter::writev(const StreamBuffer *buffers, size_t count) {
+    const size_t capacity = _ring.slot_size();
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += buffers[i].size;
+    }
+    if (total == 0) {
+        return;
+    }
+    // The parts are copied straight into the slots
+    size_t used = 0;
+    char *slot = reserve();
+    for (size_t i = 0; i < count; i++) {
+        const char *data = buffers[i].data;
+        size_t size = buffers[i].size;
+        while (size > 0) {
+            if (used == capacity) {
+                publish(used, SHM_SLOT_CONTINUED);
+                slot = reserve();
+                used = 0;
+            }
+            size_t n = std::min(size, capacity - used);
+            memcpy(slot + used, data, n);
+            used += n;
+            data += n;
+            size -= n;
+        }
+    }
+    publish(used, 0);
+}
+
+bool ShmRingWriter::bad() {
+    return _closed;
+}
+
+void ShmRingWriter::close() {
+    if (!_closed) {
+        reserve();
+        publish(0, SHM_SLOT_END);
+        _closed = true;
+        store(&_ring._header->writer_closed, 1);
+    }
+}
+
+ShmRingReader::ShmRingReader(ShmRing &ring) : _ring(ring), _acquired(false), _end(false), _offset(0), _eof(false) {
+    _slot.data = NULL;
+    _slot.size = 0;
+    _slot.continued = false;
+}
+
+ShmRingReader::~ShmRingReader() {
+    if (_acquired) {
+        release();
+    }
+}
+
+bool ShmRingReader::acquire(ShmSlotView &slot) {
+    if (_acquired) {
+        throw std::runtime_error("The previous shared memory slot was not released");
+    }
+    if (_end) {
+        return false;
+    }
+    ShmRingHeader *header = _ring._header;
+    uint32_t tail = header->tail;
+    while (!wait_while_equal(&header->head, tail, &header->reader_waiting)) {
+        // A writer that closed the stream sent its end first, so only one that
+        // died leaves the ring empty. Checked again in case it sent it meanwhile.
+        if (writer_gone(header) && load(&header->head) == tail) {
+            throw std::runtime_error("The shared memory writer exited without closing the stream");
+        }
+    }
+
+    const char *data = _ring.slot(tail);
+    uint32_t size, flags;
+    memcpy(&size, data, sizeof(uint32_t));
+    memcpy(&flags, data + sizeof(uint32_t), sizeof(uint32_t));
+    if (size > _ring.slot_size()) {
+        throw std::runtime_error("Corrupt shared memory slot: size larger than the slot");
+    }
+    _acquired = true;
+    if (flags & SHM_SLOT_END) {
+        release();
+        _end = true;
+        return false;
+    }
+    slot.data = data + slot_data_offset;
+    slot.size = size;
+    slot.continued = (flags & SHM_SLOT_CONTINUED) != 0;
+    return true;
+}
+
+void ShmRingReader::release() {
+    if (!_acquired) {
+        throw std::runtime_error("No shared memory slot acquired");
+    }
+    ShmRingHeader *header = _ring._header;
+    store(&header->tail, header->tail + 1);
+    wake(&header->tail, &header->writer_waiting);
+    _acquired = false;
+}
+
+bool ShmRingReader::next_stream_slot() {
+    do {
+        if (!acquire(_slot)) {
+            _eof = true;
+            return false;
+        }
+        if (_slot.size == 0) {
+            release();
+        }
+    } while (!_acquired);
+    _offset = 0;
+    return true;
+}
+
+void ShmRingReader::read(char *buffer, size_t count) {
+    while (count > 0) {
+        if (!_acquired && !next_stream_slot()) {
+            return;
+        }
+        size_t n = std::min(count, _slot.size - _offset);
+        memcpy(buffer, _slot.data + _offset, n);
+        buffer += n;
+        count -= n;
+        _offset += n;
+        // Slots go back to the writer as soon as they are consumed
+        if (_offset == _slot.size) {
+            release();
+        }
+    }
+}
+
+bool ShmRingReader::eof() {
+    return _eof;
+}
+
+void ShmRingReader::skip(size_t count) {
+    while (count > 0) {
+        if (!_acquired && !next_stream_slot()) {
+            return;
+        }
+        size_t n = std::min(count, _slot.size - _offset);
+        count -= n;
+        _offset += n;
+        if (_offset == _slot.size) {
+            release();
+        }
+    }
+}
+
+bool view_acquisition(const ShmSlotView &slot, AcquisitionView &acq) {
+    const size_t head_end = sizeof(uint16_t) + sizeof(AcquisitionHeader);
+    if (slot.continued || slot.size < head_end) {
+        return false;
+    }
+    uint16_t id;
+    memcpy(&id, slot.data, sizeof(uint16_t));
+    if (id != ISMRMRD_MESSAGE_ACQUISITION) {
+        return false;
+    }
+    acq.head = reinterpret_cast<const AcquisitionHeader *>(slot.data + sizeof(uint16_t));
+    size_t traj_size = static_cast<size_t>(acq.head->trajectory_dimensions) * acq.head->number_of_samples * sizeof(float);
+    size_t data_size = static_cast<size_t>(acq.head->number_of_samples) * acq.head->active_channels * 2 * sizeof(float);
+    if (slot.size != head_end + traj_size + data_size) {
+        return false;
+    }
+    acq.traj = reinterpret_cast<const float *>(slot.data + head_end);
+    acq.data = reinterpret_cast<const complex_float_t *>(slot.data + head_end + traj_size);
+    return true;
+}
+
+} // namespace ISMRMRD
@@ -0,0 +1,254 @@
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sstream>
+#include <stdexcept>
+
+#include "ismrmrd/serialization_socket.h"
+
+namespace ISMRMRD {
+
+SocketOptions::SocketOptions()
+    : send_buffer_size(0), receive_buffer_size(0), timeout_ms(0), no_delay(true), cork(false),
+      flush_messages(true), stream_buffer_size(ISMRMRD_FD_STREAM_BUFFER_SIZE) {}
+
+static void throw_socket_error(const std::string &what) {
+    throw std::runtime_error(what + ": " + strerror(errno));
+}
+
+static void set_option(int fd, int level, int name, const void *value, socklen_t size) {
+    if (setsockopt(fd, level, name, value, size) != 0) {
+        throw_socket_error("Error setting socket option");
+    }
+}
+
+static void set_int_option(int fd, int level, int name, int value) {
+    set_option(fd, level, name, &value, sizeof(value));
+}
+
+static void set_timeout_option(int fd, int name, int timeout_ms) {
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    set_option(fd, SOL_SOCKET, name, &tv, sizeof(tv));
+}
+
+static bool is_tcp(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t size = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &size) != 0) {
+        throw_socket_error("Error querying socket");
+    }
+    return addr.ss_family == AF_INET || addr.ss_family == AF_INET6;
+}
+
+SocketReadStream::SocketReadStream(int fd, const SocketOptions &options)
+    : FdReadStream(fd, options.stream_buffer_size) {
+    if (options.receive_buffer_size > 0) {
+        set_int_option(fd, SOL_SOCKET, SO_RCVBUF, options.receive_buffer_size);
+    }
+    if (options.timeout_ms > 0) {
+        set_timeout_option(fd, SO_RCVTIMEO, options.timeout_ms);
+    }
+}
+
+SocketWriteStream::SocketWriteStream(int fd, const SocketOptions &options)
+    : FdWriteStream(fd, options.stream_buffer_size), _flush_messages(options.flush_messages), _corked(false) {
+    if (options.send_buffer_size > 0) {
+        set_int_option(fd, SOL_SOCKET, SO_SNDBUF, options.send_buffer_size);
+    }
+    if (options.timeout_ms > 0) {
+        set_timeout_option(fd, SO_SNDTIMEO, options.timeout_ms);
+    }
+    if (is_tcp(fd)) {
+        set_int_option(fd, IPPROTO_TCP, TCP_NODELAY, options.no_delay ? 1 : 0);
+        if (options.cork) {
+            set_cork(true);
+        }
+    }
+}
+
+SocketWriteStream::~SocketWriteStream() {
+    // The base class destructor cannot reach our flush
+    FdWriteStream::flush();
+    if (_corked) {
+        set_cork(false);
+    }
+}
+
+void SocketWriteStream::set_cork(bool enabled) {
+#ifdef TCP_CORK
+    int value = enabled ? 1 : 0;
+    // Failing to uncork in the destructor must not throw, the kernel uncorks on close
+    if (setsockopt(_fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) == 0) {
+        _corked = enabled;
+    }
+#else
+    (void)enabled;
+#endif
+}
+
+void SocketWriteStream::writev(const StreamBuffer *buffers, size_t count) {
+    FdWriteStream::writev(buffers, count);
+    if (_flush_messages) {
+        flush();
+    }
+}
+
+void SocketWriteStream::flush() {
+    FdWriteStream::flush();
+    if (_corked) {
+        // Uncorking sends the partial segment at the end of the message
+        set_cork(false);
+        set_cork(true);
+    }
+}
+
+static struct addrinfo *resolve(const std::string &host, unsigned short port, bool passive) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | (passive ? AI_PASSIVE : 0);
+
+    std::stringstream service;
+    service << port;
+    struct addrinfo *result = NULL;
+    int status = getaddrinfo(host.empty() ? NULL : host.c_str(), service.str().c_str(), &hints, &result);
+    if (status != 0) {
+        throw std::runtime_error("Error resolving " + host + ": " + gai_strerror(status));
+    }
+    return result;
+}
+
+int connect_tcp(const std::string &host, unsigned short port) {
+    struct addrinfo *addresses = resolve(host, port, false);
+    int error = 0;
+    for (struct addrinfo *a = addresses; a != NULL; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) {
+            error = errno;
+            continue;
+        }
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            freeaddrinfo(addresses);
+            return fd;
+        }
+        error = errno;
+        close(fd);
+    }
+    freeaddrinfo(addresses);
+    errno = error;
+    std::stringstream where;
+    where << host << ":" << port;
+    throw_socket_error("Error connecting to " + where.str());
+    return -1;
+}
+
+int listen_tcp(const std::string &host, unsigned short port, int backlog) {
+    struct addrinfo *addresses = resolve(host, port, true);
+    int error = 0;
+    for (struct addrinfo *a = addresses; a != NULL; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) {
+            error = errno;
+            continue;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, a->ai_addr, a->ai_addrlen) == 0 && listen(fd, backlog) == 0) {
+            freeaddrinfo(addresses);
+            return fd;
+        }
+        error = errno;
+        close(fd);
+    }
+    freeaddrinfo(addresses);
+    errno = error;
+    std::stringstream where;
+    where << host << ":" << port;
+    throw_socket_error("Error listening on " + where.str());
+    return -1;
+}
+
+static struct sockaddr_un unix_address(const std::string &path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Unix domain socket path is too long: " + path);
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return addr;
+}
+
+int connect_unix(const std::string &path) {
+    struct sockaddr_un addr = unix_address(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw_socket_error("Error creating socket");
+    }
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        throw_socket_error("Error connecting to " + path);
+    }
+    return fd;
+}
+
+int listen_unix(const std::string &path, int backlog) {
+    struct sockaddr_un addr = unix_address(path);
+    // A socket file left behind by a previous server would make bind fail
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw_socket_error("Error creating socket");
+    }
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, backlog) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        throw_socket_error("Error listening on " + path);
+    }
+    return fd;
+}
+
+int accept_connection(int listen_fd) {
+    while (true) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd >= 0) {
+            return fd;
+        }
+        if (errno != EINTR) {
+            throw_socket_error("Error accepting connection");
+        }
+    }
+}
+
+unsigned short socket_port(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t size = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &size) != 0) {
+        throw_socket_error("Error querying socket");
+    }
+    if (addr.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<struct sockaddr_in *>(&addr)->sin_port);
+    }
+    if (addr.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<struct sockaddr_in6 *>(&addr)->sin6_port);
+    }
+    throw std::runtime_error("Not a TCP socket");
+}
+
+} // namespace ISMRMRD
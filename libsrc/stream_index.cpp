@@ -0,0 +1,391 @@
+#include "ismrmrd/stream_index.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace ISMRMRD {
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'M', 'R', 'D', 'I', 'N', 'D', 'E', 'X'};
+const uint32_t INDEX_VERSION = 2;
+
+// Bytes at each end of the stream file that its fingerprint covers
+const uint64_t FINGERPRINT_BLOCK = 4096;
+
+// Layout of the sidecar file, followed by the message and acquisition tables
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t closed;
+    uint64_t stream_size;
+    int64_t stream_mtime;
+    uint64_t stream_fingerprint;
+    uint64_t messages;
+    uint64_t acquisitions;
+};
+
+uint64_t file_size(std::ifstream &file) {
+    file.seekg(0, std::ios::end);
+    std::streampos end = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (end == std::streampos(-1)) {
+        throw std::runtime_error("Cannot determine the size of the stream file");
+    }
+    return static_cast<uint64_t>(end);
+}
+
+int64_t modification_time(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Cannot determine the modification time of " + path);
+    }
+    return static_cast<int64_t>(st.st_mtime);
+}
+
+// FNV-1a hash of the first and last block of the file, which catches a stream
+// rewritten at the same length within the resolution of its modification time
+uint64_t fingerprint(std::ifstream &file, uint64_t size) {
+    char block[FINGERPRINT_BLOCK];
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t starts[2] = {0, size > FINGERPRINT_BLOCK ? size - FINGERPRINT_BLOCK : 0};
+    for (int b = 0; b < 2; b++) {
+        uint64_t length = size < FINGERPRINT_BLOCK ? size : FINGERPRINT_BLOCK;
+        file.seekg(static_cast<std::streamoff>(starts[b]), std::ios::beg);
+        file.read(block, static_cast<std::streamsize>(length));
+        if (!file) {
+            throw std::runtime_error("Error reading the stream file");
+        }
+        for (uint64_t i = 0; i < length; i++) {
+            hash = (hash ^ static_cast<unsigned char>(block[i])) * 1099511628211ULL;
+        }
+    }
+    file.seekg(0, std::ios::beg);
+    return hash;
+}
+
+uint64_t acquisition_data_size(const AcquisitionHeader &head) {
+    return static_cast<uint64_t>(head.trajectory_dimensions) * head.number_of_samples * sizeof(float) +
+           static_cast<uint64_t>(head.number_of_samples) * head.active_channels * sizeof(complex_float_t);
+}
+
+uint16_t uncompressed_id(uint16_t id) {
+    if (id == ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION) {
+        return ISMRMRD_MESSAGE_ACQUISITION;
+    }
+    if (id == ISMRMRD_MESSAGE_COMPRESSED_IMAGE) {
+        return ISMRMRD_MESSAGE_IMAGE;
+    }
+    return id;
+}
+
+StreamIndexAcquisition acquisition_entry(const AcquisitionHeader &head, uint64_t message, uint64_t header_offset,
+                                         uint64_t data_offset) {
+    StreamIndexAcquisition entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.message = message;
+    entry.header_offset = header_offset;
+    entry.data_offset = data_offset;
+    entry.flags = head.flags;
+    entry.scan_counter = head.scan_counter;
+    entry.idx = head.idx;
+    return entry;
+}
+
+} // namespace
+
+StreamIndex::StreamIndex() : _stream_size(0), _stream_mtime(0), _stream_fingerprint(0), _closed(false) {}
+
+void StreamIndex::build(const std::string &stream_path) {
+    std::ifstream file(stream_path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open stream file " + stream_path);
+    }
+    _messages.clear();
+    _acquisitions.clear();
+    _stream_size = file_size(file);
+    _stream_mtime = modification_time(stream_path);
+    _stream_fingerprint = fingerprint(file, _stream_size);
+    _closed = false;
+
+    IStreamView rs(file);
+    ProtocolDeserializer deserializer(rs);
+    for (;;) {
+        uint64_t offset = static_cast<uint64_t>(file.tellg());
+        if (offset >= _stream_size) {
+            break;
+        }
+        uint16_t id;
+        try {
+            id = deserializer.peek();
+        } catch (std::runtime_error &) {
+            if (file.eof()) {
+                // The recording ends inside the message headers
+                break;
+            }
+            throw;
+        }
+        if (id == ISMRMRD_MESSAGE_CLOSE) {
+            _closed = true;
+            break;
+        }
+
+        StreamIndexMessage entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = offset;
+        entry.first_acquisition = _acquisitions.size();
+        entry.id = id;
+        if (deserializer.peek_compressed()) {
+            entry.id = id == ISMRMRD_MESSAGE_ACQUISITION ? ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION
+                                                         : ISMRMRD_MESSAGE_COMPRESSED_IMAGE;
+        }
+
+        uint64_t message = _messages.size();
+        uint64_t headers = offset + sizeof(uint16_t);
+        if (id == ISMRMRD_MESSAGE_ACQUISITION) {
+            const AcquisitionHeader &head = deserializer.peek_acquisition_header();
+            uint64_t data = deserializer.peek_compressed() ? 0 : headers + sizeof(AcquisitionHeader);
+            _acquisitions.push_back(acquisition_entry(head, message, headers, data));
+            entry.acquisitions = 1;
+        } else if (id == ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+            const std::vector<AcquisitionHeader> &heads = deserializer.peek_batch_headers();
+            headers += sizeof(uint32_t);
+            uint64_t data = headers + heads.size() * sizeof(AcquisitionHeader);
+            for (size_t i = 0; i < heads.size(); i++) {
+                _acquisitions.push_back(
+                    acquisition_entry(heads[i], message, headers + i * sizeof(AcquisitionHeader), data));
+                data += acquisition_data_size(heads[i]);
+            }
+            entry.acquisitions = static_cast<uint32_t>(heads.size());
+        } else if (id == ISMRMRD_MESSAGE_IMAGE) {
+            const ImageHeader &head = deserializer.peek_image_header();
+            entry.data_type = head.data_type;
+            entry.image_index = head.image_index;
+            entry.image_series_index = head.image_series_index;
+        } else if (id == ISMRMRD_MESSAGE_NDARRAY) {
+            entry.data_type = static_cast<uint16_t>(deserializer.peek_ndarray_data_type());
+        }
+
+        try {
+            deserializer.skip();
+        } catch (std::runtime_error &) {
+            if (!file.eof()) {
+                throw;
+            }
+        }
+        std::streampos end = file.tellg();
+        if (file.eof() || end == std::streampos(-1) || static_cast<uint64_t>(end) > _stream_size) {
+            // The recording ends inside the message
+            _acquisitions.resize(entry.first_acquisition);
+            break;
+        }
+        entry.size = static_cast<uint64_t>(end) - offset;
+        _messages.push_back(entry);
+    }
+}
+
+void StreamIndex::save(const std::string &index_path) const {
+    std::ofstream file(index_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Cannot create stream index " + index_path);
+    }
+    IndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.closed = _closed ? 1 : 0;
+    header.stream_size = _stream_size;
+    header.stream_mtime = _stream_mtime;
+    header.stream_fingerprint = _stream_fingerprint;
+    header.messages = _messages.size();
+    header.acquisitions = _acquisitions.size();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!_messages.empty()) {
+        file.write(reinterpret_cast<const char *>(&_messages[0]), _messages.size() * sizeof(StreamIndexMessage));
+    }
+    if (!_acquisitions.empty()) {
+        file.write(reinterpret_cast<const char *>(&_acquisitions[0]),
+                   _acquisitions.size() * sizeof(StreamIndexAcquisition));
+    }
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Error writing stream index " + index_path);
+    }
+}
+
+void StreamIndex::load(const std::string &index_path) {
+    std::ifstream file(index_path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open stream index " + index_path);
+    }
+    uint64_t size = file_size(file);
+    IndexFileHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+        size != sizeof(header) + header.messages * sizeof(StreamIndexMessage) +
+                    header.acquisitions * sizeof(StreamIndexAcquisition)) {
+        throw std::runtime_error("Not a stream index: " + index_path);
+    }
+    _messages.resize(header.messages);
+    _acquisitions.resize(header.acquisitions);
+    if (!_messages.empty()) {
+        file.read(reinterpret_cast<char *>(&_messages[0]), _messages.size() * sizeof(StreamIndexMessage));
+    }
+    if (!_acquisitions.empty()) {
+        file.read(reinterpret_cast<char *>(&_acquisitions[0]), _acquisitions.size() * sizeof(StreamIndexAcquisition));
+    }
+    if (!file) {
+        throw std::runtime_error("Error reading stream index " + index_path);
+    }
+    _stream_size = header.stream_size;
+    _stream_mtime = header.stream_mtime;
+    _stream_fingerprint = header.stream_fingerprint;
+    _closed = header.closed != 0;
+}
+
+void StreamIndex::open(const std::string &stream_path) {
+    std::ifstream file(stream_path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open stream file " + stream_path);
+    }
+    uint64_t size = file_size(file);
+    std::string index_path = sidecar_path(stream_path);
+    try {
+        load(index_path);
+        if (_stream_size == size && _stream_mtime == modification_time(stream_path) &&
+            _stream_fingerprint == fingerprint(file, size)) {
+            return;
+        }
+    } catch (std::runtime_error &) {
+        // Missing or not readable, rebuilt below
+    }
+    build(stream_path);
+    try {
+        save(index_path);
+    } catch (std::runtime_error &) {
+        // The index is still usable, e.g. for a stream in a read-only directory
+    }
+}
+
+std::string StreamIndex::sidecar_path(const std::string &stream_path) {
+    return stream_path + ".idx";
+}
+
+const std::vector<StreamIndexMessage> &StreamIndex::messages() const {
+    return _messages;
+}
+
+const std::vector<StreamIndexAcquisition> &StreamIndex::acquisitions() const {
+    return _acquisitions;
+}
+
+uint64_t StreamIndex::stream_size() const {
+    return _stream_size;
+}
+
+bool StreamIndex::closed() const {
+    return _closed;
+}
+
+std::vector<size_t> StreamIndex::find_acquisitions(int key, uint16_t value) const {
+    if (key < 0 || key >= ISMRMRD_IDX_NUMBER_OF_KEYS) {
+        throw std::runtime_error("Invalid encoding counter key");
+    }
+    std::vector<size_t> found;
+    for (size_t n = 0; n < _acquisitions.size(); n++) {
+        if (ismrmrd_get_encoding_counter(&_acquisitions[n].idx, key) == value) {
+            found.push_back(n);
+        }
+    }
+    return found;
+}
+
+size_t StreamIndex::find_scan_counter(uint32_t scan_counter) const {
+    for (size_t n = 0; n < _acquisitions.size(); n++) {
+        if (_acquisitions[n].scan_counter == scan_counter) {
+            return n;
+        }
+    }
+    return _acquisitions.size();
+}
+
+std::vector<size_t> StreamIndex::find_messages(uint16_t id) const {
+    std::vector<size_t> found;
+    for (size_t n = 0; n < _messages.size(); n++) {
+        if (uncompressed_id(_messages[n].id) == id) {
+            found.push_back(n);
+        }
+    }
+    return found;
+}
+
+IndexedStreamReader::IndexedStreamReader(const std::string &stream_path)
+    : _index(_own_index), _file(stream_path.c_str(), std::ios::in | std::ios::binary), _view(_file),
+      _deserializer(NULL) {
+    if (!_file) {
+        throw std::runtime_error("Cannot open stream file " + stream_path);
+    }
+    _own_index.open(stream_path);
+}
+
+IndexedStreamReader::IndexedStreamReader(const std::string &stream_path, const StreamIndex &index)
+    : _index(index), _file(stream_path.c_str(), std::ios::in | std::ios::binary), _view(_file), _deserializer(NULL) {
+    if (!_file) {
+        throw std::runtime_error("Cannot open stream file " + stream_path);
+    }
+}
+
+IndexedStreamReader::~IndexedStreamReader() {
+    delete _deserializer;
+}
+
+const StreamIndex &IndexedStreamReader::index() const {
+    return _index;
+}
+
+void IndexedStreamReader::seek(uint64_t offset) {
+    _file.clear();
+    _file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    if (!_file) {
+        throw std::runtime_error("Error seeking in the stream file");
+    }
+}
+
+ProtocolDeserializer &IndexedStreamReader::message(size_t n) {
+    if (n >= _index.messages().size()) {
+        throw std::runtime_error("Message number out of the index");
+    }
+    seek(_index.messages()[n].offset);
+    // A new deserializer, which has not peeked at another position
+    delete _deserializer;
+    _deserializer = NULL;
+    _deserializer = new ProtocolDeserializer(_view);
+    return *_deserializer;
+}
+
+void IndexedStreamReader::read_acquisition(size_t n, Acquisition &acq) {
+    if (n >= _index.acquisitions().size()) {
+        throw std::runtime_error("Acquisition number out of the index");
+    }
+    const StreamIndexAcquisition &entry = _index.acquisitions()[n];
+    if (entry.data_offset == 0) {
+        // Compressed, the codec needs the whole message
+        message(static_cast<size_t>(entry.message)).deserialize(acq);
+        return;
+    }
+    AcquisitionHeader head;
+    seek(entry.header_offset);
+    _view.read(reinterpret_cast<char *>(&head), sizeof(AcquisitionHeader));
+    acq.setHead(head);
+    if (entry.data_offset != entry.header_offset + sizeof(AcquisitionHeader)) {
+        seek(entry.data_offset);
+    }
+    _view.read(reinterpret_cast<char *>(acq.getTrajPtr()), acq.getTrajSize());
+    _view.read(reinterpret_cast<char *>(acq.getDataPtr()), acq.getDataSize());
+    if (_view.eof()) {
+        throw std::runtime_error("Error reading acquisition");
+    }
+}
+
+} // namespace ISMRMRD
@@ -0,0 +1,234 @@
+#ifdef _WIN32
+// Keeps the min and max macros from breaking std::min and std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "ismrmrd/serialization.h"
+#include "ismrmrd/stream_statistics.h"
+
+namespace ISMRMRD {
+
+const char *message_name(uint16_t id) {
+    switch (id) {
+    case ISMRMRD_MESSAGE_CONFIG_FILE: return "config file";
+    case ISMRMRD_MESSAGE_CONFIG_TEXT: return "config text";
+    case ISMRMRD_MESSAGE_HEADER: return "header";
+    case ISMRMRD_MESSAGE_CLOSE: return "close";
+    case ISMRMRD_MESSAGE_TEXT: return "text";
+    case ISMRMRD_MESSAGE_ACQUISITION: return "acquisition";
+    case ISMRMRD_MESSAGE_IMAGE: return "image";
+    case ISMRMRD_MESSAGE_WAVEFORM: return "waveform";
+    case ISMRMRD_MESSAGE_NDARRAY: return "ndarray";
+    case ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION: return "compressed acquisition";
+    case ISMRMRD_MESSAGE_COMPRESSED_IMAGE: return "compressed image";
+    case ISMRMRD_MESSAGE_ACQUISITION_BATCH: return "acquisition batch";
+    default: return "unknown";
+    }
+}
+
+MessageStatistics::MessageStatistics() : count(0), bytes(0), io_seconds(0), codec_seconds(0) {}
+
+const std::map<uint16_t, MessageStatistics> &StreamStatistics::messages() const {
+    return _messages;
+}
+
+MessageStatistics StreamStatistics::message(uint16_t id) const {
+    std::map<uint16_t, MessageStatistics>::const_iterator it = _messages.find(id);
+    return it == _messages.end() ? MessageStatistics() : it->second;
+}
+
+MessageStatistics StreamStatistics::total() const {
+    MessageStatistics sum;
+    for (std::map<uint16_t, MessageStatistics>::const_iterator it = _messages.begin(); it != _messages.end(); ++it) {
+        sum.count += it->second.count;
+        sum.bytes += it->second.bytes;
+        sum.io_seconds += it->second.io_seconds;
+        sum.codec_seconds += it->second.codec_seconds;
+    }
+    return sum;
+}
+
+void StreamStatistics::reset() {
+    _messages.clear();
+}
+
+static void print_line(std::ostream &os, const char *name, const MessageStatistics &stats) {
+    double seconds = stats.io_seconds + stats.codec_seconds;
+    os << std::left << std::setw(24) << name << std::right << std::setw(10) << stats.count << std::setw(14)
+       << stats.bytes << std::setw(12) << stats.io_seconds << std::setw(12) << stats.codec_seconds << std::setw(12)
+       << (seconds > 0 ? stats.bytes / seconds / 1e6 : 0.0) << std::endl;
+}
+
+void StreamStatistics::print(std::ostream &os) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << std::left << std::setw(24) << "message" << std::right << std::setw(10) << "count" << std::setw(14)
+       << "bytes" << std::setw(12) << "I/O (s)" << std::setw(12) << "codec (s)" << std::setw(12) << "MB/s"
+       << std::endl;
+    for (std::map<uint16_t, MessageStatistics>::const_iterator it = _messages.begin(); it != _messages.end(); ++it) {
+        print_line(os, message_name(it->first), it->second);
+    }
+    print_line(os, "total", total());
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void StreamStatistics::record(uint16_t id, uint64_t bytes, double io_seconds, double seconds) {
+    MessageStatistics &stats = _messages[id];
+    stats.count++;
+    stats.bytes += bytes;
+    stats.io_seconds += io_seconds;
+    stats.codec_seconds += seconds > io_seconds ? seconds - io_seconds : 0;
+}
+
+double StreamStatistics::now() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return static_cast<double>(counter.QuadPart) / static_cast<double>(frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+void LatencyStatistics::received(uint64_t key, double time) {
+    _received[key] = time;
+}
+
+double LatencyStatistics::sent(uint64_t key, double time) {
+    std::map<uint64_t, double>::iterator it = _received.find(key);
+    if (it == _received.end()) {
+        return -1;
+    }
+    double latency = time - it->second;
+    _received.erase(it);
+    _latencies.push_back(latency);
+    return latency;
+}
+
+const std::vector<double> &LatencyStatistics::latencies() const {
+    return _latencies;
+}
+
+double LatencyStatistics::percentile(double p) const {
+    if (_latencies.empty()) {
+        return 0;
+    }
+    std::vector<double> sorted(_latencies);
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+void LatencyStatistics::reset() {
+    _received.clear();
+    _latencies.clear();
+}
+
+void LatencyStatistics::print(std::ostream &os) const {
+    double sum = 0;
+    for (size_t i = 0; i < _latencies.size(); i++) {
+        sum += _latencies[i];
+    }
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "latency (ms): count " << _latencies.size() << " mean "
+       << (_latencies.empty() ? 0.0 : sum / _latencies.size() * 1e3) << " p50 " << percentile(0.5) * 1e3 << " p95 "
+       << percentile(0.95) * 1e3 << " p99 " << percentile(0.99) * 1e3 << " max " << percentile(1) * 1e3
+       << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+TimedReadableStreamView::TimedReadableStreamView(ReadableStreamView &rs)
+    : timed(false), bytes(0), seconds(0), _rs(rs) {}
+
+void TimedReadableStreamView::read(char *buffer, size_t count) {
+    if (!timed) {
+        _rs.read(buffer, count);
+        return;
+    }
+    double start = StreamStatistics::now();
+    _rs.read(buffer, count);
+    seconds += StreamStatistics::now() - start;
+    bytes += count;
+}
+
+bool TimedReadableStreamView::eof() {
+    return _rs.eof();
+}
+
+void TimedReadableStreamView::skip(size_t count) {
+    if (!timed) {
+        _rs.skip(count);
+        return;
+    }
+    double start = StreamStatistics::now();
+    _rs.skip(count);
+    seconds += StreamStatistics::now() - start;
+    bytes += count;
+}
+
+const char *TimedReadableStreamView::read_in_place(size_t count) {
+    if (!timed) {
+        return _rs.read_in_place(count);
+    }
+    double start = StreamStatistics::now();
+    const char *data = _rs.read_in_place(count);
+    seconds += StreamStatistics::now() - start;
+    if (data) {
+        bytes += count;
+    }
+    return data;
+}
+
+TimedWritableStreamView::TimedWritableStreamView(WritableStreamView &ws)
+    : timed(false), bytes(0), seconds(0), _ws(ws) {}
+
+void TimedWritableStreamView::write(const char *buffer, size_t count) {
+    if (!timed) {
+        _ws.write(buffer, count);
+        return;
+    }
+    double start = StreamStatistics::now();
+    _ws.write(buffer, count);
+    seconds += StreamStatistics::now() - start;
+    bytes += count;
+}
+
+void TimedWritableStreamView::writev(const StreamBuffer *buffers, size_t count) {
+    if (!timed) {
+        _ws.writev(buffers, count);
+        return;
+    }
+    double start = StreamStatistics::now();
+    _ws.writev(buffers, count);
+    seconds += StreamStatistics::now() - start;
+    for (size_t i = 0; i < count; i++) {
+        bytes += buffers[i].size;
+    }
+}
+
+bool TimedWritableStreamView::bad() {
+    return _ws.bad();
+}
+
+void TimedWritableStreamView::flush() {
+    _ws.flush();
+}
+
+} // namespace ISMRMRD
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <ismrmrd/dataset.h>
+#include <ismrmrd/serialization.h>
+
+using namespace ISMRMRD;
+
+// Compression ratio and throughput of the compressed acquisition messages on a
+// dataset, by default the output of ismrmrd_generate_cartesian_shepp_logan. For
+// the quantized codec the largest error is reported in the units of the data.
+
+// Keeps the serialized stream in memory, so that only serialization is timed
+class MemoryWriteStream : public WritableStreamView {
+public:
+    void write(const char *buffer, size_t count) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    bool bad() {
+        return false;
+    }
+    std::vector<char> data;
+};
+
+class MemoryReadStream : public ReadableStreamView {
+public:
+    MemoryReadStream(const std::vector<char> &data) : _data(data), _pos(0), _eof(false) {}
+    void read(char *buffer, size_t count) {
+        if (_pos + count > _data.size()) {
+            _eof = true;
+            count = _data.size() - _pos;
+        }
+        memcpy(buffer, &_data[_pos], count);
+        _pos += count;
+    }
+    bool eof() {
+        return _eof;
+    }
+
+private:
+    const std::vector<char> &_data;
+    size_t _pos;
+    bool _eof;
+};
+
+struct Setting {
+    const char *name;
+    uint16_t codec;
+    int level;
+    int tolerance_mode;
+    float tolerance;
+};
+
+static const Setting settings[] = {
+    {"none                 ", ISMRMRD_COMPRESSION_NONE, 0, 0, 0},
+    {"deflate, level 1     ", ISMRMRD_COMPRESSION_DEFLATE, 1, 0, 0},
+    {"deflate, level 6     ", ISMRMRD_COMPRESSION_DEFLATE, 6, 0, 0},
+    {"shuffle+deflate, 1   ", ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, 1, 0, 0},
+    {"shuffle+deflate, 6   ", ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, 6, 0, 0},
+    {"shuffle+deflate, 9   ", ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, 9, 0, 0},
+    {"quantized, 0.1 noise ", ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, 1, ISMRMRD_TOLERANCE_NOISE, 0.1f},
+    {"quantized, 0.5 noise ", ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, 1, ISMRMRD_TOLERANCE_NOISE, 0.5f},
+    {"quantized, 1 noise   ", ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, 1, ISMRMRD_TOLERANCE_NOISE, 1.0f},
+    {"quantized, 1e-3      ", ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, 1, ISMRMRD_TOLERANCE_ABSOLUTE, 1e-3f},
+    {"quantized, 1e-2      ", ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, 1, ISMRMRD_TOLERANCE_ABSOLUTE, 1e-2f},
+};
+
+static float max_error(const Acquisition &a, const Acquisition &b) {
+    const float *x = reinterpret_cast<const float *>(a.getDataPtr());
+    const float *y = reinterpret_cast<const float *>(b.getDataPtr());
+    float error = 0;
+    for (size_t i = 0; i < 2 * a.getNumberOfDataElements(); i++) {
+        error = std::max(error, std::fabs(x[i] - y[i]));
+    }
+    return error;
+}
+
+int main(int argc, char **argv) {
+    const char *file = argc > 1 ? argv[1] : "testdata.h5";
+    const char *group = argc > 2 ? argv[2] : "dataset";
+
+    std::vector<Acquisition> acqs;
+    {
+        Dataset dataset(file, group, DATASET_READ_ONLY);
+        uint32_t count = dataset.getNumberOfAcquisitions();
+        acqs.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            dataset.readAcquisition(i, acqs[i]);
+        }
+    }
+    double raw = 0;
+    for (const auto &acq : acqs) {
+        raw += sizeof(AcquisitionHeader) + acq.getDataSize() + acq.getTrajSize();
+    }
+    std::cout << acqs.size() << " acquisitions, " << raw / 1e6 << " MB" << std::endl;
+    std::cout << "  codec                   ratio   compress       decompress     max error" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const auto &setting : settings) {
+        if (!compression_supported(setting.codec)) {
+            std::cout << "  " << setting.name << "   not supported by this build" << std::endl;
+            continue;
+        }
+        MemoryWriteStream ws;
+        ws.data.reserve(size_t(raw) + 1024);
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            ProtocolSerializer serializer(ws);
+            if (setting.codec != ISMRMRD_COMPRESSION_NONE) {
+                serializer.set_compression(setting.codec, setting.level);
+                serializer.set_quantization(QuantizationSettings(setting.tolerance_mode, setting.tolerance));
+            }
+            for (const auto &acq : acqs) {
+                serializer.serialize(acq);
+            }
+            serializer.close();
+        }
+        double write_duration = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        MemoryReadStream rs(ws.data);
+        ProtocolDeserializer deserializer(rs);
+        Acquisition acq;
+        size_t count = 0;
+        while (deserializer.peek() == ISMRMRD_MESSAGE_ACQUISITION) {
+            deserializer.deserialize(acq);
+            count++;
+        }
+        double read_duration = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        if (count != acqs.size()) {
+            throw std::runtime_error("Unexpected number of acquisitions");
+        }
+
+        // Decoded again outside of the timing
+        MemoryReadStream check_rs(ws.data);
+        ProtocolDeserializer check(check_rs);
+        float error = 0;
+        for (const auto &original : acqs) {
+            check.deserialize(acq);
+            error = std::max(error, max_error(original, acq));
+        }
+
+        std::cout << "  " << setting.name << "   " << std::setw(5) << raw / ws.data.size() << "   " << std::setw(7)
+                  << raw / 1e6 / write_duration << " MB/s   " << std::setw(8) << raw / 1e6 / read_duration << " MB/s   "
+                  << std::scientific << std::setprecision(2) << error << std::fixed << std::endl;
+    }
+    return 0;
+}
@@ -14,6 +14,51 @@ float create_random_float() {
     return dist(rng);
 }
 
+// Opens every file, reads the acquisition count and returns the mean time per file in microseconds
+template <typename OpenMode>
+double time_open(const std::vector<std::string> &files, OpenMode mode) {
+    auto start = std::chrono::high_resolution_clock::now();
+    uint32_t total = 0;
+    for (const auto &file : files) {
+        Dataset dataset(file.c_str(), "/test", mode);
+        total += dataset.getNumberOfAcquisitions();
+    }
+    auto duration = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start);
+    if (total != files.size() * 8) {
+        throw std::runtime_error("Unexpected number of acquisitions");
+    }
+    return duration.count() / files.size();
+}
+
+void benchmark_open_latency() {
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directory(dir);
+
+    std::vector<std::string> files;
+    Acquisition acq = Acquisition(256, 8, 0);
+    for (int i = 0; i < 500; i++) {
+        files.push_back((dir / ("file" + std::to_string(i) + ".h5")).string());
+        Dataset dataset = Dataset(files.back().c_str(), "/test", true);
+        dataset.writeHeader("<ismrmrdHeader></ismrmrdHeader>");
+        for (int j = 0; j < 8; j++)
+            dataset.appendAcquisition(acq);
+    }
+    // Archived files are read-only, so the default open pays for a failed read-write attempt
+    for (const auto &file : files)
+        boost::filesystem::permissions(file, boost::filesystem::owner_read | boost::filesystem::group_read |
+                                                 boost::filesystem::others_read);
+
+    // Warm the page cache so that only the open path is compared
+    time_open(files, DATASET_READ_ONLY);
+
+    std::cout << "Open latency over " << files.size() << " files:" << std::endl;
+    std::cout << "  default open:           " << time_open(files, false) << "us" << std::endl;
+    std::cout << "  read-only:              " << time_open(files, DATASET_READ_ONLY) << "us" << std::endl;
+    std::cout << "  read-only, no locking:  " << time_open(files, DATASET_READ_ONLY_NO_FILE_LOCKING) << "us" << std::endl;
+
+    boost::filesystem::remove_all(dir);
+}
+
 int main(int argc, char **argv) {
 
     boost::filesystem::path temp = boost::filesystem::unique_path();
@@ -49,4 +94,6 @@ int main(int argc, char **argv) {
     }
 
     boost::filesystem::remove(temp);
+
+    benchmark_open_latency();
 }
\ No newline at end of file
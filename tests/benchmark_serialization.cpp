@@ -0,0 +1,609 @@
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <ismrmrd/serialization_fd.h>
+#include <ismrmrd/serialization_iostream.h>
+#include <ismrmrd/serialization_mmap.h>
+#include <ismrmrd/serialization_shm.h>
+#include <ismrmrd/serialization_socket.h>
+#include <ismrmrd/version.h>
+#include <ismrmrd/xml.h>
+#include <thread>
+#include <unistd.h>
+
+#include "embedded_xml.h"
+
+using namespace ISMRMRD;
+
+// Usage: benchmark_serialization [--json] [--quick]
+//
+// Round-trips every message type through memory, file, pipe and socket stream
+// views, then measures the acquisition transports in more detail. Each result
+// is printed as a line, or with --json as one JSON document on stdout to be
+// compared between releases. --quick sends a tenth of the messages.
+
+// One measurement
+struct Result {
+    std::string transport;
+    std::string message;
+    std::string operation;
+    size_t messages;
+    double bytes;
+    double seconds;
+};
+
+static std::vector<Result> results;
+static bool json = false;
+static bool quick = false;
+
+static size_t scaled(size_t count) {
+    return quick ? std::max<size_t>(count / 10, 1) : count;
+}
+
+static void report(const std::string &transport, const std::string &message, const std::string &operation,
+                   size_t messages, double bytes, double duration) {
+    Result r = {transport, message, operation, messages, bytes, duration};
+    results.push_back(r);
+    if (!json) {
+        std::printf("%-10s %-28s %-26s %12.0f msg/s %10.1f MB/s\n", transport.c_str(), message.c_str(),
+                    operation.c_str(), messages / duration, bytes / duration / 1e6);
+        std::fflush(stdout);
+    }
+}
+
+static std::string quoted(const std::string &str) {
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+static void print_json() {
+    std::printf("{\n  \"benchmark\": \"serialization\",\n  \"version\": \"%d.%d.%d\",\n  \"git_sha1\": %s,\n",
+                ISMRMRD_VERSION_MAJOR, ISMRMRD_VERSION_MINOR, ISMRMRD_VERSION_PATCH,
+                quoted(ISMRMRD_GIT_SHA1_HASH).c_str());
+    std::printf("  \"quick\": %s,\n  \"results\": [\n", quick ? "true" : "false");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        std::printf("    {\"transport\": %s, \"message\": %s, \"operation\": %s, \"messages\": %zu, \"bytes\": %.0f, "
+                    "\"seconds\": %.6f, \"messages_per_second\": %.1f, \"megabytes_per_second\": %.3f}%s\n",
+                    quoted(r.transport).c_str(), quoted(r.message).c_str(), quoted(r.operation).c_str(), r.messages,
+                    r.bytes, r.seconds, r.messages / r.seconds, r.bytes / r.seconds / 1e6,
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+template <typename F>
+static double seconds(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static std::string temp_path() {
+    return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+}
+
+// In-memory views, so that only the serializers are measured
+class StringWriteView : public WritableStreamView {
+public:
+    explicit StringWriteView(std::string &data) : _data(data) {}
+    void write(const char *buffer, size_t count) {
+        _data.append(buffer, count);
+    }
+    bool bad() {
+        return false;
+    }
+
+private:
+    std::string &_data;
+};
+
+class StringReadView : public ReadableStreamView {
+public:
+    explicit StringReadView(const std::string &data) : _data(data), _pos(0), _eof(false) {}
+    void read(char *buffer, size_t count) {
+        if (count > _data.size() - _pos) {
+            _eof = true;
+            count = _data.size() - _pos;
+        }
+        std::memcpy(buffer, _data.data() + _pos, count);
+        _pos += count;
+    }
+    bool eof() {
+        return _eof;
+    }
+
+private:
+    const std::string &_data;
+    size_t _pos;
+    bool _eof;
+};
+
+template <typename T>
+static void write_messages(WritableStreamView &ws, const std::vector<T> &msgs) {
+    ProtocolSerializer serializer(ws);
+    for (const auto &msg : msgs) {
+        serializer.serialize(msg);
+    }
+    serializer.close();
+}
+
+// A new message per read, as a consumer that hands them on has to do
+template <typename T>
+static size_t read_messages(ReadableStreamView &rs) {
+    ProtocolDeserializer deserializer(rs);
+    size_t count = 0;
+    while (deserializer.peek() != ISMRMRD_MESSAGE_CLOSE) {
+        T msg;
+        deserializer.deserialize(msg);
+        count++;
+    }
+    return count;
+}
+
+static void check_count(size_t count, size_t expected) {
+    if (count != expected) {
+        throw std::runtime_error("Unexpected number of messages");
+    }
+}
+
+// Writes and reads msgs in memory and in a file, and sends them through a pipe
+// and a TCP loopback connection from a writer thread
+template <typename T>
+static void benchmark_messages(const std::string &message, const std::vector<T> &msgs) {
+    std::string data;
+    double duration = seconds([&]() {
+        StringWriteView ws(data);
+        write_messages(ws, msgs);
+    });
+    const double bytes = double(data.size());
+    report("memory", message, "write", msgs.size(), bytes, duration);
+    size_t count = 0;
+    duration = seconds([&]() {
+        StringReadView rs(data);
+        count = read_messages<T>(rs);
+    });
+    check_count(count, msgs.size());
+    report("memory", message, "read", msgs.size(), bytes, duration);
+    data = std::string();
+
+    std::string file = temp_path();
+    report("file", message, "write", msgs.size(), bytes, seconds([&]() {
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        {
+            FdWriteStream ws(fd);
+            write_messages(ws, msgs);
+        }
+        close(fd);
+    }));
+    duration = seconds([&]() {
+        int fd = open(file.c_str(), O_RDONLY);
+        {
+            FdReadStream rs(fd);
+            count = read_messages<T>(rs);
+        }
+        close(fd);
+    });
+    check_count(count, msgs.size());
+    report("file", message, "read", msgs.size(), bytes, duration);
+    boost::filesystem::remove(file);
+
+    duration = seconds([&]() {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::runtime_error("Failed to create pipe");
+        }
+        std::thread writer([&]() {
+            {
+                FdWriteStream ws(fds[1]);
+                write_messages(ws, msgs);
+            }
+            close(fds[1]);
+        });
+        {
+            FdReadStream rs(fds[0]);
+            count = read_messages<T>(rs);
+        }
+        close(fds[0]);
+        writer.join();
+    });
+    check_count(count, msgs.size());
+    report("pipe", message, "transfer", msgs.size(), bytes, duration);
+
+    SocketOptions options;
+    options.flush_messages = false;
+    int listener = listen_tcp("127.0.0.1", 0);
+    duration = seconds([&]() {
+        std::thread writer([&]() {
+            int fd = connect_tcp("127.0.0.1", socket_port(listener));
+            {
+                SocketWriteStream ws(fd, options);
+                write_messages(ws, msgs);
+            }
+            close(fd);
+        });
+        int fd = accept_connection(listener);
+        {
+            SocketReadStream rs(fd, options);
+            count = read_messages<T>(rs);
+        }
+        close(fd);
+        writer.join();
+    });
+    close(listener);
+    check_count(count, msgs.size());
+    report("tcp", message, "transfer", msgs.size(), bytes, duration);
+}
+
+static void benchmark_acquisitions(uint16_t samples, uint16_t channels, uint16_t trajectory_dimensions,
+                                   size_t count) {
+    std::vector<Acquisition> acqs(scaled(count), Acquisition(samples, channels, trajectory_dimensions));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(i);
+        std::fill(acqs[i].data_begin(), acqs[i].data_end(), std::complex<float>(float(i % 256), 1));
+    }
+    std::string name = "acquisition " + std::to_string(samples) + "x" + std::to_string(channels);
+    if (trajectory_dimensions) {
+        name += " traj " + std::to_string(trajectory_dimensions);
+    }
+    benchmark_messages(name, acqs);
+}
+
+template <typename T>
+static void benchmark_images(const std::string &type, size_t count) {
+    Image<T> img(256, 256, 1, 1);
+    img.setAttributeString("<ismrmrdMeta><meta><name>benchmark</name><value>1</value></meta></ismrmrdMeta>");
+    std::fill(img.begin(), img.end(), T(1));
+    benchmark_messages("image " + type + " 256x256", std::vector<Image<T> >(scaled(count), img));
+}
+
+static void benchmark_message_types() {
+    benchmark_acquisitions(128, 2, 0, 200000);
+    benchmark_acquisitions(256, 32, 0, 20000);
+    benchmark_acquisitions(512, 8, 2, 20000);
+    benchmark_acquisitions(4096, 1, 3, 20000);
+
+    benchmark_images<unsigned short>("ushort", 1000);
+    benchmark_images<short>("short", 1000);
+    benchmark_images<unsigned int>("uint", 500);
+    benchmark_images<int>("int", 500);
+    benchmark_images<float>("float", 500);
+    benchmark_images<double>("double", 250);
+    benchmark_images<std::complex<float> >("cxfloat", 250);
+    benchmark_images<std::complex<double> >("cxdouble", 125);
+
+    Waveform wfm(256, 4);
+    std::fill(wfm.begin_data(), wfm.end_data(), 7u);
+    benchmark_messages("waveform 256x4", std::vector<Waveform>(scaled(50000), wfm));
+
+    std::vector<size_t> dims = {64, 64, 16};
+    NDArray<float> arr(dims);
+    std::fill(arr.begin(), arr.end(), 1.0f);
+    benchmark_messages("ndarray float 64x64x16", std::vector<NDArray<float> >(scaled(500), arr));
+
+    IsmrmrdHeader hdr;
+    deserialize(extended_xml.c_str(), hdr);
+    benchmark_messages("header", std::vector<IsmrmrdHeader>(scaled(5000), hdr));
+}
+
+// Small acquisitions are dominated by the per-field overhead, large ones by the payload copies
+struct Workload {
+    const char *message;
+    uint16_t samples;
+    uint16_t channels;
+    size_t count;
+};
+
+static const Workload workloads[] = {
+    {"acquisition 128x2", 128, 2, 200000},
+    {"acquisition 256x32", 256, 32, 20000},
+};
+
+static std::vector<Acquisition> make_acquisitions(const Workload &w) {
+    std::vector<Acquisition> acqs(scaled(w.count), Acquisition(w.samples, w.channels, 0));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(i);
+    }
+    return acqs;
+}
+
+static double bytes(const Workload &w) {
+    return double(scaled(w.count)) * (sizeof(AcquisitionHeader) + 2 + w.samples * w.channels * 2 * sizeof(float));
+}
+
+static void write_stream(WritableStreamView &ws, const std::vector<Acquisition> &acqs) {
+    ProtocolSerializer serializer(ws);
+    for (const auto &acq : acqs) {
+        serializer.serialize(acq);
+    }
+    serializer.close();
+}
+
+// Acquisitions in batch messages of batch_size
+static void write_stream_batched(WritableStreamView &ws, const std::vector<Acquisition> &acqs, size_t batch_size) {
+    ProtocolSerializer serializer(ws);
+    std::vector<Acquisition> batch;
+    for (size_t i = 0; i < acqs.size(); i += batch_size) {
+        batch.assign(acqs.begin() + i, acqs.begin() + std::min(acqs.size(), i + batch_size));
+        serializer.serialize(batch);
+    }
+    serializer.close();
+}
+
+static size_t read_stream_batched(ReadableStreamView &rs) {
+    ProtocolDeserializer deserializer(rs);
+    std::vector<Acquisition> batch;
+    size_t count = 0;
+    while (deserializer.peek() == ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+        deserializer.deserialize(batch);
+        count += batch.size();
+    }
+    return count;
+}
+
+// A new acquisition per message, as a consumer that hands them on has to do without a pool
+static size_t read_stream(ReadableStreamView &rs) {
+    ProtocolDeserializer deserializer(rs);
+    size_t count = 0;
+    while (deserializer.peek() == ISMRMRD_MESSAGE_ACQUISITION) {
+        Acquisition acq;
+        deserializer.deserialize(acq);
+        count++;
+    }
+    return count;
+}
+
+// Same as read_stream, but recycling the acquisitions through a pool
+static size_t read_stream_pooled(ReadableStreamView &rs) {
+    MessagePool pool;
+    ProtocolDeserializer deserializer(rs, pool);
+    Pooled<Acquisition> acq;
+    size_t count = 0;
+    while (deserializer.peek() == ISMRMRD_MESSAGE_ACQUISITION) {
+        deserializer.deserialize(acq);
+        count++;
+    }
+    return count;
+}
+
+static void report(const char *transport, const char *operation, const Workload &w, double duration) {
+    report(transport, w.message, operation, scaled(w.count), bytes(w), duration);
+}
+
+static void benchmark_file(const Workload &w) {
+    std::string file = temp_path();
+    std::vector<Acquisition> acqs = make_acquisitions(w);
+    size_t count = 0;
+
+    report("file", "write, iostream view", w, seconds([&]() {
+        std::ofstream os(file.c_str(), std::ios::out | std::ios::binary);
+        OStreamView ws(os);
+        write_stream(ws, acqs);
+    }));
+    report("file", "write, fd stream", w, seconds([&]() {
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        {
+            FdWriteStream ws(fd);
+            write_stream(ws, acqs);
+        }
+        close(fd);
+    }));
+    report("file", "read, iostream view", w, seconds([&]() {
+        std::ifstream is(file.c_str(), std::ios::in | std::ios::binary);
+        IStreamView rs(is);
+        count += read_stream(rs);
+    }));
+    report("file", "read, fd stream", w, seconds([&]() {
+        int fd = open(file.c_str(), O_RDONLY);
+        {
+            FdReadStream rs(fd);
+            count += read_stream(rs);
+        }
+        close(fd);
+    }));
+    report("file", "read, fd, pooled", w, seconds([&]() {
+        int fd = open(file.c_str(), O_RDONLY);
+        {
+            FdReadStream rs(fd);
+            count += read_stream_pooled(rs);
+        }
+        close(fd);
+    }));
+    // In place where the data is aligned in the file
+    report("file", "read, mmap, views", w, seconds([&]() {
+        MmapReadStream rs(file);
+        ProtocolDeserializer deserializer(rs);
+        AcquisitionView view;
+        while (deserializer.peek() == ISMRMRD_MESSAGE_ACQUISITION) {
+            deserializer.deserialize(view);
+            count++;
+        }
+    }));
+    // Batches of 64. Only reading is timed, writing copies the acquisitions into the batches
+    {
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        {
+            FdWriteStream ws(fd);
+            write_stream_batched(ws, acqs, 64);
+        }
+        close(fd);
+    }
+    report("file", "read, fd, batches of 64", w, seconds([&]() {
+        int fd = open(file.c_str(), O_RDONLY);
+        {
+            FdReadStream rs(fd);
+            count += read_stream_batched(rs);
+        }
+        close(fd);
+    }));
+    if (count != 5 * acqs.size()) {
+        throw std::runtime_error("Unexpected number of acquisitions");
+    }
+    boost::filesystem::remove(file);
+}
+
+// Reads from a child process writing to its stdout, the way the stream utilities are chained
+static void benchmark_pipe(const char *self, const Workload &w, size_t workload) {
+    const char *views[] = {"iostream", "fd"};
+    for (const char *view : views) {
+        std::string command = std::string(self) + " --write-stdout " + view + " " + std::to_string(workload) +
+                              (quick ? " --quick" : "");
+        FILE *child = popen(command.c_str(), "r");
+        if (child == NULL) {
+            throw std::runtime_error("Failed to start writer process");
+        }
+        size_t count = 0;
+        double duration = 0;
+        if (strcmp(view, "fd") == 0) {
+            FdReadStream rs(fileno(child));
+            duration = seconds([&]() { count = read_stream(rs); });
+        } else {
+            // Read through std::cin as the utilities do
+            int saved = dup(0);
+            dup2(fileno(child), 0);
+            IStreamView rs(std::cin);
+            duration = seconds([&]() { count = read_stream(rs); });
+            dup2(saved, 0);
+            close(saved);
+            std::cin.clear();
+        }
+        pclose(child);
+        check_count(count, scaled(w.count));
+        report("process", strcmp(view, "fd") == 0 ? "read stdin, fd stream" : "read stdin, iostream view", w,
+               duration);
+    }
+}
+
+// Same as the pipe, through a shared memory ring, read as a stream and in place
+static void benchmark_shm(const char *self, const Workload &w, size_t workload) {
+    for (bool in_place : {false, true}) {
+        std::string name = "/ismrmrd_benchmark_" + std::to_string(getpid());
+        ShmRing ring(name, 1024 * 1024, 16);
+        std::string command = std::string(self) + " --write-shm " + name + " " + std::to_string(workload) +
+                              (quick ? " --quick" : "");
+        FILE *child = popen(command.c_str(), "r");
+        if (child == NULL) {
+            throw std::runtime_error("Failed to start writer process");
+        }
+        ShmRingReader rs(ring);
+        size_t count = 0;
+        double duration = seconds([&]() {
+            if (!in_place) {
+                count = read_stream_pooled(rs);
+                return;
+            }
+            ShmSlotView slot;
+            AcquisitionView acq;
+            while (rs.acquire(slot)) {
+                count += view_acquisition(slot, acq) ? 1 : 0;
+                rs.release();
+            }
+        });
+        pclose(child);
+        check_count(count, scaled(w.count));
+        report("shm", in_place ? "read, slot views" : "read, stream view, pooled", w, duration);
+    }
+}
+
+// Loopback transfer between two threads, with each message sent as it is serialized
+// (as a scanner client streams) and with messages batched into the stream buffer
+static void benchmark_socket(const Workload &w) {
+    std::vector<Acquisition> acqs = make_acquisitions(w);
+    std::string path = temp_path();
+    const char *transports[] = {"tcp", "unix"};
+    for (const char *transport : transports) {
+        for (bool flush_messages : {true, false}) {
+            bool tcp = strcmp(transport, "tcp") == 0;
+            int listener = tcp ? listen_tcp("127.0.0.1", 0) : listen_unix(path);
+            SocketOptions options;
+            options.flush_messages = flush_messages;
+            options.send_buffer_size = 4 * 1024 * 1024;
+            options.receive_buffer_size = 4 * 1024 * 1024;
+
+            size_t count = 0;
+            double duration = seconds([&]() {
+                std::thread writer([&]() {
+                    int fd = tcp ? connect_tcp("127.0.0.1", socket_port(listener)) : connect_unix(path);
+                    {
+                        SocketWriteStream ws(fd, options);
+                        write_stream(ws, acqs);
+                    }
+                    close(fd);
+                });
+                int fd = accept_connection(listener);
+                {
+                    SocketReadStream rs(fd, options);
+                    count = read_stream_pooled(rs);
+                }
+                close(fd);
+                writer.join();
+            });
+            close(listener);
+            check_count(count, acqs.size());
+            report(transport, flush_messages ? "transfer, per message" : "transfer, buffered", w, duration);
+        }
+    }
+    boost::filesystem::remove(path);
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    // Writer side of the pipe benchmark
+    if (args.size() == 3 && args[0] == "--write-stdout") {
+        std::vector<Acquisition> acqs = make_acquisitions(workloads[std::stoul(args[2])]);
+        if (args[1] == "fd") {
+            FdWriteStream ws(1);
+            write_stream(ws, acqs);
+        } else {
+            OStreamView ws(std::cout);
+            write_stream(ws, acqs);
+        }
+        return 0;
+    }
+    // Writer side of the shared memory benchmark
+    if (args.size() == 3 && args[0] == "--write-shm") {
+        std::vector<Acquisition> acqs = make_acquisitions(workloads[std::stoul(args[2])]);
+        ShmRing ring(args[1]);
+        ShmRingWriter ws(ring);
+        write_stream(ws, acqs);
+        return 0;
+    }
+    if (!args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--json] [--quick]" << std::endl;
+        return 1;
+    }
+
+    benchmark_message_types();
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        benchmark_file(workloads[i]);
+        benchmark_pipe(argv[0], workloads[i], i);
+        benchmark_shm(argv[0], workloads[i], i);
+        benchmark_socket(workloads[i]);
+    }
+    if (json) {
+        print_json();
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "ismrmrd/dataset.h"
+#include "ismrmrd/dataset_rollover.h"
 #include "ismrmrd/ismrmrd.h"
 #include "ismrmrd/version.h"
 #include <boost/filesystem.hpp>
@@ -53,4 +54,528 @@ BOOST_AUTO_TEST_CASE(test_read_write) {
     boost::filesystem::remove(temp);
 }
 
+BOOST_AUTO_TEST_CASE(test_read_waveforms) {
+
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+
+    std::vector<Waveform> wavs;
+    for (uint16_t i = 0; i < 5; i++) {
+        Waveform wav(uint16_t(16 + i), 2);
+        wav.head.time_stamp = i;
+        for (uint32_t *p = wav.begin_data(); p != wav.end_data(); p++) {
+            *p = uint32_t(p - wav.begin_data()) + i;
+        }
+        wavs.push_back(wav);
+    }
+
+    {
+        Dataset dataset = Dataset(temp.string().c_str(), "/test", true);
+        for (size_t i = 0; i < wavs.size(); i++)
+            dataset.appendWaveform(wavs[i]);
+    }
+
+    {
+        Dataset dataset = Dataset(temp.string().c_str(), "/test", false);
+        std::vector<Waveform> block(1);
+        dataset.readWaveforms(1, 3, block);
+        BOOST_REQUIRE_EQUAL(block.size(), 3u);
+        for (size_t i = 0; i < block.size(); i++) {
+            const Waveform &ref = wavs[i + 1];
+            BOOST_CHECK_EQUAL(block[i].head.time_stamp, ref.head.time_stamp);
+            BOOST_REQUIRE_EQUAL(block[i].head.number_of_samples, ref.head.number_of_samples);
+            BOOST_CHECK(std::equal(block[i].begin_data(), block[i].end_data(), ref.begin_data()));
+        }
+    }
+
+    boost::filesystem::remove(temp);
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_append) {
+
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directory(dir);
+    std::string filename = (dir / "bulk.h5").string();
+
+    std::vector<Acquisition> acqs(10, Acquisition(32, 4, 2));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(i);
+        std::generate((float *)acqs[i].data_begin(), (float *)acqs[i].data_end(), create_random_float);
+        std::generate((float *)acqs[i].traj_begin(), (float *)acqs[i].traj_end(), create_random_float);
+    }
+
+    std::vector<Image<float> > imgs(3, Image<float>(8, 8, 1, 2));
+    for (size_t i = 0; i < imgs.size(); i++) {
+        std::generate(imgs[i].begin(), imgs[i].end(), create_random_float);
+    }
+    imgs[1].setAttributeString("abc");
+
+    std::vector<Waveform> wavs;
+    for (uint16_t i = 0; i < 3; i++) {
+        Waveform wav(16, 2);
+        wav.head.time_stamp = i;
+        std::fill(wav.begin_data(), wav.end_data(), i);
+        wavs.push_back(wav);
+    }
+
+    {
+        Dataset dataset = Dataset(filename.c_str(), "/test", true);
+        dataset.appendAcquisition(acqs[0]);
+        dataset.appendAcquisitions(&acqs[1], acqs.size() - 1);
+        dataset.appendImages("image", &imgs[0], imgs.size());
+        dataset.appendWaveforms(&wavs[0], wavs.size());
+
+        // One write per call, so all images must have the same size
+        std::vector<Image<float> > mixed(2, Image<float>(8, 8, 1, 2));
+        mixed[1].resize(4, 4, 1, 2);
+        BOOST_CHECK_THROW(dataset.appendImages("mixed", &mixed[0], mixed.size()), std::runtime_error);
+    }
+
+    {
+        Dataset dataset = Dataset(filename.c_str(), "/test", false);
+        BOOST_REQUIRE_EQUAL(dataset.getNumberOfAcquisitions(), acqs.size());
+        for (uint32_t i = 0; i < acqs.size(); i++) {
+            Acquisition acq;
+            dataset.readAcquisition(i, acq);
+            BOOST_REQUIRE(acq.getHead() == acqs[i].getHead());
+            BOOST_CHECK(std::equal(acq.data_begin(), acq.data_end(), acqs[i].data_begin()));
+            BOOST_CHECK(std::equal(acq.traj_begin(), acq.traj_end(), acqs[i].traj_begin()));
+        }
+
+        BOOST_REQUIRE_EQUAL(dataset.getNumberOfImages("image"), imgs.size());
+        for (uint32_t i = 0; i < imgs.size(); i++) {
+            Image<float> img;
+            dataset.readImage("image", i, img);
+            BOOST_CHECK_EQUAL(img.getAttributeStringLength(), imgs[i].getAttributeStringLength());
+            BOOST_CHECK(std::equal(img.begin(), img.end(), imgs[i].begin()));
+        }
+        BOOST_CHECK_EQUAL(dataset.getNumberOfImages("mixed"), 0u);
+
+        BOOST_REQUIRE_EQUAL(dataset.getNumberOfWaveforms(), wavs.size());
+        Waveform wav;
+        dataset.readWaveform(2, wav);
+        BOOST_CHECK(std::equal(wav.begin_data(), wav.end_data(), wavs[2].begin_data()));
+    }
+
+    {
+        // Split where per-acquisition appends would have started a new part
+        RolloverDataset dataset((dir / "session.h5").string().c_str(), "/test", 0, 4);
+        dataset.appendAcquisitions(&acqs[0], acqs.size());
+        dataset.close();
+        BOOST_REQUIRE_EQUAL(dataset.getNumberOfParts(), 3u);
+        Dataset last(dataset.getPartFilename(2).c_str(), "/test", false);
+        BOOST_CHECK_EQUAL(last.getNumberOfAcquisitions(), 2u);
+    }
+
+    boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_append_views) {
+
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+
+    Acquisition acq = Acquisition(32, 4, 2);
+    std::generate((float *)acq.data_begin(), (float *)acq.data_end(), create_random_float);
+    std::generate((float *)acq.traj_begin(), (float *)acq.traj_end(), create_random_float);
+    std::vector<complex_float_t> acq_data(acq.data_begin(), acq.data_end());
+    std::vector<float> acq_traj(acq.traj_begin(), acq.traj_end());
+
+    Image<float> img(8, 8, 1, 1);
+    std::generate(img.begin(), img.end(), create_random_float);
+    std::vector<float> img_data(img.begin(), img.end());
+    // Not null terminated
+    const char attributes[] = {'a', 'b', 'c'};
+    ImageHeader img_head = img.getHead();
+    img_head.attribute_string_len = sizeof(attributes);
+
+    std::vector<size_t> dims(2, 4);
+    std::vector<float> arr_data(16);
+    std::generate(arr_data.begin(), arr_data.end(), create_random_float);
+
+    {
+        Dataset dataset = Dataset(temp.string().c_str(), "/test", true);
+        dataset.appendAcquisition(AcquisitionView(acq.getHead(), &acq_data[0], &acq_traj[0]));
+        dataset.appendImage("image", ImageView<float>(img_head, &img_data[0], attributes));
+        dataset.appendImage("image", ImageView<float>(img.getHead(), &img_data[0]));
+        dataset.appendNDArray("array", NDArrayView<float>(dims, &arr_data[0]));
+
+        // A header type wider than the buffer would be read past its end
+        ImageHeader wrong_head = img.getHead();
+        ImageView<float> wrong_type(wrong_head, &img_data[0]);
+        wrong_head.data_type = ISMRMRD_CXFLOAT;
+        BOOST_CHECK_THROW(dataset.appendImage("image", wrong_type), std::runtime_error);
+        wrong_head.data_type = ISMRMRD_INT;
+        BOOST_CHECK_THROW(dataset.appendImage("image", wrong_type), std::runtime_error);
+    }
+
+    {
+        Dataset dataset = Dataset(temp.string().c_str(), "/test", false);
+        Acquisition exact;
+        dataset.readAcquisition(0, exact);
+        BOOST_REQUIRE(exact.getHead() == acq.getHead());
+        BOOST_CHECK(std::equal(exact.data_begin(), exact.data_end(), acq.data_begin()));
+        BOOST_CHECK(std::equal(exact.traj_begin(), exact.traj_end(), acq.traj_begin()));
+
+        Image<float> img2;
+        dataset.readImage("image", 0, img2);
+        BOOST_CHECK_EQUAL(img2.getAttributeString(), std::string("abc"));
+        BOOST_CHECK(std::equal(img2.begin(), img2.end(), img.begin()));
+        dataset.readImage("image", 1, img2);
+        BOOST_CHECK_EQUAL(img2.getAttributeStringLength(), 0u);
+        BOOST_CHECK_EQUAL(dataset.getNumberOfImages("image"), 2u);
+
+        NDArray<float> arr;
+        dataset.readNDArray("array", 0, arr);
+        BOOST_CHECK_EQUAL(arr.getDims()[1], 4u);
+        BOOST_CHECK(std::equal(arr.begin(), arr.end(), arr_data.begin()));
+    }
+
+    boost::filesystem::remove(temp);
+}
+
+BOOST_AUTO_TEST_CASE(test_read_only_open) {
+
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+
+    Acquisition acq = Acquisition(32, 4, 2);
+    {
+        Dataset dataset = Dataset(temp.string().c_str(), "/test", true);
+        dataset.appendAcquisition(acq);
+    }
+
+    {
+        Dataset dataset(temp.string().c_str(), "/test", DATASET_READ_ONLY_NO_FILE_LOCKING);
+        BOOST_CHECK_EQUAL(dataset.getNumberOfAcquisitions(), 1u);
+        Acquisition read;
+        dataset.readAcquisition(0, read);
+        BOOST_CHECK(read.getHead() == acq.getHead());
+        BOOST_CHECK_THROW(dataset.appendAcquisition(acq), std::runtime_error);
+    }
+
+    BOOST_CHECK_THROW(Dataset((temp.string() + ".missing").c_str(), "/test", DATASET_READ_ONLY), std::runtime_error);
+
+    boost::filesystem::remove(temp);
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_and_merge) {
+
+    boost::filesystem::path src_file = boost::filesystem::unique_path();
+    boost::filesystem::path dst_file = boost::filesystem::unique_path();
+
+    std::vector<Image<float> > images(3, Image<float>(16, 16, 1, 2));
+    for (size_t i = 0; i < images.size(); i++) {
+        images[i].setImageIndex(uint16_t(i));
+        images[i].setAttributeString("<meta/>");
+        std::generate(images[i].begin(), images[i].end(), create_random_float);
+    }
+    Acquisition acq = Acquisition(32, 4, 2);
+    std::generate((float *)acq.data_begin(), (float *)acq.data_end(), create_random_float);
+
+    {
+        Dataset src(src_file.string().c_str(), "/test", true);
+        src.writeHeader("<src/>");
+        src.appendAcquisition(acq);
+        src.appendAcquisition(acq);
+        for (size_t i = 1; i < images.size(); i++)
+            src.appendImage("image_1", images[i]);
+
+        Dataset dst(dst_file.string().c_str(), "/test", true);
+        dst.writeHeader("<dst/>");
+        dst.appendAcquisition(acq);
+        dst.appendImage("image_1", images[0]);
+
+        dst.copyVariable(src, "image_1", "image_1");
+        dst.copyVariable(src, "image_1", "image_2");
+        dst.merge(src);
+    }
+
+    {
+        Dataset dst(dst_file.string().c_str(), "/test", DATASET_READ_ONLY);
+        std::string xml;
+        dst.readHeader(xml);
+        BOOST_CHECK_EQUAL(xml, "<dst/>");
+        BOOST_CHECK_EQUAL(dst.getNumberOfAcquisitions(), 3u);
+        Acquisition read;
+        dst.readAcquisition(2, read);
+        BOOST_CHECK(std::equal(read.data_begin(), read.data_end(), acq.data_begin()));
+
+        // image_1 got the source series appended twice: once copied, once merged
+        BOOST_REQUIRE_EQUAL(dst.getNumberOfImages("image_1"), 5u);
+        BOOST_REQUIRE_EQUAL(dst.getNumberOfImages("image_2"), 2u);
+        size_t expected[] = {0, 1, 2, 1, 2};
+        for (uint32_t i = 0; i < 5; i++) {
+            Image<float> im;
+            dst.readImage("image_1", i, im);
+            Image<float> &ref = images[expected[i]];
+            BOOST_CHECK_EQUAL(im.getImageIndex(), ref.getImageIndex());
+            BOOST_CHECK_EQUAL(std::string(im.getAttributeString()), std::string(ref.getAttributeString()));
+            BOOST_CHECK(std::equal(im.begin(), im.end(), ref.begin()));
+        }
+    }
+
+    boost::filesystem::remove(src_file);
+    boost::filesystem::remove(dst_file);
+}
+
+BOOST_AUTO_TEST_CASE(test_sorted_acquisitions) {
+
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    boost::filesystem::path sorted = boost::filesystem::unique_path();
+
+    // Interleaved multi-slice acquisition: 3 slices, 4 lines each
+    std::vector<Acquisition> acqs(12, Acquisition(16, 2, 0));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(i);
+        acqs[i].idx().slice = uint16_t(i % 3);
+        acqs[i].idx().kspace_encode_step_1 = uint16_t(3 - i / 3);
+        std::generate((float *)acqs[i].data_begin(), (float *)acqs[i].data_end(), create_random_float);
+    }
+
+    std::vector<ISMRMRD_EncodingCounterKeys> keys;
+    keys.push_back(ISMRMRD_IDX_SLICE);
+    keys.push_back(ISMRMRD_IDX_KSPACE_ENCODE_STEP_1);
+
+    {
+        Dataset dataset(temp.string().c_str(), "/test", true);
+        for (size_t i = 0; i < acqs.size(); i++)
+            dataset.appendAcquisition(acqs[i]);
+        dataset.sortAcquisitions(keys);
+
+        Dataset copy(sorted.string().c_str(), "/test", true);
+        copy.sortAcquisitions(dataset, keys);
+    }
+
+    {
+        Dataset dataset(temp.string().c_str(), "/test", DATASET_READ_ONLY);
+        BOOST_CHECK(dataset.getAcquisitionSortKeys() == keys);
+
+        std::vector<AcquisitionHeader> heads;
+        dataset.readAcquisitionHeaders(0, 12, heads);
+        for (size_t i = 1; i < heads.size(); i++) {
+            BOOST_CHECK(heads[i - 1].idx.slice < heads[i].idx.slice ||
+                        (heads[i - 1].idx.slice == heads[i].idx.slice &&
+                         heads[i - 1].idx.kspace_encode_step_1 < heads[i].idx.kspace_encode_step_1));
+        }
+
+        // The stored order maps every position back to the original acquisition
+        std::vector<uint32_t> order;
+        dataset.getAcquisitionOrder(order);
+        BOOST_REQUIRE_EQUAL(order.size(), acqs.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            Acquisition acq;
+            dataset.readAcquisition(i, acq);
+            BOOST_CHECK(acq.getHead() == acqs[order[i]].getHead());
+            BOOST_CHECK(std::equal(acq.data_begin(), acq.data_end(), acqs[order[i]].data_begin()));
+        }
+
+        // One slice is a single contiguous range
+        uint32_t first = 0, count = 0;
+        dataset.findAcquisitionRange(std::vector<uint16_t>(1, 1), first, count);
+        BOOST_CHECK_EQUAL(first, 4u);
+        BOOST_CHECK_EQUAL(count, 4u);
+
+        Dataset copy(sorted.string().c_str(), "/test", DATASET_READ_ONLY);
+        std::vector<uint32_t> copy_order;
+        copy.getAcquisitionOrder(copy_order);
+        BOOST_CHECK(copy_order == order);
+    }
+
+    boost::filesystem::remove(temp);
+    boost::filesystem::remove(sorted);
+}
+
+BOOST_AUTO_TEST_CASE(test_merge_sorted_acquisitions) {
+
+    boost::filesystem::path src_file = boost::filesystem::unique_path();
+    boost::filesystem::path dst_files[] = {boost::filesystem::unique_path(), boost::filesystem::unique_path(),
+                                           boost::filesystem::unique_path()};
+
+    std::vector<Acquisition> acqs(6, Acquisition(16, 2, 0));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(i);
+        acqs[i].idx().slice = uint16_t(i % 2);
+    }
+    std::vector<ISMRMRD_EncodingCounterKeys> keys(1, ISMRMRD_IDX_SLICE);
+
+    {
+        Dataset src(src_file.string().c_str(), "/test", true);
+        for (size_t i = 0; i < acqs.size(); i++)
+            src.appendAcquisition(acqs[i]);
+        // A sort that did not finish leaves the sorted copy behind
+        src.copyVariable(src, "data", "data_sorting");
+        src.sortAcquisitions(keys);
+
+        // Unsorted, sorted and empty destinations
+        Dataset unsorted(dst_files[0].string().c_str(), "/test", true);
+        Dataset sorted(dst_files[1].string().c_str(), "/test", true);
+        Dataset empty(dst_files[2].string().c_str(), "/test", true);
+        for (size_t i = 0; i < 3; i++) {
+            unsorted.appendAcquisition(acqs[i]);
+            sorted.appendAcquisition(acqs[i]);
+        }
+        sorted.sortAcquisitions(keys);
+        unsorted.merge(src);
+        sorted.merge(src);
+        empty.merge(src);
+    }
+
+    {
+        Dataset src(src_file.string().c_str(), "/test", DATASET_READ_ONLY);
+        std::vector<uint32_t> src_order;
+        src.getAcquisitionOrder(src_order);
+        uint32_t expected_src[] = {0, 2, 4, 1, 3, 5};
+        BOOST_CHECK(src_order == std::vector<uint32_t>(expected_src, expected_src + 6));
+
+        // The merged acquisitions follow those of the destination in their sorted order
+        Dataset unsorted(dst_files[0].string().c_str(), "/test", DATASET_READ_ONLY);
+        std::vector<uint32_t> order;
+        unsorted.getAcquisitionOrder(order);
+        BOOST_REQUIRE_EQUAL(order.size(), 9u);
+        for (uint32_t i = 0; i < order.size(); i++)
+            BOOST_CHECK_EQUAL(order[i], i);
+        BOOST_CHECK(unsorted.getAcquisitionSortKeys().empty());
+
+        Dataset sorted(dst_files[1].string().c_str(), "/test", DATASET_READ_ONLY);
+        sorted.getAcquisitionOrder(order);
+        uint32_t expected_sorted[] = {0, 2, 1, 3, 4, 5, 6, 7, 8};
+        BOOST_CHECK(order == std::vector<uint32_t>(expected_sorted, expected_sorted + 9));
+        uint32_t first = 0, count = 0;
+        sorted.findAcquisitionRange(std::vector<uint16_t>(1, 1), first, count);
+        BOOST_CHECK_EQUAL(first, 2u);
+        BOOST_CHECK_EQUAL(count, 1u);
+
+        Dataset empty(dst_files[2].string().c_str(), "/test", DATASET_READ_ONLY);
+        empty.getAcquisitionOrder(order);
+        BOOST_CHECK(order == src_order);
+        empty.findAcquisitionRange(std::vector<uint16_t>(1, 1), first, count);
+        BOOST_CHECK_EQUAL(first, 3u);
+        BOOST_CHECK_EQUAL(count, 3u);
+    }
+
+    boost::filesystem::remove(src_file);
+    for (size_t i = 0; i < 3; i++)
+        boost::filesystem::remove(dst_files[i]);
+}
+
+BOOST_AUTO_TEST_CASE(test_acquisition_header_table) {
+
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+
+    std::vector<Acquisition> acqs(10, Acquisition(8, 1, 0));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(100 + i);
+        acqs[i].idx().slice = uint16_t(i % 3);
+        acqs[i].idx().user[2] = uint16_t(2 * i);
+        acqs[i].position()[1] = float(i) / 2;
+        acqs[i].user_int()[7] = -int32_t(i);
+        if (i == 9)
+            acqs[i].setFlag(ISMRMRD_ACQ_LAST_IN_MEASUREMENT);
+    }
+
+    {
+        Dataset dataset(temp.string().c_str(), "/test", true);
+        for (size_t i = 0; i < acqs.size(); i++)
+            dataset.appendAcquisition(acqs[i]);
+    }
+
+    const ISMRMRD_EncodingCounterKeys user_2 = ISMRMRD_EncodingCounterKeys(ISMRMRD_IDX_USER_0 + 2);
+    Dataset dataset(temp.string().c_str(), "/test", DATASET_READ_ONLY);
+    AcquisitionHeaderTable table;
+    dataset.readAcquisitionHeaderTable(table);
+    BOOST_REQUIRE_EQUAL(table.size(), acqs.size());
+    BOOST_REQUIRE_EQUAL(table.position.size(), 3 * acqs.size());
+    for (size_t i = 0; i < acqs.size(); i++) {
+        BOOST_CHECK_EQUAL(table.scan_counter[i], acqs[i].scan_counter());
+        BOOST_CHECK_EQUAL(table.number_of_samples[i], 8);
+        BOOST_CHECK_EQUAL(table.flags[i], acqs[i].flags());
+        BOOST_CHECK_EQUAL(table.idx[ISMRMRD_IDX_SLICE][i], acqs[i].idx().slice);
+        BOOST_CHECK_EQUAL(table.counter(user_2)[i], acqs[i].idx().user[2]);
+        BOOST_CHECK_EQUAL(table.position[3 * i + 1], acqs[i].position()[1]);
+        BOOST_CHECK_EQUAL(table.user_int[ISMRMRD_USER_INTS * i + 7], acqs[i].user_int()[7]);
+    }
+
+    std::vector<uint16_t> slices = table.uniqueCounterValues(ISMRMRD_IDX_SLICE);
+    BOOST_REQUIRE_EQUAL(slices.size(), 3u);
+    BOOST_CHECK_EQUAL(slices[0], 0);
+    BOOST_CHECK_EQUAL(slices[2], 2);
+
+    uint16_t min = 0, max = 0;
+    BOOST_CHECK(table.counterRange(user_2, min, max));
+    BOOST_CHECK_EQUAL(min, 0);
+    BOOST_CHECK_EQUAL(max, 18);
+
+    std::vector<uint32_t> rows = table.selectCounterValue(ISMRMRD_IDX_SLICE, 1);
+    BOOST_REQUIRE_EQUAL(rows.size(), 3u);
+    BOOST_CHECK_EQUAL(rows[2], 7u);
+    rows = table.selectFlag(ISMRMRD_ACQ_LAST_IN_MEASUREMENT);
+    BOOST_REQUIRE_EQUAL(rows.size(), 1u);
+    BOOST_CHECK_EQUAL(rows[0], 9u);
+
+    // Single columns are read with a compound subset of the acquisition type
+    std::vector<uint16_t> slice;
+    dataset.readAcquisitionHeaderColumn("idx.slice", slice);
+    BOOST_CHECK(slice == table.idx[ISMRMRD_IDX_SLICE]);
+    std::vector<float> position;
+    dataset.readAcquisitionHeaderColumn("position", position, 3);
+    BOOST_CHECK(position == table.position);
+    std::vector<uint32_t> wrong_width;
+    BOOST_CHECK_THROW(dataset.readAcquisitionHeaderColumn("position", wrong_width), std::runtime_error);
+    BOOST_CHECK_THROW(dataset.readAcquisitionHeaderColumn("idx.no_such_counter", slice), std::runtime_error);
+
+    boost::filesystem::remove(temp);
+}
+
+BOOST_AUTO_TEST_CASE(test_rollover) {
+
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directory(dir);
+    std::string filename = (dir / "session.h5").string();
+    std::string xml = "<ismrmrdHeader></ismrmrdHeader>";
+
+    std::vector<Acquisition> acqs(10, Acquisition(32, 4, 2));
+    for (size_t i = 0; i < acqs.size(); i++) {
+        acqs[i].scan_counter() = uint32_t(i);
+        std::generate((float *)acqs[i].data_begin(), (float *)acqs[i].data_end(), create_random_float);
+        std::generate((float *)acqs[i].traj_begin(), (float *)acqs[i].traj_end(), create_random_float);
+    }
+
+    std::string manifest;
+    {
+        RolloverDataset dataset(filename.c_str(), "/test", 0, 4);
+        dataset.writeHeader(xml);
+        for (size_t i = 0; i < acqs.size(); i++)
+            dataset.appendAcquisition(acqs[i]);
+        dataset.close();
+        BOOST_CHECK_EQUAL(dataset.getNumberOfParts(), 3u);
+        manifest = dataset.getManifestFilename();
+
+        // Every part is a complete dataset with its own copy of the header
+        Dataset last(dataset.getPartFilename(2).c_str(), "/test", false);
+        std::string part_xml;
+        last.readHeader(part_xml);
+        BOOST_CHECK_EQUAL(part_xml, xml);
+        BOOST_CHECK_EQUAL(last.getNumberOfAcquisitions(), 2u);
+
+        std::vector<Acquisition> block;
+        last.readAcquisitions(0, 2, block);
+        BOOST_REQUIRE_EQUAL(block.size(), 2u);
+        BOOST_CHECK(block[1].getHead() == acqs[9].getHead());
+    }
+
+    {
+        // A prefetch block of 3 crosses the part boundaries at 4 and 8
+        RolloverDatasetReader reader(manifest.c_str(), 3);
+        BOOST_CHECK_EQUAL(reader.getNumberOfParts(), 3u);
+        BOOST_REQUIRE_EQUAL(reader.getNumberOfAcquisitions(), acqs.size());
+        for (size_t i = 0; i < acqs.size(); i++) {
+            Acquisition acq;
+            reader.readAcquisition(i, acq);
+            BOOST_REQUIRE(acq.getHead() == acqs[i].getHead());
+            BOOST_CHECK(std::equal(acq.data_begin(), acq.data_end(), acqs[i].data_begin()));
+            BOOST_CHECK(std::equal(acq.traj_begin(), acq.traj_end(), acqs[i].traj_begin()));
+        }
+    }
+
+    boost::filesystem::remove_all(dir);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,10 +1,31 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/vector.hpp>
+#include <boost/random.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <map>
 #include <sstream>
 
 #include "ismrmrd/serialization.h"
 #include "ismrmrd/serialization_iostream.h"
+#include "ismrmrd/stream_index.h"
+#if __cplusplus >= 201103L
+#include "ismrmrd/stream_reader.h"
+#include "ismrmrd/stream_router.h"
+#endif
+#ifndef _WIN32
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "ismrmrd/serialization_fd.h"
+#include "ismrmrd/serialization_mmap.h"
+#include "ismrmrd/serialization_shm.h"
+#include "ismrmrd/serialization_socket.h"
+#endif
 
 using namespace ISMRMRD;
 
@@ -356,4 +377,1538 @@ BOOST_AUTO_TEST_CASE(test_of_protocol_serialization) {
                                   img2.getDataPtr(), img2.getDataPtr() + img2.getNumberOfDataElements());
 }
 
+BOOST_AUTO_TEST_CASE(test_pooled_deserialization) {
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    OStreamView ws(ss);
+    IStreamView rs(ss);
+    ProtocolSerializer serializer(ws);
+
+    for (uint32_t i = 0; i < 50; i++) {
+        Acquisition acq(128, 4, 0);
+        acq.scan_counter() = i;
+        acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i);
+        serializer.serialize(acq);
+    }
+    Image<float> with_attributes(8, 8, 1, 1), without_attributes(8, 8, 1, 1);
+    with_attributes.setAttributeString("<ismrmrdMeta/>");
+    serializer.serialize(with_attributes);
+    serializer.serialize(without_attributes);
+
+    MessagePool pool;
+    ProtocolDeserializer deserializer(rs, pool);
+
+    // Keeping only the current acquisition recycles one object and its buffers
+    Pooled<Acquisition> acq;
+    const complex_float_t *data = NULL;
+    for (uint32_t i = 0; i < 40; i++) {
+        deserializer.deserialize(acq);
+        BOOST_CHECK_EQUAL(acq->scan_counter(), i);
+        BOOST_CHECK_EQUAL(acq->getDataPtr()[i], value_from_size_t<std::complex<float> >(i));
+        if (i == 0) {
+            data = acq->getDataPtr();
+        }
+    }
+    BOOST_CHECK_EQUAL(pool.acquisitions().size(), 1u);
+    BOOST_CHECK(acq->getDataPtr() == data);
+
+    // Acquisitions that are kept (e.g. queued for another stage) add objects to the pool
+    std::vector<Pooled<Acquisition> > kept;
+    for (uint32_t i = 40; i < 50; i++) {
+        deserializer.deserialize(acq);
+        kept.push_back(acq);
+    }
+    BOOST_CHECK_EQUAL(pool.acquisitions().size(), 10u);
+    BOOST_CHECK_EQUAL(kept[9]->scan_counter(), 49u);
+    acq.reset();
+    kept.clear();
+    BOOST_CHECK_EQUAL(pool.acquisitions().available(), 10u);
+
+    // A recycled image does not keep the attributes of the previous message
+    Pooled<Image<float> > img;
+    deserializer.deserialize(img);
+    BOOST_CHECK_EQUAL(img->getAttributeString(), "<ismrmrdMeta/>");
+    deserializer.deserialize(img);
+    BOOST_CHECK_EQUAL(img->getAttributeStringLength(), 0u);
+    BOOST_CHECK_EQUAL(pool.images<float>().size(), 1u);
+
+    // Without a pool, pooled deserialization is an error
+    ProtocolDeserializer unpooled(rs);
+    BOOST_CHECK_THROW(unpooled.deserialize(acq), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_object_pool_outlived_by_handle) {
+    Pooled<Waveform> wfm;
+    {
+        ObjectPool<Waveform> pool;
+        wfm = pool.acquire();
+        wfm->head.time_stamp = 7;
+    }
+    BOOST_CHECK_EQUAL(wfm->head.time_stamp, 7u);
+    wfm.reset();
+    BOOST_CHECK(wfm.get() == NULL);
+}
+
+// Writes one message of every kind, returns the scan counter of the acquisition
+static uint32_t serialize_mixed_messages(ProtocolSerializer &serializer) {
+    ConfigFile cfg;
+    strcpy(cfg.config, "config.xml");
+    ConfigText cfg_txt;
+    cfg_txt.config_text = "<config/>";
+    TextMessage txt;
+    txt.message = "text";
+    Waveform wf(100, 3);
+    std::vector<size_t> dims(3, 5);
+    NDArray<double> arr(dims);
+    Image<std::complex<float> > img(16, 8, 2, 3);
+    img.setAttributeString("<ismrmrdMeta/>");
+    img.setImageIndex(3);
+    Acquisition acq(64, 4, 2);
+    acq.scan_counter() = 17;
+
+    serializer.serialize(cfg);
+    serializer.serialize(cfg_txt);
+    serializer.serialize(txt);
+    serializer.serialize(wf);
+    serializer.serialize(arr);
+    serializer.serialize(img);
+    serializer.serialize(std::vector<Acquisition>(3, acq));
+    serializer.serialize(acq);
+    serializer.serialize(wf);
+    serializer.serialize(img);
+    serializer.close();
+    return acq.scan_counter();
+}
+
+// Skips everything but the second image and checks that the stream stays in sync
+static void check_skip(ReadableStreamView &rs) {
+    ProtocolDeserializer deserializer(rs);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_CONFIG_FILE);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_CONFIG_TEXT);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_TEXT);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_WAVEFORM);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_NDARRAY);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_IMAGE);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_ACQUISITION_BATCH);
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+    Acquisition acq;
+    deserializer.deserialize(acq);
+    BOOST_CHECK_EQUAL(acq.scan_counter(), 17u);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_WAVEFORM);
+    Image<std::complex<float> > img;
+    deserializer.deserialize(img);
+    BOOST_CHECK_EQUAL(img.getImageIndex(), 3);
+    BOOST_CHECK_EQUAL(img.getAttributeString(), "<ismrmrdMeta/>");
+    BOOST_CHECK_THROW(deserializer.skip(), ProtocolStreamClosed);
+}
+
+// Skips the messages of a stream cut inside its last image, the skip of that
+// image must report the truncation rather than pass the end of the input
+static void check_truncated_skip(ReadableStreamView &rs) {
+    ProtocolDeserializer deserializer(rs);
+    for (int n = 0; n < 9; n++) {
+        deserializer.skip();
+    }
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_IMAGE);
+    BOOST_CHECK_THROW(deserializer.skip(), std::runtime_error);
+}
+
+// A view without a skip override exercises the default (read and discard)
+class ReadOnlyStreamView : public ReadableStreamView {
+public:
+    ReadOnlyStreamView(std::istream &is) : _is(is) {}
+    void read(char *buffer, size_t count) { _is.read(buffer, count); }
+    bool eof() { return _is.eof(); }
+private:
+    std::istream &_is;
+};
+
+BOOST_AUTO_TEST_CASE(test_skip_messages) {
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    OStreamView ws(ss);
+    ProtocolSerializer serializer(ws);
+    serialize_mixed_messages(serializer);
+    const std::string data = ss.str();
+    // Without the close message and the end of the last image
+    const std::string truncated = data.substr(0, data.size() - sizeof(uint16_t) - 64);
+
+    std::stringstream seekable(data, std::ios::in | std::ios::binary);
+    IStreamView rs(seekable);
+    check_skip(rs);
+
+    std::stringstream sequential(data, std::ios::in | std::ios::binary);
+    ReadOnlyStreamView ro(sequential);
+    check_skip(ro);
+
+    std::stringstream truncated_ss(truncated, std::ios::in | std::ios::binary);
+    IStreamView truncated_rs(truncated_ss);
+    check_truncated_skip(truncated_rs);
+
+    std::string truncated_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    {
+        std::ofstream out(truncated_path.c_str(), std::ios::out | std::ios::binary);
+        out.write(truncated.data(), truncated.size());
+    }
+    {
+        std::ifstream truncated_file(truncated_path.c_str(), std::ios::in | std::ios::binary);
+        IStreamView truncated_file_rs(truncated_file);
+        check_truncated_skip(truncated_file_rs);
+    }
+    boost::filesystem::remove(truncated_path);
+
+#ifndef _WIN32
+    // Seekable file descriptor, with a buffer smaller than the messages
+    FILE *file = tmpfile();
+    BOOST_REQUIRE(file != NULL);
+    BOOST_REQUIRE_EQUAL(write(fileno(file), data.data(), data.size()), (ssize_t)data.size());
+    BOOST_REQUIRE_EQUAL(lseek(fileno(file), 0, SEEK_SET), 0);
+    FdReadStream file_rs(fileno(file), 256);
+    check_skip(file_rs);
+    fclose(file);
+
+    FILE *truncated_file = tmpfile();
+    BOOST_REQUIRE(truncated_file != NULL);
+    BOOST_REQUIRE_EQUAL(write(fileno(truncated_file), truncated.data(), truncated.size()), (ssize_t)truncated.size());
+    BOOST_REQUIRE_EQUAL(lseek(fileno(truncated_file), 0, SEEK_SET), 0);
+    FdReadStream truncated_file_rs(fileno(truncated_file), 256);
+    check_truncated_skip(truncated_file_rs);
+    fclose(truncated_file);
+
+    // A pipe cannot seek, the skipped bytes are read
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(pipe(fds), 0);
+    BOOST_REQUIRE(data.size() < 65536);
+    BOOST_REQUIRE_EQUAL(write(fds[1], data.data(), data.size()), (ssize_t)data.size());
+    close(fds[1]);
+    FdReadStream pipe_rs(fds[0], 256);
+    check_skip(pipe_rs);
+    close(fds[0]);
+
+    BOOST_REQUIRE_EQUAL(pipe(fds), 0);
+    BOOST_REQUIRE_EQUAL(write(fds[1], truncated.data(), truncated.size()), (ssize_t)truncated.size());
+    close(fds[1]);
+    FdReadStream truncated_pipe_rs(fds[0], 256);
+    check_truncated_skip(truncated_pipe_rs);
+    close(fds[0]);
+#endif
+}
+
+// Records how the serializers hand messages to the stream
+class CountingStreamView : public WritableStreamView {
+public:
+    CountingStreamView() : writes(0), vectored_writes(0) {}
+
+    void write(const char *buffer, size_t count) {
+        writes++;
+        data.append(buffer, count);
+    }
+
+    void writev(const StreamBuffer *buffers, size_t count) {
+        vectored_writes++;
+        for (size_t i = 0; i < count; i++) {
+            data.append(buffers[i].data, buffers[i].size);
+        }
+    }
+
+    bool bad() {
+        return false;
+    }
+
+    size_t writes;
+    size_t vectored_writes;
+    std::string data;
+};
+
+BOOST_AUTO_TEST_CASE(test_vectored_protocol_writes) {
+    Acquisition acq(64, 4, 2);
+    Image<float> img(16, 16, 1, 2);
+    img.setAttributeString("attributes");
+    std::vector<size_t> dims(2, 3);
+    NDArray<float> arr(dims);
+    TextMessage txt;
+    txt.message = "text";
+
+    CountingStreamView counting;
+    ProtocolSerializer serializer(counting);
+    serializer.serialize(acq);
+    serializer.serialize(img);
+    serializer.serialize(arr);
+    serializer.serialize(txt);
+
+    // Every message, including its id, is a single vectored write
+    BOOST_CHECK_EQUAL(counting.vectored_writes, 4u);
+    BOOST_CHECK_EQUAL(counting.writes, 0u);
+
+    // and produces the same bytes as sequential writes
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    OStreamView ws(ss);
+    ProtocolSerializer sequential(ws);
+    sequential.serialize(acq);
+    sequential.serialize(img);
+    sequential.serialize(arr);
+    sequential.serialize(txt);
+    BOOST_CHECK(ss.str() == counting.data);
+}
+
+// Messages serialized from views of plain buffers are identical to those of the owning types
+BOOST_AUTO_TEST_CASE(test_view_serialization) {
+    Acquisition acq(64, 4, 2);
+    for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+        acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i);
+    }
+    for (size_t i = 0; i < acq.getNumberOfTrajElements(); i++) {
+        acq.getTrajPtr()[i] = value_from_size_t<float>(i);
+    }
+    std::vector<complex_float_t> acq_data(acq.getDataPtr(), acq.getDataPtr() + acq.getNumberOfDataElements());
+    std::vector<float> acq_traj(acq.getTrajPtr(), acq.getTrajPtr() + acq.getNumberOfTrajElements());
+    AcquisitionHeader acq_head = acq.getHead();
+
+    Image<float> img(16, 16, 1, 2);
+    for (size_t i = 0; i < img.getNumberOfDataElements(); i++) {
+        img.getDataPtr()[i] = value_from_size_t<float>(i);
+    }
+    img.setAttributeString("attributes");
+    std::vector<float> img_data(img.getDataPtr(), img.getDataPtr() + img.getNumberOfDataElements());
+    std::string attributes("attributes");
+    ImageHeader img_head = img.getHead();
+
+    std::vector<size_t> dims;
+    dims.push_back(3);
+    dims.push_back(5);
+    NDArray<int32_t> arr(dims);
+    for (size_t i = 0; i < arr.getNumberOfElements(); i++) {
+        arr.getDataPtr()[i] = value_from_size_t<int32_t>(i);
+    }
+    std::vector<int32_t> arr_data(arr.getDataPtr(), arr.getDataPtr() + arr.getNumberOfElements());
+
+    uint16_t codecs[] = {ISMRMRD_COMPRESSION_NONE, ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE};
+    for (size_t k = 0; k < 2; k++) {
+        if (!compression_supported(codecs[k])) {
+            continue;
+        }
+        std::stringstream owning_ss(std::ios::in | std::ios::out | std::ios::binary);
+        OStreamView owning_ws(owning_ss);
+        ProtocolSerializer owning(owning_ws);
+        std::stringstream view_ss(std::ios::in | std::ios::out | std::ios::binary);
+        OStreamView view_ws(view_ss);
+        ProtocolSerializer views(view_ws);
+        if (codecs[k] != ISMRMRD_COMPRESSION_NONE) {
+            owning.set_compression(codecs[k]);
+            views.set_compression(codecs[k]);
+        }
+
+        owning.serialize(acq);
+        owning.serialize(img);
+        owning.serialize(arr);
+        views.serialize(AcquisitionView(acq_head, &acq_data[0], &acq_traj[0]));
+        views.serialize(ImageView<float>(img_head, &img_data[0], attributes.data()));
+        views.serialize(NDArrayView<int32_t>(dims, &arr_data[0]));
+        BOOST_CHECK(owning_ss.str() == view_ss.str());
+    }
+
+    // The free functions as well
+    std::stringstream owning_ss(std::ios::in | std::ios::out | std::ios::binary);
+    OStreamView owning_ws(owning_ss);
+    ISMRMRD::serialize(acq, owning_ws);
+    ISMRMRD::serialize(img, owning_ws);
+    ISMRMRD::serialize(arr, owning_ws);
+    std::stringstream view_ss(std::ios::in | std::ios::out | std::ios::binary);
+    OStreamView view_ws(view_ss);
+    ISMRMRD::serialize(AcquisitionView(acq_head, &acq_data[0], &acq_traj[0]), view_ws);
+    ISMRMRD::serialize(ImageView<float>(img_head, &img_data[0], attributes.data()), view_ws);
+    ISMRMRD::serialize(NDArrayView<int32_t>(dims, &arr_data[0]), view_ws);
+    BOOST_CHECK(owning_ss.str() == view_ss.str());
+
+    IStreamView rs(view_ss);
+    Acquisition acq2;
+    Image<float> img2;
+    NDArray<int32_t> arr2;
+    ISMRMRD::deserialize(acq2, rs);
+    ISMRMRD::deserialize(img2, rs);
+    ISMRMRD::deserialize(arr2, rs);
+    BOOST_CHECK(acq2.getHead() == acq.getHead());
+    BOOST_CHECK_EQUAL(img2.getAttributeString(), attributes);
+    BOOST_CHECK_EQUAL_COLLECTIONS(arr2.getDataPtr(), arr2.getDataPtr() + arr2.getNumberOfElements(),
+                                  arr_data.begin(), arr_data.end());
+
+    // The attributes must be as long as the header says
+    ImageView<float> truncated(img_head, &img_data[0], attributes.data());
+    truncated.attribute_string_length = 4;
+    BOOST_CHECK_THROW(ISMRMRD::serialize(truncated, view_ws), std::runtime_error);
+
+    // And the header must have the type of the buffer, not just its size
+    ImageHeader int_head = img_head;
+    int_head.data_type = ISMRMRD_INT;
+    ImageView<float> mislabeled(int_head, &img_data[0], attributes.data());
+    BOOST_CHECK_THROW(ISMRMRD::serialize(mislabeled, view_ws), std::runtime_error);
+    ProtocolSerializer serializer(view_ws);
+    BOOST_CHECK_THROW(serializer.serialize(mislabeled), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_acquisition_batch_serialization) {
+    // Acquisitions of different sizes, with and without trajectories
+    std::vector<Acquisition> acqs;
+    for (size_t n = 0; n < 5; n++) {
+        Acquisition acq(uint16_t(8 + n), uint16_t(1 + n % 3), uint16_t(n % 2 ? 2 : 0));
+        for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+            acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i + n);
+        }
+        for (size_t i = 0; i < acq.getNumberOfTrajElements(); i++) {
+            acq.getTrajPtr()[i] = float(i + n);
+        }
+        acq.scan_counter() = uint32_t(n);
+        acqs.push_back(acq);
+    }
+
+    // The whole batch is one vectored write
+    CountingStreamView counting;
+    ProtocolSerializer serializer(counting);
+    serializer.serialize(acqs);
+    serializer.serialize(std::vector<Acquisition>());
+    serializer.serialize(acqs[0]);
+    serializer.close();
+    BOOST_CHECK_EQUAL(counting.vectored_writes, 3u);
+
+    std::stringstream ss(counting.data);
+    IStreamView rs(ss);
+    ProtocolDeserializer deserializer(rs);
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION_BATCH);
+    const std::vector<AcquisitionHeader> &heads = deserializer.peek_batch_headers();
+    BOOST_REQUIRE_EQUAL(heads.size(), acqs.size());
+    for (size_t n = 0; n < acqs.size(); n++) {
+        BOOST_CHECK(heads[n] == acqs[n].getHead());
+    }
+
+    // Reuses the acquisitions already in the vector
+    std::vector<Acquisition> acqs2(7);
+    deserializer.deserialize(acqs2);
+    BOOST_REQUIRE_EQUAL(acqs2.size(), acqs.size());
+    for (size_t n = 0; n < acqs.size(); n++) {
+        BOOST_CHECK(acqs2[n].getHead() == acqs[n].getHead());
+        BOOST_CHECK_EQUAL_COLLECTIONS(acqs2[n].data_begin(), acqs2[n].data_end(), acqs[n].data_begin(),
+                                      acqs[n].data_end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(acqs2[n].traj_begin(), acqs2[n].traj_end(), acqs[n].traj_begin(),
+                                      acqs[n].traj_end());
+    }
+
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION_BATCH);
+    BOOST_CHECK(deserializer.peek_batch_headers().empty());
+    deserializer.deserialize(acqs2);
+    BOOST_CHECK(acqs2.empty());
+
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+    BOOST_CHECK_THROW(deserializer.peek_batch_headers(), std::runtime_error);
+    BOOST_CHECK_THROW(deserializer.deserialize(acqs2), std::runtime_error);
+    BOOST_CHECK(deserializer.peek_acquisition_header() == acqs[0].getHead());
+    Acquisition acq;
+    deserializer.deserialize(acq);
+    BOOST_CHECK_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_CLOSE);
+
+    // A corrupt count is rejected before the headers are allocated
+    std::stringstream corrupt;
+    uint16_t id = ISMRMRD_MESSAGE_ACQUISITION_BATCH;
+    uint32_t count = ISMRMRD_MAX_BATCH_ACQUISITIONS + 1;
+    corrupt.write(reinterpret_cast<const char *>(&id), sizeof(id));
+    corrupt.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    IStreamView corrupt_rs(corrupt);
+    ProtocolDeserializer corrupt_deserializer(corrupt_rs);
+    BOOST_CHECK_THROW(corrupt_deserializer.peek(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_statistics) {
+    Acquisition acq(64, 4, 2);
+    Image<float> img(16, 16, 1, 2);
+    img.setAttributeString("attributes");
+    TextMessage txt;
+    txt.message = "text";
+
+    CountingStreamView counting;
+    ProtocolSerializer serializer(counting);
+    StreamStatistics sent;
+    serializer.set_statistics(&sent);
+    serializer.serialize(acq);
+    const size_t acq_size = counting.data.size();
+    serializer.serialize(acq);
+    serializer.serialize(img);
+    const size_t img_size = counting.data.size() - 2 * acq_size;
+    serializer.serialize(txt);
+    const size_t txt_size = counting.data.size() - 2 * acq_size - img_size;
+    serializer.close();
+
+    BOOST_CHECK_EQUAL(sent.messages().size(), 3u);
+    BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_ACQUISITION).count, 2u);
+    BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_ACQUISITION).bytes, 2 * acq_size);
+    BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_IMAGE).count, 1u);
+    BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_IMAGE).bytes, img_size);
+    BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_TEXT).bytes, txt_size);
+    BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_CLOSE).count, 0u);
+    // The close message is not counted
+    BOOST_CHECK_EQUAL(sent.total().count, 4u);
+    BOOST_CHECK_EQUAL(sent.total().bytes, counting.data.size() - sizeof(uint16_t));
+    BOOST_CHECK(sent.total().io_seconds >= 0);
+    BOOST_CHECK(sent.total().codec_seconds >= 0);
+
+    // Skipped messages are counted as read
+    std::stringstream ss(counting.data);
+    IStreamView rs(ss);
+    ProtocolDeserializer deserializer(rs);
+    StreamStatistics received;
+    deserializer.set_statistics(&received);
+    Acquisition acq2;
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+    deserializer.deserialize(acq2);
+    BOOST_CHECK_EQUAL(deserializer.skip(), ISMRMRD_MESSAGE_ACQUISITION);
+    Image<float> img2;
+    deserializer.deserialize(img2);
+    TextMessage txt2;
+    deserializer.deserialize(txt2);
+    BOOST_CHECK_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_CLOSE);
+    BOOST_CHECK(received.messages().size() == sent.messages().size());
+    std::map<uint16_t, MessageStatistics>::const_iterator it;
+    for (it = sent.messages().begin(); it != sent.messages().end(); ++it) {
+        BOOST_CHECK_EQUAL(received.message(it->first).count, it->second.count);
+        BOOST_CHECK_EQUAL(received.message(it->first).bytes, it->second.bytes);
+    }
+
+    received.reset();
+    BOOST_CHECK(received.messages().empty());
+    BOOST_CHECK_EQUAL(received.total().count, 0u);
+
+    std::stringstream table;
+    sent.print(table);
+    BOOST_CHECK(table.str().find("acquisition") != std::string::npos);
+    BOOST_CHECK(table.str().find("total") != std::string::npos);
+    BOOST_CHECK_EQUAL(std::string(message_name(ISMRMRD_MESSAGE_ACQUISITION_BATCH)), "acquisition batch");
+
+    // Compressed messages are counted apart, detached statistics stay as they are
+    if (compression_supported(ISMRMRD_COMPRESSION_DEFLATE)) {
+        CountingStreamView compressed;
+        ProtocolSerializer compressing(compressed);
+        compressing.set_compression(ISMRMRD_COMPRESSION_DEFLATE);
+        compressing.set_statistics(&sent);
+        compressing.serialize(acq);
+        compressing.set_statistics(NULL);
+        compressing.serialize(acq);
+        BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION).count, 1u);
+        BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION).bytes, compressed.data.size() / 2);
+        BOOST_CHECK_EQUAL(sent.message(ISMRMRD_MESSAGE_ACQUISITION).count, 2u);
+
+        std::stringstream css(compressed.data);
+        IStreamView crs(css);
+        ProtocolDeserializer decompressing(crs);
+        decompressing.set_statistics(&received);
+        decompressing.deserialize(acq2);
+        BOOST_CHECK_EQUAL(received.message(ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION).count, 1u);
+        BOOST_CHECK_EQUAL(received.message(ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION).bytes,
+                          compressed.data.size() / 2);
+        BOOST_CHECK_EQUAL(received.message(ISMRMRD_MESSAGE_ACQUISITION).count, 0u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_latency_statistics) {
+    LatencyStatistics latency;
+    BOOST_CHECK_EQUAL(latency.percentile(0.5), 0.0);
+
+    // The last input of a key counts, keys are independent
+    latency.received(0, 1.0);
+    latency.received(1, 1.5);
+    latency.received(0, 2.0);
+    BOOST_CHECK_CLOSE(latency.sent(0, 2.25), 0.25, 1e-9);
+    BOOST_CHECK_LT(latency.sent(0, 3.0), 0.0);
+    for (int i = 2; i <= 100; i++) {
+        latency.received(i, 10.0);
+        latency.sent(i, 10.0 + i * 1e-3);
+    }
+    BOOST_CHECK_CLOSE(latency.sent(1, 2.5), 1.0, 1e-9);
+
+    BOOST_REQUIRE_EQUAL(latency.latencies().size(), 101u);
+    BOOST_CHECK_CLOSE(latency.latencies()[0], 0.25, 1e-9);
+    BOOST_CHECK_CLOSE(latency.percentile(0.5), 0.052, 1e-6);
+    BOOST_CHECK_CLOSE(latency.percentile(0.99), 0.25, 1e-6);
+    BOOST_CHECK_CLOSE(latency.percentile(1), 1.0, 1e-6);
+    BOOST_CHECK_CLOSE(latency.percentile(0), 0.002, 1e-6);
+
+    std::stringstream summary;
+    latency.print(summary);
+    BOOST_CHECK(summary.str().find("p99 250.000") != std::string::npos);
+
+    latency.reset();
+    BOOST_CHECK(latency.latencies().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_serialization) {
+    BOOST_CHECK(compression_supported(ISMRMRD_COMPRESSION_NONE));
+    BOOST_CHECK(!compression_supported(999));
+    std::stringstream unused;
+    OStreamView unused_ws(unused);
+    ProtocolSerializer unused_serializer(unused_ws);
+    BOOST_CHECK_THROW(unused_serializer.set_compression(999), std::runtime_error);
+    if (!compression_supported(ISMRMRD_COMPRESSION_DEFLATE)) {
+        BOOST_TEST_MESSAGE("Built without zlib, skipping compressed messages");
+        return;
+    }
+
+    // Smooth data with a trajectory, and an image with attributes
+    Acquisition acq(256, 4, 2);
+    for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+        acq.getDataPtr()[i] = std::complex<float>(float(i % 256), -float(i % 256));
+    }
+    for (size_t i = 0; i < acq.getNumberOfTrajElements(); i++) {
+        acq.getTrajPtr()[i] = float(i) / 2;
+    }
+    acq.scan_counter() = 5;
+    Image<std::complex<double> > img(32, 16, 1, 2);
+    for (size_t i = 0; i < img.getNumberOfDataElements(); i++) {
+        img.getDataPtr()[i] = std::complex<double>(double(i % 32), 1.0);
+    }
+    img.setAttributeString("<ismrmrdMeta/>");
+
+    uint16_t codecs[] = {ISMRMRD_COMPRESSION_DEFLATE, ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE};
+    for (size_t c = 0; c < 2; c++) {
+        std::stringstream ss;
+        OStreamView ws(ss);
+        ProtocolSerializer serializer(ws);
+        serializer.set_compression(codecs[c], 1);
+        serializer.serialize(acq);
+        serializer.serialize(img);
+        serializer.close();
+        BOOST_CHECK(ss.str().size() < acq.getDataSize() + img.getDataSize());
+
+        IStreamView rs(ss);
+        ProtocolDeserializer deserializer(rs);
+        BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+        BOOST_CHECK(deserializer.peek_compressed());
+        Acquisition acq2;
+        deserializer.deserialize(acq2);
+        BOOST_CHECK(acq2.getHead() == acq.getHead());
+        BOOST_CHECK_EQUAL_COLLECTIONS(acq2.data_begin(), acq2.data_end(), acq.data_begin(), acq.data_end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(acq2.traj_begin(), acq2.traj_end(), acq.traj_begin(), acq.traj_end());
+
+        BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_IMAGE);
+        BOOST_CHECK(deserializer.peek_compressed());
+        BOOST_CHECK_EQUAL(deserializer.peek_image_data_type(), ISMRMRD_CXDOUBLE);
+        Image<std::complex<double> > img2;
+        deserializer.deserialize(img2);
+        BOOST_CHECK_EQUAL(img2.getAttributeString(), "<ismrmrdMeta/>");
+        BOOST_CHECK_EQUAL_COLLECTIONS(img2.begin(), img2.end(), img.begin(), img.end());
+        BOOST_CHECK_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_CLOSE);
+        BOOST_CHECK(!deserializer.peek_compressed());
+    }
+
+    // Compressed messages are skipped like the uncompressed ones
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    OStreamView ws(ss);
+    ProtocolSerializer serializer(ws);
+    serializer.set_compression(ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE);
+    serialize_mixed_messages(serializer);
+    std::stringstream seekable(ss.str(), std::ios::in | std::ios::binary);
+    IStreamView rs(seekable);
+    check_skip(rs);
+
+    // A corrupted payload is detected
+    std::stringstream acq_only;
+    OStreamView acq_ws(acq_only);
+    ProtocolSerializer acq_serializer(acq_ws);
+    acq_serializer.set_compression(ISMRMRD_COMPRESSION_DEFLATE);
+    acq_serializer.serialize(acq);
+    std::string corrupt = acq_only.str();
+    corrupt[corrupt.size() - 20] ^= 0x55;
+    std::stringstream corrupt_ss(corrupt);
+    IStreamView corrupt_rs(corrupt_ss);
+    ProtocolDeserializer corrupt_deserializer(corrupt_rs);
+    Acquisition acq3;
+    BOOST_CHECK_THROW(corrupt_deserializer.deserialize(acq3), std::runtime_error);
+
+    // So is a compressed size the header does not allow, before it is allocated
+    std::string oversized = acq_only.str();
+    uint64_t compressed_size = uint64_t(1) << 40;
+    memcpy(&oversized[sizeof(uint16_t) + sizeof(AcquisitionHeader) + sizeof(uint16_t)], &compressed_size,
+           sizeof(uint64_t));
+    std::stringstream oversized_ss(oversized);
+    IStreamView oversized_rs(oversized_ss);
+    ProtocolDeserializer oversized_deserializer(oversized_rs);
+    BOOST_CHECK_THROW(oversized_deserializer.deserialize(acq3), std::runtime_error);
+}
+
+// Readouts of the k-space of a gaussian blob, itself a gaussian, with complex
+// gaussian noise of standard deviation sigma and a different gain per coil
+static std::vector<Acquisition> phantom_kspace(uint16_t samples, uint16_t lines, uint16_t coils, float sigma) {
+    boost::random::mt19937 rng(17);
+    boost::random::normal_distribution<float> noise(0.0f, sigma);
+    const float width = 3.0f;
+    std::vector<Acquisition> acqs;
+    for (uint16_t line = 0; line < lines; line++) {
+        Acquisition acq(samples, coils, 2);
+        acq.idx().kspace_encode_step_1 = line;
+        float ky = float(line - lines / 2);
+        for (uint16_t s = 0; s < samples; s++) {
+            float kx = float(s - samples / 2);
+            float value = 1000.0f * std::exp(-(kx * kx + ky * ky) / (2 * width * width));
+            for (uint16_t c = 0; c < coils; c++) {
+                std::complex<float> coil_value = std::polar(value * (1.0f + 0.5f * c), 0.7f * c);
+                acq.data(s, c) = coil_value + std::complex<float>(noise(rng), noise(rng));
+            }
+            acq.traj(0, s) = kx / samples;
+            acq.traj(1, s) = ky / lines;
+        }
+        acqs.push_back(acq);
+    }
+    return acqs;
+}
+
+static float max_channel_error(const Acquisition &acq, const Acquisition &decoded, uint16_t channel) {
+    float error = 0;
+    size_t offset = size_t(channel) * acq.number_of_samples();
+    for (size_t s = 0; s < acq.number_of_samples(); s++) {
+        std::complex<float> d = acq.getDataPtr()[offset + s] - decoded.getDataPtr()[offset + s];
+        error = std::max(error, std::max(std::fabs(d.real()), std::fabs(d.imag())));
+    }
+    return error;
+}
+
+static size_t serialized_size(const std::vector<Acquisition> &acqs, uint16_t codec, const QuantizationSettings &settings,
+                              std::vector<Acquisition> &decoded) {
+    std::stringstream ss;
+    OStreamView ws(ss);
+    ProtocolSerializer serializer(ws);
+    serializer.set_compression(codec);
+    serializer.set_quantization(settings);
+    for (size_t i = 0; i < acqs.size(); i++) {
+        serializer.serialize(acqs[i]);
+    }
+    serializer.close();
+
+    IStreamView rs(ss);
+    ProtocolDeserializer deserializer(rs);
+    decoded.resize(acqs.size());
+    for (size_t i = 0; i < acqs.size(); i++) {
+        BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+        BOOST_REQUIRE(deserializer.peek_compressed());
+        deserializer.deserialize(decoded[i]);
+    }
+    BOOST_CHECK_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_CLOSE);
+    return ss.str().size();
+}
+
+BOOST_AUTO_TEST_CASE(test_quantized_serialization) {
+    BOOST_CHECK_EQUAL(quantization_step(0.5f), 1.0f);
+    BOOST_CHECK_EQUAL(quantization_step(0.3f), 0.5f);
+    BOOST_CHECK_EQUAL(quantization_step(0.0f), 0.0f);
+    BOOST_CHECK_EQUAL(quantization_step(-1.0f), 0.0f);
+    BOOST_CHECK_EQUAL(compression_supported(ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE),
+                      compression_supported(ISMRMRD_COMPRESSION_DEFLATE));
+    if (!compression_supported(ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE)) {
+        BOOST_TEST_MESSAGE("Built without zlib, skipping quantized messages");
+        return;
+    }
+
+    const float sigma = 0.05f;
+    std::vector<Acquisition> acqs = phantom_kspace(128, 32, 4, sigma);
+    std::vector<Acquisition> decoded;
+    size_t lossless_size = serialized_size(acqs, ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE, QuantizationSettings(), decoded);
+
+    // The error is bounded by the tolerance, in the units of the data or of the noise level
+    QuantizationSettings settings[] = {QuantizationSettings(ISMRMRD_TOLERANCE_ABSOLUTE, 0.01f),
+                                       QuantizationSettings(ISMRMRD_TOLERANCE_NOISE, 0.5f)};
+    std::vector<float> scratch;
+    for (size_t m = 0; m < 2; m++) {
+        size_t size = serialized_size(acqs, ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, settings[m], decoded);
+        BOOST_CHECK_LT(size, lossless_size);
+        for (size_t i = 0; i < acqs.size(); i++) {
+            BOOST_REQUIRE(decoded[i].getHead() == acqs[i].getHead());
+            BOOST_CHECK_EQUAL_COLLECTIONS(decoded[i].traj_begin(), decoded[i].traj_end(), acqs[i].traj_begin(),
+                                          acqs[i].traj_end());
+            for (uint16_t c = 0; c < acqs[i].active_channels(); c++) {
+                float tolerance = settings[m].tolerance;
+                if (settings[m].mode == ISMRMRD_TOLERANCE_NOISE) {
+                    float noise = estimate_noise_level(&acqs[i].data(0, c), acqs[i].number_of_samples(), scratch);
+                    // Readouts far from the center of k-space are mostly noise
+                    if (i < 3 || i > 29) {
+                        BOOST_CHECK_CLOSE(noise, sigma, 25.0f);
+                    }
+                    tolerance *= noise;
+                }
+                BOOST_CHECK_LE(max_channel_error(acqs[i], decoded[i], c), tolerance);
+            }
+            // Quantizing in place gives the decoded data
+            Acquisition quantized = acqs[i];
+            quantize_acquisition(quantized, settings[m]);
+            BOOST_CHECK_EQUAL_COLLECTIONS(quantized.data_begin(), quantized.data_end(), decoded[i].data_begin(),
+                                          decoded[i].data_end());
+        }
+    }
+
+    // Channels that cannot be quantized are kept exactly, the others are still quantized
+    std::vector<Acquisition> special(1, acqs[0]);
+    special[0].data(3, 1) = std::complex<float>(std::numeric_limits<float>::quiet_NaN(), 0.0f);
+    special[0].data(5, 2) = std::complex<float>(1e30f, -1e30f);
+    serialized_size(special, ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE, settings[0], decoded);
+    BOOST_CHECK(memcmp(&decoded[0].data(0, 1), &special[0].data(0, 1), 2 * sizeof(float) * 128) == 0);
+    BOOST_CHECK(memcmp(&decoded[0].data(0, 2), &special[0].data(0, 2), 2 * sizeof(float) * 128) == 0);
+    BOOST_CHECK_GT(max_channel_error(special[0], decoded[0], 0), 0.0f);
+    BOOST_CHECK_LE(max_channel_error(special[0], decoded[0], 0), settings[0].tolerance);
+
+    // Images are compressed losslessly
+    std::stringstream ss;
+    OStreamView ws(ss);
+    ProtocolSerializer serializer(ws);
+    serializer.set_compression(ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE);
+    BOOST_CHECK_THROW(serializer.set_quantization(QuantizationSettings(7, 1.0f)), std::runtime_error);
+    Image<float> img(16, 16, 1, 1);
+    for (size_t i = 0; i < img.getNumberOfDataElements(); i++) {
+        img.getDataPtr()[i] = float(i) / 3;
+    }
+    serializer.serialize(img);
+    IStreamView rs(ss);
+    ProtocolDeserializer deserializer(rs);
+    BOOST_REQUIRE(deserializer.peek_compressed());
+    Image<float> img2;
+    deserializer.deserialize(img2);
+    BOOST_CHECK_EQUAL_COLLECTIONS(img2.begin(), img2.end(), img.begin(), img.end());
+}
+
+// Acquisitions of a recorded stream, test_stream_index
+static Acquisition indexed_acquisition(size_t n) {
+    Acquisition acq(uint16_t(8 + n % 3), 2, uint16_t(n % 2 ? 2 : 0));
+    for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+        acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i + 10 * n);
+    }
+    for (size_t i = 0; i < acq.getNumberOfTrajElements(); i++) {
+        acq.getTrajPtr()[i] = float(i + n);
+    }
+    acq.scan_counter() = uint32_t(100 + n);
+    acq.idx().slice = uint16_t(n % 3);
+    acq.idx().kspace_encode_step_1 = uint16_t(n);
+    return acq;
+}
+
+static void check_acquisition(const Acquisition &acq, size_t n) {
+    Acquisition expected = indexed_acquisition(n);
+    BOOST_CHECK(acq.getHead() == expected.getHead());
+    BOOST_CHECK_EQUAL_COLLECTIONS(acq.data_begin(), acq.data_end(), expected.data_begin(), expected.data_end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(acq.traj_begin(), acq.traj_end(), expected.traj_begin(), expected.traj_end());
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_index) {
+    const size_t count = 12;
+    bool compressed = compression_supported(ISMRMRD_COMPRESSION_DEFLATE);
+    std::string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    std::string index_path = StreamIndex::sidecar_path(path);
+    {
+        std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+        OStreamView ws(file);
+        ProtocolSerializer serializer(ws);
+        TextMessage txt;
+        txt.message = "recorded";
+        serializer.serialize(txt);
+        for (size_t n = 0; n < 4; n++) {
+            serializer.serialize(indexed_acquisition(n));
+        }
+        std::vector<Acquisition> batch;
+        for (size_t n = 4; n < 9; n++) {
+            batch.push_back(indexed_acquisition(n));
+        }
+        serializer.serialize(batch);
+        Image<float> img(4, 4, 1, 1);
+        img.setImageIndex(3);
+        img.setImageSeriesIndex(2);
+        serializer.serialize(img);
+        if (compressed) {
+            serializer.set_compression(ISMRMRD_COMPRESSION_DEFLATE);
+        }
+        for (size_t n = 9; n < count; n++) {
+            serializer.serialize(indexed_acquisition(n));
+        }
+        serializer.close();
+    }
+
+    StreamIndex index;
+    index.open(path);
+    BOOST_CHECK(boost::filesystem::exists(index_path));
+    BOOST_CHECK(index.closed());
+    BOOST_CHECK_EQUAL(index.stream_size(), boost::filesystem::file_size(path));
+    const std::vector<StreamIndexMessage> &messages = index.messages();
+    BOOST_REQUIRE_EQUAL(messages.size(), 10u);
+    BOOST_CHECK_EQUAL(messages[0].id, ISMRMRD_MESSAGE_TEXT);
+    BOOST_CHECK_EQUAL(messages[0].offset, 0u);
+    BOOST_CHECK_EQUAL(messages[5].id, ISMRMRD_MESSAGE_ACQUISITION_BATCH);
+    BOOST_CHECK_EQUAL(messages[5].acquisitions, 5u);
+    BOOST_CHECK_EQUAL(messages[5].first_acquisition, 4u);
+    BOOST_CHECK_EQUAL(messages[6].id, ISMRMRD_MESSAGE_IMAGE);
+    BOOST_CHECK_EQUAL(messages[6].data_type, ISMRMRD_FLOAT);
+    BOOST_CHECK_EQUAL(messages[6].image_index, 3);
+    BOOST_CHECK_EQUAL(messages[6].image_series_index, 2);
+    BOOST_CHECK_EQUAL(messages[7].id, compressed ? ISMRMRD_MESSAGE_COMPRESSED_ACQUISITION : ISMRMRD_MESSAGE_ACQUISITION);
+    for (size_t n = 1; n < messages.size(); n++) {
+        BOOST_CHECK_EQUAL(messages[n].offset, messages[n - 1].offset + messages[n - 1].size);
+    }
+    // The close message follows the last message
+    BOOST_CHECK_EQUAL(messages.back().offset + messages.back().size + sizeof(uint16_t), index.stream_size());
+    BOOST_CHECK_EQUAL(index.find_messages(ISMRMRD_MESSAGE_ACQUISITION).size(), 7u);
+
+    BOOST_REQUIRE_EQUAL(index.acquisitions().size(), count);
+    std::vector<size_t> slice = index.find_acquisitions(ISMRMRD_IDX_SLICE, 1);
+    BOOST_REQUIRE_EQUAL(slice.size(), 4u);
+    for (size_t i = 0; i < slice.size(); i++) {
+        BOOST_CHECK_EQUAL(slice[i], 1 + 3 * i);
+    }
+    BOOST_CHECK_EQUAL(index.find_scan_counter(107), 7u);
+    BOOST_CHECK_EQUAL(index.find_scan_counter(7), count);
+    BOOST_CHECK_THROW(index.find_acquisitions(ISMRMRD_IDX_NUMBER_OF_KEYS, 0), std::runtime_error);
+
+    // The second reader loads the sidecar
+    StreamIndex loaded;
+    loaded.load(index_path);
+    BOOST_CHECK_EQUAL(loaded.messages().size(), messages.size());
+    BOOST_CHECK_EQUAL(loaded.acquisitions().size(), count);
+    BOOST_CHECK_EQUAL(loaded.acquisitions()[6].data_offset, index.acquisitions()[6].data_offset);
+
+    // Random access, backwards
+    IndexedStreamReader reader(path);
+    Acquisition acq;
+    for (size_t n = count; n-- > 0;) {
+        reader.read_acquisition(n, acq);
+        check_acquisition(acq, n);
+    }
+    ProtocolDeserializer &deserializer = reader.message(6);
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_IMAGE);
+    BOOST_CHECK_EQUAL(deserializer.peek_image_header().image_index, 3);
+    Image<float> img;
+    deserializer.deserialize(img);
+    BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+    deserializer.deserialize(acq);
+    check_acquisition(acq, 9);
+    BOOST_CHECK_EQUAL(reader.message(0).peek(), ISMRMRD_MESSAGE_TEXT);
+    BOOST_CHECK_THROW(reader.message(messages.size()), std::runtime_error);
+    BOOST_CHECK_THROW(reader.read_acquisition(count, acq), std::runtime_error);
+
+#if __cplusplus >= 201103L
+    std::vector<Acquisition> decoded(count);
+    decode_acquisitions(path, index, 1, count, 3, [&](size_t n, const Acquisition &a) { decoded[n] = a; });
+    for (size_t n = 1; n < count; n++) {
+        check_acquisition(decoded[n], n);
+    }
+#endif
+
+    // A recording rewritten at the same length gets a new index
+    {
+        std::fstream file(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(messages[6].offset + sizeof(uint16_t) +
+                                               offsetof(ImageHeader, image_index)));
+        uint16_t image_index = 4;
+        file.write(reinterpret_cast<const char *>(&image_index), sizeof(uint16_t));
+    }
+    boost::filesystem::last_write_time(path, boost::filesystem::last_write_time(path) + 10);
+    StreamIndex rewritten;
+    rewritten.open(path);
+    BOOST_REQUIRE_EQUAL(rewritten.messages().size(), messages.size());
+    BOOST_CHECK_EQUAL(rewritten.messages()[6].image_index, 4);
+
+    // An interrupted recording, cut inside the batch
+    boost::filesystem::resize_file(path, messages[5].offset + messages[5].size / 2);
+    StreamIndex truncated;
+    truncated.open(path);
+    BOOST_CHECK(!truncated.closed());
+    BOOST_CHECK_EQUAL(truncated.messages().size(), 5u);
+    BOOST_CHECK_EQUAL(truncated.acquisitions().size(), 4u);
+    StreamIndex reloaded;
+    reloaded.load(index_path);
+    BOOST_CHECK_EQUAL(reloaded.messages().size(), 5u);
+
+    BOOST_CHECK_THROW(loaded.load(path), std::runtime_error);
+    boost::filesystem::remove(path);
+    boost::filesystem::remove(index_path);
+}
+
+#if __cplusplus >= 201103L
+BOOST_AUTO_TEST_CASE(test_background_producer) {
+    // More items than slots, in slots that keep their storage
+    int produced = 0;
+    BackgroundProducer<std::vector<int> > producer(4);
+    producer.start([&](std::vector<int> &slot) {
+        if (produced == 10) {
+            return false;
+        }
+        slot.assign(3, produced++);
+        return true;
+    });
+    for (int n = 0; n < 10; n++) {
+        std::vector<int> *item = producer.next();
+        BOOST_REQUIRE(item);
+        BOOST_CHECK_EQUAL(item->size(), 3u);
+        BOOST_CHECK_EQUAL(item->back(), n);
+    }
+    BOOST_CHECK(!producer.next());
+
+    // An error is rethrown after the items produced before it
+    BackgroundProducer<int> failing(2);
+    int count = 0;
+    failing.start([&](int &slot) {
+        if (count == 1) {
+            throw std::runtime_error("producer failed");
+        }
+        slot = count++;
+        return true;
+    });
+    BOOST_REQUIRE(failing.next());
+    BOOST_CHECK_THROW(failing.next(), std::runtime_error);
+
+    // Stopped while the ring is full
+    BackgroundProducer<int> unread(2);
+    unread.start([](int &slot) {
+        slot = 0;
+        return true;
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_reader) {
+    // More acquisitions than ring slots, so that the slots are reused
+    std::vector<Acquisition> acqs;
+    for (size_t n = 0; n < 20; n++) {
+        Acquisition acq(uint16_t(16 + n), 2, 0);
+        for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+            acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i + n);
+        }
+        acq.scan_counter() = uint32_t(n);
+        acqs.push_back(acq);
+    }
+    Image<float> img(8, 4, 1, 1);
+    std::fill(img.begin(), img.end(), 3.0f);
+    img.setAttributeString("attributes");
+    std::vector<size_t> dims(2, 5);
+    NDArray<int32_t> arr(dims);
+    std::fill(arr.begin(), arr.end(), 7);
+    TextMessage txt;
+    txt.message = "text";
+
+    std::stringstream ss;
+    OStreamView ws(ss);
+    ProtocolSerializer serializer(ws);
+    serializer.serialize(txt);
+    for (size_t i = 0; i < acqs.size(); i++) {
+        serializer.serialize(acqs[i]);
+        serializer.serialize(Waveform(16, 2));
+    }
+    serializer.serialize(img);
+    serializer.serialize(arr);
+    serializer.close();
+    std::string stream = ss.str();
+
+    {
+        IStreamView rs(ss);
+        std::set<uint16_t> skipped;
+        skipped.insert(ISMRMRD_MESSAGE_WAVEFORM);
+        StreamReader reader(rs, 4, skipped);
+
+        StreamMessage *msg = reader.next();
+        BOOST_REQUIRE(msg != NULL);
+        BOOST_REQUIRE_EQUAL(msg->id, ISMRMRD_MESSAGE_TEXT);
+        BOOST_CHECK_EQUAL(msg->text.message, txt.message);
+        for (size_t i = 0; i < acqs.size(); i++) {
+            msg = reader.next();
+            BOOST_REQUIRE(msg != NULL);
+            BOOST_REQUIRE_EQUAL(msg->id, ISMRMRD_MESSAGE_ACQUISITION);
+            BOOST_CHECK(msg->acquisition.getHead() == acqs[i].getHead());
+            BOOST_CHECK_EQUAL_COLLECTIONS(msg->acquisition.data_begin(), msg->acquisition.data_end(),
+                                          acqs[i].data_begin(), acqs[i].data_end());
+        }
+        msg = reader.next();
+        BOOST_REQUIRE(msg != NULL);
+        BOOST_REQUIRE_EQUAL(msg->id, ISMRMRD_MESSAGE_IMAGE);
+        BOOST_REQUIRE_EQUAL(msg->data_type, ISMRMRD_FLOAT);
+        BOOST_CHECK_EQUAL(msg->image<float>().getAttributeString(), std::string("attributes"));
+        BOOST_CHECK_EQUAL_COLLECTIONS(msg->image<float>().begin(), msg->image<float>().end(), img.begin(), img.end());
+        msg = reader.next();
+        BOOST_REQUIRE(msg != NULL);
+        BOOST_REQUIRE_EQUAL(msg->id, ISMRMRD_MESSAGE_NDARRAY);
+        BOOST_REQUIRE_EQUAL(msg->data_type, ISMRMRD_INT);
+        BOOST_CHECK_EQUAL_COLLECTIONS(msg->ndarray<int32_t>().begin(), msg->ndarray<int32_t>().end(), arr.begin(),
+                                      arr.end());
+        BOOST_CHECK(reader.next() == NULL);
+        BOOST_CHECK(reader.next() == NULL);
+    }
+
+    // A stream that ends without a close message is an error of the consumer
+    std::stringstream truncated(stream.substr(0, stream.size() / 2));
+    IStreamView rs(truncated);
+    StreamReader reader(rs);
+    BOOST_CHECK_THROW(while (reader.next()) {}, std::exception);
+
+    // Stopping a reader that has not been read to the end
+    std::stringstream unread(stream);
+    IStreamView rs2(unread);
+    StreamReader abandoned(rs2, 2);
+    StreamMessage *first = abandoned.next();
+    BOOST_REQUIRE(first != NULL);
+    // Timestamped by the reader thread
+    BOOST_CHECK(first->received > 0);
+}
+
+// A worker of test_stream_router: one image per slice, after the close message
+static void slice_worker(ReadableStreamView &in, WritableStreamView &out) {
+    ProtocolDeserializer deserializer(in);
+    ProtocolSerializer serializer(out);
+    StreamMessage msg;
+    // Runs on a worker thread, where errors are reported by route_to_threads
+    if (!read_message(deserializer, msg) || msg.id != ISMRMRD_MESSAGE_HEADER) {
+        throw std::runtime_error("The header was not routed to the worker");
+    }
+    size_t noise = 0;
+    std::map<uint16_t, float> sums;
+    while (read_message(deserializer, msg)) {
+        std::vector<Acquisition> acqs(1, msg.acquisition);
+        if (msg.id == ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+            acqs = msg.acquisitions;
+        } else if (msg.id != ISMRMRD_MESSAGE_ACQUISITION) {
+            continue;
+        }
+        for (size_t i = 0; i < acqs.size(); i++) {
+            if (acqs[i].isFlagSet(ISMRMRD_ACQ_IS_NOISE_MEASUREMENT)) {
+                noise++;
+            } else {
+                sums[acqs[i].idx().slice] += acqs[i].data(0, 0).real();
+            }
+        }
+    }
+    // Workers finishing at different times must not change the merged order
+    std::this_thread::sleep_for(std::chrono::milliseconds(5 * (sums.begin()->first % 3)));
+    TextMessage txt;
+    txt.message = "noise " + std::to_string(noise);
+    serializer.serialize(txt);
+    for (std::map<uint16_t, float>::const_iterator it = sums.begin(); it != sums.end(); ++it) {
+        Image<float> img(4, 4, 1, 1);
+        std::fill(img.begin(), img.end(), it->second);
+        img.setImageSeriesIndex(1);
+        img.setImageIndex(it->first);
+        serializer.serialize(img);
+    }
+    serializer.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_router) {
+    const uint16_t slices = 7;
+    const uint16_t lines = 5;
+    IsmrmrdHeader hdr;
+    hdr.experimentalConditions.H1resonanceFrequency_Hz = 63500000;
+
+    std::stringstream ss;
+    OStreamView ws(ss);
+    ProtocolSerializer serializer(ws);
+    serializer.serialize(hdr);
+    Acquisition noise(8, 1, 0);
+    noise.setFlag(ISMRMRD_ACQ_IS_NOISE_MEASUREMENT);
+    serializer.serialize(noise);
+    std::vector<Acquisition> batch;
+    for (uint16_t line = 0; line < lines; line++) {
+        for (uint16_t slice = 0; slice < slices; slice++) {
+            Acquisition acq(8, 1, 0);
+            acq.idx().slice = slice;
+            acq.idx().kspace_encode_step_1 = line;
+            acq.data(0, 0) = complex_float_t(float(slice * 100 + line), 0);
+            // The last line is sent in a batch, together with another noise scan
+            if (line + 1 < lines) {
+                serializer.serialize(acq);
+            } else {
+                batch.push_back(acq);
+            }
+        }
+    }
+    batch.push_back(noise);
+    serializer.serialize(batch);
+    serializer.close();
+
+    for (size_t workers = 1; workers <= 4; workers++) {
+        std::stringstream in(ss.str());
+        IStreamView rs(in);
+        std::stringstream result;
+        OStreamView out(result);
+        route_to_threads(rs, out, ISMRMRD_IDX_SLICE, workers, slice_worker);
+
+        IStreamView results(result);
+        ProtocolDeserializer deserializer(results);
+        StreamMessage msg;
+        std::vector<uint16_t> indices;
+        size_t texts = 0;
+        while (read_message(deserializer, msg)) {
+            if (msg.id == ISMRMRD_MESSAGE_TEXT) {
+                BOOST_CHECK_EQUAL(msg.text.message, "noise 2");
+                texts++;
+                continue;
+            }
+            BOOST_REQUIRE_EQUAL(msg.id, ISMRMRD_MESSAGE_IMAGE);
+            const Image<float> &img = msg.image<float>();
+            uint16_t slice = img.getImageIndex();
+            // Every line of the slice went to the same worker
+            BOOST_CHECK_EQUAL(img.getDataPtr()[0], float(slice * 100 * lines + lines * (lines - 1) / 2));
+            indices.push_back(slice);
+        }
+        BOOST_CHECK_EQUAL(texts, workers);
+        BOOST_REQUIRE_EQUAL(indices.size(), slices);
+        for (uint16_t slice = 0; slice < slices; slice++) {
+            BOOST_CHECK_EQUAL(indices[slice], slice);
+        }
+    }
+
+    // The error of a worker is reported
+    std::stringstream in(ss.str());
+    IStreamView rs(in);
+    std::stringstream result;
+    OStreamView out(result);
+    BOOST_CHECK_THROW(route_to_threads(rs, out, ISMRMRD_IDX_SLICE, 3,
+                                       [](ReadableStreamView &, WritableStreamView &) {
+                                           throw std::runtime_error("worker failed");
+                                       }),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(route_to_threads(rs, out, ISMRMRD_IDX_NUMBER_OF_KEYS, 3, slice_worker), std::runtime_error);
+}
+#endif
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(test_fd_stream_serialization) {
+    // Acquisitions of different sizes, with small buffers so that fields straddle
+    // buffer boundaries and the sample data bypasses the buffer
+    std::vector<Acquisition> acqs;
+    for (size_t n = 1; n <= 8; n++) {
+        Acquisition acq(uint16_t(16 * n), uint16_t(n), 2);
+        for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+            acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i + n);
+        }
+        acq.scan_counter() = uint32_t(n);
+        acqs.push_back(acq);
+    }
+    Waveform wf(32, 4);
+    wf.head.time_stamp = 42;
+
+    FILE *file = tmpfile();
+    BOOST_REQUIRE(file != NULL);
+    int fd = fileno(file);
+    {
+        FdWriteStream ws(fd, 500);
+        ProtocolSerializer serializer(ws);
+        for (size_t i = 0; i < acqs.size(); i++) {
+            serializer.serialize(acqs[i]);
+        }
+        serializer.serialize(wf);
+        serializer.close();
+        BOOST_CHECK(!ws.bad());
+    }
+    BOOST_REQUIRE_EQUAL(lseek(fd, 0, SEEK_SET), 0);
+
+    FdReadStream rs(fd, 300);
+    ProtocolDeserializer deserializer(rs);
+    for (size_t i = 0; i < acqs.size(); i++) {
+        Acquisition acq;
+        BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+        deserializer.deserialize(acq);
+        BOOST_CHECK(acq.getHead() == acqs[i].getHead());
+        BOOST_CHECK_EQUAL_COLLECTIONS(acq.data_begin(), acq.data_end(), acqs[i].data_begin(), acqs[i].data_end());
+    }
+    Waveform wf2;
+    deserializer.deserialize(wf2);
+    BOOST_CHECK_EQUAL(wf2.head.time_stamp, wf.head.time_stamp);
+    BOOST_CHECK_EQUAL_COLLECTIONS(wf.begin_data(), wf.end_data(), wf2.begin_data(), wf2.end_data());
+    BOOST_CHECK_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_CLOSE);
+    BOOST_CHECK(!rs.eof());
+
+    // Reading past the end of the input sets eof
+    char c;
+    rs.read(&c, 1);
+    BOOST_CHECK(rs.eof());
+    fclose(file);
+}
+
+// Sends acquisitions from client to server, small enough to fit in the socket buffers
+static void check_socket_round_trip(int client, int server, const SocketOptions &options) {
+    std::vector<Acquisition> acqs;
+    for (size_t n = 1; n <= 4; n++) {
+        Acquisition acq(uint16_t(32 * n), 2, 0);
+        for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+            acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i + n);
+        }
+        acq.scan_counter() = uint32_t(n);
+        acqs.push_back(acq);
+    }
+    {
+        SocketWriteStream ws(client, options);
+        ProtocolSerializer serializer(ws);
+        for (size_t i = 0; i < acqs.size(); i++) {
+            serializer.serialize(acqs[i]);
+        }
+        serializer.close();
+        BOOST_CHECK(!ws.bad());
+    }
+    close(client);
+
+    SocketReadStream rs(server, options);
+    ProtocolDeserializer deserializer(rs);
+    for (size_t i = 0; i < acqs.size(); i++) {
+        Acquisition acq;
+        BOOST_REQUIRE_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_ACQUISITION);
+        deserializer.deserialize(acq);
+        BOOST_CHECK(acq.getHead() == acqs[i].getHead());
+        BOOST_CHECK_EQUAL_COLLECTIONS(acq.data_begin(), acq.data_end(), acqs[i].data_begin(), acqs[i].data_end());
+    }
+    BOOST_CHECK_EQUAL(deserializer.peek(), ISMRMRD_MESSAGE_CLOSE);
+    close(server);
+}
+
+BOOST_AUTO_TEST_CASE(test_socket_stream_serialization) {
+    SocketOptions options;
+    options.send_buffer_size = 64 * 1024;
+    options.receive_buffer_size = 64 * 1024;
+    options.timeout_ms = 5000;
+    options.stream_buffer_size = 500;
+
+    // TCP loopback, the connection is established before it is accepted
+    int listener = listen_tcp("127.0.0.1", 0);
+    int client = connect_tcp("127.0.0.1", socket_port(listener));
+    int server = accept_connection(listener);
+    check_socket_round_trip(client, server, options);
+
+    // Corked, buffering messages until the stream is closed
+    options.cork = true;
+    options.flush_messages = false;
+    client = connect_tcp("127.0.0.1", socket_port(listener));
+    server = accept_connection(listener);
+    check_socket_round_trip(client, server, options);
+    close(listener);
+
+    std::stringstream path;
+    path << "/tmp/ismrmrd_test_" << getpid() << ".sock";
+    listener = listen_unix(path.str());
+    client = connect_unix(path.str());
+    server = accept_connection(listener);
+    check_socket_round_trip(client, server, SocketOptions());
+
+    // A read that gets no data within the timeout throws
+    client = connect_unix(path.str());
+    server = accept_connection(listener);
+    options.timeout_ms = 50;
+    SocketReadStream rs(server, options);
+    char c;
+    BOOST_CHECK_THROW(rs.read(&c, 1), std::runtime_error);
+    close(client);
+    close(server);
+    close(listener);
+    unlink(path.str().c_str());
+
+    BOOST_CHECK_THROW(connect_unix(path.str()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_stream_serialization) {
+    std::stringstream name;
+    name << "/ismrmrd_test_shm_" << getpid();
+    BOOST_CHECK_THROW(ShmRing(name.str(), 4096, 3), std::runtime_error);
+    BOOST_CHECK_THROW(ShmRing ring(name.str()), std::runtime_error);
+
+    // Few small slots, so that messages span slots and the ring wraps around
+    ShmRing ring(name.str(), 4096, 4);
+    const size_t count = 20;
+    pid_t child = fork();
+    BOOST_REQUIRE(child >= 0);
+    if (child == 0) {
+        int status = 0;
+        try {
+            ShmRing shared(name.str());
+            ShmRingWriter ws(shared);
+            ProtocolSerializer serializer(ws);
+            serialize_mixed_messages(serializer);
+            for (size_t n = 0; n < count; n++) {
+                Acquisition acq(64, 4, 2);
+                for (size_t i = 0; i < acq.getNumberOfDataElements(); i++) {
+                    acq.getDataPtr()[i] = value_from_size_t<std::complex<float> >(i + n);
+                }
+                acq.scan_counter() = uint32_t(n);
+                serializer.serialize(acq);
+            }
+        } catch (...) {
+            status = 1;
+        }
+        _exit(status);
+    }
+
+    ShmRingReader rs(ring);
+    check_skip(rs);
+
+    // The acquisitions after the close message are used in place
+    ShmSlotView slot;
+    ShmAcquisitionView view;
+    size_t n = 0;
+    while (rs.acquire(slot)) {
+        BOOST_REQUIRE(view_acquisition(slot, view));
+        BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(view.data) % 4, 0u);
+        BOOST_CHECK_EQUAL(view.head->scan_counter, n);
+        BOOST_CHECK_EQUAL(view.head->number_of_samples, 64);
+        BOOST_CHECK(view.data[5] == value_from_size_t<std::complex<float> >(5 + n));
+        rs.release();
+        n++;
+    }
+    BOOST_CHECK_EQUAL(n, count);
+    int status = -1;
+    BOOST_REQUIRE_EQUAL(waitpid(child, &status, 0), child);
+    BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    char c;
+    rs.read(&c, 1);
+    BOOST_CHECK(rs.eof());
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_stream_failures) {
+    std::stringstream name;
+    name << "/ismrmrd_test_shm_failures_" << getpid();
+    ShmRing ring(name.str(), 4096, 4);
+    ShmRingReader rs(ring);
+
+    // The writer sends one message and dies without closing the stream
+    pid_t child = fork();
+    BOOST_REQUIRE(child >= 0);
+    if (child == 0) {
+        ShmRing shared(name.str());
+        ShmRingWriter ws(shared);
+        memcpy(ws.reserve(), "hello", 5);
+        ws.commit(5);
+        _exit(0);
+    }
+    int status = -1;
+    BOOST_REQUIRE_EQUAL(waitpid(child, &status, 0), child);
+
+    ShmSlotView slot;
+    BOOST_REQUIRE(rs.acquire(slot));
+    BOOST_CHECK_EQUAL(std::string(slot.data, slot.size), "hello");
+    rs.release();
+    BOOST_CHECK_THROW(rs.acquire(slot), std::runtime_error);
+
+    // A slot whose size, at the start of the slot, is larger than the slot
+    ShmRingWriter ws(ring);
+    char *data = ws.reserve();
+    ws.commit(5);
+    uint32_t size = uint32_t(ring.slot_size() + 1);
+    memcpy(data - 14, &size, sizeof(size));
+    BOOST_CHECK_THROW(rs.acquire(slot), std::runtime_error);
+}
+
+static void check_acquisition_view(const AcquisitionView &view, size_t n) {
+    Acquisition expected = indexed_acquisition(n);
+    BOOST_CHECK(*view.head == expected.getHead());
+    BOOST_CHECK_EQUAL(view.getNumberOfDataElements(), expected.getNumberOfDataElements());
+    BOOST_CHECK_EQUAL(view.getTrajSize(), expected.getTrajSize());
+    BOOST_CHECK_EQUAL_COLLECTIONS(view.data, view.data + view.getNumberOfDataElements(), expected.data_begin(),
+                                  expected.data_end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(view.traj, view.traj + view.getNumberOfTrajElements(), expected.traj_begin(),
+                                  expected.traj_end());
+}
+
+// Whether the view points into the mapped file
+static bool in_mapping(const MmapReadStream &rs, const void *data) {
+    const char *p = static_cast<const char *>(data);
+    return p >= rs.data() && p < rs.data() + rs.size();
+}
+
+BOOST_AUTO_TEST_CASE(test_mmap_stream_views) {
+    const size_t count = 8;
+    bool compressed = compression_supported(ISMRMRD_COMPRESSION_DEFLATE);
+    Image<float> img(16, 8, 1, 2);
+    for (size_t i = 0; i < img.getNumberOfDataElements(); i++) {
+        img.getDataPtr()[i] = float(i);
+    }
+    img.setAttributeString("<ismrmrdMeta/>");
+    Image<std::complex<double> > cimg(4, 4);
+    cimg.getDataPtr()[3] = std::complex<double>(1, 2);
+
+    std::string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    {
+        std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+        OStreamView ws(file);
+        ProtocolSerializer serializer(ws);
+        for (size_t n = 0; n < count; n++) {
+            serializer.serialize(indexed_acquisition(n));
+        }
+        serializer.serialize(img);
+        serializer.serialize(cimg);
+        if (compressed) {
+            serializer.set_compression(ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE);
+            serializer.serialize(indexed_acquisition(count));
+            serializer.serialize(img);
+        }
+        serializer.close();
+    }
+
+    MmapReadStream rs(path);
+    ProtocolDeserializer deserializer(rs);
+    AcquisitionView view;
+    size_t in_place = 0;
+    for (size_t n = 0; n < count; n++) {
+        deserializer.deserialize(view);
+        check_acquisition_view(view, n);
+        // Data aligned in the file is used in place, the rest is copied aligned
+        BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(view.data) % 4, 0u);
+        in_place += in_mapping(rs, view.data) ? 1 : 0;
+    }
+    BOOST_CHECK(in_place > 0);
+
+    ImageView<double> wrong_type;
+    BOOST_CHECK_THROW(deserializer.deserialize(wrong_type), std::runtime_error);
+    ImageView<int32_t> same_size_type;
+    BOOST_CHECK_THROW(deserializer.deserialize(same_size_type), std::runtime_error);
+    ImageView<float> img_view;
+    deserializer.deserialize(img_view);
+    BOOST_CHECK_EQUAL(memcmp(img_view.head, &img.getHead(), sizeof(ImageHeader)), 0);
+    BOOST_CHECK_EQUAL(std::string(img_view.attribute_string, img_view.attribute_string_length), "<ismrmrdMeta/>");
+    BOOST_CHECK(in_mapping(rs, img_view.attribute_string));
+    BOOST_CHECK_EQUAL(img_view.getDataSize(), img.getDataSize());
+    BOOST_CHECK_EQUAL_COLLECTIONS(img_view.data, img_view.data + img_view.getNumberOfDataElements(), img.begin(),
+                                  img.end());
+    ImageView<std::complex<double> > cimg_view;
+    deserializer.deserialize(cimg_view);
+    BOOST_CHECK_EQUAL(cimg_view.attribute_string_length, 0u);
+    BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(cimg_view.data) % 8, 0u);
+    BOOST_CHECK(cimg_view.data[3] == std::complex<double>(1, 2));
+
+    // Compressed messages are viewed in the buffers of the deserializer
+    if (compressed) {
+        deserializer.deserialize(view);
+        check_acquisition_view(view, count);
+        BOOST_CHECK(!in_mapping(rs, view.data));
+        deserializer.deserialize(img_view);
+        BOOST_CHECK_EQUAL(std::string(img_view.attribute_string, img_view.attribute_string_length), "<ismrmrdMeta/>");
+        BOOST_CHECK_EQUAL_COLLECTIONS(img_view.data, img_view.data + img_view.getNumberOfDataElements(), img.begin(),
+                                      img.end());
+    }
+    BOOST_CHECK_THROW(deserializer.deserialize(view), ProtocolStreamClosed);
+    BOOST_CHECK_EQUAL(rs.position(), rs.size());
+
+    // Streams without memory in place are read into the buffers of the deserializer
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    IStreamView is(file);
+    ProtocolDeserializer copying(is);
+    for (size_t n = 0; n < count; n++) {
+        copying.deserialize(view);
+        check_acquisition_view(view, n);
+    }
+
+    // Owning messages read the same from a mapping
+    rs.seek(0);
+    ProtocolDeserializer owning(rs);
+    Acquisition acq;
+    owning.deserialize(acq);
+    check_acquisition(acq, 0);
+
+    char c;
+    rs.seek(rs.size());
+    BOOST_CHECK(rs.read_in_place(1) == NULL);
+    BOOST_CHECK(!rs.eof());
+    rs.read(&c, 1);
+    BOOST_CHECK(rs.eof());
+    BOOST_CHECK_THROW(rs.seek(rs.size() + 1), std::runtime_error);
+    boost::filesystem::remove(path);
+    BOOST_CHECK_THROW(MmapReadStream missing(path), std::runtime_error);
+
+    std::ofstream(path.c_str()).close();
+    MmapReadStream empty(path);
+    BOOST_CHECK_EQUAL(empty.size(), 0u);
+    empty.read(&c, 1);
+    BOOST_CHECK(empty.eof());
+    boost::filesystem::remove(path);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,8 +1,10 @@
 #include "ismrmrd/dataset.h"
 #include "ismrmrd/serialization.h"
 #include "ismrmrd/serialization_iostream.h"
+#include "ismrmrd/stream_reader.h"
 #include "ismrmrd_io_utils.h"
 
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <fstream>
 #include <iostream>
@@ -10,10 +12,122 @@
 
 namespace po = boost::program_options;
 
-void serialize_to_stream(const std::string &input_file, const std::string &groupname, const std::vector<std::string> &image_series, std::ostream &os, std::string config_file, std::string config_text) {
-    ISMRMRD::Dataset d(input_file.c_str(), groupname.c_str(), false);
+// Maps a --compression name to its codec
+uint16_t parse_compression(const std::string &name) {
+    if (name == "none") {
+        return ISMRMRD::ISMRMRD_COMPRESSION_NONE;
+    } else if (name == "deflate") {
+        return ISMRMRD::ISMRMRD_COMPRESSION_DEFLATE;
+    } else if (name == "shuffle-deflate") {
+        return ISMRMRD::ISMRMRD_COMPRESSION_SHUFFLE_DEFLATE;
+    } else if (name == "quantized") {
+        return ISMRMRD::ISMRMRD_COMPRESSION_QUANTIZED_DEFLATE;
+    }
+    throw std::runtime_error("Unknown compression: " + name);
+}
+
+// Acquisitions and waveforms of a dataset, merged by timestamp
+struct ReadBlock {
+    std::vector<ISMRMRD::Acquisition> acquisitions;
+    std::vector<ISMRMRD::Waveform> waveforms;
+    // Message order: false for the next acquisition, true for the next waveform
+    std::vector<bool> order;
+};
+
+// Reads the acquisitions and waveforms of a dataset on a background thread,
+// with block reads of up to block_size messages, up to depth blocks ahead
+// of the serializer. Acquisitions and waveforms are each assumed to be sorted
+// by timestamp, the waveforms are merged in before the first acquisition that
+// is not earlier.
+class BlockReader {
+public:
+    BlockReader(ISMRMRD::Dataset &d, size_t block_size, size_t depth)
+        : _d(d), _block_size(std::max<size_t>(block_size, 1)), _acquisitions(d.getNumberOfAcquisitions()),
+          _waveforms(d.getNumberOfWaveforms()), _a(0), _w(0), _w_first(0), _producer(std::max<size_t>(depth, 1)) {
+        _producer.start([this](ReadBlock &block) { return read(block); });
+    }
+
+    // The next block, valid until the following call, NULL after the last one.
+    // An error of the reader thread is rethrown here.
+    const ReadBlock *next() {
+        return _producer.next();
+    }
+
+    BlockReader(const BlockReader &) = delete;
+    BlockReader &operator=(const BlockReader &) = delete;
+
+private:
+    // Reads the block holding waveform _w, returns false if there are none left
+    bool fetch_waveform() {
+        if (_w >= _waveforms) {
+            return false;
+        }
+        if (_w - _w_first >= _waveform_block.size()) {
+            uint32_t count = static_cast<uint32_t>(std::min<size_t>(_block_size, _waveforms - _w));
+            _d.readWaveforms(_w, count, _waveform_block);
+            _w_first = _w;
+        }
+        return true;
+    }
+
+    const ISMRMRD::Waveform &waveform() const {
+        return _waveform_block[_w - _w_first];
+    }
+
+    void add_waveform(ReadBlock &block) {
+        block.waveforms.push_back(waveform());
+        block.order.push_back(true);
+        _w++;
+    }
+
+    // Fills the next block, returns false once everything has been read
+    bool read(ReadBlock &block) {
+        block.waveforms.clear();
+        block.order.clear();
+        uint32_t count = static_cast<uint32_t>(std::min<size_t>(_block_size, _acquisitions - _a));
+        _d.readAcquisitions(_a, count, block.acquisitions);
+        _a += count;
+        for (uint32_t n = 0; n < count; n++) {
+            uint32_t time_stamp = block.acquisitions[n].getHead().acquisition_time_stamp;
+            while (fetch_waveform() && !(time_stamp < waveform().head.time_stamp)) {
+                add_waveform(block);
+            }
+            block.order.push_back(false);
+        }
+        if (_a == _acquisitions) {
+            while (block.order.size() < _block_size && fetch_waveform()) {
+                add_waveform(block);
+            }
+        }
+        return !block.order.empty();
+    }
+
+    ISMRMRD::Dataset &_d;
+    size_t _block_size;
+    uint32_t _acquisitions;
+    uint32_t _waveforms;
+    // Next acquisition and waveform to read
+    uint32_t _a;
+    uint32_t _w;
+    // Waveforms read ahead, from _w_first on
+    uint32_t _w_first;
+    std::vector<ISMRMRD::Waveform> _waveform_block;
+    // Last, so that the thread is joined before the members it uses go away
+    ISMRMRD::BackgroundProducer<ReadBlock> _producer;
+};
+
+void serialize_to_stream(const std::string &input_file, const std::string &groupname, const std::vector<std::string> &image_series, std::ostream &os, std::string config_file, std::string config_text, uint16_t compression, int compression_level, const ISMRMRD::QuantizationSettings &quantization, size_t batch_size, size_t block_size, size_t buffer_depth, bool stats) {
+    ISMRMRD::Dataset d(input_file.c_str(), groupname.c_str(), ISMRMRD::DATASET_READ_ONLY);
     ISMRMRD::OStreamView ws(os);
     ISMRMRD::ProtocolSerializer serializer(ws);
+    ISMRMRD::StreamStatistics statistics;
+    if (stats) {
+        serializer.set_statistics(&statistics);
+    }
+    if (compression != ISMRMRD::ISMRMRD_COMPRESSION_NONE) {
+        serializer.set_compression(compression, compression_level);
+        serializer.set_quantization(quantization);
+    }
 
     if (config_file.size()) {
         ISMRMRD::ConfigFile cfg;
@@ -81,43 +195,39 @@ void serialize_to_stream(const std::string &input_file, const std::string &group
             }
         }
     } else {
-        // Here we implement the pattern of merge sorting acquisitions and waveforms based on timestamp.
-        // For each dataset of waveforms and acquisitions, we will assume that they are sorted by timestamp.
-        unsigned int number_of_acquisitions = d.getNumberOfAcquisitions();
-        unsigned int number_of_waveforms = d.getNumberOfWaveforms();
-        unsigned int a = 0, a_fetched = number_of_acquisitions, w = 0, w_fetched = number_of_waveforms;
-        ISMRMRD::Acquisition acq;
-        ISMRMRD::Waveform wfm;
-        while (a < number_of_acquisitions || w < number_of_waveforms) {
-            if (a < number_of_acquisitions && a_fetched != a) {
-                d.readAcquisition(a, acq);
-                a_fetched = a;
-            }
-            if (w < number_of_waveforms && w_fetched != w) {
-                d.readWaveform(w, wfm);
-                w_fetched = w;
-            }
-
-            // If we have both acquisitions and waveforms, advance the one with the
-            // smaller timestamp, otherwise advance the one that exists
-            if (a < number_of_acquisitions && w < number_of_waveforms) {
-                if (acq.getHead().acquisition_time_stamp < wfm.head.time_stamp) {
-                    serializer.serialize(acq);
-                    a++;
+        // The file is read and merged on a background thread, so reading the
+        // next blocks overlaps with serializing and writing the current one
+        BlockReader reader(d, block_size, buffer_depth);
+        // Consecutive acquisitions are sent in batches of up to batch_size
+        std::vector<ISMRMRD::Acquisition> batch;
+        while (const ReadBlock *block = reader.next()) {
+            size_t a = 0, w = 0;
+            for (size_t i = 0; i < block->order.size(); i++) {
+                if (block->order[i]) {
+                    if (!batch.empty()) {
+                        serializer.serialize(batch);
+                        batch.clear();
+                    }
+                    serializer.serialize(block->waveforms[w++]);
+                } else if (batch_size > 1) {
+                    batch.push_back(block->acquisitions[a++]);
+                    if (batch.size() == batch_size) {
+                        serializer.serialize(batch);
+                        batch.clear();
+                    }
                 } else {
-                    serializer.serialize(wfm);
-                    w++;
+                    serializer.serialize(block->acquisitions[a++]);
                 }
-            } else if (a < number_of_acquisitions) {
-                serializer.serialize(acq);
-                a++;
-            } else {
-                serializer.serialize(wfm);
-                w++;
             }
         }
+        if (!batch.empty()) {
+            serializer.serialize(batch);
+        }
     }
     serializer.close();
+    if (stats) {
+        statistics.print(std::cerr);
+    }
 }
 
 int main(int argc, char **argv) {
@@ -134,6 +244,14 @@ int main(int argc, char **argv) {
     bool use_stdout = false;
     std::vector<std::string> image_series;
     std::string groupname;
+    std::string compression_name;
+    int compression_level = -1;
+    float noise_tolerance = 0.5f;
+    float tolerance = 0;
+    size_t batch_size = 1;
+    size_t block_size = 64;
+    size_t buffer_depth = 4;
+    bool stats = false;
 
     // clang-format off
     desc.add_options()
@@ -144,7 +262,15 @@ int main(int argc, char **argv) {
         ("group,g", po::value<std::string>(&groupname)->default_value("dataset"), "group name")
         ("image-series,s", po::value<std::vector<std::string> >(&image_series)->multitoken(), "image series to extract")
         ("config-file,c", po::value<std::string>(&config_file), "Configuration name (aka config file)")
-        ("local-config-file,C", po::value<std::string>(&local_config_file), "Configuration text file");
+        ("local-config-file,C", po::value<std::string>(&local_config_file), "Configuration text file")
+        ("compression", po::value<std::string>(&compression_name)->default_value("none"), "Compress acquisitions and images: none, deflate, shuffle-deflate or quantized (lossy for acquisitions)")
+        ("compression-level", po::value<int>(&compression_level)->default_value(-1), "Compression level, 1 (fastest) to 9 (smallest), -1 for the default")
+        ("noise-tolerance", po::value<float>(&noise_tolerance)->default_value(0.5f), "Largest error of quantized compression, as a fraction of the noise level")
+        ("tolerance", po::value<float>(&tolerance), "Largest error of quantized compression, in the units of the data (instead of --noise-tolerance)")
+        ("batch-size", po::value<size_t>(&batch_size)->default_value(1), "Send consecutive acquisitions in batch messages of up to this many acquisitions (uncompressed)")
+        ("block-size", po::value<size_t>(&block_size)->default_value(64), "Acquisitions or waveforms read from the file at a time")
+        ("buffer-depth", po::value<size_t>(&buffer_depth)->default_value(4), "Blocks of acquisitions read ahead of the serializer")
+        ("stats", po::bool_switch(&stats), "Print the count, size and time of the messages sent to stderr");
     // clang-format on
 
     po::variables_map vm;
@@ -172,6 +298,33 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    uint16_t compression;
+    try {
+        compression = parse_compression(compression_name);
+    } catch (std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!ISMRMRD::compression_supported(compression)) {
+        std::cerr << "Error: Compression " << compression_name << " is not supported by this build" << std::endl;
+        return 1;
+    }
+
+    if (batch_size > ISMRMRD::ISMRMRD_MAX_BATCH_ACQUISITIONS) {
+        std::cerr << "Error: --batch-size cannot exceed " << ISMRMRD::ISMRMRD_MAX_BATCH_ACQUISITIONS << std::endl;
+        return 1;
+    }
+
+    if (batch_size > 1 && compression != ISMRMRD::ISMRMRD_COMPRESSION_NONE) {
+        std::cerr << "Error: Acquisition batches are not compressed, cannot use --batch-size with --compression" << std::endl;
+        return 1;
+    }
+
+    ISMRMRD::QuantizationSettings quantization(ISMRMRD::ISMRMRD_TOLERANCE_NOISE, noise_tolerance);
+    if (vm.count("tolerance")) {
+        quantization = ISMRMRD::QuantizationSettings(ISMRMRD::ISMRMRD_TOLERANCE_ABSOLUTE, tolerance);
+    }
+
     // Read config text file into string
     if (vm.count("local-config-file")) {
         std::ifstream f(local_config_file.c_str());
@@ -182,10 +335,10 @@ int main(int argc, char **argv) {
 
     if (use_stdout) {
         ISMRMRD::set_binary_io();
-        serialize_to_stream(input_file, groupname, image_series, std::cout, config_file, config_text);
+        serialize_to_stream(input_file, groupname, image_series, std::cout, config_file, config_text, compression, compression_level, quantization, batch_size, block_size, buffer_depth, stats);
     } else if (output_file != "") {
         std::ofstream out(output_file.c_str(), std::ios::out | std::ios::binary);
-        serialize_to_stream(input_file, groupname, image_series, out, config_file, config_text);
+        serialize_to_stream(input_file, groupname, image_series, out, config_file, config_text, compression, compression_level, quantization, batch_size, block_size, buffer_depth, stats);
     } else {
         std::cerr << "Error: Must specify either output file or use-stdout" << std::endl;
         return 1;
@@ -0,0 +1,93 @@
+#include "ismrmrd/stream_index.h"
+
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace po = boost::program_options;
+
+void print_messages(const ISMRMRD::StreamIndex &index) {
+    const std::vector<ISMRMRD::StreamIndexMessage> &messages = index.messages();
+    for (size_t n = 0; n < messages.size(); n++) {
+        const ISMRMRD::StreamIndexMessage &msg = messages[n];
+        std::cout << n << "\t" << msg.offset << "\t" << msg.size << "\t" << ISMRMRD::message_name(msg.id);
+        if (msg.acquisitions) {
+            const ISMRMRD::StreamIndexAcquisition &acq = index.acquisitions()[msg.first_acquisition];
+            std::cout << "\tscan_counter " << acq.scan_counter << "\tslice " << acq.idx.slice << "\tline "
+                      << acq.idx.kspace_encode_step_1;
+            if (msg.acquisitions > 1) {
+                std::cout << "\t(" << msg.acquisitions << " acquisitions)";
+            }
+        } else if (msg.id == ISMRMRD::ISMRMRD_MESSAGE_IMAGE || msg.id == ISMRMRD::ISMRMRD_MESSAGE_COMPRESSED_IMAGE) {
+            std::cout << "\tseries " << msg.image_series_index << "\tindex " << msg.image_index;
+        }
+        std::cout << std::endl;
+    }
+}
+
+void print_summary(const ISMRMRD::StreamIndex &index) {
+    std::map<std::string, size_t> counts;
+    for (size_t n = 0; n < index.messages().size(); n++) {
+        counts[ISMRMRD::message_name(index.messages()[n].id)]++;
+    }
+    std::cout << index.stream_size() << " bytes, " << index.messages().size() << " messages, "
+              << index.acquisitions().size() << " acquisitions" << std::endl;
+    for (std::map<std::string, size_t>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+        std::cout << "  " << it->first << ": " << it->second << std::endl;
+    }
+    if (!index.closed()) {
+        std::cout << "The stream does not end with a close message" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string input_file;
+    std::string output_file;
+    bool rebuild = false;
+    bool list = false;
+
+    po::options_description desc("Allowed options");
+
+    // clang-format off
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("input,i", po::value<std::string>(&input_file)->required(), "Recorded stream file")
+        ("output,o", po::value<std::string>(&output_file), "Index file (default: the input file + .idx)")
+        ("rebuild", po::bool_switch(&rebuild), "Scan the stream even if its index is up to date")
+        ("list", po::bool_switch(&list), "List the messages of the stream");
+    // clang-format on
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cerr << desc << "\n";
+            return 1;
+        }
+        po::notify(vm);
+    } catch (po::error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    try {
+        ISMRMRD::StreamIndex index;
+        if (output_file.empty() && !rebuild) {
+            index.open(input_file);
+        } else {
+            index.build(input_file);
+            index.save(output_file.empty() ? ISMRMRD::StreamIndex::sidecar_path(input_file) : output_file);
+        }
+        print_summary(index);
+        if (list) {
+            print_messages(index);
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,346 @@
+#include "ismrmrd/dataset.h"
+#include "ismrmrd/serialization_iostream.h"
+#include "ismrmrd/stream_reader.h"
+#include "ismrmrd_io_utils.h"
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+// Length of a tick of acquisition_time_stamp and waveform time_stamp
+const double TICK_SECONDS = 0.0025;
+
+// Messages to replay, in order
+class MessageSource {
+public:
+    virtual ~MessageSource() {}
+    // Reads the next message into msg, returns false after the last one
+    virtual bool next(ISMRMRD::StreamMessage &msg) = 0;
+};
+
+// The messages of a recorded stream, up to its close message
+class StreamSource : public MessageSource {
+public:
+    explicit StreamSource(std::istream &is) : _rs(is), _deserializer(_rs) {}
+
+    bool next(ISMRMRD::StreamMessage &msg) {
+        return ISMRMRD::read_message(_deserializer, msg);
+    }
+
+private:
+    ISMRMRD::IStreamView _rs;
+    ISMRMRD::ProtocolDeserializer _deserializer;
+};
+
+// The header, acquisitions and waveforms of an HDF5 dataset, merged by
+// timestamp like ismrmrd_hdf5_to_stream does: a waveform goes before the
+// first acquisition that is not earlier.
+class DatasetSource : public MessageSource {
+public:
+    DatasetSource(ISMRMRD::Dataset &d, uint32_t block_size)
+        : _d(d), _block_size(std::max<uint32_t>(block_size, 1)), _header(true),
+          _acquisitions(d.getNumberOfAcquisitions()), _waveforms(d.getNumberOfWaveforms()), _a(0), _a_first(0),
+          _w(0), _w_first(0) {}
+
+    bool next(ISMRMRD::StreamMessage &msg) {
+        if (_header) {
+            _header = false;
+            std::string xml;
+            try {
+                _d.readHeader(xml);
+            } catch (std::runtime_error &) {
+                // Datasets without a header are replayed without one
+            }
+            if (!xml.empty()) {
+                ISMRMRD::deserialize(xml.c_str(), msg.header);
+                msg.id = ISMRMRD::ISMRMRD_MESSAGE_HEADER;
+                return true;
+            }
+        }
+        bool acquisition = fetch(_a, _a_first, _acquisitions, _acquisition_block);
+        bool waveform = fetch(_w, _w_first, _waveforms, _waveform_block);
+        if (waveform && !(acquisition && _acquisition_block[_a - _a_first].getHead().acquisition_time_stamp <
+                                             _waveform_block[_w - _w_first].head.time_stamp)) {
+            msg.id = ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM;
+            msg.waveform = _waveform_block[_w++ - _w_first];
+            return true;
+        }
+        if (acquisition) {
+            msg.id = ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION;
+            msg.acquisition = _acquisition_block[_a++ - _a_first];
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // Reads the block holding element index, returns false if there are none left
+    template <typename T>
+    bool fetch(uint32_t index, uint32_t &first, uint32_t total, std::vector<T> &block) {
+        if (index >= total) {
+            return false;
+        }
+        if (index - first >= block.size()) {
+            read_block(index, std::min(_block_size, total - index), block);
+            first = index;
+        }
+        return true;
+    }
+
+    void read_block(uint32_t index, uint32_t count, std::vector<ISMRMRD::Acquisition> &block) {
+        _d.readAcquisitions(index, count, block);
+    }
+
+    void read_block(uint32_t index, uint32_t count, std::vector<ISMRMRD::Waveform> &block) {
+        _d.readWaveforms(index, count, block);
+    }
+
+    ISMRMRD::Dataset &_d;
+    uint32_t _block_size;
+    bool _header;
+    uint32_t _acquisitions;
+    uint32_t _waveforms;
+    // Next acquisition and waveform, and the first one of the block read
+    uint32_t _a;
+    uint32_t _a_first;
+    uint32_t _w;
+    uint32_t _w_first;
+    std::vector<ISMRMRD::Acquisition> _acquisition_block;
+    std::vector<ISMRMRD::Waveform> _waveform_block;
+};
+
+// Timestamp the emission of a message is paced by, false for messages sent
+// right away. An acquisition batch is sent when its last acquisition would
+// have been.
+bool pacing_time_stamp(const ISMRMRD::StreamMessage &msg, uint32_t &time_stamp) {
+    switch (msg.id) {
+    case ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION:
+        time_stamp = msg.acquisition.getHead().acquisition_time_stamp;
+        return true;
+    case ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION_BATCH:
+        if (msg.acquisitions.empty()) {
+            return false;
+        }
+        time_stamp = msg.acquisitions.back().getHead().acquisition_time_stamp;
+        return true;
+    case ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM:
+        time_stamp = msg.waveform.head.time_stamp;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Emission times of the paced messages, relative to the first one
+struct ReplayStatistics {
+    ReplayStatistics() : count(0), late(0), total_lag(0), max_lag(0), target(0), achieved(0) {}
+    size_t count;
+    // Sent more than a (sped up) tick after their target time
+    size_t late;
+    double total_lag;
+    double max_lag;
+    // Of the last message
+    double target;
+    double achieved;
+};
+
+// Sends the messages of source, each paced message at the time its timestamp
+// is after the first one, divided by speed, or as fast as possible with
+// max_rate. Timestamps that go back (e.g. a new measurement) are sent right
+// after the previous message and pacing continues from them. If log is given,
+// a line with the target and achieved time of every paced message is written
+// to it.
+ReplayStatistics replay(MessageSource &source, std::ostream &os, const std::string &config_file,
+                        const std::string &config_text, double speed, bool max_rate, std::ostream *log) {
+    ISMRMRD::OStreamView ws(os);
+    ISMRMRD::ProtocolSerializer serializer(ws);
+    ReplayStatistics stats;
+
+    if (config_file.size()) {
+        ISMRMRD::ConfigFile cfg;
+        strncpy(cfg.config, config_file.c_str(), sizeof(cfg.config) - 1);
+        cfg.config[sizeof(cfg.config) - 1] = '\0';
+        serializer.serialize(cfg);
+    }
+    if (config_text.size()) {
+        ISMRMRD::ConfigText cfg;
+        cfg.config_text = config_text;
+        serializer.serialize(cfg);
+    }
+    ws.flush();
+
+    if (log) {
+        *log << "message,time_stamp,target_s,achieved_s,lag_ms" << std::endl;
+    }
+
+    ISMRMRD::StreamMessage msg;
+    Clock::time_point start;
+    double target = 0;
+    uint32_t last_time_stamp = 0;
+    while (source.next(msg)) {
+        uint32_t time_stamp;
+        if (!pacing_time_stamp(msg, time_stamp)) {
+            ISMRMRD::write_message(serializer, msg);
+            ws.flush();
+            continue;
+        }
+
+        if (stats.count == 0) {
+            start = Clock::now();
+        } else if (time_stamp >= last_time_stamp) {
+            // Accumulated from the previous target, so a late message does not delay the following ones
+            target += (time_stamp - last_time_stamp) * TICK_SECONDS / speed;
+        }
+        last_time_stamp = time_stamp;
+        if (!max_rate) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>(target)));
+        }
+
+        ISMRMRD::write_message(serializer, msg);
+        ws.flush();
+        double achieved = std::chrono::duration<double>(Clock::now() - start).count();
+
+        double lag = achieved - target;
+        stats.count++;
+        stats.late += lag > TICK_SECONDS / speed ? 1 : 0;
+        stats.total_lag += lag;
+        stats.max_lag = std::max(stats.max_lag, lag);
+        stats.target = target;
+        stats.achieved = achieved;
+        if (log) {
+            *log << ISMRMRD::message_name(msg.id) << "," << time_stamp << "," << target << "," << achieved << ","
+                 << lag * 1e3 << "\n";
+        }
+    }
+    serializer.close();
+    return stats;
+}
+
+void print_statistics(const ReplayStatistics &stats, std::ostream &os) {
+    os << "Replayed " << stats.count << " paced messages in " << stats.achieved << " s (target " << stats.target
+       << " s)";
+    if (stats.count) {
+        os << ", lag mean " << stats.total_lag / stats.count * 1e3 << " ms, max " << stats.max_lag * 1e3
+           << " ms, " << stats.late << " more than a tick late";
+    }
+    os << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::string input_file;
+    std::string output_file;
+    std::string groupname;
+    bool stream_input = false;
+    bool use_stdout = false;
+    std::string config_file;
+    std::string local_config_file;
+    std::string config_text;
+    double speed = 1;
+    bool max_rate = false;
+    std::string log_file;
+    uint32_t block_size = 64;
+
+    po::options_description desc("Allowed options");
+
+    // clang-format off
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("input,i", po::value<std::string>(&input_file)->required(), "ISMRMRD HDF5 file, or recorded stream with --stream-input")
+        ("stream-input", po::bool_switch(&stream_input), "The input is a recorded MRD stream")
+        ("group,g", po::value<std::string>(&groupname)->default_value("dataset"), "group name of an HDF5 input")
+        ("output,o", po::value<std::string>(&output_file), "Binary output file")
+        ("use-stdout", po::bool_switch(&use_stdout), "Use stdout for output")
+        ("config-file,c", po::value<std::string>(&config_file), "Configuration name (aka config file)")
+        ("local-config-file,C", po::value<std::string>(&local_config_file), "Configuration text file")
+        ("speed", po::value<double>(&speed)->default_value(1), "Replay this many times faster than the data was acquired")
+        ("max-rate", po::bool_switch(&max_rate), "Send the messages as fast as possible, without pacing")
+        ("log", po::value<std::string>(&log_file), "Write the target and achieved time of every paced message to this CSV file")
+        ("block-size", po::value<uint32_t>(&block_size)->default_value(64), "Acquisitions or waveforms read from an HDF5 input at a time");
+    // clang-format on
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (boost::wrapexcept<po::required_option> &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help")) {
+        std::cerr << desc << "\n";
+        return 1;
+    }
+
+    if (vm.count("output") && use_stdout) {
+        std::cerr << "Error: Cannot specify both output file and use-stdout" << std::endl;
+        return 1;
+    }
+
+    if (vm.count("config-file") && vm.count("local-config-file")) {
+        std::cerr << "Error: Cannot specify both config-name and config-text-file" << std::endl;
+        return 1;
+    }
+
+    if (!(speed > 0)) {
+        std::cerr << "Error: The speed must be positive" << std::endl;
+        return 1;
+    }
+
+    if (vm.count("local-config-file")) {
+        std::ifstream f(local_config_file.c_str());
+        std::stringstream buffer;
+        buffer << f.rdbuf();
+        config_text = buffer.str();
+    }
+
+    std::ofstream log;
+    if (vm.count("log")) {
+        log.open(log_file.c_str());
+        if (!log) {
+            std::cerr << "Error: Could not open log file " << log_file << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream out;
+    if (use_stdout) {
+        ISMRMRD::set_binary_io();
+    } else if (output_file != "") {
+        out.open(output_file.c_str(), std::ios::out | std::ios::binary);
+    } else {
+        std::cerr << "Error: Must specify either output file or use-stdout" << std::endl;
+        return 1;
+    }
+    std::ostream &os = use_stdout ? std::cout : out;
+    std::ostream *log_ptr = log.is_open() ? &log : NULL;
+
+    ReplayStatistics stats;
+    if (stream_input) {
+        std::ifstream is(input_file.c_str(), std::ios::binary);
+        if (!is) {
+            std::cerr << "Error: Could not open input file " << input_file << std::endl;
+            return 1;
+        }
+        StreamSource source(is);
+        stats = replay(source, os, config_file, config_text, speed, max_rate, log_ptr);
+    } else {
+        ISMRMRD::Dataset d(input_file.c_str(), groupname.c_str(), ISMRMRD::DATASET_READ_ONLY);
+        DatasetSource source(d, block_size);
+        stats = replay(source, os, config_file, config_text, speed, max_rate, log_ptr);
+    }
+    print_statistics(stats, std::cerr);
+
+    return 0;
+}
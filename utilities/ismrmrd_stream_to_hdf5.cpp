@@ -1,17 +1,21 @@
 #include "ismrmrd/dataset.h"
+#include "ismrmrd/dataset_rollover.h"
 #include "ismrmrd/serialization_iostream.h"
+#include "ismrmrd/stream_reader.h"
 #include "ismrmrd_io_utils.h"
+
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <fstream>
 #include <iostream>
+#include <map>
 
 namespace po = boost::program_options;
 
-template <typename T>
-std::string create_image_series_name(const ISMRMRD::Image<T> &img) {
+std::string create_image_series_name(uint16_t image_series_index) {
     std::stringstream ss;
     ss.imbue(std::locale::classic());
-    ss << "image_" << img.getHead().image_series_index;
+    ss << "image_" << image_series_index;
     return ss.str();
 }
 
@@ -25,127 +29,302 @@ std::string create_nd_array_name(const ISMRMRD::NDArray<T> &arr) {
     return ss.str();
 }
 
-void convert_stream_to_hdf5(std::string output_file, std::string groupname, std::istream &is) {
-    ISMRMRD::Dataset d(output_file.c_str(), groupname.c_str(), true);
+// Consecutive messages appended to the dataset together: acquisitions (or
+// one acquisition batch message), waveforms, or images of one series with
+// the same data type and size. Any other message is a batch of its own, in
+// message. The vectors keep their storage between batches, only the first
+// count entries belong to the batch.
+struct MessageBatch {
+    MessageBatch() : id(0), data_type(0), count(0) {}
 
-    ISMRMRD::IStreamView rs(is);
-    ISMRMRD::ProtocolDeserializer deserializer(rs);
-
-    // Some reconstructions return the header but it is not required.
-    if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_HEADER) {
-        ISMRMRD::IsmrmrdHeader hdr;
-        deserializer.deserialize(hdr);
-
-        // We will convert the XML header to a string and write it to the HDF5 file
-        std::stringstream xmlstream(std::ios::out | std::ios::binary);
-        ISMRMRD::serialize(hdr, xmlstream);
-        d.writeHeader(xmlstream.str());
-    }
-
-    while (deserializer.peek() != ISMRMRD::ISMRMRD_MESSAGE_CLOSE) {
-        if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION) {
-            ISMRMRD::Acquisition acq;
-            deserializer.deserialize(acq);
-            d.appendAcquisition(acq);
-        } else if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_IMAGE) {
-            if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_USHORT) {
-                ISMRMRD::Image<unsigned short> img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_SHORT) {
-                ISMRMRD::Image<short> img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_UINT) {
-                ISMRMRD::Image<unsigned int> img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_INT) {
-                ISMRMRD::Image<int> img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_FLOAT) {
-                ISMRMRD::Image<float> img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_DOUBLE) {
-                ISMRMRD::Image<double> img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_CXFLOAT) {
-                ISMRMRD::Image<std::complex<float> > img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else if (deserializer.peek_image_data_type() == ISMRMRD::ISMRMRD_CXDOUBLE) {
-                ISMRMRD::Image<std::complex<double> > img;
-                deserializer.deserialize(img);
-                d.appendImage(create_image_series_name(img), img);
-            } else {
-                throw std::runtime_error("Unknown image type");
+    // ISMRMRD_MESSAGE_ACQUISITION for acquisition batch messages too
+    uint16_t id;
+    // ISMRMRD_DataTypes of the images
+    int data_type;
+    size_t count;
+
+    std::vector<ISMRMRD::Acquisition> acquisitions;
+    std::vector<ISMRMRD::Waveform> waveforms;
+    ISMRMRD::StreamMessage message;
+
+    template <typename T> std::vector<ISMRMRD::Image<T> > &images();
+
+private:
+    std::vector<ISMRMRD::Image<uint16_t> > _ushort_images;
+    std::vector<ISMRMRD::Image<int16_t> > _short_images;
+    std::vector<ISMRMRD::Image<uint32_t> > _uint_images;
+    std::vector<ISMRMRD::Image<int32_t> > _int_images;
+    std::vector<ISMRMRD::Image<float> > _float_images;
+    std::vector<ISMRMRD::Image<double> > _double_images;
+    std::vector<ISMRMRD::Image<complex_float_t> > _cxfloat_images;
+    std::vector<ISMRMRD::Image<complex_double_t> > _cxdouble_images;
+};
+
+template <> std::vector<ISMRMRD::Image<uint16_t> > &MessageBatch::images<uint16_t>() { return _ushort_images; }
+template <> std::vector<ISMRMRD::Image<int16_t> > &MessageBatch::images<int16_t>() { return _short_images; }
+template <> std::vector<ISMRMRD::Image<uint32_t> > &MessageBatch::images<uint32_t>() { return _uint_images; }
+template <> std::vector<ISMRMRD::Image<int32_t> > &MessageBatch::images<int32_t>() { return _int_images; }
+template <> std::vector<ISMRMRD::Image<float> > &MessageBatch::images<float>() { return _float_images; }
+template <> std::vector<ISMRMRD::Image<double> > &MessageBatch::images<double>() { return _double_images; }
+template <> std::vector<ISMRMRD::Image<complex_float_t> > &MessageBatch::images<complex_float_t>() { return _cxfloat_images; }
+template <> std::vector<ISMRMRD::Image<complex_double_t> > &MessageBatch::images<complex_double_t>() { return _cxdouble_images; }
+
+// The slot for the next entry of a batch, grown as needed
+template <typename T> T &batch_slot(std::vector<T> &v, size_t count) {
+    if (v.size() <= count) {
+        v.resize(count + 1);
+    }
+    return v[count];
+}
+
+// Decodes the stream on a background thread into batches of up to batch_size
+// messages, up to depth batches ahead of the HDF5 writer. A batch is closed
+// when a message of another kind arrives, so the last batch of a run waits
+// for the following message.
+class BatchDecoder {
+public:
+    BatchDecoder(ISMRMRD::ReadableStreamView &rs, size_t batch_size, size_t depth,
+                 ISMRMRD::StreamStatistics *statistics)
+        : _deserializer(rs), _batch_size(std::max<size_t>(batch_size, 1)), _producer(std::max<size_t>(depth, 1)) {
+        _deserializer.set_statistics(statistics);
+        _producer.start([this](MessageBatch &batch) { return read(batch); });
+    }
+
+    // The next batch, valid until the following call, NULL once the close
+    // message has been read. An error of the decoder thread is rethrown here.
+    MessageBatch *next() {
+        return _producer.next();
+    }
+
+    BatchDecoder(const BatchDecoder &) = delete;
+    BatchDecoder &operator=(const BatchDecoder &) = delete;
+
+private:
+    template <typename T> void read_images(MessageBatch &batch) {
+        ISMRMRD::ImageHeader first = _deserializer.peek_image_header();
+        std::vector<ISMRMRD::Image<T> > &images = batch.images<T>();
+        do {
+            _deserializer.deserialize(batch_slot(images, batch.count++));
+        } while (batch.count < _batch_size && _deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_IMAGE &&
+                 same_image_layout(first, _deserializer.peek_image_header()));
+    }
+
+    // Images appended to the same variable with a single write
+    static bool same_image_layout(const ISMRMRD::ImageHeader &a, const ISMRMRD::ImageHeader &b) {
+        return a.image_series_index == b.image_series_index && a.data_type == b.data_type &&
+               a.channels == b.channels && std::equal(a.matrix_size, a.matrix_size + 3, b.matrix_size);
+    }
+
+    // Decodes the next batch, returns false at the close message
+    bool read(MessageBatch &batch) {
+        uint16_t id = _deserializer.peek();
+        batch.id = id;
+        batch.count = 0;
+        switch (id) {
+        case ISMRMRD::ISMRMRD_MESSAGE_CLOSE:
+            return false;
+        case ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION:
+            do {
+                _deserializer.deserialize(batch_slot(batch.acquisitions, batch.count++));
+            } while (batch.count < _batch_size && _deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION);
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION_BATCH:
+            _deserializer.deserialize(batch.acquisitions);
+            batch.id = ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION;
+            batch.count = batch.acquisitions.size();
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM:
+            do {
+                _deserializer.deserialize(batch_slot(batch.waveforms, batch.count++));
+            } while (batch.count < _batch_size && _deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM);
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_IMAGE:
+            batch.data_type = _deserializer.peek_image_data_type();
+            switch (batch.data_type) {
+            case ISMRMRD::ISMRMRD_USHORT: read_images<uint16_t>(batch); break;
+            case ISMRMRD::ISMRMRD_SHORT: read_images<int16_t>(batch); break;
+            case ISMRMRD::ISMRMRD_UINT: read_images<uint32_t>(batch); break;
+            case ISMRMRD::ISMRMRD_INT: read_images<int32_t>(batch); break;
+            case ISMRMRD::ISMRMRD_FLOAT: read_images<float>(batch); break;
+            case ISMRMRD::ISMRMRD_DOUBLE: read_images<double>(batch); break;
+            case ISMRMRD::ISMRMRD_CXFLOAT: read_images<complex_float_t>(batch); break;
+            case ISMRMRD::ISMRMRD_CXDOUBLE: read_images<complex_double_t>(batch); break;
+            default: throw std::runtime_error("Unknown image type");
+            }
+            break;
+        default:
+            ISMRMRD::read_message(_deserializer, batch.message);
+            batch.count = 1;
+            break;
+        }
+        return true;
+    }
+
+    ISMRMRD::ProtocolDeserializer _deserializer;
+    size_t _batch_size;
+    // Last, so that the thread is joined before the members it uses go away
+    ISMRMRD::BackgroundProducer<MessageBatch> _producer;
+};
+
+// Appends decoded batches to an ISMRMRD::Dataset or ISMRMRD::RolloverDataset
+template <typename OutputDataset>
+class BatchWriter {
+public:
+    explicit BatchWriter(OutputDataset &d) : _d(d), _first(true) {}
+
+    void write(MessageBatch &batch) {
+        bool first = _first;
+        _first = false;
+        switch (batch.id) {
+        case ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION:
+            _d.appendAcquisitions(batch.acquisitions.data(), batch.count);
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM:
+            _d.appendWaveforms(batch.waveforms.data(), batch.count);
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_IMAGE:
+            switch (batch.data_type) {
+            case ISMRMRD::ISMRMRD_USHORT: write_images<uint16_t>(batch); break;
+            case ISMRMRD::ISMRMRD_SHORT: write_images<int16_t>(batch); break;
+            case ISMRMRD::ISMRMRD_UINT: write_images<uint32_t>(batch); break;
+            case ISMRMRD::ISMRMRD_INT: write_images<int32_t>(batch); break;
+            case ISMRMRD::ISMRMRD_FLOAT: write_images<float>(batch); break;
+            case ISMRMRD::ISMRMRD_DOUBLE: write_images<double>(batch); break;
+            case ISMRMRD::ISMRMRD_CXFLOAT: write_images<complex_float_t>(batch); break;
+            case ISMRMRD::ISMRMRD_CXDOUBLE: write_images<complex_double_t>(batch); break;
+            }
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_NDARRAY:
+            switch (batch.message.data_type) {
+            case ISMRMRD::ISMRMRD_USHORT: write_ndarray<uint16_t>(batch.message); break;
+            case ISMRMRD::ISMRMRD_SHORT: write_ndarray<int16_t>(batch.message); break;
+            case ISMRMRD::ISMRMRD_UINT: write_ndarray<uint32_t>(batch.message); break;
+            case ISMRMRD::ISMRMRD_INT: write_ndarray<int32_t>(batch.message); break;
+            case ISMRMRD::ISMRMRD_FLOAT: write_ndarray<float>(batch.message); break;
+            case ISMRMRD::ISMRMRD_DOUBLE: write_ndarray<double>(batch.message); break;
+            case ISMRMRD::ISMRMRD_CXFLOAT: write_ndarray<complex_float_t>(batch.message); break;
+            case ISMRMRD::ISMRMRD_CXDOUBLE: write_ndarray<complex_double_t>(batch.message); break;
             }
-        } else if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM) {
-            ISMRMRD::Waveform wfm;
-            deserializer.deserialize(wfm);
-            d.appendWaveform(wfm);
-        } else if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_NDARRAY) {
-            if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_USHORT) {
-                ISMRMRD::NDArray<unsigned short> arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_SHORT) {
-                ISMRMRD::NDArray<short> arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_UINT) {
-                ISMRMRD::NDArray<unsigned int> arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_INT) {
-                ISMRMRD::NDArray<int> arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_FLOAT) {
-                ISMRMRD::NDArray<float> arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_DOUBLE) {
-                ISMRMRD::NDArray<double> arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_CXFLOAT) {
-                ISMRMRD::NDArray<std::complex<float> > arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else if (deserializer.peek_ndarray_data_type() == ISMRMRD::ISMRMRD_CXDOUBLE) {
-                ISMRMRD::NDArray<std::complex<double> > arr;
-                deserializer.deserialize(arr);
-                d.appendNDArray(create_nd_array_name(arr), arr);
-            } else {
-                throw std::runtime_error("Unknown nd array type");
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_TEXT:
+            std::cerr << "TEXT MESSAGE: " << batch.message.text.message << std::endl;
+            break;
+        case ISMRMRD::ISMRMRD_MESSAGE_HEADER:
+            // Some reconstructions return the header but it is not required.
+            if (first) {
+                // We will convert the XML header to a string and write it to the HDF5 file
+                std::stringstream xmlstream(std::ios::out | std::ios::binary);
+                ISMRMRD::serialize(batch.message.header, xmlstream);
+                _d.writeHeader(xmlstream.str());
+                break;
             }
-        } else if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_TEXT) {
-            ISMRMRD::TextMessage txt;
-            deserializer.deserialize(txt);
-            std::cerr << "TEXT MESSAGE: " << txt.message << std::endl;
-        } else {
+            // Fall through
+        default:
             std::stringstream ss;
-            ss << "Unknown message type " << deserializer.peek();
+            ss << "Unknown message type " << batch.id;
             throw std::runtime_error(ss.str());
         }
     }
 
+private:
+    template <typename T> void write_images(MessageBatch &batch) {
+        // All images of a batch belong to the same series
+        const std::vector<ISMRMRD::Image<T> > &images = batch.images<T>();
+        _d.appendImages(image_series_name(images[0].getHead().image_series_index), images.data(), batch.count);
+    }
+
+    template <typename T> void write_ndarray(const ISMRMRD::StreamMessage &msg) {
+        const ISMRMRD::NDArray<T> &arr = msg.ndarray<T>();
+        _d.appendNDArray(create_nd_array_name(arr), arr);
+    }
+
+    // Series names are built once per series rather than once per image
+    const std::string &image_series_name(uint16_t image_series_index) {
+        std::map<uint16_t, std::string>::iterator it = _series_names.find(image_series_index);
+        if (it == _series_names.end()) {
+            it = _series_names.insert(std::make_pair(image_series_index, create_image_series_name(image_series_index))).first;
+        }
+        return it->second;
+    }
+
+    OutputDataset &_d;
+    bool _first;
+    std::map<uint16_t, std::string> _series_names;
+};
+
+// Output is either an ISMRMRD::Dataset or an ISMRMRD::RolloverDataset
+template <typename OutputDataset>
+void convert_stream_to_hdf5(OutputDataset &d, std::istream &is, size_t batch_size, size_t queue_depth,
+                            ISMRMRD::StreamStatistics *statistics) {
+    ISMRMRD::IStreamView rs(is);
+    {
+        // Decoding the next batches overlaps with the HDF5 writes of the current one
+        BatchDecoder decoder(rs, batch_size, queue_depth, statistics);
+        BatchWriter<OutputDataset> writer(d);
+        while (MessageBatch *batch = decoder.next()) {
+            writer.write(*batch);
+        }
+    }
+
     // If we can read any more at this point, it is an error
     if (is.get() != EOF) {
         throw std::runtime_error("Extra data after ISMRMRD_CLOSE");
     }
 }
 
+// Parses a comma separated list of encoding counter names, e.g. "slice,contrast,kspace_encode_step_1"
+std::vector<ISMRMRD::ISMRMRD_EncodingCounterKeys> parse_sort_keys(const std::string &list) {
+    static const char *names[] = {"kspace_encode_step_1", "kspace_encode_step_2", "average", "slice", "contrast",
+                                  "phase", "repetition", "set", "segment"};
+    std::vector<ISMRMRD::ISMRMRD_EncodingCounterKeys> keys;
+    std::stringstream ss(list);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        int key = -1;
+        for (int n = 0; n < ISMRMRD::ISMRMRD_IDX_USER_0; n++) {
+            if (name == names[n])
+                key = n;
+        }
+        if (name.size() == 5 && name.compare(0, 4, "user") == 0 && name[4] >= '0' && name[4] < '0' + ISMRMRD::ISMRMRD_USER_INTS)
+            key = ISMRMRD::ISMRMRD_IDX_USER_0 + (name[4] - '0');
+        if (key < 0)
+            throw std::runtime_error("Unknown encoding counter " + name);
+        keys.push_back(static_cast<ISMRMRD::ISMRMRD_EncodingCounterKeys>(key));
+    }
+    return keys;
+}
+
+void convert_stream_to_hdf5(std::string output_file, std::string groupname, uint64_t rollover_bytes,
+                            uint32_t rollover_acquisitions, const std::string &sort_keys, std::istream &is,
+                            size_t batch_size, size_t queue_depth, ISMRMRD::StreamStatistics *statistics) {
+    if (!sort_keys.empty()) {
+        std::vector<ISMRMRD::ISMRMRD_EncodingCounterKeys> keys = parse_sort_keys(sort_keys);
+        ISMRMRD::Dataset d(output_file.c_str(), groupname.c_str(), true);
+        convert_stream_to_hdf5(d, is, batch_size, queue_depth, statistics);
+        d.sortAcquisitions(keys);
+    } else if (rollover_bytes > 0 || rollover_acquisitions > 0) {
+        ISMRMRD::RolloverDataset d(output_file.c_str(), groupname.c_str(), rollover_bytes, rollover_acquisitions);
+        convert_stream_to_hdf5(d, is, batch_size, queue_depth, statistics);
+        d.close();
+        std::cerr << "Wrote " << d.getNumberOfParts() << " parts, manifest " << d.getManifestFilename() << std::endl;
+    } else {
+        ISMRMRD::Dataset d(output_file.c_str(), groupname.c_str(), true);
+        convert_stream_to_hdf5(d, is, batch_size, queue_depth, statistics);
+    }
+}
+
 int main(int argc, char **argv) {
     // Arguments
     std::string input_file = "";
     std::string output_file;
     std::string groupname;
     bool use_stdin = false;
+    uint64_t rollover_bytes = 0;
+    uint32_t rollover_acquisitions = 0;
+    std::string sort_keys;
+    size_t batch_size = 64;
+    size_t queue_depth = 4;
+    bool stats = false;
 
     // Parse arguments using boost program options
     po::options_description desc("Allowed options");
@@ -156,7 +335,13 @@ int main(int argc, char **argv) {
         ("input,i", po::value<std::string>(&input_file),"Binary input file")
         ("output,o", po::value<std::string>(&output_file)->required(),"ISMRMRD HDF5 output file")
         ("use-stdin", po::bool_switch(&use_stdin), "Use stdout for output")
-        ("group,g", po::value<std::string>(&groupname)->default_value("dataset"), "group name");
+        ("group,g", po::value<std::string>(&groupname)->default_value("dataset"), "group name")
+        ("rollover-bytes", po::value<uint64_t>(&rollover_bytes), "Start a new output file after this many bytes of data")
+        ("rollover-acquisitions", po::value<uint32_t>(&rollover_acquisitions), "Start a new output file after this many acquisitions")
+        ("sort-acquisitions", po::value<std::string>(&sort_keys), "Store acquisitions sorted by these encoding counters, e.g. slice,contrast,kspace_encode_step_1")
+        ("batch-size", po::value<size_t>(&batch_size)->default_value(64), "Consecutive messages of one type appended to the file with a single write")
+        ("queue-depth", po::value<size_t>(&queue_depth)->default_value(4), "Batches decoded ahead of the file writer")
+        ("stats", po::bool_switch(&stats), "Print the count, size and time of the messages received to stderr");
     // clang-format on
 
     po::variables_map vm;
@@ -174,25 +359,42 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (!sort_keys.empty() && (rollover_bytes > 0 || rollover_acquisitions > 0)) {
+        std::cerr << "Error: Cannot combine sort-acquisitions with rollover" << std::endl;
+        return 1;
+    }
+
+    try {
+        parse_sort_keys(sort_keys);
+    } catch (std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
     if (vm.count("help")) {
         std::cerr << desc << "\n";
         return 1;
     }
 
+    ISMRMRD::StreamStatistics statistics;
+    ISMRMRD::StreamStatistics *statistics_ptr = stats ? &statistics : NULL;
     if (vm.count("input")) {
         std::ifstream is(input_file.c_str(), std::ios::binary);
         if (!is) {
             std::cerr << "Error: Could not open input file " << input_file << std::endl;
             return 1;
         }
-        convert_stream_to_hdf5(output_file, groupname, is);
+        convert_stream_to_hdf5(output_file, groupname, rollover_bytes, rollover_acquisitions, sort_keys, is, batch_size, queue_depth, statistics_ptr);
     } else if (use_stdin) {
         ISMRMRD::set_binary_io();
-        convert_stream_to_hdf5(output_file, groupname, std::cin);
+        convert_stream_to_hdf5(output_file, groupname, rollover_bytes, rollover_acquisitions, sort_keys, std::cin, batch_size, queue_depth, statistics_ptr);
     } else {
         std::cerr << "Error: Must specify either input file or use-stdin" << std::endl;
         return 1;
     }
+    if (stats) {
+        statistics.print(std::cerr);
+    }
 
     return 0;
 }
@@ -1,6 +1,7 @@
 #include "fftw3.h"
 #include "ismrmrd/meta.h"
 #include "ismrmrd/serialization_iostream.h"
+#include "ismrmrd/stream_reader.h"
 #include "ismrmrd_io_utils.h"
 #include <boost/program_options.hpp>
 #include <fstream>
@@ -21,30 +22,42 @@ void circshift(complex_float_t *out, const complex_float_t *in, int xdim, int yd
 
 #define fftshift(out, in, x, y) circshift(out, in, x, y, (x / 2), (y / 2))
 
-void reconstruct(std::istream &in, std::ostream &out, bool magnitude = false) {
+// Statistics, if given, count the messages received and sent. Latency, if
+// given, records the time from the last acquisition of each image to the image
+// being sent, and with latency_text its summary is sent as a text message.
+void reconstruct(std::istream &in, std::ostream &out, bool magnitude = false,
+                 ISMRMRD::StreamStatistics *received = NULL, ISMRMRD::StreamStatistics *sent = NULL,
+                 ISMRMRD::LatencyStatistics *latency = NULL, bool latency_text = false) {
     ISMRMRD::IStreamView rs(in);
     ISMRMRD::OStreamView ws(out);
 
-    ISMRMRD::ProtocolDeserializer deserializer(rs);
     ISMRMRD::ProtocolSerializer serializer(ws);
+    serializer.set_statistics(sent);
 
-    if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_CONFIG_FILE) {
-        ISMRMRD::ConfigFile cfg;
-        deserializer.deserialize(cfg);
-        std::string config_name(cfg.config);
+    // Decode on a background thread, so that reading the next acquisitions overlaps
+    // with copying the current one. Waveforms are not used by this reconstruction.
+    std::set<uint16_t> skipped;
+    skipped.insert(ISMRMRD::ISMRMRD_MESSAGE_WAVEFORM);
+    ISMRMRD::StreamReader reader(rs, 64, skipped, received);
+    ISMRMRD::StreamMessage *msg = reader.next();
+
+    if (msg && msg->id == ISMRMRD::ISMRMRD_MESSAGE_CONFIG_FILE) {
+        std::string config_name(msg->config_file.config);
         std::cerr << "Reconstruction received config file: " << config_name << std::endl;
         std::cerr << "Configuration file is ignored in this sample reconstruction" << std::endl;
+        msg = reader.next();
     }
 
-    if (deserializer.peek() == ISMRMRD::ISMRMRD_MESSAGE_TEXT) {
-        ISMRMRD::TextMessage msg;
-        deserializer.deserialize(msg);
+    if (msg && msg->id == ISMRMRD::ISMRMRD_MESSAGE_TEXT) {
         std::cerr << "Reconstruction received text message prior to config: " << std::endl
-                  << msg.message << std::endl;
+                  << msg->text.message << std::endl;
+        msg = reader.next();
     }
 
-    ISMRMRD::IsmrmrdHeader hdr;
-    deserializer.deserialize(hdr);
+    if (!msg || msg->id != ISMRMRD::ISMRMRD_MESSAGE_HEADER) {
+        throw std::runtime_error("Expected an MRD header message");
+    }
+    ISMRMRD::IsmrmrdHeader hdr = msg->header;
 
     if (hdr.encoding.size() != 1) {
         throw std::runtime_error("This simple reconstruction application only supports one encoding space");
@@ -62,17 +75,10 @@ void reconstruct(std::istream &in, std::ostream &out, bool magnitude = false) {
     uint16_t nCoils = 0;
     ISMRMRD::NDArray<complex_float_t> buffer;
     ISMRMRD::AcquisitionHeader acqhdr;
-    while (std::cin) {
-        ISMRMRD::Acquisition acq;
-        try {
-            deserializer.deserialize(acq);
-        } catch (ISMRMRD::ProtocolStreamClosed &) {
-            break;
-        }
-
+    auto add_acquisition = [&](const ISMRMRD::AcquisitionView &acq) {
         if (!nCoils) {
-            nCoils = acq.active_channels();
-            acqhdr = acq.getHead();
+            nCoils = acq.head->active_channels;
+            acqhdr = *acq.head;
 
             // Allocate a buffer for the data
             std::vector<size_t> dims;
@@ -84,7 +90,23 @@ void reconstruct(std::istream &in, std::ostream &out, bool magnitude = false) {
         }
 
         for (uint16_t c = 0; c < nCoils; c++) {
-            memcpy(&buffer(0, acq.idx().kspace_encode_step_1, c), &acq.data(0, c), sizeof(complex_float_t) * nX);
+            memcpy(&buffer(0, acq.head->idx.kspace_encode_step_1, c), acq.data + c * acq.head->number_of_samples,
+                   sizeof(complex_float_t) * nX);
+        }
+    };
+    // This reconstruction makes a single image of all acquisitions, so they share one latency key
+    const uint64_t image_key = 0;
+    while ((msg = reader.next()) != NULL) {
+        if (latency && (msg->id == ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION ||
+                        msg->id == ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION_BATCH)) {
+            latency->received(image_key, msg->received);
+        }
+        if (msg->id == ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION) {
+            add_acquisition(msg->acquisition);
+        } else if (msg->id == ISMRMRD::ISMRMRD_MESSAGE_ACQUISITION_BATCH) {
+            for (auto &acq : msg->acquisitions) {
+                add_acquisition(acq);
+            }
         }
     }
 
@@ -147,20 +169,34 @@ void reconstruct(std::istream &in, std::ostream &out, bool magnitude = false) {
 
     // If this we want magnitude:
     if (magnitude) {
-        ISMRMRD::Image<float> float_img_out(img_out.getMatrixSizeX(), img_out.getMatrixSizeY(), 1, 1);
+        // Sent from a plain buffer, with the attributes of the complex image
+        std::vector<float> magnitudes(img_out.getNumberOfDataElements());
+        for (size_t i = 0; i < magnitudes.size(); i++) {
+            magnitudes[i] = std::abs(img_out.getDataPtr()[i]);
+        }
         ISMRMRD::ImageHeader head = img_out.getHead();
         head.image_type = ISMRMRD::ISMRMRD_IMTYPE_MAGNITUDE;
         head.data_type = ISMRMRD::ISMRMRD_FLOAT;
-        float_img_out.setHead(head);
-        float_img_out.setAttributeString(meta_string_stream.str().c_str());
-        for (size_t i = 0; i < img_out.getNumberOfDataElements(); i++) {
-            float_img_out.getDataPtr()[i] = std::abs(img_out.getDataPtr()[i]);
-        }
-        serializer.serialize(float_img_out);
+        serializer.serialize(ISMRMRD::ImageView<float>(head, magnitudes.data(), img_out.getAttributeString()));
     } else {
         serializer.serialize(img_out);
     }
 
+    if (latency) {
+        // Sent once the image has been handed to the output stream
+        double seconds = latency->sent(image_key, ISMRMRD::StreamStatistics::now());
+        if (seconds >= 0) {
+            std::cerr << "Image " << img_out.getImageIndex() << " latency " << seconds * 1e3 << " ms" << std::endl;
+        }
+        if (latency_text) {
+            std::stringstream summary;
+            latency->print(summary);
+            ISMRMRD::TextMessage txt;
+            txt.message = summary.str();
+            serializer.serialize(txt);
+        }
+    }
+
     serializer.close();
 }
 
@@ -174,6 +210,9 @@ int main(int argc, char **argv) {
     bool use_stdin = false;
     bool use_stdout = false;
     bool output_magnitude = false; // Default output images is complex float
+    bool stats = false;
+    bool latency = false;
+    bool latency_text = false;
     // clang-format off
     desc.add_options()
         ("help,h", "produce help message")
@@ -181,7 +220,10 @@ int main(int argc, char **argv) {
         ("output,o", po::value<std::string>(&output_file),"Binary output file")
         ("use-stdout", po::bool_switch(&use_stdout), "Use stdout for output")
         ("use-stdin", po::bool_switch(&use_stdin), "Use stdout for output")
-        ("output-magnitude", po::bool_switch(&output_magnitude), "Output magnitude images");
+        ("output-magnitude", po::bool_switch(&output_magnitude), "Output magnitude images")
+        ("stats", po::bool_switch(&stats), "Print the count, size and time of the messages received and sent to stderr")
+        ("latency", po::bool_switch(&latency), "Print the time from the last acquisition of each image to the image being sent, and their percentiles, to stderr")
+        ("latency-text", po::bool_switch(&latency_text), "Also send the latency percentiles as a text message before closing the output");
     // clang-format on
 
     po::variables_map vm;
@@ -203,25 +245,42 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    ISMRMRD::StreamStatistics received, sent;
+    ISMRMRD::StreamStatistics *received_ptr = stats ? &received : NULL;
+    ISMRMRD::StreamStatistics *sent_ptr = stats ? &sent : NULL;
+    ISMRMRD::LatencyStatistics latencies;
+    ISMRMRD::LatencyStatistics *latency_ptr = latency || latency_text ? &latencies : NULL;
+
     if (use_stdin && use_stdout) {
         ISMRMRD::set_binary_io();
-        reconstruct(std::cin, std::cout, output_magnitude);
+        reconstruct(std::cin, std::cout, output_magnitude, received_ptr, sent_ptr, latency_ptr, latency_text);
     } else if (input_file.size() && output_file.size()) {
         std::ifstream input(input_file.c_str(), std::ios::in | std::ios::binary);
         std::ofstream output(output_file.c_str(), std::ios::out | std::ios::binary);
-        reconstruct(input, output, output_magnitude);
+        reconstruct(input, output, output_magnitude, received_ptr, sent_ptr, latency_ptr, latency_text);
     } else if (input_file.size() && use_stdout) {
         ISMRMRD::set_binary_io();
         std::ifstream input(input_file.c_str(), std::ios::in | std::ios::binary);
-        reconstruct(input, std::cout, output_magnitude);
+        reconstruct(input, std::cout, output_magnitude, received_ptr, sent_ptr, latency_ptr, latency_text);
     } else if (output_file.size() && use_stdin) {
         ISMRMRD::set_binary_io();
         std::ofstream output(output_file.c_str(), std::ios::out | std::ios::binary);
-        reconstruct(std::cin, output, output_magnitude);
+        reconstruct(std::cin, output, output_magnitude, received_ptr, sent_ptr, latency_ptr, latency_text);
     } else {
         std::cerr << "Error: Must specify either input file and output file or use-stdin and use-stdout" << std::endl;
         return 1;
     }
 
+    // The reader thread has finished once reconstruct returns
+    if (stats) {
+        std::cerr << "Received:" << std::endl;
+        received.print(std::cerr);
+        std::cerr << "Sent:" << std::endl;
+        sent.print(std::cerr);
+    }
+    if (latency_ptr) {
+        latencies.print(std::cerr);
+    }
+
     return 0;
 }